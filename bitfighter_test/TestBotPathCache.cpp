@@ -0,0 +1,281 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "BotPathCache.h"
+#include "BotNavMeshZone.h"
+#include "BotZoneHierarchy.h"
+#include "CoreGame.h"
+#include "PathRequestBatch.h"
+#include "ServerGame.h"
+#include "stringUtils.h"
+
+#include "tnlRandom.h"
+#include "tnlThread.h"
+
+#include "TestUtils.h"
+
+#include "gtest/gtest.h"
+
+namespace Zap
+{
+
+// Loads a bundled level and builds its bot zones into the game's zone database
+static bool buildZones(ServerGame *game, const string &levelFile, Vector<BotNavMeshZone *> &zones)
+{
+   GridDatabase *db = game->getGameObjDatabase();
+   game->loadLevelFromString(readFile(joindir("levels", levelFile)), db);
+
+   Rect extents = db->getExtents();
+
+   return BotNavMeshZone::buildBotMeshZones(game->getBotZoneDatabase(), db, &zones, &extents, false) && zones.size() > 1;
+}
+
+
+// Plays out 32 bots on each bundled level, each of them replanning toward one of a few shared goals from wherever
+// they have wandered to; the shared path cache must get them wherever plain AStar searches do
+TEST(BotPathCacheTest, BundledLevelsCacheMatchesSearch)
+{
+   const S32 BotCount = 32;
+   const S32 ReplansPerBot = 50;
+   const S32 GoalCount = 4;      // Flags, nexus, goal zones...
+
+   const string extensions[] = { "level" };
+   Vector<string> levels;
+   getFilesFromFolder("levels", levels, extensions, ARRAYSIZE(extensions));
+
+   ASSERT_TRUE(levels.size() > 0) << "No levels found to test with!";
+
+   for(S32 i = 0; i < levels.size(); i++)
+   {
+      ServerGame *game = newServerGame();
+      Vector<BotNavMeshZone *> zones;
+
+      if(!buildZones(game, levels[i], zones))
+      {
+         delete game;
+         continue;
+      }
+
+      U16 goals[GoalCount];
+      for(S32 j = 0; j < GoalCount; j++)
+         goals[j] = U16(TNL::Random::readI(0, zones.size() - 1));
+
+      Vector<pair<U16, U16> > requests;
+      for(S32 j = 0; j < BotCount * ReplansPerBot; j++)
+         requests.push_back(pair<U16, U16>(U16(TNL::Random::readI(0, zones.size() - 1)), goals[j % BotCount % GoalCount]));
+
+      Vector<Vector<Point> > searched;
+      searched.resize(requests.size());
+
+      AStar search;
+
+      for(S32 j = 0; j < requests.size(); j++)
+         search.findPath(&zones, requests[j].first, requests[j].second, zones[requests[j].second]->getCenter(), searched[j]);
+
+      BotPathCache cache;
+      cache.reset(&zones);
+
+      Vector<Vector<Point> > cached;
+      cached.resize(requests.size());
+
+      for(S32 j = 0; j < requests.size(); j++)
+         cached[j] = cache.findPath(requests[j].first, requests[j].second, zones[requests[j].second]->getCenter());
+
+      // Routes can differ, but the cache must get there whenever a search does, starting from where the bot is
+      for(S32 j = 0; j < requests.size(); j++)
+      {
+         ASSERT_EQ(searched[j].size() == 0, cached[j].size() == 0) << levels[i] << ": request " << j;
+
+         if(cached[j].size() > 0)
+         {
+            EXPECT_EQ(zones[requests[j].second]->getCenter(), cached[j][0]);
+            EXPECT_EQ(zones[requests[j].first]->getCenter(), cached[j].last());
+         }
+      }
+
+      for(S32 j = 0; j < GoalCount; j++)
+         EXPECT_TRUE(cache.hasFlowField(goals[j])) << levels[i];
+
+      delete game;
+   }
+}
+
+
+// Searches spread over several threads, each with its own AStar, must find exactly what one AStar finds by itself
+TEST(BotPathCacheTest, BatchedSearchesMatchSerialSearches)
+{
+   const S32 RequestCount = 500;
+
+   ServerGame *game = newServerGame();
+   Vector<BotNavMeshZone *> zones;
+
+   ASSERT_TRUE(buildZones(game, "zc.level", zones));
+
+   Vector<pair<U16, U16> > requests;
+   PathRequestBatch batch;
+
+   for(S32 i = 0; i < RequestCount; i++)
+   {
+      requests.push_back(pair<U16, U16>(U16(TNL::Random::readI(0, zones.size() - 1)),
+                                        U16(TNL::Random::readI(0, zones.size() - 1))));
+
+      EXPECT_EQ(i, batch.addRequest(requests[i].first, requests[i].second, zones[requests[i].second]->getCenter()));
+   }
+
+   WorkerPool pool(3);
+   batch.solve(&zones, &pool);
+
+   ASSERT_EQ(RequestCount, batch.getRequestCount());
+
+   AStar search;
+   Vector<Point> path;
+
+   for(S32 i = 0; i < 2; i++)    // Twice, so the second pass runs on scratch space left over from the first
+      for(S32 j = 0; j < RequestCount; j++)
+      {
+         bool found = search.findPath(&zones, requests[j].first, requests[j].second, zones[requests[j].second]->getCenter(), path);
+
+         ASSERT_EQ(found, batch.isFound(j)) << "request " << j;
+         ASSERT_EQ(path.size(), batch.getPath(j).size()) << "request " << j;
+
+         for(S32 k = 0; k < path.size(); k++)
+            EXPECT_EQ(path[k], batch.getPath(j)[k]);
+      }
+
+   delete game;
+}
+
+
+// Adds up what it costs to follow a path, the same way AStar does: zone center to gateway to zone center
+static F32 getPathLength(const Vector<Point> &path)
+{
+   F32 length = 0;
+
+   for(S32 i = 2; i < path.size(); i++)      // Skip the leg from the target's zone center to the target itself
+      length += path[i - 1].distanceTo(path[i]);
+
+   return length;
+}
+
+
+// Long searches across a big level, directly and through the portal hierarchy; the hierarchy should look at fewer
+// zones, and find paths just as cheap
+TEST(BotPathCacheTest, HierarchicalSearchMatchesAStar)
+{
+   const S32 RequestCount = 500;
+   const F32 MaxAverageStretch = 1.001f;     // Only rounding should make hierarchical paths any longer
+
+   ServerGame *game = newServerGame();
+   Vector<BotNavMeshZone *> zones;
+
+   ASSERT_TRUE(buildZones(game, "zc.level", zones));
+   ASSERT_TRUE(zones.size() >= BotZoneHierarchy::MinZones) << "Need a bigger level to test with!";
+
+   BotZoneHierarchy hierarchy;
+   hierarchy.build(&zones);
+   ASSERT_TRUE(hierarchy.isBuilt());
+
+   Vector<pair<U16, U16> > requests;
+   while(requests.size() < RequestCount)
+   {
+      U16 startZone = U16(TNL::Random::readI(0, zones.size() - 1));
+      U16 targetZone = U16(TNL::Random::readI(0, zones.size() - 1));
+
+      if(hierarchy.isLongDistance(startZone, targetZone))
+         requests.push_back(pair<U16, U16>(startZone, targetZone));
+   }
+
+   AStar search;
+   BotZoneHierarchy::Search hierarchySearch;
+   Vector<Point> path, hierarchyPath;
+
+   U64 expanded = 0, hierarchyExpanded = 0;
+   F64 stretch = 0;
+   S32 found = 0;
+
+   for(S32 i = 0; i < requests.size(); i++)
+   {
+      Point target = zones[requests[i].second]->getCenter();
+
+      bool searchFound = search.findPath(&zones, requests[i].first, requests[i].second, target, path);
+      expanded += search.getExpandedCount();
+
+      bool hierarchyFound = hierarchy.findPath(hierarchySearch, requests[i].first, requests[i].second, target, hierarchyPath);
+      hierarchyExpanded += hierarchySearch.getExpandedCount();
+
+      ASSERT_EQ(searchFound, hierarchyFound) << "request " << i;
+
+      if(!searchFound)
+         continue;
+
+      EXPECT_EQ(target, hierarchyPath[0]);
+      EXPECT_EQ(zones[requests[i].first]->getCenter(), hierarchyPath.last());
+
+      F32 length = getPathLength(path);
+      F32 hierarchyLength = getPathLength(hierarchyPath);
+
+      EXPECT_GE(hierarchyLength, length * 0.999f) << "request " << i << ": shorter than the cheapest path?";
+
+      stretch += (length > 0) ? hierarchyLength / length : 1;
+      found++;
+   }
+
+   ASSERT_TRUE(found > 0);
+   stretch /= found;
+
+   EXPECT_LT(stretch, MaxAverageStretch);
+   EXPECT_LT(hierarchyExpanded, expanded);
+
+   delete game;
+}
+
+
+// Once a Core is destroyed, the zones under it are no longer worth avoiding, and routes found around them are stale
+TEST(BotPathCacheTest, DestroyedCoreOpensZones)
+{
+   ServerGame *game = newServerGame();
+   Vector<BotNavMeshZone *> zones;
+
+   ASSERT_TRUE(buildZones(game, "core.level", zones));
+
+   BotPathCache *cache = game->getBotPathCache();
+   cache->reset(&zones);
+
+   S32 blockedZone = -1;
+   for(S32 i = 0; i < zones.size(); i++)
+      if(!zones[i]->getWalkable())
+         blockedZone = i;
+
+   ASSERT_TRUE(blockedZone >= 0) << "Expected some zones under the Cores!";
+
+   S32 fromZone = (blockedZone + 1) % zones.size();
+
+   cache->findPath(fromZone, blockedZone, zones[blockedZone]->getCenter());
+   cache->findPath(fromZone, blockedZone, zones[blockedZone]->getCenter());
+   EXPECT_EQ(1, cache->getSearches());
+   EXPECT_EQ(1, cache->getRouteHits());
+
+   Vector<DatabaseObject *> cores;
+   game->getGameObjDatabase()->findObjects(CoreTypeNumber, cores);
+   ASSERT_TRUE(cores.size() > 0);
+
+   for(S32 i = 0; i < cores.size(); i++)
+   {
+      Vector<Point> area;
+      static_cast<CoreItem *>(cores[i])->getBufferForBotZone(BotNavMeshZone::BufferRadius + 5, area);
+      game->openBotZones(area);
+   }
+
+   for(S32 i = 0; i < zones.size(); i++)
+      EXPECT_TRUE(zones[i]->getWalkable());
+
+   cache->findPath(fromZone, blockedZone, zones[blockedZone]->getCenter());
+   EXPECT_EQ(2, cache->getSearches());
+
+   delete game;
+}
+
+
+};
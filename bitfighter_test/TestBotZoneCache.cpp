@@ -0,0 +1,141 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "BotZoneCache.h"
+#include "BotNavMeshZone.h"
+#include "ServerGame.h"
+#include "stringUtils.h"
+
+#include "TestUtils.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+namespace Zap
+{
+
+static const string LevelHash = "0123456789abcdef0123456789abcdef";
+static const string CacheFile = "TestBotZoneCache.zones";
+
+
+// Builds zones for a bundled level
+static void buildZones(ServerGame *game, const string &levelFile, Vector<BotNavMeshZone *> &zones)
+{
+   GridDatabase *db = game->getGameObjDatabase();
+   game->loadLevelFromString(readFile(joindir("levels", levelFile)), db);
+   game->computeWorldObjectExtents();
+
+   EXPECT_TRUE(BotNavMeshZone::buildBotMeshZones(game->getBotZoneDatabase(), db, &zones, game->getWorldExtents(), false));
+}
+
+
+// Zones read back from a file must be exactly the ones that were built
+TEST(BotZoneCacheTest, ReadMatchesBuild)
+{
+   const string levels[] = { "zc.level", "core.level", "ctf.level" };
+
+   for(U32 i = 0; i < ARRAYSIZE(levels); i++)
+   {
+      ServerGame *game = newServerGame();
+      Vector<BotNavMeshZone *> built;
+
+      buildZones(game, levels[i], built);
+      ASSERT_TRUE(built.size() > 0) << levels[i];
+
+      ASSERT_TRUE(BotZoneCache::write(CacheFile, LevelHash, &built));
+
+      // Copy what we need to compare, as reading replaces the zones in the game's zone database
+      Vector<Vector<Point> > outlines;
+      Vector<Vector<NeighboringZone> > neighbors;
+      Vector<bool> walkable;
+
+      for(S32 j = 0; j < built.size(); j++)
+      {
+         outlines.push_back(*built[j]->getOutline());
+         neighbors.push_back(built[j]->mNeighbors);
+         walkable.push_back(built[j]->getWalkable());
+      }
+
+      S32 zoneCount = built.size();
+      built.deleteAndClear();
+
+      Vector<BotNavMeshZone *> read;
+
+      ASSERT_TRUE(BotZoneCache::read(CacheFile, LevelHash, game->getBotZoneDatabase(), &read, false)) << levels[i];
+
+      ASSERT_EQ(zoneCount, read.size());
+      EXPECT_EQ(zoneCount, game->getBotZoneDatabase()->getObjectCount());
+
+      for(S32 j = 0; j < zoneCount; j++)
+      {
+         EXPECT_EQ(j, read[j]->getZoneId());
+         EXPECT_EQ(walkable[j], read[j]->getWalkable());
+
+         ASSERT_EQ(outlines[j].size(), read[j]->getOutline()->size());
+         for(S32 k = 0; k < outlines[j].size(); k++)
+            EXPECT_EQ(outlines[j][k], read[j]->getOutline()->get(k));
+
+         ASSERT_EQ(neighbors[j].size(), read[j]->mNeighbors.size());
+         for(S32 k = 0; k < neighbors[j].size(); k++)
+         {
+            const NeighboringZone &expected = neighbors[j][k];
+            const NeighboringZone &actual = read[j]->mNeighbors[k];
+
+            EXPECT_EQ(expected.zoneID, actual.zoneID);
+            EXPECT_EQ(expected.borderStart, actual.borderStart);
+            EXPECT_EQ(expected.borderEnd, actual.borderEnd);
+            EXPECT_EQ(expected.borderCenter, actual.borderCenter);
+            EXPECT_EQ(expected.center, actual.center);
+            EXPECT_EQ(expected.distTo, actual.distTo);
+         }
+      }
+
+      read.deleteAndClear();
+      delete game;
+   }
+
+   remove(CacheFile.c_str());
+}
+
+
+// Files for some other level, or that got cut short, are ignored so the zones get built instead
+TEST(BotZoneCacheTest, RejectsMismatchedOrDamagedFiles)
+{
+   ServerGame *game = newServerGame();
+   Vector<BotNavMeshZone *> zones;
+
+   buildZones(game, "ctf.level", zones);
+   ASSERT_TRUE(BotZoneCache::write(CacheFile, LevelHash, &zones));
+
+   EXPECT_FALSE(BotZoneCache::read(CacheFile, "some other level", game->getBotZoneDatabase(), &zones, false));
+   EXPECT_EQ(0, zones.size());
+   EXPECT_EQ(0, game->getBotZoneDatabase()->getObjectCount());
+
+   EXPECT_FALSE(BotZoneCache::read("no such file.zones", LevelHash, game->getBotZoneDatabase(), &zones, false));
+   EXPECT_EQ(0, zones.size());
+
+   // Lop the end off the file
+   string contents;
+   FILE *file = fopen(CacheFile.c_str(), "rb");
+   ASSERT_TRUE(file != NULL);
+   for(int c; (c = fgetc(file)) != EOF; )
+      contents += char(c);
+   fclose(file);
+
+   file = fopen(CacheFile.c_str(), "wb");
+   fwrite(contents.data(), 1, contents.size() / 2, file);
+   fclose(file);
+
+   EXPECT_FALSE(BotZoneCache::read(CacheFile, LevelHash, game->getBotZoneDatabase(), &zones, false));
+   EXPECT_EQ(0, zones.size());
+   EXPECT_EQ(0, game->getBotZoneDatabase()->getObjectCount());
+
+   remove(CacheFile.c_str());
+   delete game;
+}
+
+
+};
@@ -0,0 +1,271 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "tnlGhostConnection.h"
+#include "tnlNetInterface.h"
+#include "tnlNetObject.h"
+#include "tnlRandom.h"
+
+#include "gtest/gtest.h"
+
+namespace Zap
+{
+
+using namespace TNL;
+
+// Object with a fixed priority that keeps track of how often it gets asked for it
+class PriorityTestObject : public NetObject
+{
+   typedef NetObject Parent;
+
+public:
+   static Vector<PriorityTestObject *> packOrder;    // Every object written, in the order they were written
+
+   F32 basePriority;
+   S32 priorityRequests;
+
+   PriorityTestObject()
+   {
+      mNetFlags.set(Ghostable);
+      basePriority = 0;
+      priorityRequests = 0;
+   }
+
+   F32 getUpdatePriority(GhostConnection *connection, U32 updateMask, S32 updateSkips)
+   {
+      priorityRequests++;
+      return basePriority + updateSkips * 0.2f;
+   }
+
+   F32 getUpdatePriorityPerSkip()
+   {
+      return 0.2f;
+   }
+
+   U32 packUpdate(GhostConnection *connection, U32 updateMask, BitStream *stream)
+   {
+      stream->writeInt(0, 32);     // Roughly the size of a small object's update
+      packOrder.push_back(this);
+      return 0;
+   }
+
+   void unpackUpdate(GhostConnection *connection, BitStream *stream)
+   {
+      stream->readInt(32);
+   }
+
+   void setPriority(F32 priority)
+   {
+      basePriority = priority;
+      setMaskBits(1);
+   }
+
+   TNL_DECLARE_CLASS(PriorityTestObject);
+};
+
+TNL_IMPLEMENT_NETOBJECT(PriorityTestObject);
+
+Vector<PriorityTestObject *> PriorityTestObject::packOrder;
+
+
+// Puts everything in its list in scope
+class ScopeEverythingObject : public NetObject
+{
+public:
+   Vector<PriorityTestObject *> objects;
+
+   void performScopeQuery(GhostConnection *connection)
+   {
+      for(S32 i = 0; i < objects.size(); i++)
+         connection->objectInScope(objects[i]);
+   }
+};
+
+
+// A ghosting connection with nobody on the other end; packets are written, then treated as received straight away
+class LoopbackGhostConnection : public GhostConnection
+{
+public:
+   // Needs a default constructor to be registered as a NetConnection class, so setup happens in here
+   void connect(NetInterface *netInterface, NetObject *scopeObject)
+   {
+      setInterface(netInterface);
+      setTranslatesStrings();
+      setGhostFrom(true);
+      setScopeObject(scopeObject);
+
+      mGhostClassCount = NetClassRep::getNetClassCount(getNetClassGroup(), NetClassTypeObject);
+      mGhostClassBitSize = getNextBinLog2(mGhostClassCount);
+
+      // Skip the RPC handshake
+      mScoping = true;
+      mGhosting = true;
+   }
+
+   // Packets are only acked as far as the ghosting code is concerned, so we can't send more than a packet
+   // window's worth (32) on one connection
+   static const S32 MaxPackets = 25;
+
+   static S32 getUpdateBatchSize() { return UpdateBatchSize; }
+
+   void writeAndReceivePacket()
+   {
+      U32 lastSequence = getLastSendSequence();
+
+      checkPacketSend(true, getInterface()->getCurrentTime());
+
+      if(getLastSendSequence() != lastSequence)
+         handleNotify(getLastSendSequence(), true);
+   }
+
+   TNL_DECLARE_NETCONNECTION(LoopbackGhostConnection);
+};
+
+TNL_IMPLEMENT_NETCONNECTION(LoopbackGhostConnection, NetClassGroupGame, false);
+
+
+class GhostConnectionTest : public testing::Test
+{
+protected:
+   RefPtr<NetInterface> mNetInterface;
+   ScopeEverythingObject mScopeObject;
+
+   virtual void SetUp()
+   {
+      mNetInterface = new NetInterface(Address(IPProtocol, Address::Any, 0));
+      PriorityTestObject::packOrder.clear();
+   }
+
+   virtual void TearDown()
+   {
+      mScopeObject.objects.deleteAndClear();
+      NetObject::collapseDirtyList();
+   }
+
+   void createObjects(S32 count)
+   {
+      for(S32 i = 0; i < count; i++)
+      {
+         mScopeObject.objects.push_back(new PriorityTestObject());
+         mScopeObject.objects.last()->basePriority = F32(TNL::Random::readI(0, 100000)) / 100.0f;
+      }
+   }
+
+   LoopbackGhostConnection *createConnection()
+   {
+      LoopbackGhostConnection *conn = new LoopbackGhostConnection();
+      conn->connect(mNetInterface, &mScopeObject);
+      return conn;
+   }
+};
+
+
+// Only the top of the list gets sorted, so make sure what comes out is still in priority order
+TEST_F(GhostConnectionTest, UpdatesAreWrittenInPriorityOrder)
+{
+   createObjects(500);
+   LoopbackGhostConnection *conn = createConnection();
+
+   conn->writeAndReceivePacket();
+
+   // Nothing has been sent yet, so everything is waiting, and the packet should hold the most important objects
+   S32 sent = PriorityTestObject::packOrder.size();
+   ASSERT_TRUE(sent > LoopbackGhostConnection::getUpdateBatchSize()) << "Test should send more than one batch per packet";
+   ASSERT_TRUE(sent < mScopeObject.objects.size());
+
+   for(S32 i = 1; i < sent; i++)
+      EXPECT_TRUE(PriorityTestObject::packOrder[i - 1]->basePriority >= PriorityTestObject::packOrder[i]->basePriority);
+
+   F32 lowestSent = PriorityTestObject::packOrder.last()->basePriority;
+   S32 higherCount = 0;
+   for(S32 i = 0; i < mScopeObject.objects.size(); i++)
+      if(mScopeObject.objects[i]->basePriority > lowestSent)
+         higherCount++;
+
+   EXPECT_TRUE(higherCount < sent) << "A higher priority object was left out of the packet";
+
+   // Keep going until everything has been sent once
+   for(S32 i = 1; i < LoopbackGhostConnection::MaxPackets && PriorityTestObject::packOrder.size() < mScopeObject.objects.size(); i++)
+      conn->writeAndReceivePacket();
+
+   EXPECT_EQ(mScopeObject.objects.size(), PriorityTestObject::packOrder.size());
+
+   delete conn;
+}
+
+
+// Servers log what each packet was spent on, so the categories had better add up to what was sent
+TEST_F(GhostConnectionTest, TrafficIsCounted)
+{
+   createObjects(500);
+   LoopbackGhostConnection *conn = createConnection();
+
+   conn->writeAndReceivePacket();
+
+   S32 sent = PriorityTestObject::packOrder.size();
+   EXPECT_EQ(mScopeObject.objects.size(), conn->getGhostCount());
+   EXPECT_EQ(U32(sent), conn->getGhostUpdatesSent());
+   EXPECT_EQ(U32(mScopeObject.objects.size() - sent), conn->getGhostUpdatesSkipped());
+
+   U64 totalBits = 0;
+   for(S32 i = 0; i < NetConnection::TrafficCategoryCount; i++)
+      totalBits += conn->mTrafficBitsSent[i];
+
+   EXPECT_EQ(U64(conn->mPacketSendBytesTotal) * 8, totalBits);
+   EXPECT_LT(U64(sent * 32), conn->mTrafficBitsSent[NetConnection::TrafficGhosts]);
+   EXPECT_LT(conn->mTrafficBitsSent[NetConnection::TrafficEvents], 8u);     // Nothing but the end-of-events flag
+   EXPECT_EQ(0u, conn->mTrafficBitsSent[NetConnection::TrafficMoves]);
+
+   delete conn;
+}
+
+
+// Priorities should only be recomputed for objects that have changed
+TEST_F(GhostConnectionTest, PrioritiesAreCachedUntilObjectsChange)
+{
+   createObjects(3000);
+   LoopbackGhostConnection *conn = createConnection();
+
+   conn->writeAndReceivePacket();
+   conn->writeAndReceivePacket();
+
+   // Everything still waiting has been asked once, for the first packet
+   for(S32 i = 0; i < mScopeObject.objects.size(); i++)
+      EXPECT_TRUE(mScopeObject.objects[i]->priorityRequests <= 1);
+
+   // A changed object is asked again
+   PriorityTestObject *changed = NULL;
+   for(S32 i = 0; i < mScopeObject.objects.size() && !changed; i++)
+      if(mScopeObject.objects[i]->priorityRequests == 1)
+         changed = mScopeObject.objects[i];
+
+   ASSERT_TRUE(changed != NULL);
+   changed->setPriority(changed->basePriority + 1);
+   NetObject::collapseDirtyList();
+
+   conn->writeAndReceivePacket();
+   EXPECT_EQ(2, changed->priorityRequests);
+
+   // So is everything still waiting, when the reference object changes
+   mScopeObject.setMaskBits(1);
+   NetObject::collapseDirtyList();
+
+   S32 requestsBefore = 0;
+   for(S32 i = 0; i < mScopeObject.objects.size(); i++)
+      requestsBefore += mScopeObject.objects[i]->priorityRequests;
+
+   conn->writeAndReceivePacket();
+
+   S32 requestsAfter = 0;
+   for(S32 i = 0; i < mScopeObject.objects.size(); i++)
+      requestsAfter += mScopeObject.objects[i]->priorityRequests;
+
+   EXPECT_TRUE(requestsAfter - requestsBefore > mScopeObject.objects.size() / 2);
+
+   delete conn;
+}
+
+
+};
@@ -0,0 +1,500 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "gridDB.h"
+#include "barrier.h"
+#include "moveObject.h"     // For ActualState
+#include "ServerGame.h"
+#include "BfObject.h"
+#include "stringUtils.h"
+
+#include "tnlRandom.h"
+#include "tnlThread.h"
+
+#include "TestUtils.h"
+
+#include "gtest/gtest.h"
+
+namespace Zap
+{
+
+using namespace std;
+
+class GridDatabaseTest : public testing::Test
+{
+public:
+   static const S32 QueryCount = 20000;
+
+   struct QueryMix
+   {
+      Vector<Rect> rects;
+      Vector<TestFunc> testFuncs;
+      Vector<Point> rayStarts;
+      Vector<Point> rayEnds;
+   };
+
+
+   static F32 randomFloat(F32 min, F32 max)
+   {
+      return min + (max - min) * F32(TNL::Random::readI(0, 10000)) / 10000.0f;
+   }
+
+
+   // Mostly small queries like ships and bullets make, with a few big ones like scoping and bots scanning the map
+   static void buildQueryMix(const Rect &extents, QueryMix &mix)
+   {
+      static const TestFunc testFuncs[] = { (TestFunc)isWallType, (TestFunc)isShipType, (TestFunc)isCollideableType,
+                                            (TestFunc)isAnyObjectType };
+
+      for(S32 i = 0; i < QueryCount; i++)
+      {
+         Point center(randomFloat(extents.min.x, extents.max.x), randomFloat(extents.min.y, extents.max.y));
+         F32 size = (i % 10 == 0) ? randomFloat(800, 2000) : randomFloat(20, 300);
+
+         mix.rects.push_back(Rect(center, size));
+         mix.testFuncs.push_back(testFuncs[i % ARRAYSIZE(testFuncs)]);
+
+         mix.rayStarts.push_back(center);
+         mix.rayEnds.push_back(center + Point(randomFloat(-1000, 1000), randomFloat(-1000, 1000)));
+      }
+   }
+
+
+   // Runs the query mix, collecting all objects found
+   static void runQueryMix(const GridDatabase *db, const QueryMix &mix, Vector<Vector<DatabaseObject *> > &results)
+   {
+      Vector<DatabaseObject *> found;
+      F32 collisionTime;
+      Point normal;
+
+      for(S32 i = 0; i < mix.rects.size(); i++)
+      {
+         found.clear();
+         db->findObjects(mix.testFuncs[i], found, mix.rects[i]);
+         db->findObjectLOS((TestFunc)isWallType, ActualState, mix.rayStarts[i], mix.rayEnds[i], collisionTime, normal);
+
+         found.sort(ptrSort);
+         results.push_back(found);
+      }
+   }
+
+
+   static S32 QSORT_CALLBACK ptrSort(DatabaseObject **a, DatabaseObject **b)
+   {
+      return (*a < *b) ? -1 : ((*a > *b) ? 1 : 0);
+   }
+
+
+   // Runs the query mix with its own DatabaseQuery, signaling done when finished
+   class QueryThread : public Thread
+   {
+      const GridDatabase *mDatabase;
+      const QueryMix *mMix;
+      Semaphore *mDone;
+
+   public:
+      Vector<Vector<DatabaseObject *> > results;
+      Vector<DatabaseObject *> losHits;
+
+      QueryThread(const GridDatabase *db, const QueryMix *mix, Semaphore *done)
+      {
+         mDatabase = db;
+         mMix = mix;
+         mDone = done;
+      }
+
+      U32 run()
+      {
+         DatabaseQuery query;
+         F32 collisionTime;
+         Point normal;
+
+         for(S32 i = 0; i < mMix->rects.size(); i++)
+         {
+            query.clearResults();
+            mDatabase->findObjects(mMix->testFuncs[i], query, mMix->rects[i]);
+            query.getResults().sort(ptrSort);
+            results.push_back(query.getResults());
+
+            losHits.push_back(mDatabase->findObjectLOS((TestFunc)isWallType, query, ActualState, true,
+                                                       mMix->rayStarts[i], mMix->rayEnds[i], collisionTime, normal));
+         }
+
+         mDone->increment();
+         return 0;
+      }
+   };
+};
+
+
+// Moving objects around has to keep them findable, regardless of how the buckets are laid out
+TEST_F(GridDatabaseTest, HierarchicalIndexTracksMovingObjects)
+{
+   ServerGame *game = newServerGame();
+   GridDatabase *db = game->getGameObjDatabase();
+
+   db->setSpatialIndex(SpatialIndexHierarchicalGrid, Rect(Point(0,0), Point(20000, 20000)));
+
+   WallItem *wall = new WallItem();
+   Vector<Point> geom;
+   geom.push_back(Point(0, 0));
+   geom.push_back(Point(19000, 19000));
+   wall->GeomObject::setGeom(geom);
+   wall->setExtent(Rect(geom));
+   wall->addToDatabase(db);
+
+   // Way off the map is fine too -- it will be clamped to the border cells
+   Point positions[] = { Point(100, 100), Point(15000, 300), Point(-50000, 12000), Point(19999, 19999) };
+
+   for(S32 i = 0; i < ARRAYSIZE(positions); i++)
+   {
+      wall->setExtent(Rect(positions[i], 10));
+
+      fillVector.clear();
+      db->findObjects((TestFunc)isWallType, fillVector, Rect(positions[i], 50));
+      EXPECT_EQ(1, fillVector.size()) << "Lost track of object at " << positions[i].toString();
+
+      fillVector.clear();
+      db->findObjects((TestFunc)isWallType, fillVector, Rect(positions[i] + Point(4096, 4096), 50));
+      EXPECT_EQ(0, fillVector.size()) << "Distant query should not alias onto object at " << positions[i].toString();
+   }
+
+   delete game;
+}
+
+
+// Buckets are compacted when objects leave them; make sure the objects that get shuffled around stay findable
+TEST_F(GridDatabaseTest, RemovingObjectsKeepsBucketsConsistent)
+{
+   ServerGame *game = newServerGame();
+   GridDatabase *db = game->getGameObjDatabase();
+
+   static const S32 WallCount = 50;
+   Vector<WallItem *> walls;
+
+   // Pile everything up in the same few buckets
+   for(S32 i = 0; i < WallCount; i++)
+   {
+      WallItem *wall = new WallItem();
+      wall->setExtent(Rect(Point(i * 4, i * 4), 2));
+      wall->addToDatabase(db);
+      walls.push_back(wall);
+   }
+
+   // Remove every third wall, and move some of the others somewhere else and back
+   for(S32 i = 0; i < WallCount; i += 3)
+      db->removeFromDatabase(walls[i], false);
+
+   for(S32 i = 1; i < WallCount; i += 4)
+   {
+      walls[i]->setExtent(Rect(Point(5000, 5000), 2));
+      walls[i]->setExtent(Rect(Point(i * 4, i * 4), 2));
+   }
+
+   for(S32 i = 0; i < WallCount; i++)
+   {
+      fillVector.clear();
+      db->findObjects((TestFunc)isWallType, fillVector, Rect(Point(i * 4, i * 4), 1));
+
+      if(i % 3 == 0)
+         EXPECT_EQ(0, fillVector.size()) << "Found removed wall " << i;
+      else
+      {
+         ASSERT_EQ(1, fillVector.size()) << "Lost wall " << i;
+         EXPECT_EQ(walls[i], fillVector[0]);
+      }
+   }
+
+   for(S32 i = 0; i < WallCount; i += 3)
+      delete walls[i];
+
+   delete game;
+}
+
+
+// Several threads searching the same database, each with its own DatabaseQuery, should get the same answers as
+// a single thread using the classic interface
+TEST_F(GridDatabaseTest, ConcurrentQueriesMatchSerialResults)
+{
+   ServerGame *game = newServerGame();
+   GridDatabase *db = game->getGameObjDatabase();
+
+   game->loadLevelFromString(readFile(joindir("levels", "zc.level")), db);
+   ASSERT_TRUE(db->getObjectCount() > 0) << "Could not load zc.level!";
+
+   QueryMix mix;
+   buildQueryMix(db->getExtents(), mix);
+
+   Vector<Vector<DatabaseObject *> > expected;
+   Vector<DatabaseObject *> expectedHits;
+   F32 collisionTime;
+   Point normal;
+
+   for(S32 i = 0; i < mix.rects.size(); i++)
+   {
+      fillVector.clear();
+      db->findObjects(mix.testFuncs[i], fillVector, mix.rects[i]);
+      fillVector.sort(ptrSort);
+      expected.push_back(fillVector);
+
+      expectedHits.push_back(db->findObjectLOS((TestFunc)isWallType, ActualState, mix.rayStarts[i], mix.rayEnds[i], 
+                                               collisionTime, normal));
+   }
+
+   static const S32 ThreadCount = 4;
+   Semaphore done;
+   Vector<QueryThread *> threads;
+
+   for(S32 i = 0; i < ThreadCount; i++)
+   {
+      threads.push_back(new QueryThread(db, &mix, &done));
+      threads.last()->start();
+   }
+
+   for(S32 i = 0; i < ThreadCount; i++)
+      done.wait();
+
+   for(S32 i = 0; i < ThreadCount; i++)
+   {
+      ASSERT_EQ(expected.size(), threads[i]->results.size());
+
+      for(S32 j = 0; j < expected.size(); j++)
+      {
+         ASSERT_EQ(expected[j].size(), threads[i]->results[j].size()) << "Thread " << i << ", query " << j << " differs";
+
+         for(S32 k = 0; k < expected[j].size(); k++)
+            EXPECT_EQ(expected[j][k], threads[i]->results[j][k]);
+
+         EXPECT_EQ(expectedHits[j], threads[i]->losHits[j]);
+      }
+   }
+
+   threads.deleteAndClear();
+   delete game;
+}
+
+
+// Only lets through objects whose extents are centered within a circle
+class CircleFilter : public RegionQueryCache::Filter
+{
+   Point mCenter;
+   F32 mRadius;
+
+public:
+   CircleFilter(const Point &center, F32 radius) { mCenter = center; mRadius = radius; }
+
+   bool passes(DatabaseObject *object) const
+   {
+      return (object->getExtent().getCenter() - mCenter).len() < mRadius;
+   }
+};
+
+
+// A cached search has to find exactly what a fresh one would, however things move around, come and go
+TEST_F(GridDatabaseTest, CachedRegionQueriesMatchUncachedSearches)
+{
+   static const S32 Steps = 300;
+   static const S32 MoverCount = 100;
+
+   SpatialIndexType indexTypes[] = { SpatialIndexWrappingGrid, SpatialIndexHierarchicalGrid };
+
+   for(S32 t = 0; t < ARRAYSIZE(indexTypes); t++)
+   {
+      ServerGame *game = newServerGame();
+      GridDatabase *db = game->getGameObjDatabase();
+
+      game->loadLevelFromString(readFile(joindir("levels", "zc.level")), db);
+      Rect extents = db->getExtents();
+      db->setSpatialIndex(indexTypes[t], extents);
+
+      Vector<WallItem *> movers;
+      for(S32 i = 0; i < MoverCount; i++)
+      {
+         movers.push_back(new WallItem());
+         movers.last()->setExtent(Rect(Point(randomFloat(extents.min.x, extents.max.x), randomFloat(extents.min.y, extents.max.y)), 20));
+         movers.last()->addToDatabase(db);
+      }
+
+      RegionQueryCache viewCache, filteredCache;
+      DatabaseQuery query;
+      U32 examined = 0, covered = 0;
+
+      Point viewer = extents.getCenter();
+      Point fixedCenter(randomFloat(extents.min.x, extents.max.x), randomFloat(extents.min.y, extents.max.y));
+      CircleFilter filter(fixedCenter, 500);
+
+      for(S32 step = 0; step < Steps; step++)
+      {
+         // Wander the viewer around slowly, like a ship, and shuffle a few of the movers
+         viewer += Point(randomFloat(-30, 30), randomFloat(-30, 30));
+
+         for(S32 i = 0; i < 5; i++)
+         {
+            WallItem *mover = movers[TNL::Random::readI(0, movers.size() - 1)];
+            mover->setExtent(Rect(mover->getExtent().getCenter() + Point(randomFloat(-100, 100), randomFloat(-100, 100)), 20));
+         }
+
+         // And every so often, swap one out for a new one
+         if(step % 10 == 0)
+         {
+            S32 index = TNL::Random::readI(0, movers.size() - 1);
+            delete movers[index];
+            movers[index] = new WallItem();
+            movers[index]->setExtent(Rect(viewer + Point(randomFloat(-500, 500), randomFloat(-500, 500)), 20));
+            movers[index]->addToDatabase(db);
+         }
+
+         Rect viewRect(viewer, 1600);
+
+         fillVector.clear();
+         db->findObjects((TestFunc)isAnyObjectType, fillVector, viewRect);
+         fillVector.sort(ptrSort);
+
+         query.clearResults();
+         db->findObjects((TestFunc)isAnyObjectType, query, viewCache, viewRect);
+         query.getResults().sort(ptrSort);
+
+         ASSERT_EQ(fillVector.size(), query.getResults().size()) << "Step " << step;
+         for(S32 i = 0; i < fillVector.size(); i++)
+            EXPECT_EQ(fillVector[i], query.getResults()[i]);
+
+         // Same for a fixed region with a filter
+         Rect fixedRect(fixedCenter, 1000);
+
+         fillVector.clear();
+         db->findObjects((TestFunc)isAnyObjectType, fillVector, fixedRect);
+         for(S32 i = fillVector.size() - 1; i >= 0; i--)
+            if(!filter.passes(fillVector[i]))
+               fillVector.erase(i);
+         fillVector.sort(ptrSort);
+
+         query.clearResults();
+         db->findObjects((TestFunc)isAnyObjectType, query, filteredCache, fixedRect, &filter);
+         query.getResults().sort(ptrSort);
+
+         ASSERT_EQ(fillVector.size(), query.getResults().size()) << "Filtered, step " << step;
+         for(S32 i = 0; i < fillVector.size(); i++)
+            EXPECT_EQ(fillVector[i], query.getResults()[i]);
+      }
+
+      viewCache.collectTotals(examined, covered);
+      filteredCache.collectTotals(examined, covered);
+      EXPECT_TRUE(examined < covered / 2) << SpatialIndex::typeToString(indexTypes[t]) << " caches aren't saving much: "
+                                          << examined << " of " << covered;
+
+      movers.deleteAndClear();
+      delete game;
+   }
+}
+
+
+// Loads each bundled level, runs the same query mix against both the classic wrapping grid and the hierarchical
+// grid, and verifies they find the same objects
+TEST_F(GridDatabaseTest, BundledLevelQueriesMatch)
+{
+   const string extensions[] = { "level" };
+   Vector<string> levels;
+   getFilesFromFolder("levels", levels, extensions, ARRAYSIZE(extensions));
+
+   ASSERT_TRUE(levels.size() > 0) << "No levels found to test!";
+
+   for(S32 i = 0; i < levels.size(); i++)
+   {
+      ServerGame *game = newServerGame();
+      GridDatabase *db = game->getGameObjDatabase();
+
+      game->loadLevelFromString(readFile(joindir("levels", levels[i])), db);
+      Rect extents = db->getExtents();
+
+      QueryMix mix;
+      buildQueryMix(extents, mix);
+
+      Vector<Vector<DatabaseObject *> > gridResults, hierarchicalResults;
+
+      db->setSpatialIndex(SpatialIndexWrappingGrid, extents);
+      runQueryMix(db, mix, gridResults);
+
+      db->setSpatialIndex(SpatialIndexHierarchicalGrid, extents);
+      runQueryMix(db, mix, hierarchicalResults);
+
+      ASSERT_EQ(gridResults.size(), hierarchicalResults.size());
+      for(S32 j = 0; j < gridResults.size(); j++)
+      {
+         ASSERT_EQ(gridResults[j].size(), hierarchicalResults[j].size()) << levels[i] << ": query " << j << " differs";
+
+         for(S32 k = 0; k < gridResults[j].size(); k++)
+            EXPECT_EQ(gridResults[j][k], hierarchicalResults[j][k]);
+      }
+
+      delete game;
+   }
+}
+
+
+// Casting a batch of rays has to agree with casting them one at a time, in both modes
+TEST_F(GridDatabaseTest, BatchedRaysMatchSingleRays)
+{
+   static const S32 ViewerCount = 500;
+   static const S32 RaysPerViewer = 16;      // Like a turret or bot checking what it can see around it
+
+   const string extensions[] = { "level" };
+   Vector<string> levels;
+   getFilesFromFolder("levels", levels, extensions, ARRAYSIZE(extensions));
+
+   ASSERT_TRUE(levels.size() > 0) << "No levels found to test!";
+
+   for(S32 i = 0; i < levels.size(); i++)
+   {
+      ServerGame *game = newServerGame();
+      GridDatabase *db = game->getGameObjDatabase();
+
+      game->loadLevelFromString(readFile(joindir("levels", levels[i])), db);
+      Rect extents = db->getExtents();
+
+      RayBatch batch;
+      Vector<Point> rayStarts, rayEnds;
+
+      for(S32 j = 0; j < ViewerCount; j++)
+      {
+         Point viewer(randomFloat(extents.min.x, extents.max.x), randomFloat(extents.min.y, extents.max.y));
+
+         for(S32 k = 0; k < RaysPerViewer; k++)
+         {
+            rayStarts.push_back(viewer);
+            rayEnds.push_back(viewer + Point(randomFloat(-800, 800), randomFloat(-800, 800)));
+            batch.addRay(rayStarts.last(), rayEnds.last());
+         }
+      }
+
+      Vector<F32> expectedTimes;
+      F32 collisionTime;
+      Point normal;
+
+      for(S32 j = 0; j < batch.getRayCount(); j++)
+      {
+         if(!db->findObjectLOS((TestFunc)isWallType, ActualState, rayStarts[j], rayEnds[j], collisionTime, normal))
+            collisionTime = 1;
+         expectedTimes.push_back(collisionTime);
+      }
+
+      db->castRays((TestFunc)isWallType, ActualState, batch);
+
+      for(S32 j = 0; j < batch.getRayCount(); j++)
+      {
+         EXPECT_EQ(expectedTimes[j] < 1, batch.isBlocked(j)) << levels[i] << ": ray " << j;
+         EXPECT_FLOAT_EQ(expectedTimes[j], batch.getHitTime(j)) << levels[i] << ": ray " << j;
+      }
+
+      db->castRays((TestFunc)isWallType, ActualState, batch, false);
+
+      for(S32 j = 0; j < batch.getRayCount(); j++)
+         EXPECT_EQ(expectedTimes[j] < 1, batch.isBlocked(j)) << levels[i] << ": ray " << j;
+
+      delete game;
+   }
+}
+
+
+};
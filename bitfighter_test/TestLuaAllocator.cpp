@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "../zap/LuaAllocator.h"
+
+#include "gtest/gtest.h"
+
+namespace Zap
+{
+
+using namespace TNL;
+
+// Roughly what a bot's onTick does: lots of little point tables and result lists, thrown away each tick, while a
+// big pile of longer-lived data sits around for the collector to trace
+static const char *BotLikeWork =
+   "local function pt(x, y) return { x = x, y = y } end\n"
+   "function tick()\n"
+   "   local found = {}\n"
+   "   for i = 1, 200 do found[#found + 1] = pt(i, -i) end\n"
+   "   local sum = 0\n"
+   "   for i = 1, #found do sum = sum + found[i].x end\n"
+   "   local names = {}\n"
+   "   for i = 1, 20 do names[i] = 'obj' .. i .. ':' .. sum end\n"
+   "   return sum\n"
+   "end\n"
+   "live = {}\n"
+   "for i = 1, 20000 do live[i] = { i, tostring(i) } end\n";
+
+
+static lua_State *newState(bool pooled)
+{
+   lua_State *L = luaL_newstate();
+   luaL_openlibs(L);
+   LuaAllocator::install(L, pooled);
+
+   return L;
+}
+
+
+TEST(LuaAllocatorTest, PooledStateRunsScripts)
+{
+   lua_State *L = newState(true);
+
+   ASSERT_TRUE(LuaAllocator::get(L) != NULL);
+   EXPECT_TRUE(LuaAllocator::get(L)->isPooled());
+
+   ASSERT_EQ(0, luaL_dostring(L, BotLikeWork));
+
+   // Tables growing through every size class, and past the biggest, keep what was put in them
+   ASSERT_EQ(0, luaL_dostring(L, "t = {} for i = 1, 100 do t[i] = i * 2 end "
+                                 "for i = 1, 100 do assert(t[i] == i * 2) end "
+                                 "s = '' for i = 1, 300 do s = s .. 'x' end assert(#s == 300)"));
+
+   lua_getglobal(L, "tick");
+   ASSERT_EQ(0, lua_pcall(L, 0, 1, 0));
+   EXPECT_EQ(20100, lua_tointeger(L, -1));
+   lua_pop(L, 1);
+
+   LuaAllocator::closeState(L);
+}
+
+
+TEST(LuaAllocatorTest, CountsMemory)
+{
+   bool pooled[] = { false, true };
+
+   for(S32 i = 0; i < ARRAYSIZE(pooled); i++)
+   {
+      lua_State *L = newState(pooled[i]);
+      LuaAllocator *allocator = LuaAllocator::get(L);
+
+      U64 allocated = allocator->getBytesAllocated();
+      U64 inUse = allocator->getBytesInUse();
+
+      ASSERT_EQ(0, luaL_dostring(L, "keep = {} for i = 1, 1000 do keep[i] = { i } end"));
+
+      EXPECT_LT(allocated + 1000 * sizeof(void *), allocator->getBytesAllocated());
+      EXPECT_LT(inUse + 1000 * sizeof(void *), allocator->getBytesInUse());
+
+      // Letting go of it all gives back what's in use, but doesn't take back what was allocated
+      allocated = allocator->getBytesAllocated();
+      inUse = allocator->getBytesInUse();
+
+      ASSERT_EQ(0, luaL_dostring(L, "keep = nil"));
+      lua_gc(L, LUA_GCCOLLECT, 0);
+
+      EXPECT_GT(inUse, allocator->getBytesInUse());
+      EXPECT_LE(allocated, allocator->getBytesAllocated());
+
+      LuaAllocator::closeState(L);
+   }
+}
+
+
+// A block we hand out that never comes back shouldn't stop the state closing, or keep our chunks from being freed
+TEST(LuaAllocatorTest, ClosesWithBlocksOutstanding)
+{
+   lua_State *L = newState(true);
+   ASSERT_EQ(0, luaL_dostring(L, BotLikeWork));
+
+   void *data;
+   lua_Alloc alloc = lua_getallocf(L, &data);
+   void *lost = alloc(data, NULL, 0, 32);
+   ASSERT_TRUE(lost != NULL);
+
+   LuaAllocator::closeState(L);
+}
+
+
+};
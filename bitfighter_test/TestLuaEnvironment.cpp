@@ -405,4 +405,32 @@ TEST_F(LuaEnvironmentTest, findAllObjects)
 }
 
 
+TEST_F(LuaEnvironmentTest, scriptProfile)
+{
+   ASSERT_TRUE(levelgen->runString("function work() local t = {} for i = 1, 1000 do t[i] = { i } end end"));
+
+   EXPECT_EQ(0, levelgen->getProfile().calls);
+
+   EXPECT_FALSE(levelgen->runCmd("work", 0, 0));
+   EXPECT_FALSE(levelgen->runCmd("work", 0, 0));
+
+   const LuaScriptProfile &profile = levelgen->getProfile();
+   EXPECT_EQ(2, profile.calls);
+   EXPECT_LE(0, profile.time);
+   EXPECT_LT(2 * 1000 * sizeof(void *), profile.bytesAllocated);    // At least a pointer for each table we made
+   EXPECT_EQ(0, profile.instructions);                               // Not counted unless asked for
+   EXPECT_EQ(0, profile.deferredTicks);
+
+   // Taking the recent profile starts it over, but leaves the full one alone
+   EXPECT_EQ(2, levelgen->takeRecentProfile().calls);
+   EXPECT_EQ(0, levelgen->takeRecentProfile().calls);
+   EXPECT_EQ(2, levelgen->getProfile().calls);
+
+   // Without a budget, scripts never sit out a tick
+   U32 deltaT = 10;
+   EXPECT_FALSE(levelgen->deferTick(deltaT));
+   EXPECT_EQ(10, deltaT);
+}
+
+
 };
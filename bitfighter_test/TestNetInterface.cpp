@@ -0,0 +1,322 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "tnlNetInterface.h"
+#include "tnlRingBuffer.h"
+#include "tnlThread.h"
+#include "tnlPlatform.h"
+
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+
+namespace Zap
+{
+
+using namespace TNL;
+
+static const S32 ItemCount = 200000;
+
+// Writes the numbers 0 to ItemCount - 1 into a RingBuffer, in runs of whatever size it will take
+class RingBufferWriter : public Thread
+{
+   RingBuffer<S32> *mBuffer;
+
+public:
+   Semaphore mFinished;
+
+   RingBufferWriter(RingBuffer<S32> *buffer) { mBuffer = buffer; }
+
+   U32 run()
+   {
+      S32 next = 0;
+      while(next < ItemCount)
+      {
+         S32 count;
+         S32 *items = mBuffer->beginWrite(&count);
+         if(!items)
+            Platform::sleep(0);     // Let the reader catch up, even on one processor
+
+         S32 written = 0;
+         for(; written < count && next < ItemCount; written++)
+            items[written] = next++;
+
+         mBuffer->endWrite(written);
+      }
+
+      mFinished.increment();
+      return 0;
+   }
+};
+
+
+TEST(RingBufferTest, HandsItemsAcrossThreadsInOrder)
+{
+   RingBuffer<S32> buffer(64);     // Small, so it's full, empty and wrapping around all the time
+   EXPECT_TRUE(buffer.isEmpty());
+
+   RingBufferWriter writer(&buffer);
+   ASSERT_TRUE(writer.start());
+
+   S32 expected = 0;
+   while(expected < ItemCount)
+   {
+      S32 count;
+      S32 *items = buffer.beginRead(&count);
+      if(!items)
+         Platform::sleep(0);
+
+      for(S32 i = 0; i < count; i++, expected++)
+         ASSERT_EQ(expected, items[i]);
+
+      buffer.endRead(count);
+   }
+
+   writer.mFinished.wait();
+   EXPECT_TRUE(buffer.isEmpty());
+}
+
+
+// Writes down every packet it's handed, and when it arrived
+class RecordingInterface : public NetInterface
+{
+public:
+   Vector<U8> firstBytes;
+   Vector<U32> arrivalTimes;
+
+   RecordingInterface() : NetInterface(Address("IP:127.0.0.1:0")) { }
+
+   void processPacket(const Address &address, BitStream *packetStream)
+   {
+      firstBytes.push_back(packetStream->getBuffer()[0]);
+      arrivalTimes.push_back(mPacketArrivalTime);
+   }
+};
+
+
+// With an I/O thread, packets are picked up as they come in, and stamped with that time rather than when the game
+// gets around to them
+TEST(NetInterfaceTest, IOThreadTimestampsPacketsOnArrival)
+{
+   RecordingInterface netInterface;
+   ASSERT_TRUE(netInterface.startIOThread());
+   ASSERT_TRUE(netInterface.hasIOThread());
+
+   Socket peer(Address("IP:127.0.0.1:0"));
+   Address interfaceAddress = netInterface.getSocket().getBoundAddress();
+
+   U32 sendTime = Platform::getRealMilliseconds();
+
+   U8 data[4] = { 0, 1, 2, 3 };
+   for(U8 i = 0; i < 10; i++)
+   {
+      data[0] = i;
+      ASSERT_EQ(NoError, peer.sendto(interfaceAddress, data, sizeof(data)));
+   }
+
+   // Wait until they've all been read, then keep the game busy with something else for a while...
+   NetInterface *interfaces[] = { &netInterface };
+   while(netInterface.firstBytes.size() < 10)
+   {
+      ASSERT_TRUE(NetInterface::waitForPackets(interfaces, 1, 10000));
+
+      U32 readTime = Platform::getRealMilliseconds();
+      Platform::sleep(10);
+
+      // ...so anything stamped when the game handles it is stamped after readTime
+      S32 handled = netInterface.firstBytes.size();
+      netInterface.checkIncomingPackets();
+
+      for(S32 i = handled; i < netInterface.firstBytes.size(); i++)
+      {
+         EXPECT_EQ(i, netInterface.firstBytes[i]);
+         EXPECT_LE(sendTime, netInterface.arrivalTimes[i]) << "Packet " << i;
+         EXPECT_GE(readTime, netInterface.arrivalTimes[i]) << "Packet " << i << " stamped when it was handled";
+      }
+   }
+
+   ASSERT_EQ(10, netInterface.firstBytes.size());
+
+   // Packets sent by the game go out through the thread
+   PacketStream out;
+   out.write(U8(42));
+   EXPECT_EQ(NoError, netInterface.sendto(peer.getBoundAddress(), &out));
+
+   Socket *peerSocket = &peer;
+   ASSERT_TRUE(Socket::waitForReadable(&peerSocket, 1, 1000));
+
+   Address from;
+   S32 bytesRead;
+   ASSERT_EQ(NoError, peer.recvfrom(&from, data, sizeof(data), &bytesRead));
+   EXPECT_EQ(1, bytesRead);
+   EXPECT_EQ(42, data[0]);
+
+   netInterface.stopIOThread();
+   EXPECT_FALSE(netInterface.hasIOThread());
+   EXPECT_FALSE(NetInterface::waitForPackets(interfaces, 1, 0));
+}
+
+
+
+// Sends a packet to an address after a pause, so it arrives while someone is waiting for it
+class DelayedSender : public Thread
+{
+   Address mTo;
+
+public:
+   Semaphore mFinished;
+
+   DelayedSender(const Address &to) { mTo = to; }
+
+   U32 run()
+   {
+      Platform::sleep(100);
+
+      Socket socket(Address("IP:127.0.0.1:0"));
+      U8 data = 7;
+      socket.sendto(mTo, &data, 1);
+
+      mFinished.increment();
+      return 0;
+   }
+};
+
+
+// The I/O thread wakes a waiting game thread when it has read something, and doesn't wake it otherwise.  A wait
+// that times out returns false, so one that returns true was woken.
+TEST(NetInterfaceTest, IOThreadWakesWaitForPackets)
+{
+   RecordingInterface netInterface;
+   ASSERT_TRUE(netInterface.startIOThread());
+
+   NetInterface *interfaces[] = { &netInterface };
+
+   EXPECT_FALSE(NetInterface::waitForPackets(interfaces, 1, 100));
+
+   for(S32 i = 0; i < 3; i++)
+   {
+      DelayedSender sender(netInterface.getSocket().getBoundAddress());
+      ASSERT_TRUE(sender.start());
+
+      EXPECT_TRUE(NetInterface::waitForPackets(interfaces, 1, 60000));
+
+      sender.mFinished.wait();
+      netInterface.checkIncomingPackets();
+      EXPECT_EQ(i + 1, netInterface.firstBytes.size());
+   }
+
+   netInterface.stopIOThread();
+}
+
+
+
+// Simulated lag holds packets back for at least as long as asked, and lets them go in order of when they're due;
+// packets due at the same time go in the order they were sent.  One is held for longer than a turn of the delay wheel.
+TEST(NetInterfaceTest, DelayedPacketsGoOutInOrder)
+{
+   NetInterface netInterface(Address("IP:127.0.0.1:0"));
+   Socket peer(Address("IP:127.0.0.1:0"));
+   Address peerAddress = peer.getBoundAddress();
+
+   const U32 delays[] = { 40, 10, 1100, 25, 10, 0, 25, 10 };
+   const S32 count = ARRAYSIZE(delays);
+
+   // Order they should arrive in
+   const U8 expected[] = { 5, 1, 4, 7, 3, 6, 0, 2 };
+
+   netInterface.processConnections();     // Brings the interface's clock up to date
+   U32 start = netInterface.getCurrentTime();
+
+   for(S32 i = 0; i < count; i++)
+   {
+      PacketStream out;
+      out.write(U8(i));
+      netInterface.sendtoDelayed(&peerAddress, NULL, &out, delays[i]);
+   }
+
+   Vector<U8> arrived;
+   while(arrived.size() < count && Platform::getRealMilliseconds() - start < 3000)
+   {
+      netInterface.processConnections();
+
+      U8 data[MaxPacketDataSize];
+      Address from;
+      S32 bytesRead;
+
+      while(peer.recvfrom(&from, data, sizeof(data), &bytesRead) == NoError)
+      {
+         EXPECT_GE(netInterface.getCurrentTime() - start, delays[data[0]]) << "Packet " << S32(data[0]) << " went early";
+         arrived.push_back(data[0]);
+      }
+
+      Platform::sleep(1);
+   }
+
+   ASSERT_EQ(count, arrived.size());
+   for(S32 i = 0; i < count; i++)
+      EXPECT_EQ(expected[i], arrived[i]) << "Position " << i;
+}
+
+
+// On a manual clock, stepped a millisecond at a time, each delayed packet goes out on the first step past when it's
+// due, however many are waiting; packets due together go in the order they were sent.  Plenty are held for longer
+// than a turn of the delay wheel, and the clock wraps around along the way.
+TEST(NetInterfaceTest, DelayedPacketsGoOutWhenDue)
+{
+   const S32 count = 2000;
+   const U32 maxDelay = 2500;
+   const U32 start = U32_MAX - 1000;
+
+   NetInterface netInterface(Address("IP:127.0.0.1:0"));
+   netInterface.useManualClock(start);
+
+   Socket peer(Address("IP:127.0.0.1:0"));
+   Address peerAddress = peer.getBoundAddress();
+
+   srand(1);
+   Vector<U32> delays;
+   for(S32 i = 0; i < count; i++)
+   {
+      delays.push_back(U32(rand()) % maxDelay);
+
+      PacketStream out;
+      out.write(U8(i >> 8));
+      out.write(U8(i & 0xFF));
+      netInterface.sendtoDelayed(&peerAddress, NULL, &out, delays[i]);
+   }
+
+   // Order they should arrive in: by delay, then by when they were sent
+   Vector<S32> expected;
+   for(U32 delay = 0; delay < maxDelay; delay++)
+      for(S32 i = 0; i < count; i++)
+         if(delays[i] == delay)
+            expected.push_back(i);
+
+   Vector<S32> arrived;
+   for(U32 elapsed = 1; elapsed <= maxDelay; elapsed++)
+   {
+      netInterface.advanceTime(1);
+      netInterface.processConnections();
+
+      U8 data[MaxPacketDataSize];
+      Address from;
+      S32 bytesRead;
+
+      while(peer.recvfrom(&from, data, sizeof(data), &bytesRead) == NoError)
+      {
+         ASSERT_EQ(2, bytesRead);
+
+         S32 index = (data[0] << 8) | data[1];
+         EXPECT_EQ(delays[index] + 1, elapsed) << "Packet " << index;
+         arrived.push_back(index);
+      }
+   }
+
+   ASSERT_EQ(count, arrived.size());
+   for(S32 i = 0; i < count; i++)
+      EXPECT_EQ(expected[i], arrived[i]) << "Position " << i;
+}
+
+};
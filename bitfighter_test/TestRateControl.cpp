@@ -0,0 +1,307 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "tnlNetConnection.h"
+#include "tnlEventConnection.h"
+#include "tnlNetEvent.h"
+#include "tnlNetInterface.h"
+#include "tnlRateController.h"
+
+#include "gtest/gtest.h"
+
+namespace Zap
+{
+
+using namespace TNL;
+
+// The accepting side fills every packet it's allowed to send, like a server with lots of ghosts to update; the
+// initiating side sends nearly empty packets, which are all it takes to carry the acks back.  Like the real
+// writers, it stops once the packet has reached the size the rate calls for.
+class BulkConnection : public NetConnection
+{
+public:
+   U32 bytesReceived;
+
+   BulkConnection() { bytesReceived = 0; }
+
+   // Fixed rate connections only ack on packets of their own, so both sides always have something to say
+   bool isDataToTransmit() { return true; }
+
+   void writePacket(BitStream *stream, PacketNotify *note)
+   {
+      if(getConnectionParameters().mIsInitiator)
+         return;
+
+      while(!stream->isFull() && stream->getBitPosition() + 32 <= mWriteMaxBitSize)
+         stream->writeInt(0, 32);
+   }
+
+   void readPacket(BitStream *stream)
+   {
+      bytesReceived += (stream->getMaxReadBitPosition() - stream->getBitPosition()) / 8;
+   }
+
+   void setRate(U32 sendPeriod, U32 bandwidth)
+   {
+      setFixedRateParameters(sendPeriod, sendPeriod, bandwidth, bandwidth);
+   }
+
+   BulkConnection *getRemote()
+   {
+      return (BulkConnection *)mRemoteConnection.getPointer();
+   }
+
+   TNL_DECLARE_NETCONNECTION(BulkConnection);
+};
+
+TNL_IMPLEMENT_NETCONNECTION(BulkConnection, NetClassGroupGame, false);
+
+
+struct LinkResult
+{
+   F32 bandwidth;    // Bytes per second that got through
+   F32 roundTrip;    // Average, in ms
+   F32 loss;         // Fraction of data packets lost
+};
+
+
+static const U32 StartTime = 100000;      // Anything will do, so long as it's the same every time
+static const U32 WarmUpTime = 10000;      // Simulated ms before we start measuring
+static const U32 MeasureTime = 20000;
+
+// Server rates are those of a Bitfighter server; the client asks for whatever it likes.  Acks come back over a
+// link just like the one the data goes out on, but with room to spare.
+static LinkResult runLink(const NetConnection::SimulatedLink &link, RateControlType type, U32 clientPeriod, U32 clientBandwidth)
+{
+   NetInterface serverInterface(Address("IP:127.0.0.1:0"));
+   NetInterface clientInterface(Address("IP:127.0.0.1:0"));
+
+   serverInterface.useManualClock(StartTime);
+   clientInterface.useManualClock(StartTime);
+
+   RefPtr<BulkConnection> client = new BulkConnection();
+   client->setRate(clientPeriod, clientBandwidth);
+   EXPECT_TRUE(client->connectLocal(&clientInterface, &serverInterface));
+
+   BulkConnection *server = client->getRemote();
+   server->setRate(20, 65535);
+   server->setRateController(RateController::create(type));
+   server->setSimulatedLink(link);
+
+   NetConnection::SimulatedLink returnLink = link;
+   returnLink.bandwidth = 0;
+   returnLink.seed = link.seed + 1;
+   client->setSimulatedLink(returnLink);
+
+   LinkResult result;
+   F64 roundTripTotal = 0;
+   S32 roundTripSamples = 0;
+   U32 startBytes = 0, startSent = 0, startDropped = 0;
+
+   for(U32 time = 1; time <= WarmUpTime + MeasureTime; time++)
+   {
+      serverInterface.advanceTime(1);
+      clientInterface.advanceTime(1);
+      serverInterface.processConnections();
+      clientInterface.processConnections();
+
+      if(time == WarmUpTime)
+      {
+         startBytes = client->bytesReceived;
+         startSent = server->mPacketSendCount;
+         startDropped = server->mPacketSendDropped;
+      }
+      else if(time > WarmUpTime && time % 10 == 0)
+      {
+         roundTripTotal += server->getRoundTripTime();
+         roundTripSamples++;
+      }
+   }
+
+   result.bandwidth = (client->bytesReceived - startBytes) * 1000.0f / MeasureTime;
+   result.roundTrip = F32(roundTripTotal / roundTripSamples);
+   result.loss = F32(server->mPacketSendDropped - startDropped) / (server->mPacketSendCount - startSent);
+
+   return result;
+}
+
+
+// Plenty of bandwidth, but a client that asked for a modest rate
+static NetConnection::SimulatedLink getGoodLink()
+{
+   NetConnection::SimulatedLink link;
+   link.latency = 25;
+   link.jitter = 5;
+   link.bandwidth = 100000;
+   link.queueLimit = 200;
+   link.seed = 1;
+
+   return link;
+}
+
+
+// Less bandwidth than the client asked for, behind a deep queue, with some jitter and loss besides
+static NetConnection::SimulatedLink getPoorLink()
+{
+   NetConnection::SimulatedLink link;
+   link.latency = 50;
+   link.jitter = 20;
+   link.packetLoss = 0.02f;
+   link.bandwidth = 10000;
+   link.queueLimit = 200;
+   link.seed = 1;
+
+   return link;
+}
+
+
+TEST(RateControlTest, SimulatedLinksRepeatExactly)
+{
+   RateControlType types[] = { RateControlFixed, RateControlDelayBased };
+
+   for(S32 i = 0; i < ARRAYSIZE(types); i++)
+   {
+      LinkResult first = runLink(getPoorLink(), types[i], 30, 20000);
+      LinkResult second = runLink(getPoorLink(), types[i], 30, 20000);
+
+      EXPECT_EQ(first.bandwidth, second.bandwidth);
+      EXPECT_EQ(first.roundTrip, second.roundTrip);
+      EXPECT_EQ(first.loss, second.loss);
+   }
+}
+
+
+// The fixed rate is stuck with what the client asked for; the controller finds the rest of the link
+TEST(RateControlTest, DelayBasedUsesSpareBandwidth)
+{
+   LinkResult fixed = runLink(getGoodLink(), RateControlFixed, 45, 8000);
+   LinkResult delayBased = runLink(getGoodLink(), RateControlDelayBased, 45, 8000);
+
+   EXPECT_GT(delayBased.bandwidth, fixed.bandwidth * 2);
+   EXPECT_LT(delayBased.roundTrip, fixed.roundTrip + 20);
+   EXPECT_EQ(0, delayBased.loss);
+}
+
+
+// The fixed rate overfills the link's queue, so packets wait and then get dropped; the controller keeps the queue
+// short without giving up much of what gets through
+TEST(RateControlTest, DelayBasedKeepsQueuesShort)
+{
+   LinkResult fixed = runLink(getPoorLink(), RateControlFixed, 30, 20000);
+   LinkResult delayBased = runLink(getPoorLink(), RateControlDelayBased, 30, 20000);
+
+   EXPECT_LT(delayBased.roundTrip, fixed.roundTrip * 0.6f);
+   EXPECT_LT(delayBased.loss, fixed.loss);
+   EXPECT_GT(delayBased.bandwidth, fixed.bandwidth * 0.8f);
+}
+
+
+// Bigger than the smallest packets the controller asks for, but well within what a packet can carry
+class BigEvent : public NetEvent
+{
+public:
+   enum { Words = 100 };
+
+   static S32 received;
+
+   BigEvent() : NetEvent(GuaranteedOrdered, DirAny) { }
+
+   void pack(EventConnection *connection, BitStream *stream)
+   {
+      for(U32 i = 0; i < Words; i++)
+         stream->writeInt(i, 32);
+   }
+
+   void unpack(EventConnection *connection, BitStream *stream)
+   {
+      for(U32 i = 0; i < Words; i++)
+         EXPECT_EQ(i, stream->readInt(32));
+   }
+
+   void process(EventConnection *connection)
+   {
+      received++;
+   }
+
+   TNL_DECLARE_CLASS(BigEvent);
+};
+
+S32 BigEvent::received = 0;
+
+TNL_IMPLEMENT_NETEVENT(BigEvent, NetClassGroupGameMask, 0);
+
+
+class BigEventConnection : public EventConnection
+{
+public:
+   // As above, so the acks keep coming back
+   bool isDataToTransmit() { return true; }
+
+   void setRate(U32 sendPeriod, U32 bandwidth)
+   {
+      setFixedRateParameters(sendPeriod, sendPeriod, bandwidth, bandwidth);
+   }
+
+   BigEventConnection *getRemote()
+   {
+      return (BigEventConnection *)mRemoteConnection.getPointer();
+   }
+
+   TNL_DECLARE_NETCONNECTION(BigEventConnection);
+};
+
+TNL_IMPLEMENT_NETCONNECTION(BigEventConnection, NetClassGroupGame, false);
+
+
+// A congested link shrinks the controller's packets, but a guaranteed event too big for them still gets through
+TEST(RateControlTest, BigEventsSurviveCongestion)
+{
+   NetInterface serverInterface(Address("IP:127.0.0.1:0"));
+   NetInterface clientInterface(Address("IP:127.0.0.1:0"));
+
+   serverInterface.useManualClock(StartTime);
+   clientInterface.useManualClock(StartTime);
+
+   RefPtr<BigEventConnection> client = new BigEventConnection();
+   client->setRate(50, 2000);
+   ASSERT_TRUE(client->connectLocal(&clientInterface, &serverInterface));
+
+   NetConnection::SimulatedLink link = getPoorLink();
+   link.bandwidth = 1000;
+
+   BigEventConnection *server = client->getRemote();
+   server->setRate(20, 65535);
+   server->setRateController(RateController::create(RateControlDelayBased));
+   server->setSimulatedLink(link);
+
+   BigEvent::received = 0;
+   const S32 Events = 5;
+
+   for(U32 time = 1; time <= WarmUpTime; time++)
+   {
+      if(time % 1000 == 0 && time / 1000 <= Events)
+         server->postNetEvent(new BigEvent());
+
+      serverInterface.advanceTime(1);
+      clientInterface.advanceTime(1);
+      serverInterface.processConnections();
+      clientInterface.processConnections();
+   }
+
+   EXPECT_EQ(Events, BigEvent::received);
+}
+
+
+TEST(RateControlTest, TypeNames)
+{
+   for(S32 i = 0; i < RateControlTypeCount; i++)
+      EXPECT_EQ(RateControlType(i), RateController::stringToType(RateController::typeToString(RateControlType(i))));
+
+   EXPECT_EQ(RateControlDelayBased, RateController::stringToType("delaybased"));
+   EXPECT_EQ(RateControlFixed, RateController::stringToType("Nonsense"));
+}
+
+
+};
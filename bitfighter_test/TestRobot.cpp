@@ -8,8 +8,14 @@
 #include "../zap/ServerGame.h"
 #include "../zap/gameType.h"
 #include "../zap/luaLevelGenerator.h"
+#include "../zap/robot.h"
+#include "../zap/stringUtils.h"
 #include "gtest/gtest.h"
 
+#include "tnlRandom.h"
+
+#include <tomcrypt.h>
+
 namespace Zap
 {
 
@@ -62,6 +68,196 @@ TEST(RobotTest, luaRobotNew)
 }
 
 
+// Paths asked for with requestPath() are searched for between ticks, not while the bot waits
+TEST(RobotTest, RequestedPathsAreSolvedBetweenTicks)
+{
+   GamePair gamePair(readFile(joindir("levels", "zc.level")), 0);
+   gamePair.server->unsuspendGame(false);
+
+   Vector<const char *> args;
+   gamePair.server->addBot(args, ClientInfo::ClassRobotAddedByAddbots);
+   gamePair.idle(10, 10);
+
+   ASSERT_EQ(1, gamePair.server->getRobotCount());
+
+   LuaLevelGenerator levelgen(gamePair.server);
+   ASSERT_TRUE(levelgen.prepareEnvironment());
+
+   ASSERT_TRUE(levelgen.runString("bot = bf:findAllObjects(ObjType.Robot)[1]; "
+                                  "zones = bf:findAllObjects(ObjType.GoalZone); "
+                                  "target = zones[#zones]:getPos(); "
+                                  "handle = bot:requestPath(target)"));
+   ASSERT_TRUE(levelgen.runString("assert(handle)"));
+   EXPECT_TRUE(levelgen.runString("assert(not bot:isPathReady(handle)); assert(bot:getPath(handle) == nil)"));
+
+   gamePair.idle(10);
+
+   EXPECT_TRUE(levelgen.runString("assert(bot:isPathReady(handle))"));
+   EXPECT_TRUE(levelgen.runString("path = bot:getPath(handle); assert(#path > 1); "
+                                  "assert(path[#path].x == target.x and path[#path].y == target.y)"));
+   EXPECT_TRUE(levelgen.runString("assert(not bot:isPathReady(handle + 1))"));
+}
+
+
+// A requested path comes back as a PathReady event, to the bot that asked for it and nobody else
+TEST(RobotTest, RequestedPathsFirePathReady)
+{
+   GamePair gamePair(readFile(joindir("levels", "zc.level")), 0);
+   gamePair.server->unsuspendGame(false);
+
+   Vector<const char *> args;
+   gamePair.server->addBot(args, ClientInfo::ClassRobotAddedByAddbots);
+   gamePair.server->addBot(args, ClientInfo::ClassRobotAddedByAddbots);
+   gamePair.idle(10, 10);
+
+   ASSERT_EQ(2, gamePair.server->getBotCount());
+
+   const string handler = "readyCount = 0 "
+                          "function onPathReady(h, found) "
+                          "   readyCount = readyCount + 1; readyHandle = h; readyFound = found; readyPath = bot:getPath(h) "
+                          "end "
+                          "bf:subscribe(Event.PathReady)";
+
+   Robot *asker = gamePair.server->getBot(0);
+   Robot *bystander = gamePair.server->getBot(1);
+
+   ASSERT_TRUE(asker->runString(handler));
+   ASSERT_TRUE(bystander->runString(handler));
+   gamePair.idle(10);      // Subscriptions take effect during the tick
+
+   ASSERT_TRUE(asker->runString("zones = bf:findAllObjects(ObjType.GoalZone); "
+                                "target = zones[#zones]:getPos(); "
+                                "handle = bot:requestPath(target)"));
+
+   // Nothing until the search has been done
+   EXPECT_EQ(0, asker->getLuaGlobalVar<S32>("readyCount"));
+
+   gamePair.idle(10);
+
+   EXPECT_EQ(1, asker->getLuaGlobalVar<S32>("readyCount"));
+   EXPECT_EQ(asker->getLuaGlobalVar<S32>("handle"), asker->getLuaGlobalVar<S32>("readyHandle"));
+   EXPECT_TRUE(asker->runString("assert(readyFound); assert(#readyPath > 1); "
+                                "assert(readyPath[#readyPath].x == target.x and readyPath[#readyPath].y == target.y)"));
+
+   EXPECT_EQ(0, bystander->getLuaGlobalVar<S32>("readyCount"));
+}
+
+
+// Plays six bots running script on level, writing down where each one was after each tick.  Random numbers
+// are drawn starting from randomState.
+static void recordBotReplay(const string &script, const string &level, const prng_state &randomState,
+                            bool parallelBotScripts, Vector<string> &ticks)
+{
+   GameSettingsPtr settings = GameSettingsPtr(new GameSettings());
+   settings->getIniSettings()->workerThreads = 3;
+   settings->getIniSettings()->parallelBotScripts = parallelBotScripts;
+   settings->getIniSettings()->defaultRobotScript = script;
+
+   GamePair gamePair(settings, level);
+   gamePair.server->unsuspendGame(false);
+
+   // Starting up hosting mixes the time into the random numbers
+   *static_cast<prng_state *>(TNL::Random::getState()) = randomState;
+
+   Vector<const char *> args;
+   for(S32 i = 0; i < 6; i++)
+      gamePair.server->addBot(args, ClientInfo::ClassRobotAddedByAddbots);
+
+   ASSERT_EQ(6, gamePair.server->getBotCount());
+
+   for(S32 i = 0; i < gamePair.server->getBotCount(); i++)
+      EXPECT_EQ(parallelBotScripts, gamePair.server->getBot(i)->hasOwnLuaState());
+
+   for(S32 tick = 0; tick < 1000; tick++)
+   {
+      gamePair.idle(10);
+
+      string state;
+      for(S32 i = 0; i < gamePair.server->getBotCount(); i++)
+      {
+         Robot *bot = gamePair.server->getBot(i);
+         Point pos = bot->getActualPos();
+
+         state += ftos(pos.x, 3) + "," + ftos(pos.y, 3) + " " + ftos(bot->getCurrentMove().angle, 3) + "\n";
+      }
+
+      ticks.push_back(state);
+   }
+}
+
+
+// Bots running side by side in their own Lua states should fly exactly where they would one at a time
+static void checkBotReplaysMatch(const string &script, const string &level)
+{
+   Vector<string> serialTicks, parallelTicks;
+
+   // Both replays have to draw the same random numbers
+   prng_state randomState = *static_cast<prng_state *>(TNL::Random::getState());
+
+   recordBotReplay(script, level, randomState, false, serialTicks);
+   recordBotReplay(script, level, randomState, true, parallelTicks);
+
+   ASSERT_EQ(1000, serialTicks.size());
+   ASSERT_EQ(serialTicks.size(), parallelTicks.size());
+
+   // Make sure the bots actually went somewhere
+   EXPECT_NE(serialTicks[0], serialTicks[serialTicks.size() - 1]);
+
+   for(S32 i = 0; i < serialTicks.size(); i++)
+      ASSERT_EQ(serialTicks[i], parallelTicks[i]) << "Replays diverged on tick " << i;
+}
+
+
+TEST(RobotTest, ParallelBotScriptsMatchSerialReplay)
+{
+   string openLevel =
+      "GameType 10 8\n"
+      "LevelName \"Orbit Test\"\n"
+      "GridSize 255\n"
+      "Team Bluey 0 0 1\n"
+      "Specials\n"
+      "MinPlayers\n"
+      "MaxPlayers\n"
+      "Spawn 0 0 0\n"
+      "TestItem 4 4\n";
+
+   // Orbitbots only look around and steer
+   checkBotReplaysMatch("orbitbot", openLevel);
+
+   // s_bots find their way around walls, pick random targets and shoot at each other
+   checkBotReplaysMatch("s_bot", readFile(joindir("levels", "zc.level")));
+}
+
+
+// Calls that change the game but give an answer can't be saved for later; bots running side by side still get it
+TEST(RobotTest, ParallelBotScriptsGetAnswers)
+{
+   GameSettingsPtr settings = GameSettingsPtr(new GameSettings());
+   settings->getIniSettings()->workerThreads = 3;
+   settings->getIniSettings()->parallelBotScripts = true;
+   settings->getIniSettings()->defaultRobotScript = "orbitbot";
+
+   GamePair gamePair(settings, readFile(joindir("levels", "zc.level")));
+   gamePair.server->unsuspendGame(false);
+
+   Vector<const char *> args;
+   for(S32 i = 0; i < 3; i++)
+      gamePair.server->addBot(args, ClientInfo::ClassRobotAddedByAddbots);
+
+   ASSERT_EQ(3, gamePair.server->getBotCount());
+
+   for(S32 i = 0; i < gamePair.server->getBotCount(); i++)
+      ASSERT_TRUE(gamePair.server->getBot(i)->runString(
+            "function onTick() deployed = bot:engineerDeployObject(EngineerBuildObject.Turret) end"));
+
+   gamePair.idle(10, 5);
+
+   // The level doesn't allow engineering, so the answer is always no -- but it's not nil
+   for(S32 i = 0; i < gamePair.server->getBotCount(); i++)
+      EXPECT_TRUE(gamePair.server->getBot(i)->runString("assert(deployed == false)"));
+}
+
+
 /** onShipSpawned doesn't fire?
 
 TEST(RobotTest, RemoveFromGameDuringInitialOnShipSpawn)
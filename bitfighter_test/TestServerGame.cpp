@@ -6,11 +6,25 @@
 #include "gameType.h"
 #include "ServerGame.h"
 #include "EngineeredItem.h"
+#include "moveObject.h"
+#include "projectile.h"
+#include "ClientGame.h"
+#include "GameManager.h"
+#include "gameNetInterface.h"
+#include "EventManager.h"
+#include "luaLevelGenerator.h"
+#include "SystemFunctions.h"
+#include "stringUtils.h"
+
+#include "LevelFilesForTesting.h"
 
 #include "TestUtils.h"
 
+#include "tnlRandom.h"
+
 #include "gtest/gtest.h"
 
+#include <tomcrypt.h>
 #include <string>
 #include <cmath>
 
@@ -164,5 +178,254 @@ TEST(ServerGameTest, LoadoutManagementTests)
    delete serverGame;
 }
 
+// Runs a few clients through a level, writing down what each one ended up with: every object's type and where
+// it is, sorted, as ghosts may arrive in any order
+static void ghostLevelToClients(S32 workerThreads, const prng_state &randomState, Vector<string> &clientStates)
+{
+   GameSettingsPtr settings = GameSettingsPtr(new GameSettings());
+   settings->getIniSettings()->workerThreads = workerThreads;
+
+   GamePair gamePair(settings, getLevelCode1());
+
+   // Starting up hosting mixes the time into the random numbers
+   *static_cast<prng_state *>(TNL::Random::getState()) = randomState;
+
+   for(S32 i = 0; i < 4; i++)
+      gamePair.addClient("TestPlayer" + itos(i));
+
+   GamePair::idle(10, 20);
+
+   const Vector<ClientGame *> *clientGames = GameManager::getClientGames();
+   for(S32 i = 0; i < clientGames->size(); i++)
+   {
+      const Vector<DatabaseObject *> *objects = clientGames->get(i)->getGameObjDatabase()->findObjects_fast();
+
+      Vector<string> lines;
+      for(S32 j = 0; j < objects->size(); j++)
+      {
+         BfObject *obj = static_cast<BfObject *>(objects->get(j));
+         Rect extent = obj->getExtent();
+
+         lines.push_back(itos(obj->getObjectTypeNumber()) + ": " + ftos(extent.min.x, 2) + "," + ftos(extent.min.y, 2) +
+                         " " + ftos(extent.max.x, 2) + "," + ftos(extent.max.y, 2));
+      }
+
+      lines.sort(alphaSort);
+
+      string state;
+      for(S32 j = 0; j < lines.size(); j++)
+         state += lines[j] + "\n";
+
+      EXPECT_TRUE(lines.size() > 0) << "Client " << i;
+      clientStates.push_back(state);
+   }
+
+   NetInterface *netInterface = gamePair.server->getNetInterface();
+   EXPECT_TRUE(netInterface->getPacketPhaseTime(NetInterface::PacketPhaseWrite) > 0);
+}
+
+
+// Preparing packets on worker threads should get clients exactly the same objects, in the same places, as doing it
+// on the main thread
+TEST(ServerGameTest, ParallelPacketPreparationMatchesSerial)
+{
+   prng_state randomState = *static_cast<prng_state *>(TNL::Random::getState());
+
+   Vector<string> serialStates, parallelStates;
+
+   ghostLevelToClients(0, randomState, serialStates);
+   ghostLevelToClients(3, randomState, parallelStates);
+
+   ASSERT_EQ(4, serialStates.size());
+   ASSERT_EQ(serialStates.size(), parallelStates.size());
+
+   for(S32 i = 0; i < serialStates.size(); i++)
+      EXPECT_EQ(serialStates[i], parallelStates[i]) << "Client " << i;
+}
+
+
+// Small, repeatable random numbers, so both runs of a replay get exactly the same inputs
+static F32 replayRandom(U32 &seed, F32 min, F32 max)
+{
+   seed = seed * 1664525 + 1013904223;
+   return min + (max - min) * F32(seed >> 8) / F32(1 << 24);
+}
+
+
+// Plays a level full of turrets, targets and stray projectiles, writing down where everything was after each tick
+static void recordIdleReplay(S32 workerThreads, Vector<string> &ticks)
+{
+   GameSettingsPtr settings = GameSettingsPtr(new GameSettings());
+   settings->getIniSettings()->workerThreads = workerThreads;
+
+   Address addr;
+   LevelSourcePtr levelSource = LevelSourcePtr(new StringLevelSource(""));
+   ServerGame *game = new ServerGame(addr, settings, levelSource, false, false);
+   GridDatabase *db = game->getGameObjDatabase();
+
+   game->loadLevelFromString(readFile(joindir("levels", "ctf.level")), db);
+   game->unsuspendGame(false);
+
+   Rect extents = db->getExtents();
+   U32 seed = 1;
+
+   // Turrets will go after these, and projectiles will knock them around
+   for(S32 i = 0; i < 100; i++)
+   {
+      TestItem *item = new TestItem();
+      item->setActualPos(Point(replayRandom(seed, extents.min.x, extents.max.x), replayRandom(seed, extents.min.y, extents.max.y)));
+      item->setActualVel(Point(replayRandom(seed, -200, 200), replayRandom(seed, -200, 200)));
+      item->addToGame(game, db);
+   }
+
+   for(S32 tick = 0; tick < 200; tick++)
+   {
+      for(S32 i = 0; i < 20; i++)
+      {
+         Point pos(replayRandom(seed, extents.min.x, extents.max.x), replayRandom(seed, extents.min.y, extents.max.y));
+         Point vel(replayRandom(seed, -800, 800), replayRandom(seed, -800, 800));
+
+         Projectile *projectile = new Projectile(i % 2 ? WeaponPhaser : WeaponBounce, pos, vel, NULL);
+         projectile->addToGame(game, db);
+      }
+
+      // Off in empty space, every so often, set up a turret and a target that will move into its sights during the
+      // tick.  The target is added last, so it idles first; a turret going by where things were when the tick
+      // started would miss it.
+      if(tick % 10 == 0)
+      {
+         Point anchor(extents.max.x + 1000 + tick * 200, extents.max.y + 1000);
+         Turret *turret = new Turret(0, anchor, Point(0, 1));
+         turret->addToGame(game, db);
+
+         Point aimPos = anchor + Point(0, Turret::TURRET_OFFSET);
+         TestItem *target = new TestItem();
+         target->setActualPos(aimPos + Point(Turret::TurretPerceptionDistance + TestItem::TEST_ITEM_RADIUS + 10, 400));
+         target->setActualVel(Point(-1000, 0));
+         target->addToGame(game, db);
+      }
+
+      game->idle(30);
+
+      string state;
+      const Vector<DatabaseObject *> *objects = db->findObjects_fast();
+
+      for(S32 i = 0; i < objects->size(); i++)
+      {
+         BfObject *obj = static_cast<BfObject *>(objects->get(i));
+         Point pos = obj->getExtent().getCenter();    // Not everything has a position
+         Point vel = obj->getVel();
+
+         state += itos(obj->getObjectTypeNumber()) + ": " + ftos(pos.x, 3) + "," + ftos(pos.y, 3) + " " + 
+                  ftos(vel.x, 3) + "," + ftos(vel.y, 3) + " " + ftos(obj->getHealth(), 3) + "\n";
+      }
+
+      ticks.push_back(state);
+   }
+
+   delete game;
+}
+
+
+// Objects idling with searches done ahead of time on worker threads should end up exactly where they would without
+TEST(ServerGameTest, ParallelIdleMatchesSerialReplay)
+{
+   Vector<string> serialTicks, parallelTicks;
+
+   recordIdleReplay(0, serialTicks);
+   recordIdleReplay(3, parallelTicks);
+
+   ASSERT_EQ(serialTicks.size(), parallelTicks.size());
+
+   for(S32 i = 0; i < serialTicks.size(); i++)
+      ASSERT_EQ(serialTicks[i], parallelTicks[i]) << "Replays diverged on tick " << i;
+}
+
+
+// Each game in a multi-instance server fires its events only to scripts running in that game
+TEST(ServerGameTest, ExtraInstancesKeepTheirOwnEventSubscriptions)
+{
+   GameSettingsPtr settings = GameSettingsPtr(new GameSettings());
+   LuaScriptRunner::startLua(settings->getFolderManager()->luaDir);
+
+   LevelSourcePtr levelSource = LevelSourcePtr(new StringLevelSource(""));
+   initHosting(settings, levelSource, true, false);
+   ServerGame *primary = GameManager::getServerGame();
+   primary->startHosting();
+
+   ServerGame *extra = new ServerGame(Address(), settings, levelSource, true, false);
+   ASSERT_TRUE(extra->isExtraInstance());
+   ASSERT_FALSE(primary->isExtraInstance());
+   GameManager::addServerGame(extra);
+
+   GameManager::setCurrentServerGame(extra);
+   extra->startHosting();
+   EXPECT_EQ(extra, GameManager::getServerGame());
+   EXPECT_EQ(extra->getEventManager(), EventManager::get());
+
+   string script = "ticks = 0; function onTick() ticks = ticks + 1 end; levelgen:subscribe(Event.Tick)";
+
+   LuaLevelGenerator *extraLevelgen = new LuaLevelGenerator(extra);
+   ASSERT_TRUE(extraLevelgen->prepareEnvironment());
+   ASSERT_TRUE(extraLevelgen->runString(script));
+
+   GameManager::setCurrentServerGame(primary);
+   EXPECT_NE(extra->getEventManager(), EventManager::get());
+
+   LuaLevelGenerator *primaryLevelgen = new LuaLevelGenerator(primary);
+   ASSERT_TRUE(primaryLevelgen->prepareEnvironment());
+   ASSERT_TRUE(primaryLevelgen->runString(script));
+
+   // Only the primary game is running, so only its script should hear any ticks
+   primary->unsuspendGame(false);
+
+   for(S32 i = 0; i < 10; i++)
+      GameManager::idle(100);
+
+   EXPECT_EQ(primary, GameManager::getServerGame());
+   EXPECT_LT(0, primaryLevelgen->getLuaGlobalVar<S32>("ticks"));
+   EXPECT_EQ(0, extraLevelgen->getLuaGlobalVar<S32>("ticks"));
+
+   // Once both are running, each script hears its own game's ticks, which come at most once per idle, and nothing more
+   extra->unsuspendGame(false);
+   ASSERT_TRUE(primaryLevelgen->runString("ticks = 0"));
+
+   for(S32 i = 0; i < 10; i++)
+      GameManager::idle(100);
+
+   EXPECT_LT(0, extraLevelgen->getLuaGlobalVar<S32>("ticks"));
+   EXPECT_GE(10, extraLevelgen->getLuaGlobalVar<S32>("ticks"));
+   EXPECT_LT(0, primaryLevelgen->getLuaGlobalVar<S32>("ticks"));
+   EXPECT_GE(10, primaryLevelgen->getLuaGlobalVar<S32>("ticks"));
+
+   delete primaryLevelgen;
+
+   GameManager::setCurrentServerGame(extra);
+   delete extraLevelgen;
+   GameManager::setCurrentServerGame(primary);
+
+   GameManager::deleteServerGame();
+   EXPECT_EQ(0, GameManager::getServerGames()->size());
+
+   LuaScriptRunner::clearScriptCache();
+   LuaScriptRunner::shutdown();
+}
+
+
+// A dedicated server with nobody on it should be able to sleep, but never for so long that its timers fall behind
+TEST(ServerGameTest, SuspendedGamesCanWaitToIdle)
+{
+   ServerGame *game = newServerGame();
+
+   ASSERT_TRUE(game->isSuspended());
+   EXPECT_LT(0u, game->getTimeUntilIdleNeeded());
+   EXPECT_GE(+ServerGame::SuspendedIdleTime, game->getTimeUntilIdleNeeded());
+
+   game->unsuspendGame(false);
+   EXPECT_EQ(0u, game->getTimeUntilIdleNeeded());
+
+   delete game;
+}
+
 
 };
@@ -0,0 +1,137 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "tnlUDP.h"
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+namespace Zap
+{
+
+using namespace TNL;
+
+// MockSocket can't stand in here: sendto() and recvfrom() aren't virtual, and the point is to count system calls
+// anyway, so these use real sockets talking to each other over loopback
+
+static const S32 PacketsPerRound = 48;     // About what a busy server sends in a tick
+static const S32 PacketSize = 200;
+static const U32 SocketBufferSize = 256 * 1024;
+static const Address LoopbackAddress("IP:127.0.0.1:0");     // Any free port
+
+
+// Each packet carries its round and index, so we can tell if anything was lost, reordered or mangled
+static void fillPacket(U8 *buffer, S32 round, S32 index)
+{
+   for(S32 i = 0; i < PacketSize; i++)
+      buffer[i] = U8(round * 31 + index * 7 + i);
+}
+
+
+TEST(UDPTest, BatchesDeliverEveryPacket)
+{
+   Socket sender(LoopbackAddress, SocketBufferSize, SocketBufferSize);
+   Socket receiver(LoopbackAddress, SocketBufferSize, SocketBufferSize);
+
+   ASSERT_TRUE(sender.isValid());
+   ASSERT_TRUE(receiver.isValid());
+
+   Address to = receiver.getBoundAddress();
+   Address from = sender.getBoundAddress();
+
+   U8 sendData[PacketsPerRound][PacketSize];
+   Datagram datagrams[PacketsPerRound];
+
+   for(S32 i = 0; i < PacketsPerRound; i++)
+   {
+      fillPacket(sendData[i], 1, i);
+      datagrams[i].address = to;
+      datagrams[i].buffer = sendData[i];
+      datagrams[i].size = PacketSize - i;      // Sizes vary, so we know each one came through whole
+   }
+
+   S32 sentCount;
+   ASSERT_EQ(NoError, sender.sendtoBatch(datagrams, PacketsPerRound, &sentCount));
+   ASSERT_EQ(PacketsPerRound, sentCount);
+
+   // Read them back in batches smaller than what was sent
+   U8 receiveData[16][MaxPacketDataSize];
+   Datagram received[16];
+   for(S32 i = 0; i < 16; i++)
+      received[i].buffer = receiveData[i];
+
+   S32 total = 0;
+   while(total < PacketsPerRound)
+   {
+      S32 receivedCount;
+      ASSERT_EQ(NoError, receiver.recvfromBatch(received, 16, MaxPacketDataSize, &receivedCount));
+
+      for(S32 i = 0; i < receivedCount; i++, total++)
+      {
+         EXPECT_EQ(from, received[i].address);
+         ASSERT_EQ(PacketSize - total, received[i].size);
+         EXPECT_EQ(0, memcmp(sendData[total], received[i].buffer, received[i].size)) << "Packet " << total;
+      }
+   }
+
+   EXPECT_EQ(PacketsPerRound, total);
+
+   // And nothing more is waiting
+   S32 receivedCount;
+   EXPECT_EQ(WouldBlock, receiver.recvfromBatch(received, 16, MaxPacketDataSize, &receivedCount));
+   EXPECT_EQ(0, receivedCount);
+}
+
+
+#ifdef TNL_OS_LINUX
+// Elsewhere packets come back one at a time, and what happens to oversized ones is up to the platform
+TEST(UDPTest, BatchesDropTruncatedPackets)
+{
+   Socket sender(LoopbackAddress, SocketBufferSize, SocketBufferSize);
+   Socket receiver(LoopbackAddress, SocketBufferSize, SocketBufferSize);
+
+   Address to = receiver.getBoundAddress();
+
+   const S32 BufferSize = 100;
+   const S32 Count = 6;
+
+   // Every other packet is too big for the buffers we'll read into
+   U8 sendData[Count][PacketSize];
+   Datagram datagrams[Count];
+
+   for(S32 i = 0; i < Count; i++)
+   {
+      fillPacket(sendData[i], 2, i);
+      datagrams[i].address = to;
+      datagrams[i].buffer = sendData[i];
+      datagrams[i].size = i % 2 == 0 ? PacketSize : BufferSize / 2;
+   }
+
+   S32 sentCount;
+   ASSERT_EQ(NoError, sender.sendtoBatch(datagrams, Count, &sentCount));
+   ASSERT_EQ(Count, sentCount);
+
+   U8 receiveData[16][BufferSize];
+   Datagram received[16];
+   for(S32 i = 0; i < 16; i++)
+      received[i].buffer = receiveData[i];
+
+   S32 receivedCount;
+   ASSERT_EQ(NoError, receiver.recvfromBatch(received, 16, BufferSize, &receivedCount));
+   ASSERT_EQ(Count / 2, receivedCount);
+
+   for(S32 i = 0; i < receivedCount; i++)
+   {
+      ASSERT_EQ(BufferSize / 2, received[i].size);
+      EXPECT_EQ(0, memcmp(sendData[i * 2 + 1], received[i].buffer, received[i].size)) << "Packet " << i;
+   }
+
+   EXPECT_EQ(WouldBlock, receiver.recvfromBatch(received, 16, BufferSize, &receivedCount));
+}
+#endif
+
+
+};
@@ -0,0 +1,89 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "UpdatePriorityBatch.h"
+#include "gameConnection.h"
+#include "moveObject.h"
+
+#include "tnlRandom.h"
+
+#include "gtest/gtest.h"
+
+namespace Zap
+{
+
+using namespace TNL;
+
+class UpdatePriorityBatchTest : public testing::Test
+{
+protected:
+   Vector<TestItem *> mItems;
+   Vector<U32> mUpdateMasks;
+   Vector<S32> mUpdateSkips;
+
+   static Point randomPoint(F32 range)
+   {
+      return Point(TNL::Random::readF() * 2 * range - range, TNL::Random::readF() * 2 * range - range);
+   }
+
+   void createItems(S32 count)
+   {
+      for(S32 i = 0; i < count; i++)
+      {
+         TestItem *item = new TestItem();
+         item->setActualPos(randomPoint(2000));
+         item->setActualVel(randomPoint(500));
+
+         mItems.push_back(item);
+         mUpdateMasks.push_back(TNL::Random::readB() ? 0xFFFFFFFF : 1);
+         mUpdateSkips.push_back(TNL::Random::readI(0, 20));
+      }
+   }
+
+   void fillBatch(UpdatePriorityBatch &batch)
+   {
+      batch.clear();
+      for(S32 i = 0; i < mItems.size(); i++)
+         batch.add(mItems[i], mUpdateMasks[i], mUpdateSkips[i]);
+   }
+
+   virtual void TearDown()
+   {
+      mItems.deleteAndClear();
+   }
+};
+
+
+// Batched priorities feed the same sort as the ones from getUpdatePriority(), so they need to match exactly
+TEST_F(UpdatePriorityBatchTest, MatchesGetUpdatePriority)
+{
+   createItems(103);    // Not a multiple of 4, so some go through the scalar path
+
+   GameConnection conn;
+   TestItem reference;
+   reference.setActualPos(Point(100, -50));
+   reference.setActualVel(Point(20, 30));
+
+   UpdatePriorityBatch batch;
+
+   // Without a control object, and with one
+   for(S32 pass = 0; pass < 2; pass++)
+   {
+      if(pass == 1)
+         conn.setControlObject(&reference);
+
+      fillBatch(batch);
+      batch.compute(conn.getControlObject());
+
+      ASSERT_EQ(mItems.size(), batch.size());
+      for(S32 i = 0; i < mItems.size(); i++)
+         EXPECT_EQ(mItems[i]->getUpdatePriority(&conn, mUpdateMasks[i], mUpdateSkips[i]), batch.getPriority(i)) << "Item " << i;
+   }
+
+   conn.setControlObject(NULL);
+}
+
+
+};
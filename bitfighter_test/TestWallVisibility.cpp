@@ -0,0 +1,200 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "WallVisibility.h"
+#include "gridDB.h"
+#include "barrier.h"
+#include "moveObject.h"     // For ActualState
+#include "BotNavMeshZone.h"
+#include "ServerGame.h"
+#include "stringUtils.h"
+
+#include "tnlRandom.h"
+
+#include "TestUtils.h"
+
+#include "gtest/gtest.h"
+
+namespace Zap
+{
+
+static F32 randomFloat(F32 min, F32 max)
+{
+   return min + (max - min) * F32(TNL::Random::readI(0, 10000)) / 10000.0f;
+}
+
+
+// Casts the rays against walls
+static void castRays(const GridDatabase *db, const Vector<Point> &starts, const Vector<Point> &ends,
+                    Vector<DatabaseObject *> &hits, Vector<F32> &times, Vector<Point> &normals)
+{
+   hits.resize(starts.size());
+   times.resize(starts.size());
+   normals.resize(starts.size());
+
+   for(S32 i = 0; i < starts.size(); i++)
+      hits[i] = db->findObjectLOS((TestFunc)isWallType, ActualState, starts[i], ends[i], times[i], normals[i]);
+}
+
+
+// Line-of-sight checks against the tree have to find walls exactly where searching the database does
+TEST(WallVisibilityTest, TreeMatchesDatabaseSearches)
+{
+   static const S32 RayCount = 20000;
+
+   const string extensions[] = { "level" };
+   Vector<string> levels;
+   getFilesFromFolder("levels", levels, extensions, ARRAYSIZE(extensions));
+
+   ASSERT_TRUE(levels.size() > 0) << "No levels found to test!";
+
+   for(S32 i = 0; i < levels.size(); i++)
+   {
+      ServerGame *game = newServerGame();
+      GridDatabase *db = game->getGameObjDatabase();
+
+      game->loadLevelFromString(readFile(joindir("levels", levels[i])), db);
+      Rect extents = db->getExtents();
+
+      Vector<Point> starts, ends;
+      for(S32 j = 0; j < RayCount; j++)
+      {
+         starts.push_back(Point(randomFloat(extents.min.x, extents.max.x), randomFloat(extents.min.y, extents.max.y)));
+         ends.push_back(starts.last() + Point(randomFloat(-1000, 1000), randomFloat(-1000, 1000)));
+      }
+
+      Vector<DatabaseObject *> expectedHits, hits;
+      Vector<F32> expectedTimes, times;
+      Vector<Point> normals;
+
+      castRays(db, starts, ends, expectedHits, expectedTimes, normals);
+
+      ASSERT_TRUE(db->buildWallVisibility()) << levels[i];
+      ASSERT_TRUE(db->getWallVisibility() != NULL);
+
+      castRays(db, starts, ends, hits, times, normals);
+
+      for(S32 j = 0; j < RayCount; j++)
+      {
+         ASSERT_EQ(expectedHits[j] == NULL, hits[j] == NULL) << levels[i] << ": ray " << j;
+
+         // Which wall, and so which normal, may differ where the ray hits a corner or two overlapping walls
+         if(hits[j])
+            EXPECT_EQ(expectedTimes[j], times[j]) << levels[i] << ": ray " << j;
+      }
+
+      delete game;
+   }
+}
+
+
+// Walls coming and going make the tree useless until it's rebuilt
+TEST(WallVisibilityTest, ChangingWallsDropsTree)
+{
+   ServerGame *game = newServerGame();
+   GridDatabase *db = game->getGameObjDatabase();
+
+   game->loadLevelFromString(readFile(joindir("levels", "ctf.level")), db);
+
+   ASSERT_TRUE(db->buildWallVisibility());
+   ASSERT_TRUE(db->getWallVisibility() != NULL);
+
+   WallItem *wall = new WallItem();
+   Vector<Point> geom;
+   geom.push_back(Point(0, 0));
+   geom.push_back(Point(100, 100));
+   wall->GeomObject::setGeom(geom);
+   wall->setExtent(Rect(geom));
+   wall->addToDatabase(db);
+
+   EXPECT_TRUE(db->getWallVisibility() == NULL);
+
+   ASSERT_TRUE(db->buildWallVisibility());
+   wall->setExtent(Rect(Point(500, 500), 10));
+   EXPECT_TRUE(db->getWallVisibility() == NULL);
+
+   ASSERT_TRUE(db->buildWallVisibility());
+   db->removeFromDatabase(wall, true);
+   EXPECT_TRUE(db->getWallVisibility() == NULL);
+
+   delete game;
+}
+
+
+// A point somewhere inside a convex zone
+static Point randomPointIn(const BotNavMeshZone *zone)
+{
+   const Vector<Point> *outline = zone->getOutline();
+
+   Point sum;
+   F32 totalWeight = 0;
+
+   for(S32 i = 0; i < outline->size(); i++)
+   {
+      F32 weight = randomFloat(0.01f, 1);
+      sum += outline->get(i) * weight;
+      totalWeight += weight;
+   }
+
+   return sum / totalWeight;
+}
+
+
+// Zones that can see each other's centers must never be ruled out, and neither can any that see each other from
+// anywhere else; on a level full of walls, plenty of zones should still be hidden from each other
+TEST(WallVisibilityTest, ZoneVisibilityKeepsVisiblePairs)
+{
+   ServerGame *game = newServerGame();
+   GridDatabase *db = game->getGameObjDatabase();
+
+   game->loadLevelFromString(readFile(joindir("levels", "core.level")), db);
+   game->computeWorldObjectExtents();
+
+   Vector<BotNavMeshZone *> zones;
+   ASSERT_TRUE(BotNavMeshZone::buildBotMeshZones(game->getBotZoneDatabase(), db, &zones, game->getWorldExtents(), false));
+
+   ASSERT_TRUE(db->buildWallVisibility());
+   WallVisibility *visibility = db->getWallVisibility();
+
+   visibility->buildZoneVisibility(&zones, NULL);
+
+   ASSERT_TRUE(visibility->hasZoneVisibility());
+
+   S32 hiddenPairs = 0;
+   S32 pairs = 0;
+
+   for(S32 i = 0; i < zones.size(); i++)
+      for(S32 j = 0; j < zones.size(); j++)
+      {
+         EXPECT_EQ(visibility->canZonesSee(i, j), visibility->canZonesSee(j, i));
+
+         if(db->pointCanSeePoint(zones[i]->getCenter(), zones[j]->getCenter()))
+            EXPECT_TRUE(visibility->canZonesSee(i, j)) << "Zones " << i << " and " << j;
+
+         if(!visibility->canZonesSee(i, j))
+         {
+            hiddenPairs++;
+
+            for(S32 k = 0; k < 5; k++)
+            {
+               Point from = randomPointIn(zones[i]);
+               Point to = randomPointIn(zones[j]);
+
+               EXPECT_FALSE(db->pointCanSeePoint(from, to)) << "Zones " << i << " and " << j;
+            }
+         }
+
+         pairs++;
+      }
+
+   EXPECT_TRUE(hiddenPairs > pairs / 4) << "Only " << hiddenPairs << " of " << pairs << " zone pairs are hidden";
+   EXPECT_TRUE(visibility->canZonesSee(0, U16_MAX));     // Unknown zones might see anything
+
+   zones.deleteAndClear();
+   delete game;
+}
+
+
+};
@@ -0,0 +1,89 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "tnlThread.h"
+#include "tnlVector.h"
+
+#include "gtest/gtest.h"
+
+namespace Zap
+{
+
+using namespace TNL;
+
+// Counts how many times each item gets run
+class CountingJob : public WorkerPool::Job
+{
+public:
+   Vector<S32> runCounts;
+
+   CountingJob(S32 itemCount)
+   {
+      runCounts.resize(itemCount);
+      for(S32 i = 0; i < itemCount; i++)
+         runCounts[i] = 0;
+   }
+
+   // Each item only touches its own slot, so no locking needed
+   void runItem(S32 index)
+   {
+      runCounts[index]++;
+   }
+};
+
+
+static void expectEachItemRunOnce(const CountingJob &job)
+{
+   for(S32 i = 0; i < job.runCounts.size(); i++)
+      EXPECT_EQ(1, job.runCounts[i]) << "Item " << i;
+}
+
+
+TEST(WorkerPoolTest, RunsEveryItemExactlyOnce)
+{
+   WorkerPool pool(3);
+   EXPECT_EQ(3U, pool.getThreadCount());
+
+   // Fewer items than threads, more items than threads, and lots of items
+   S32 itemCounts[] = { 1, 2, 7, 1000 };
+
+   for(S32 i = 0; i < ARRAYSIZE(itemCounts); i++)
+   {
+      CountingJob job(itemCounts[i]);
+      pool.run(&job, itemCounts[i]);
+      expectEachItemRunOnce(job);
+   }
+}
+
+
+// Pool gets reused every tick, so make sure it keeps working after many runs
+TEST(WorkerPoolTest, CanBeReused)
+{
+   WorkerPool pool(2);
+
+   for(S32 i = 0; i < 200; i++)
+   {
+      CountingJob job(i);
+      pool.run(&job, i);
+      expectEachItemRunOnce(job);
+   }
+}
+
+
+// With no threads, everything runs on the calling thread
+TEST(WorkerPoolTest, WorksWithoutThreads)
+{
+   WorkerPool pool(0);
+   EXPECT_EQ(0U, pool.getThreadCount());
+
+   CountingJob job(50);
+   pool.run(&job, 50);
+   expectEachItemRunOnce(job);
+
+   EXPECT_TRUE(WorkerPool::getProcessorCount() >= 1);
+}
+
+
+};
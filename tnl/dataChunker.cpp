@@ -32,10 +32,13 @@
 
 namespace TNL {
 
-DataChunker::DataChunker(S32 size)
+DataChunker::DataChunker(S32 size, S32 align)
 {
+   TNLAssert(align >= 4 && (align & (align - 1)) == 0, "Alignment must be a power of 2, and at least a dword");
+
    chunkSize          = size;
-   curBlock           = new DataBlock(size);
+   alignment          = align;
+   curBlock           = new DataBlock(size, alignment);
    curBlock->next     = NULL;
    curBlock->curIndex = 0;
 }
@@ -52,24 +55,26 @@ void *DataChunker::alloc(S32 size)
 
    if(!curBlock || size + curBlock->curIndex > chunkSize)
    {
-      DataBlock *temp = new DataBlock(chunkSize);
+      DataBlock *temp = new DataBlock(chunkSize, alignment);
       temp->next = curBlock;
       temp->curIndex = 0;
       curBlock = temp;
    }
    void *ret = curBlock->data + curBlock->curIndex;
-   curBlock->curIndex += (size + 3) & ~3; // dword align
+   curBlock->curIndex += (size + alignment - 1) & ~(alignment - 1);
    return ret;
 }
 
-DataChunker::DataBlock::DataBlock(S32 size)
+DataChunker::DataBlock::DataBlock(S32 size, S32 alignment)
 {
-   data = new U8[size];
+   // new[] only promises dword alignment, so allocate enough extra to line things up ourselves
+   allocated = new U8[size + alignment - 4];
+   data = (U8 *) ((uintptr_t(allocated) + alignment - 1) & ~uintptr_t(alignment - 1));
 }
 
 DataChunker::DataBlock::~DataBlock()
 {
-   delete[] data;
+   delete[] allocated;
 }
 
 void DataChunker::freeBlocks()
@@ -213,6 +213,7 @@ void EventConnection::packetDropped(PacketNotify *pnotify)
             // mSendEventQueueHead in the right place (based on seq numbers)
 
             logprintf(LogConsumer::LogEventConnection, "EventConnection %s: DroppedGuaranteed - %d", getNetAddressString(), walk->mSeqCount);
+            mEventsRetransmitted++;
             while(*insertList && (*insertList)->mSeqCount < walk->mSeqCount)
                insertList = &((*insertList)->mNextEvent);
             
@@ -227,6 +228,7 @@ void EventConnection::packetDropped(PacketNotify *pnotify)
          case NetEvent::Guaranteed:
             // It was a guaranteed packet, put it at the top of
             // mUnorderedSendEventQueueHead.
+            mEventsRetransmitted++;
             temp = walk->mNextEvent;
             walk->mNextEvent = mUnorderedSendEventQueueHead;
             mUnorderedSendEventQueueHead = walk;
@@ -289,6 +291,7 @@ void EventConnection::writePacket(BitStream *bstream, PacketNotify *pnotify)
 {
    Parent::writePacket(bstream, pnotify);
    EventPacketNotify *notify = static_cast<EventPacketNotify *>(pnotify);
+   U32 eventsStart = bstream->getBitPosition();
    
    bool have_something_to_send = bstream->getBitPosition() >= 128;
 
@@ -440,6 +443,8 @@ void EventConnection::writePacket(BitStream *bstream, PacketNotify *pnotify)
       
    notify->eventList = packQueueHead;
    bstream->writeFlag(0);
+
+   addTrafficBits(TrafficEvents, bstream->getBitPosition() - eventsStart);
 }
 
 void EventConnection::readPacket(BitStream *bstream)
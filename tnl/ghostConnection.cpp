@@ -30,6 +30,9 @@
 #include "tnlNetBase.h"
 #include "tnlNetObject.h"
 #include "tnlNetInterface.h"
+#include "tnlPlatform.h"
+
+#include <algorithm>
 
 namespace TNL {
 
@@ -42,9 +45,18 @@ GhostConnection::GhostConnection()
    mScoping = false;
    mGhostLookupTable = NULL;
    mGhostZeroUpdateIndex = 0;
+   mGhostFreeIndex = 0;
 
    mGhostFrom = false;
    mGhostTo = false;
+
+   mCollectingScope = false;
+   mScopeCollected = false;
+   mUpdatePrioritiesReady = false;
+   mMaxGhostIndex = 0;
+
+   mGhostUpdatesSent = 0;
+   mGhostUpdatesSkipped = 0;
 }
 
 GhostConnection::~GhostConnection()
@@ -182,19 +194,46 @@ void GhostConnection::packetReceived(PacketNotify *pnotify)
    }
 }
 
-static S32 QSORT_CALLBACK UQECompare(const void *a,const void *b)
+static bool hasLowerPriority(const GhostInfo *a, const GhostInfo *b)
+{
+   return a->priority < b->priority;
+}
+
+// Moves the batchSize highest priority ghosts among the first count in mGhostArray to the end of that range,
+// in increasing order of priority, and returns the index of the first of them
+S32 GhostConnection::sortUpdateBatch(S32 count, S32 batchSize)
+{
+   GhostInfo **ghosts = mGhostArray.address();
+   S32 start = count > batchSize ? count - batchSize : 0;
+
+   if(start > 0)
+      std::nth_element(ghosts, ghosts + start, ghosts + count, hasLowerPriority);
+   std::sort(ghosts + start, ghosts + count, hasLowerPriority);
+
+   // reset the array indices of anything that might have moved
+   for(S32 i = 0; i < count; i++)
+      ghosts[i]->arrayIndex = i;
+
+   return start;
+}
+
+NetObject *GhostConnection::getPriorityReferenceObject()
 {
-   GhostInfo *ga = *((GhostInfo **) a);
-   GhostInfo *gb = *((GhostInfo **) b);
+   return mScopeObject;
+}
 
-   F32 ret = ga->priority - gb->priority;
-   return (ret < 0) ? -1 : ((ret > 0) ? 1 : 0);
-} 
+void GhostConnection::computeBatchedUpdatePriorities(GhostInfo **ghosts, S32 count)
+{
+   for(S32 i = 0; i < count; i++)
+      ghosts[i]->priority = ghosts[i]->obj->getUpdatePriority(this, ghosts[i]->updateMask, ghosts[i]->updateSkipCount);
+}
 
 void GhostConnection::prepareWritePacket()
 {
    Parent::prepareWritePacket();
 
+   mUpdatePrioritiesReady = false;
+
    if(!doesGhostFrom() && !mGhosting)
       return;
 
@@ -233,8 +272,42 @@ void GhostConnection::prepareWritePacket()
          walk->flags &= ~GhostInfo::InScope;
    }
 
+   if(mScopeCollected)
+   {
+      // collectScope() already did the hard work, probably on a worker thread
+      for(S32 i = 0; i < mPendingScope.size(); i++)
+         objectInScope(mPendingScope[i]);
+
+      mPendingScope.clear();
+      mScopeCollected = false;
+   }
+   else if(mScopeObject)
+   {
+      S64 start = Platform::getHighPrecisionTimerValue();
+      mScopeObject->performScopeQuery(this);
+      getInterface()->addPacketPhaseTime(NetInterface::PacketPhaseScope, 
+                                         Platform::getHighPrecisionMilliseconds(Platform::getHighPrecisionTimerValue() - start));
+   }
+}
+
+void GhostConnection::collectScope()
+{
+   Parent::collectScope();
+
+   mPendingScope.clear();
+   mScopeCollected = false;
+
+   if(!doesGhostFrom() && !mGhosting)
+      return;
+
    if(mScopeObject)
+   {
+      mCollectingScope = true;
       mScopeObject->performScopeQuery(this);
+      mCollectingScope = false;
+   }
+
+   mScopeCollected = true;
 }
 
 bool GhostConnection::isDataToTransmit()
@@ -244,30 +317,13 @@ bool GhostConnection::isDataToTransmit()
    return Parent::isDataToTransmit() || mGhostZeroUpdateIndex != 0;
 }
 
-void GhostConnection::writePacket(BitStream *bstream, PacketNotify *pnotify)
+void GhostConnection::prepareUpdatePriorities()
 {
-   Parent::writePacket(bstream, pnotify);
-   GhostPacketNotify *notify = static_cast<GhostPacketNotify *>(pnotify);
-
-   if(mConnectionParameters.mDebugObjectSizes)
-      bstream->writeInt(DebugChecksum, 32);
+   Parent::prepareUpdatePriorities();
 
-   notify->ghostList = NULL;
-   
-   if(!doesGhostFrom())
-      return;
-   
-   if(!bstream->writeFlag(mGhosting && mScopeObject.isValid()))
+   // Same conditions as writePacket() -- if we won't be ghosting, there's nothing to prioritize
+   if(!doesGhostFrom() || !mGhosting || !mScopeObject.isValid())
       return;
-      
-   // fill a packet (or two) with ghosting data
-
-   // 2. call scoped objects' priority functions if the flag set is nonzero
-   //    A removed ghost is assumed to have a high priority
-   // 3. call updates based on sorted priority until the packet is
-   //    full.  set flags to zero for all updated objects
-
-   GhostInfo *walk;
 
    for(S32 i = mGhostZeroUpdateIndex - 1; i >= 0; i--)
    {
@@ -275,38 +331,126 @@ void GhostConnection::writePacket(BitStream *bstream, PacketNotify *pnotify)
          detachObject(mGhostArray[i]);
    }
 
-   U32 maxIndex = 0;
+   mMaxGhostIndex = 0;
    for(S32 i = mGhostZeroUpdateIndex - 1; i >= 0; i--)
    {
-      walk = mGhostArray[i];
-      if(walk->index > maxIndex)
-         maxIndex = walk->index;
+      GhostInfo *walk = mGhostArray[i];
+      if(walk->index > mMaxGhostIndex)
+         mMaxGhostIndex = walk->index;
 
       // clear out any kill objects that haven't been ghosted yet
       if((walk->flags & GhostInfo::KillGhost) && (walk->flags & GhostInfo::NotYetGhosted))
-      {
          freeGhostInfo(walk);
-         continue;
-      }
+   }
+
+   mUpdatePrioritiesReady = true;
+}
+
+void GhostConnection::computeUpdatePriorities()
+{
+   Parent::computeUpdatePriorities();
+
+   if(!mUpdatePrioritiesReady)
+      return;
+
+   NetObject *reference = getPriorityReferenceObject();
+   U32 referenceRevision = reference ? reference->getUpdatePriorityRevision() : 0;
+
+   mPriorityBatch.clear();
+
+   for(S32 i = mGhostZeroUpdateIndex - 1; i >= 0; i--)
+   {
+      GhostInfo *walk = mGhostArray[i];
+
       // don't do any ghost processing on objects that are being killed
       // or in the process of ghosting
-      else if(!(walk->flags & (GhostInfo::KillingGhost | GhostInfo::Ghosting)))
+      if(!(walk->flags & (GhostInfo::KillingGhost | GhostInfo::Ghosting)))
       {
          if(walk->flags & GhostInfo::KillGhost)
             walk->priority = 10000;
          else
-            walk->priority = walk->obj->getUpdatePriority(this, walk->updateMask, walk->updateSkipCount);
+         {
+            F32 perSkip = walk->obj->getUpdatePriorityPerSkip();
+
+            // if nothing but the skip count has changed since we last asked the object, we can work it out ourselves
+            if(perSkip >= 0 && walk->priorityCached && walk->cachedUpdateMask == walk->updateMask &&
+                  walk->cachedRevision == walk->obj->getUpdatePriorityRevision() &&
+                  walk->cachedReferenceRevision == referenceRevision)
+               walk->priority = walk->cachedPriority + F32(S32(walk->updateSkipCount - walk->cachedSkipCount)) * perSkip;
+            else
+            {
+               // batched priorities get filled in, and cached, once we've found all of them
+               if(walk->obj->hasBatchedUpdatePriority())
+                  mPriorityBatch.push_back(walk);
+               else
+                  walk->priority = walk->obj->getUpdatePriority(this, walk->updateMask, walk->updateSkipCount);
+
+               walk->priorityCached = (perSkip >= 0);
+               walk->cachedPriority = walk->priority;
+               walk->cachedSkipCount = walk->updateSkipCount;
+               walk->cachedUpdateMask = walk->updateMask;
+               walk->cachedRevision = walk->obj->getUpdatePriorityRevision();
+               walk->cachedReferenceRevision = referenceRevision;
+            }
+         }
       }
       else
          walk->priority = 0;
    }
+
+   if(mPriorityBatch.size() == 0)
+      return;
+
+   computeBatchedUpdatePriorities(mPriorityBatch.address(), mPriorityBatch.size());
+
+   for(S32 i = 0; i < mPriorityBatch.size(); i++)
+      mPriorityBatch[i]->cachedPriority = mPriorityBatch[i]->priority;
+}
+
+void GhostConnection::writePacket(BitStream *bstream, PacketNotify *pnotify)
+{
+   Parent::writePacket(bstream, pnotify);
+   GhostPacketNotify *notify = static_cast<GhostPacketNotify *>(pnotify);
+   U32 ghostsStart = bstream->getBitPosition();
+
+   if(mConnectionParameters.mDebugObjectSizes)
+      bstream->writeInt(DebugChecksum, 32);
+
+   notify->ghostList = NULL;
+   
+   if(!doesGhostFrom())
+   {
+      addTrafficBits(TrafficGhosts, bstream->getBitPosition() - ghostsStart);
+      return;
+   }
+   
+   if(!bstream->writeFlag(mGhosting && mScopeObject.isValid()))
+   {
+      addTrafficBits(TrafficGhosts, bstream->getBitPosition() - ghostsStart);
+      return;
+   }
+      
+   // fill a packet (or two) with ghosting data
+
+   // 2. call scoped objects' priority functions if the flag set is nonzero
+   //    A removed ghost is assumed to have a high priority
+   // 3. call updates based on sorted priority until the packet is
+   //    full.  set flags to zero for all updated objects
+
+   // Unless the NetInterface already had us do step 2 ahead of time, do it now
+   if(!mUpdatePrioritiesReady)
+   {
+      S64 start = Platform::getHighPrecisionTimerValue();
+      prepareUpdatePriorities();
+      computeUpdatePriorities();
+      getInterface()->addPacketPhaseTime(NetInterface::PacketPhasePriority, 
+                                         Platform::getHighPrecisionMilliseconds(Platform::getHighPrecisionTimerValue() - start));
+   }
+   mUpdatePrioritiesReady = false;
+
    GhostRef *updateList = NULL;
-   if(mGhostZeroUpdateIndex != 0)
-      qsort(&mGhostArray[0], mGhostZeroUpdateIndex, sizeof(GhostInfo *), UQECompare);
-   // reset the array indices...
-   for(S32 i = mGhostZeroUpdateIndex - 1; i >= 0; i--)
-      mGhostArray[i]->arrayIndex = i;
 
+   U32 maxIndex = mMaxGhostIndex;
    U8 sendSize = 0;
    while(maxIndex != 0)
    {
@@ -321,8 +465,21 @@ void GhostConnection::writePacket(BitStream *bstream, PacketNotify *pnotify)
 
    U32 count = 0;
    bool have_something_to_send = bstream->getBitPosition() >= 256;
-   for(S32 i = mGhostZeroUpdateIndex - 1; i >= 0 && !bstream->isFull(); i--)
+   // Only the highest priority updates will fit in the packet, so rather than sorting every ghost, put the top
+   // few in order, and go back for more if they all fit.  Ghosts from sortedStart up are in priority order.
+   // Writing an update never moves any ghosts below the one being written, so the unsorted part is left alone.
+   S32 sortedStart = mGhostZeroUpdateIndex;
+   S32 batchSize = UpdateBatchSize;
+
+   S32 i;
+   for(i = mGhostZeroUpdateIndex - 1; i >= 0 && !bstream->isFull(); i--)
    {
+      if(i < sortedStart)
+      {
+         sortedStart = sortUpdateBatch(i + 1, batchSize);
+         batchSize *= 2;
+      }
+
       GhostInfo *walk = mGhostArray[i];
       if(walk->flags & (GhostInfo::KillingGhost | GhostInfo::Ghosting))
          continue;
@@ -434,6 +591,11 @@ void GhostConnection::writePacket(BitStream *bstream, PacketNotify *pnotify)
    // no more objects...
    bstream->writeFlag(false);
    notify->ghostList = updateList;
+
+   // Whatever we didn't get to (including an update that was rewound) waits for a later packet
+   mGhostUpdatesSent += count;
+   mGhostUpdatesSkipped += i + 1;
+   addTrafficBits(TrafficGhosts, bstream->getBitPosition() - ghostsStart);
 }
 
 void GhostConnection::readPacket(BitStream *bstream)
@@ -657,6 +819,12 @@ bool GhostConnection::validateGhostArray()
 
 void GhostConnection::objectInScope(NetObject *obj)
 {
+   if(mCollectingScope)
+   {
+      mPendingScope.push_back(obj);
+      return;
+   }
+
    if (!mScoping || !doesGhostFrom())     // doesGhostFrom ==>  Does this GhostConnection ghost NetObjects to the remote host?
       return;
 
@@ -705,6 +873,7 @@ void GhostConnection::objectInScope(NetObject *obj)
    giptr->obj = obj;
    giptr->lastUpdateChain = NULL;
    giptr->updateSkipCount = 0;
+   giptr->priorityCached = false;
 
    giptr->connection = this;
 
@@ -75,8 +75,15 @@ NetConnection::NetConnection()
    mSimulatedReceiveLatency = 0;
    mSimulatedSendPacketLoss = 0;
    mSimulatedReceivePacketLoss = 0;
+   mSimulatedSendJitter = 0;
+   mSimulatedLinkBandwidth = 0;
+   mSimulatedLinkQueueLimit = 0;
+   mSimulatedLinkBacklog = 0;
+   mSimulatedLinkTime = 0;
+   mSimulatedRandomState = Random::readI() | 1;
 
    mLastPacketRecvTime = 0;
+   mPacketArrivalTime = 0;
    mLastUpdateTime = 0;
    mRoundTripTime = 0;
    mSendDelayCredit = 0;
@@ -91,6 +98,7 @@ NetConnection::NetConnection()
    mLocalRate.minPacketSendPeriod = DefaultFixedSendPeriod;
 
    mUseZeroLatencyForTesting = false;
+   mRateController = NULL;
 
    mRemoteRate = mLocalRate;
    mLocalRateChanged = true;
@@ -125,6 +133,10 @@ NetConnection::NetConnection()
    mPacketRecvCount = 0;
    mPacketSendCount = 0;
 
+   for(S32 i = 0; i < TrafficCategoryCount; i++)
+      mTrafficBitsSent[i] = 0;
+   mEventsRetransmitted = 0;
+
    mWriteMaxBitSize = MaxPreferredPacketDataSize*8 - MinimumPaddingBits;
 }
 
@@ -143,6 +155,7 @@ NetConnection::~NetConnection()
 {
    clearAllPacketNotifies();
    delete mStringTable;
+   delete mRateController;
 
    TNLAssert(mNotifyQueueHead == NULL, "Uncleared notifies remain.");
 }
@@ -162,6 +175,7 @@ NetConnection::PacketNotify::PacketNotify()
 {
    rateChanged = false;
    sendTime = 0;
+   packetSize = 0;
 }
 
 bool NetConnection::checkTimeout(U32 time)
@@ -222,6 +236,8 @@ void NetConnection::setLastError(const char *fmt, ...)
 
 void NetConnection::writeRawPacket(BitStream *bstream, NetPacketType packetType)
 {
+   U32 payloadBits = 0;    // Counted by the layers that wrote it; the rest is overhead
+
    writePacketHeader(bstream, packetType);
    if(packetType == DataPacket)
    {
@@ -240,7 +256,8 @@ void NetConnection::writeRawPacket(BitStream *bstream, NetPacketType packetType)
 
       logprintf(LogConsumer::LogNetConnection, "NetConnection %s: START %s", mNetAddress.toString(), getClassName());
       writePacket(bstream, note);
-      logprintf(LogConsumer::LogNetConnection, "NetConnection %s: END %s - %d bits", mNetAddress.toString(), getClassName(), bstream->getBitPosition() - start);
+      payloadBits = bstream->getBitPosition() - start;
+      logprintf(LogConsumer::LogNetConnection, "NetConnection %s: END %s - %d bits", mNetAddress.toString(), getClassName(), payloadBits);
    }
    if(!mSymmetricCipher.isNull())
    {
@@ -250,11 +267,15 @@ void NetConnection::writeRawPacket(BitStream *bstream, NetPacketType packetType)
    mPacketSendBytesLast = bstream->getBytePosition();
    mPacketSendBytesTotal += mPacketSendBytesLast;
    mPacketSendCount++;
+   addTrafficBits(TrafficOverhead, mPacketSendBytesLast * 8 - payloadBits);
+
+   if(packetType == DataPacket)
+      mNotifyQueueTail->packetSize = mPacketSendBytesLast;
 }
 
-void NetConnection::readRawPacket(BitStream *bstream)
+void NetConnection::readRawPacket(BitStream *bstream, U32 arrivalTime)
 {
-   if(mSimulatedReceivePacketLoss && Random::readF() < mSimulatedReceivePacketLoss)
+   if(mSimulatedReceivePacketLoss && getSimulatedRandom() < mSimulatedReceivePacketLoss)
    {
       logprintf(LogConsumer::LogNetConnection, "NetConnection %s: RECVDROP - %d", mNetAddress.toString(), getLastSendSequence());
       return;
@@ -265,10 +286,11 @@ void NetConnection::readRawPacket(BitStream *bstream)
    logprintf(LogConsumer::LogNetConnection, "NetConnection %s: RECV- %d bytes", mNetAddress.toString(), mPacketRecvBytesLast);
 
    mErrorBuffer[0] = 0;
+   mPacketArrivalTime = arrivalTime;
 
    if(readPacketHeader(bstream))
    {
-      mLastPacketRecvTime = mInterface->getCurrentTime();
+      mLastPacketRecvTime = arrivalTime;
 
       readPacketRateInfo(bstream);
       bstream->setStringTable(mStringTable);
@@ -474,17 +496,30 @@ bool NetConnection::readPacketHeader(BitStream *pstream)
       bool packetTransmitSuccess = (pkAckMask[ackMaskWord] & (1 << ackMaskBit)) != 0;
       logprintf(LogConsumer::LogConnectionProtocol, "Ack %d %d", notifyIndex, packetTransmitSuccess ? 1 : 0);
 
+      U32 packetSize = mNotifyQueueHead->packetSize;     // The notify is gone once it's been handled
+
       mHighestAckedSendTime = 0;
       handleNotify(notifyIndex, packetTransmitSuccess);
 
       // Running average of roundTrip time
+      S32 roundTripDelta = 0;
       if(mHighestAckedSendTime)
       {
-         S32 roundTripDelta = mInterface->getCurrentTime() - (mHighestAckedSendTime + pkSendDelay);
+         roundTripDelta = mPacketArrivalTime - (mHighestAckedSendTime + pkSendDelay);
          mRoundTripTime = mRoundTripTime * 0.9f + roundTripDelta * 0.1f;
          if(mRoundTripTime < 0)
             mRoundTripTime = 0;
       }      
+
+      if(mRateController && !isAdaptive())
+      {
+         if(packetTransmitSuccess)
+            mRateController->packetAcked(mPacketArrivalTime, packetSize, U32(getMax(roundTripDelta, 0)));
+         else
+            mRateController->packetLost(mPacketArrivalTime, packetSize);
+
+         applyRateController();
+      }
       if(packetTransmitSuccess)
          mLastRecvAckAck = mLastSeqRecvdAtSend[notifyIndex & PacketWindowMask];
    }
@@ -565,10 +600,40 @@ void NetConnection::computeNegotiatedRate()
    if(mCurrentPacketSendSize > MaxPacketDataSize)
       mCurrentPacketSendSize = MaxPacketDataSize;
 
+   if(mRateController && !isAdaptive())
+   {
+      mRateController->setNegotiatedRate(mCurrentPacketSendPeriod, mCurrentPacketSendSize,
+                                         mLocalRate.minPacketSendPeriod, mLocalRate.maxSendBandwidth);
+      applyRateController();
+   }
+   else if(mUseZeroLatencyForTesting)
+      mCurrentPacketSendPeriod = 0;
+}
+
+// Like the negotiated packet size, the controller's is where writing stops, not a hard limit: a big event or
+// ghost update still has to fit somewhere, so it can always go over by as much as it could without a controller.
+// The controller slows us down by sending less often.
+void NetConnection::applyRateController()
+{
+   mCurrentPacketSendPeriod = mRateController->getSendPeriod();
+   mCurrentPacketSendSize = mRateController->getPacketSize();
+   mWriteMaxBitSize = getMax(mCurrentPacketSendSize, MaxPreferredPacketDataSize) * 8 - MinimumPaddingBits;
+
    if(mUseZeroLatencyForTesting)
       mCurrentPacketSendPeriod = 0;
 }
 
+void NetConnection::setRateController(RateController *controller)
+{
+   delete mRateController;
+   mRateController = controller;
+
+   if(!mRateController)
+      mWriteMaxBitSize = MaxPreferredPacketDataSize*8 - MinimumPaddingBits;
+
+   computeNegotiatedRate();
+}
+
 void NetConnection::setIsAdaptive()
 {
    mTypeFlags.set(ConnectionAdaptive);
@@ -675,21 +740,46 @@ void NetConnection::handleNotify(U32 sequence, bool recvd)
 
 //--------------------------------------------------------------------
 
-void NetConnection::checkPacketSend(bool force, U32 curTime)
+// Fixed rate connections slow down when lots of packets are waiting on acks, unless a rate controller is
+// keeping an eye on the link for them
+U32 NetConnection::getPacketSendDelay()
 {
    U32 delay = mCurrentPacketSendPeriod;
+   U32 unackedPackets = mLastSendSeq - mHighestAckedSeq;
+
+   //  This might fix extremely high ping for users with very limited speeds
+   //printf("%i", mLastSendSeq - mHighestAckedSeq);
+   if(!mRateController && unackedPackets > 5)
+      delay *= (unackedPackets - 5) * 2;
+
+   return delay;
+}
+
+bool NetConnection::isPacketSendDue(U32 curTime)
+{
+   if(isAdaptive())
+      return true;
 
+   U32 delay = getPacketSendDelay();
+   return !(curTime - mLastUpdateTime + mSendDelayCredit < delay);
+}
+
+void NetConnection::checkPacketSend(bool force, U32 curTime)
+{
+   if(beginPacketSend(force, curTime))
+      finishPacketSend(curTime);
+}
+
+bool NetConnection::beginPacketSend(bool force, U32 curTime)
+{
    if(!force)
    {
       if(!isAdaptive())
       {
-         //  This might fix extremely high ping for users with very limited speeds
-         //printf("%i", mLastSendSeq - mHighestAckedSeq);
-         if(mLastSendSeq - mHighestAckedSeq > 5)
-            delay *= (mLastSendSeq - mHighestAckedSeq - 5) * 2;
+         U32 delay = getPacketSendDelay();
 
          if(curTime - mLastUpdateTime + mSendDelayCredit < delay)
-            return;
+            return false;
       
          mSendDelayCredit = curTime - (mLastUpdateTime + delay - mSendDelayCredit);
          if(mSendDelayCredit > 1000)
@@ -720,8 +810,14 @@ void NetConnection::checkPacketSend(bool force, U32 curTime)
             sendAckPacket();
          }
       }
-      return;
+      return false;
    }
+
+   return true;
+}
+
+void NetConnection::finishPacketSend(U32 curTime)
+{
    PacketStream stream(mCurrentPacketSendSize);
    mLastUpdateTime = curTime;
 
@@ -730,6 +826,21 @@ void NetConnection::checkPacketSend(bool force, U32 curTime)
    sendPacket(&stream);
 }
 
+void NetConnection::collectScope()
+{
+   // Do nothing
+}
+
+void NetConnection::prepareUpdatePriorities()
+{
+   // Do nothing
+}
+
+void NetConnection::computeUpdatePriorities()
+{
+   // Do nothing
+}
+
 bool NetConnection::windowFull()
 {
    if(mLastSendSeq - mHighestAckedSeq >= (MaxPacketWindowSize - 2))
@@ -739,9 +850,68 @@ bool NetConnection::windowFull()
    return false;
 }
 
+NetConnection::SimulatedLink::SimulatedLink()
+{
+   latency = 0;
+   jitter = 0;
+   packetLoss = 0;
+   bandwidth = 0;
+   queueLimit = 0;
+   seed = 1;
+}
+
+void NetConnection::setSimulatedLink(const SimulatedLink &link)
+{
+   mSimulatedSendLatency = link.latency;
+   mSimulatedSendJitter = link.jitter;
+   mSimulatedSendPacketLoss = link.packetLoss;
+   mSimulatedLinkBandwidth = link.bandwidth;
+   mSimulatedLinkQueueLimit = link.queueLimit;
+   mSimulatedLinkBacklog = 0;
+   mSimulatedRandomState = link.seed ? link.seed : 1;    // Xorshift never gets anywhere from 0
+}
+
+F32 NetConnection::getSimulatedRandom()
+{
+   mSimulatedRandomState ^= mSimulatedRandomState << 13;
+   mSimulatedRandomState ^= mSimulatedRandomState >> 17;
+   mSimulatedRandomState ^= mSimulatedRandomState << 5;
+
+   return (mSimulatedRandomState >> 8) * (1.0f / (1 << 24));
+}
+
+// Packets on a link with limited bandwidth go out one after another, so each waits for those ahead of it; jitter
+// can still let a packet overtake the one before
+bool NetConnection::simulateSendLink(U32 packetSize, U32 &delay)
+{
+   delay = mSimulatedSendLatency;
+
+   if(mSimulatedSendPacketLoss && getSimulatedRandom() < mSimulatedSendPacketLoss)
+      return false;
+
+   if(mSimulatedSendJitter)
+      delay += U32(getSimulatedRandom() * (mSimulatedSendJitter + 1));
+
+   if(mSimulatedLinkBandwidth)
+   {
+      U32 time = mInterface->getCurrentTime();
+      mSimulatedLinkBacklog = getMax(mSimulatedLinkBacklog - F32(time - mSimulatedLinkTime), 0.0f);
+      mSimulatedLinkTime = time;
+
+      if(mSimulatedLinkQueueLimit && mSimulatedLinkBacklog > mSimulatedLinkQueueLimit)
+         return false;
+
+      mSimulatedLinkBacklog += packetSize * 1000.0f / mSimulatedLinkBandwidth;
+      delay += U32(mSimulatedLinkBacklog);
+   }
+
+   return true;
+}
+
 NetError NetConnection::sendPacket(BitStream *stream)
 {
-   if(mSimulatedSendPacketLoss && Random::readF() < mSimulatedSendPacketLoss)
+   U32 delay;
+   if(!simulateSendLink(stream->getBytePosition(), delay))
    {
       logprintf(LogConsumer::LogNetConnection, "NetConnection %s: SENDDROP - %d", mNetAddress.toString(), getLastSendSequence());
       return NoError;
@@ -754,9 +924,9 @@ NetError NetConnection::sendPacket(BitStream *stream)
    {
       // short circuit connection to the other side.
       // handle the packet, then force a notify.
-      if(mSimulatedSendLatency + mRemoteConnection->mSimulatedReceiveLatency != 0)
+      if(delay + mRemoteConnection->mSimulatedReceiveLatency != 0)
       {
-         mInterface->sendtoDelayed(NULL, mRemoteConnection, stream, mSimulatedSendLatency + mRemoteConnection->mSimulatedReceiveLatency);
+         mInterface->sendtoDelayed(NULL, mRemoteConnection, stream, delay + mRemoteConnection->mSimulatedReceiveLatency);
       }
       else
       {
@@ -765,15 +935,15 @@ NetError NetConnection::sendPacket(BitStream *stream)
          stream->reset();
          stream->setMaxSizes(size, 0);
       
-         mRemoteConnection->readRawPacket(stream);
+         mRemoteConnection->readRawPacket(stream, mRemoteConnection->getInterface()->getCurrentTime());
       }
       return NoError;
    }
    else
    {
-      if(mSimulatedSendLatency)
+      if(delay)
       {
-         mInterface->sendtoDelayed(&getNetAddress(), NULL, stream, mSimulatedSendLatency);
+         mInterface->sendtoDelayed(&getNetAddress(), NULL, stream, delay);
          return NoError;
       }
       else
@@ -985,4 +1155,169 @@ errorOut:
    return false;
 }
 
+//--------------------------------------------------------------------
+// Rate control
+//--------------------------------------------------------------------
+
+RateController *RateController::create(RateControlType type)
+{
+   if(type == RateControlDelayBased)
+      return new DelayBasedRateController();
+
+   return NULL;
+}
+
+RateControlType RateController::stringToType(const char *type)
+{
+   if(!stricmp(type, "DelayBased"))
+      return RateControlDelayBased;
+
+   return RateControlFixed;
+}
+
+const char *RateController::typeToString(RateControlType type)
+{
+   if(type == RateControlDelayBased)
+      return "DelayBased";
+
+   return "Fixed";
+}
+
+const F32 DelayBasedRateController::LossAverageWeight = 1 / 16.0f;
+const F32 DelayBasedRateController::LossyRate = 0.05f;
+const F32 DelayBasedRateController::CongestedLossRate = 0.2f;
+const F32 DelayBasedRateController::DrainFactor = 0.95f;
+const F32 DelayBasedRateController::FullUseFactor = 0.75f;
+const F32 DelayBasedRateController::ProbeFactor = 1.1f;
+const F32 DelayBasedRateController::MinBandwidthFactor = 0.25f;
+
+DelayBasedRateController::DelayBasedRateController()
+{
+   mNegotiatedPeriod = 0;
+   mMinSendPeriod = 0;
+   mNegotiatedBandwidth = 0;
+   mMaxBandwidth = 0;
+   mBandwidth = 0;
+
+   mMinRoundTrip = 0;
+   mMinRoundTripTime = 0;
+   mHaveRoundTrip = false;
+   mLossRate = 0;
+
+   mIntervalStart = 0;
+   mIntervalMinRoundTrip = U32_MAX;
+   mIntervalBytesAcked = 0;
+
+   mSendPeriod = 0;
+   mPacketSize = 0;
+}
+
+// What we've learned about the link is kept; only the rate starts over
+void DelayBasedRateController::setNegotiatedRate(U32 sendPeriod, U32 packetSize, U32 minSendPeriod, U32 maxBandwidth)
+{
+   mNegotiatedPeriod = getMax(sendPeriod, 1u);
+   mMinSendPeriod = getMax(getMin(minSendPeriod, mNegotiatedPeriod), 1u);
+   mNegotiatedBandwidth = packetSize * 1000.0f / mNegotiatedPeriod;
+   mMaxBandwidth = getMax(F32(maxBandwidth), mNegotiatedBandwidth);
+   mBandwidth = mNegotiatedBandwidth;
+
+   computeSendRate();
+}
+
+void DelayBasedRateController::packetAcked(U32 time, U32 packetSize, U32 roundTripTime)
+{
+   if(!mHaveRoundTrip || roundTripTime <= mMinRoundTrip || time - mMinRoundTripTime > MinRoundTripWindow)
+   {
+      mMinRoundTrip = roundTripTime;
+      mMinRoundTripTime = time;
+   }
+
+   if(!mHaveRoundTrip)
+   {
+      mHaveRoundTrip = true;
+      mIntervalStart = time;
+   }
+
+   mIntervalMinRoundTrip = getMin(mIntervalMinRoundTrip, roundTripTime);
+   mIntervalBytesAcked += packetSize;
+   mLossRate -= mLossRate * LossAverageWeight;
+
+   if(time - mIntervalStart >= getDecisionInterval())
+      endInterval(time);
+}
+
+void DelayBasedRateController::packetLost(U32 time, U32 packetSize)
+{
+   mLossRate += (1 - mLossRate) * LossAverageWeight;
+
+   if(mHaveRoundTrip && time - mIntervalStart >= getDecisionInterval())
+      endInterval(time);
+}
+
+// Long enough for a change of rate to show up in the round trips
+U32 DelayBasedRateController::getDecisionInterval() const
+{
+   return getMax(U32(MinDecisionInterval), mMinRoundTrip + MinQueueDelay);
+}
+
+// The lowest round trip of the interval is the one least thrown off by jitter, so it's the best measure of how
+// long packets spent queued
+void DelayBasedRateController::endInterval(U32 time)
+{
+   F32 delivered = mIntervalBytesAcked * 1000.0f / (time - mIntervalStart);
+
+   // With no acks at all, there's only the loss rate to go on
+   U32 queueDelay = mIntervalMinRoundTrip != U32_MAX && mIntervalMinRoundTrip > mMinRoundTrip ?
+                    mIntervalMinRoundTrip - mMinRoundTrip : 0;
+   U32 maxQueueDelay = getMax(U32(MinQueueDelay), mMinRoundTrip / 4);
+
+   if(queueDelay > maxQueueDelay || mLossRate > CongestedLossRate)
+      mBandwidth = getMin(mBandwidth, delivered) * DrainFactor;
+   else if(mLossRate <= LossyRate && delivered >= mBandwidth * FullUseFactor)
+      mBandwidth = getMin(mBandwidth * ProbeFactor, mMaxBandwidth);
+
+   mBandwidth = getMax(mBandwidth, mNegotiatedBandwidth * MinBandwidthFactor);
+
+   mIntervalStart = time;
+   mIntervalMinRoundTrip = U32_MAX;
+   mIntervalBytesAcked = 0;
+
+   computeSendRate();
+}
+
+// Keeps to the negotiated period where it can, as updates look smoothest that way; packets only come more often
+// when they'd otherwise be too big
+void DelayBasedRateController::computeSendRate()
+{
+   U32 maxPacketSize = mLossRate > LossyRate ? LossyPacketSize : MaxPacketSize;
+   F32 bytesPerPeriod = mBandwidth * mNegotiatedPeriod * 0.001f;
+
+   mSendPeriod = mNegotiatedPeriod;
+   if(bytesPerPeriod > maxPacketSize)
+      mSendPeriod = getMax(mMinSendPeriod, U32(mNegotiatedPeriod * maxPacketSize / bytesPerPeriod));
+
+   mPacketSize = U32(mBandwidth * mSendPeriod * 0.001f);
+   mPacketSize = getMax(getMin(mPacketSize, maxPacketSize), U32(MinPacketSize));
+}
+
+U32 DelayBasedRateController::getSendPeriod() const
+{
+   return mSendPeriod;
+}
+
+U32 DelayBasedRateController::getPacketSize() const
+{
+   return mPacketSize;
+}
+
+F32 DelayBasedRateController::getBandwidth() const
+{
+   return mBandwidth;
+}
+
+F32 DelayBasedRateController::getLossRate() const
+{
+   return mLossRate;
+}
+
 };
@@ -33,6 +33,9 @@
 #include "tnlNetObject.h"
 #include "tnlClientPuzzle.h"
 #include "tnlCertificate.h"
+#include "tnlThread.h"
+#include "tnlJournal.h"
+#include "tnlRingBuffer.h"
 #include <tomcrypt.h>
 
 namespace TNL {
@@ -41,7 +44,9 @@ namespace TNL {
 // NetInterface initialization/destruction
 //-----------------------------------------------------------------------------
 
-NetInterface::NetInterface(const Address &bindAddress) : mSocket(bindAddress)
+NetInterface::NetInterface(const Address &bindAddress) :
+   mSocket(bindAddress),
+   mPacketBuffers(PacketBuffersPerChunk * sizeof(PacketBuffer), CacheLineSize)
 {
    NetClassRep::initialize(); // initialize the net class reps, if they haven't been initialized already.
 
@@ -54,8 +59,24 @@ NetInterface::NetInterface(const Address &bindAddress) : mSocket(bindAddress)
    mConnectionHashTable.resize(129);
    for(S32 i = 0; i < mConnectionHashTable.size(); i++)
       mConnectionHashTable[i] = NULL;
-   mSendPacketList = NULL;
+
+   for(S32 i = 0; i < DelayWheelSlots; i++)
+      mDelayWheelHead[i] = mDelayWheelTail[i] = NULL;
+   mDelayedPacketCount = 0;
    mCurrentTime = Platform::getRealMilliseconds();
+   mManualClock = false;
+
+   mWorkerPool = NULL;
+   resetPacketPhaseTimes();
+
+   mQueueingSends = false;
+   mIOThread = NULL;
+   mPacketArrivalTime = mCurrentTime;
+   mDelayWheelTime = mCurrentTime;
+
+   mReceivedPackets.resize(ReceiveBatchSize);
+   for(S32 i = 0; i < ReceiveBatchSize; i++)
+      mReceivedPackets[i].buffer = mPacketBuffers.alloc()->data;
 }
 
 NetInterface::~NetInterface()
@@ -66,15 +87,349 @@ NetInterface::~NetInterface()
       NetConnection *c = mConnectionList[0];
       disconnect(c, NetConnection::ReasonShutdown, "");
    }
-   while(mSendPacketList)
+
+   stopIOThread();      // Sends the disconnect packets on its way out
+
+   // The pools free their memory all at once, but SafePtrs need taking down properly
+   for(S32 i = 0; i < DelayWheelSlots; i++)
+      while(mDelayWheelHead[i])
+      {
+         DelaySendPacket *next = mDelayWheelHead[i]->nextPacket;
+         mDelaySendPackets.free(mDelayWheelHead[i]);
+         mDelayWheelHead[i] = next;
+      }
+}
+
+//-----------------------------------------------------------------------------
+// NetInterface I/O thread
+//-----------------------------------------------------------------------------
+
+/// A packet on its way between the game thread and the I/O thread.
+struct QueuedPacket
+{
+   Address address;
+   U32 arrivalTime;              ///< When the I/O thread read it; not used for outgoing packets
+   S32 size;
+   U8 data[MaxPacketDataSize];
+};
+
+/// Reads and writes a NetInterface's socket, so packets don't sit in the OS buffers while the game thread is
+/// busy.  Each queue has exactly one writer and one reader: the I/O thread fills mIncoming and empties mOutgoing,
+/// and the game thread does the opposite.
+///
+/// A game thread asleep in waitForPackets() is woken through mWakeSocket, a loopback socket the I/O thread sends
+/// itself a byte on.  It's a self-pipe, but one select() can wait on everywhere, Windows included.  The I/O thread
+/// sleeps on its socket and mThreadWakeSocket, which the game thread rings the same way when it has packets to
+/// send, or has made room for more to be read.
+class NetInterface::IOThread : public Thread
+{
+   Socket *mSocket;
+   std::atomic<bool> mQuitting;
+   Semaphore mFinished;
+   Datagram mDatagrams[Socket::MaxBatchSize];
+
+   Socket mWakeSocket;
+   Address mWakeAddress;
+   std::atomic<bool> mGameThreadWaiting;     ///< Set between beginWait() and endWait(); cleared by the wake-up
+
+   Socket mThreadWakeSocket;
+   Address mThreadWakeAddress;
+   std::atomic<bool> mWaitingForSends;       ///< Set while we sleep; cleared by the wake-up
+   std::atomic<bool> mWaitingForRoom;        ///< Set while we sleep with mIncoming full; cleared by the wake-up
+
+   void receiveWaiting();
+   void sendWaiting();
+   void wait();
+
+public:
+   RingBuffer<QueuedPacket> mIncoming;
+   RingBuffer<QueuedPacket> mOutgoing;
+
+   IOThread(Socket *socket);
+   U32 run();
+
+   /// Game thread only.  Waits for the thread to send what it has and exit.
+   void stop();
+
+   /// Game thread only.  Returns false if the outgoing queue is full.
+   bool send(const Address &address, const U8 *data, S32 size);
+
+   /// Game thread only.  Call after reading from mIncoming, in case the thread is waiting for room to read into.
+   void madeRoom();
+
+   /// False if the wake socket couldn't be opened, in which case the thread is no use to us.
+   bool canWake();
+
+   /// Game thread only.  Until endWait(), the returned socket becomes readable when packets are read.
+   Socket *beginWait();
+   void endWait();
+};
+
+NetInterface::IOThread::IOThread(Socket *socket) :
+   mIncoming(IOQueueSize),
+   mOutgoing(IOQueueSize),
+   mWakeSocket(Address("IP:127.0.0.1:0")),
+   mThreadWakeSocket(Address("IP:127.0.0.1:0"))
+{
+   mSocket = socket;
+   mQuitting = false;
+   mWakeAddress = mWakeSocket.getBoundAddress();
+   mGameThreadWaiting = false;
+   mThreadWakeAddress = mThreadWakeSocket.getBoundAddress();
+   mWaitingForSends = false;
+   mWaitingForRoom = false;
+}
+
+/// Reads whatever wake-ups have landed on socket, so they don't end the next wait before it starts
+static void drainWakeSocket(Socket *socket)
+{
+   Address from;
+   U8 wake;
+   S32 size;
+   while(socket->recvfrom(&from, &wake, 1, &size) == NoError)
+      ;
+}
+
+U32 NetInterface::IOThread::run()
+{
+   while(!mQuitting)
+   {
+      sendWaiting();
+      wait();
+      receiveWaiting();
+   }
+
+   sendWaiting();
+   mFinished.increment();
+
+   return 0;
+}
+
+/// Sleeps until there are packets to read or send.  With mIncoming full, packets can wait in the OS buffers until
+/// the game thread catches up, so we only listen for it.
+void NetInterface::IOThread::wait()
+{
+   S32 count;
+   bool haveRoom = mIncoming.beginWrite(&count) != NULL;
+
+   mWaitingForSends = true;
+   mWaitingForRoom = !haveRoom;
+
+   // As in beginWait(), anything the game thread did before it could see our flags has to be checked for here
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   if(!mQuitting && mOutgoing.isEmpty() && (haveRoom || !mIncoming.beginWrite(&count)))
    {
-      DelaySendPacket *next = mSendPacketList->nextPacket;
-      mSendPacketList->~DelaySendPacket(); // properly free stuff like SafePtr
-      free(mSendPacketList);
-      mSendPacketList = next;
+      Socket *sockets[] = { &mThreadWakeSocket, mSocket };
+      Socket::waitForReadable(sockets, haveRoom ? 2 : 1, IOThreadWaitTimeout);
    }
+
+   mWaitingForSends = false;
+   mWaitingForRoom = false;
+   drainWakeSocket(&mThreadWakeSocket);
 }
 
+void NetInterface::IOThread::receiveWaiting()
+{
+   S32 count;
+   QueuedPacket *packets = mIncoming.beginWrite(&count);
+
+   // The game thread has fallen behind; wait() will sleep until it catches up
+   if(!packets)
+      return;
+
+   count = getMin(count, S32(NetInterface::ReceiveBatchSize));
+   for(S32 i = 0; i < count; i++)
+      mDatagrams[i].buffer = packets[i].data;
+
+   S32 receivedCount;
+   if(mSocket->recvfromBatch(mDatagrams, count, MaxPacketDataSize, &receivedCount) != NoError)
+      return;
+
+   U32 arrivalTime = Platform::getRealMilliseconds();
+
+   for(S32 i = 0; i < receivedCount; i++)
+   {
+      packets[i].address = mDatagrams[i].address;
+      packets[i].size = mDatagrams[i].size;
+      packets[i].arrivalTime = arrivalTime;
+   }
+
+   mIncoming.endWrite(receivedCount);
+
+   // The game thread sets its flag before checking the queue, and we check the flag after filling it, so one of us
+   // always sees the other
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   if(receivedCount > 0 && mGameThreadWaiting.exchange(false))
+   {
+      U8 wake = 0;
+      mWakeSocket.sendto(mWakeAddress, &wake, 1);
+   }
+}
+
+void NetInterface::IOThread::sendWaiting()
+{
+   S32 count;
+   QueuedPacket *packets;
+
+   while((packets = mOutgoing.beginRead(&count)) != NULL)
+   {
+      count = getMin(count, S32(Socket::MaxBatchSize));
+      for(S32 i = 0; i < count; i++)
+      {
+         mDatagrams[i].address = packets[i].address;
+         mDatagrams[i].buffer = packets[i].data;
+         mDatagrams[i].size = packets[i].size;
+      }
+
+      // As with flushSendQueue(), a packet the socket won't take is skipped
+      S32 sentCount;
+      if(mSocket->sendtoBatch(mDatagrams, count, &sentCount) != NoError)
+         sentCount++;
+
+      mOutgoing.endRead(sentCount);
+   }
+}
+
+void NetInterface::IOThread::stop()
+{
+   mQuitting = true;
+
+   U8 wake = 0;
+   mThreadWakeSocket.sendto(mThreadWakeAddress, &wake, 1);
+
+   mFinished.wait();
+}
+
+bool NetInterface::IOThread::send(const Address &address, const U8 *data, S32 size)
+{
+   S32 count;
+   QueuedPacket *packet = mOutgoing.beginWrite(&count);
+
+   if(!packet)
+      return false;
+
+   packet->address = address;
+   packet->size = size;
+   memcpy(packet->data, data, size);
+
+   mOutgoing.endWrite(1);
+
+   // We fill the queue before checking the flag, and the thread sets its flag before checking the queue
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   if(mWaitingForSends.exchange(false))
+   {
+      U8 wake = 0;
+      mThreadWakeSocket.sendto(mThreadWakeAddress, &wake, 1);
+   }
+
+   return true;
+}
+
+void NetInterface::IOThread::madeRoom()
+{
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   if(mWaitingForRoom.exchange(false))
+   {
+      U8 wake = 0;
+      mThreadWakeSocket.sendto(mThreadWakeAddress, &wake, 1);
+   }
+}
+
+bool NetInterface::IOThread::canWake()
+{
+   return mWakeSocket.isValid() && mThreadWakeSocket.isValid();
+}
+
+Socket *NetInterface::IOThread::beginWait()
+{
+   mGameThreadWaiting = true;
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+
+   return &mWakeSocket;
+}
+
+void NetInterface::IOThread::endWait()
+{
+   mGameThreadWaiting = false;
+
+   // A wake-up can land after we've stopped waiting
+   drainWakeSocket(&mWakeSocket);
+}
+
+bool NetInterface::startIOThread()
+{
+#ifdef TNL_NO_THREADS
+   return false;
+#else
+   if(mIOThread)
+      return true;
+
+   if(Journal::getCurrentMode() != Journal::Inactive)
+      return false;
+
+   mIOThread = new IOThread(&mSocket);    // Deleted in stopIOThread()
+
+   if(!mIOThread->canWake() || !mIOThread->start())
+   {
+      delete mIOThread;
+      mIOThread = NULL;
+      return false;
+   }
+
+   return true;
+#endif
+}
+
+void NetInterface::stopIOThread()
+{
+   if(!mIOThread)
+      return;
+
+   // Anything read but not yet handled is dropped, just as if it had never arrived
+   mIOThread->stop();
+   delete mIOThread;
+   mIOThread = NULL;
+}
+
+bool NetInterface::hasIOThread() const
+{
+   return mIOThread != NULL;
+}
+
+bool NetInterface::waitForPackets(NetInterface *const *interfaces, S32 count, U32 timeoutMillis)
+{
+   Vector<Socket *> sockets(count);
+   Vector<IOThread *> ioThreads(count);
+
+   for(S32 i = 0; i < count; i++)
+      if(interfaces[i]->mIOThread)
+      {
+         ioThreads.push_back(interfaces[i]->mIOThread);
+         sockets.push_back(interfaces[i]->mIOThread->beginWait());
+      }
+      else
+         sockets.push_back(&interfaces[i]->mSocket);
+
+   // Packets the I/O threads read before we started waiting didn't wake anyone
+   bool ready = false;
+   for(S32 i = 0; i < ioThreads.size() && !ready; i++)
+      ready = !ioThreads[i]->mIncoming.isEmpty();
+
+   if(!ready)
+      ready = Socket::waitForReadable(sockets.address(), sockets.size(), timeoutMillis);
+
+   for(S32 i = 0; i < ioThreads.size(); i++)
+      ioThreads[i]->endWait();
+
+   return ready;
+}
+
+//-----------------------------------------------------------------------------
+
 Address NetInterface::getFirstBoundInterfaceAddress()
 {
    Address theAddress = mSocket.getBoundAddress();
@@ -104,16 +459,80 @@ void NetInterface::setPrivateKey(AsymmetricKey *theKey)
 
 NetError NetInterface::sendto(const Address &address, BitStream *stream)
 {
+   if(mQueueingSends)
+   {
+      queuePacket(address, stream->getBuffer(), stream->getBytePosition());
+      return NoError;
+   }
+
+   if(mIOThread)
+   {
+      if(mIOThread->send(address, stream->getBuffer(), stream->getBytePosition()))
+         return NoError;
+
+      logprintf(LogConsumer::LogNetInterface, "I/O thread's queue is full; dropping packet to %s", address.toString());
+      return WouldBlock;
+   }
+
    return mSocket.sendto(address, stream->getBuffer(), stream->getBytePosition());
 }
 
+void NetInterface::queuePacket(const Address &address, const U8 *data, U32 size)
+{
+   TNLAssert(size <= MaxPacketDataSize, "Packet too big to send!");
+
+   PacketBuffer *buffer = mPacketBuffers.alloc();
+   memcpy(buffer->data, data, size);
+
+   queuePacketBuffer(address, buffer, size);
+}
+
+void NetInterface::queuePacketBuffer(const Address &address, PacketBuffer *buffer, U32 size)
+{
+   S32 index = mSendQueue.size();
+
+   mSendQueue.resize(index + 1);
+   mSendQueue[index].address = address;
+   mSendQueue[index].buffer = buffer->data;
+   mSendQueue[index].size = size;
+}
+
+void NetInterface::flushSendQueue()
+{
+   if(mIOThread)
+   {
+      for(S32 i = 0; i < mSendQueue.size(); i++)
+         if(!mIOThread->send(mSendQueue[i].address, mSendQueue[i].buffer, mSendQueue[i].size))
+            logprintf(LogConsumer::LogNetInterface, "I/O thread's queue is full; dropping packet to %s",
+                      mSendQueue[i].address.toString());
+   }
+   else
+   {
+      // A packet the socket won't take doesn't stop the others, just as if each had been sent on its own
+      S32 sent = 0;
+      while(sent < mSendQueue.size())
+      {
+         S32 sentCount;
+         NetError error = mSocket.sendtoBatch(mSendQueue.address() + sent, mSendQueue.size() - sent, &sentCount);
+
+         sent += sentCount;
+         if(error != NoError)
+            sent++;
+      }
+   }
+
+   for(S32 i = 0; i < mSendQueue.size(); i++)
+      mPacketBuffers.free((PacketBuffer *) mSendQueue[i].buffer);
+
+   // Vector keeps its memory when shrunk, so the next round doesn't allocate
+   mSendQueue.clear();
+}
+
 void NetInterface::sendtoDelayed(const Address *address, NetConnection *receiveTo, BitStream *stream, U32 millisecondDelay)
 {
    U32 dataSize = stream->getBytePosition();
 
-   // allocate the send packet, with the data size added on
-   DelaySendPacket *thePacket = (DelaySendPacket *) malloc(sizeof(DelaySendPacket) + dataSize);
-   new(thePacket) DelaySendPacket(); // Initalizes SafePtr
+   DelaySendPacket *thePacket = mDelaySendPackets.alloc();    // Constructs SafePtr
 
    thePacket->isReceive = (address == NULL);
    if(thePacket->isReceive)
@@ -123,14 +542,92 @@ void NetInterface::sendtoDelayed(const Address *address, NetConnection *receiveT
    
    thePacket->sendTime = getCurrentTime() + millisecondDelay;
    thePacket->packetSize = dataSize;
-   memcpy(thePacket->packetData, stream->getBuffer(), dataSize);
+   thePacket->packetData = mPacketBuffers.alloc();
+   memcpy(thePacket->packetData->data, stream->getBuffer(), dataSize);
 
-   // insert it into the DelaySendPacket list, sorted by time
-   DelaySendPacket **list;
-   for(list = &mSendPacketList; *list && ((*list)->sendTime <= thePacket->sendTime); list = &((*list)->nextPacket))
-      ;
-   thePacket->nextPacket = *list;
-   *list = thePacket;
+   addDelayedPacket(thePacket);
+}
+
+void NetInterface::addDelayedPacket(DelaySendPacket *packet)
+{
+   // Anything already due goes in the next slot to be emptied
+   U32 slotTime = S32(packet->sendTime - mDelayWheelTime) < 0 ? mDelayWheelTime : packet->sendTime;
+   U32 slot = slotTime & (DelayWheelSlots - 1);
+
+   packet->nextPacket = NULL;
+   if(mDelayWheelTail[slot])
+      mDelayWheelTail[slot]->nextPacket = packet;
+   else
+      mDelayWheelHead[slot] = packet;
+   mDelayWheelTail[slot] = packet;
+
+   mDelayedPacketCount++;
+}
+
+// Packets are due once the current time has passed their send time.  Each slot is only looked at once, even
+// after a long wait, so then packets in different slots may come out a little out of order.
+void NetInterface::processDelayedPackets()
+{
+   U32 currentTime = getCurrentTime();
+   S32 elapsed = S32(currentTime - mDelayWheelTime);
+
+   if(mDelayedPacketCount == 0 || elapsed <= 0)
+   {
+      if(elapsed > 0)
+         mDelayWheelTime = currentTime;
+      return;
+   }
+
+   S32 slotCount = getMin(elapsed, S32(DelayWheelSlots));
+
+   for(S32 i = 0; i < slotCount; i++)
+   {
+      U32 slot = (mDelayWheelTime + i) & (DelayWheelSlots - 1);
+
+      // Take the whole slot; anything due on a later turn goes back in
+      DelaySendPacket *packet = mDelayWheelHead[slot];
+      mDelayWheelHead[slot] = mDelayWheelTail[slot] = NULL;
+
+      while(packet)
+      {
+         DelaySendPacket *next = packet->nextPacket;
+
+         if(S32(packet->sendTime - currentTime) >= 0)
+         {
+            packet->nextPacket = NULL;
+            if(mDelayWheelTail[slot])
+               mDelayWheelTail[slot]->nextPacket = packet;
+            else
+               mDelayWheelHead[slot] = packet;
+            mDelayWheelTail[slot] = packet;
+
+            packet = next;
+            continue;
+         }
+
+         mDelayedPacketCount--;
+
+         if(packet->isReceive)
+         {
+            if(packet->receiveTo.isValid())
+            {
+               BitStream b(packet->packetData->data, packet->packetSize);
+               b.setMaxSizes(packet->packetSize, 0);
+               b.reset();
+               RefPtr<NetConnection> conn = packet->receiveTo.getPointer(); // if this packet causes a disconnection, keep the conn until this function exits
+               conn->readRawPacket(&b, getCurrentTime());
+            }
+            mPacketBuffers.free(packet->packetData);
+         }
+         else
+            queuePacketBuffer(packet->remoteAddress, packet->packetData, packet->packetSize);    // Freed once it's sent
+
+         mDelaySendPackets.free(packet);     // properly free stuff like SafePtr
+         packet = next;
+      }
+   }
+
+   mDelayWheelTime = currentTime;
 }
 
 //-----------------------------------------------------------------------------
@@ -321,39 +818,137 @@ void NetInterface::addConnection(NetConnection *conn)
 // NetInterface timeout and packet send processing
 //-----------------------------------------------------------------------------
 
+// Runs NetConnection::collectScope() for a list of connections
+class NetInterface::CollectScopeJob : public WorkerPool::Job
+{
+   const Vector<NetConnection *> &mConnections;
+public:
+   CollectScopeJob(const Vector<NetConnection *> &connections) : mConnections(connections) { }
+   void runItem(S32 index) { mConnections[index]->collectScope(); }
+};
+
+// Runs NetConnection::computeUpdatePriorities() for a list of connections
+class NetInterface::ComputePrioritiesJob : public WorkerPool::Job
+{
+   const Vector<NetConnection *> &mConnections;
+public:
+   ComputePrioritiesJob(const Vector<NetConnection *> &connections) : mConnections(connections) { }
+   void runItem(S32 index) { mConnections[index]->computeUpdatePriorities(); }
+};
+
+// Same result as calling checkPacketSend() on each connection in turn, but with the scoping and prioritizing for
+// every connection done up front, in parallel.  Anything that touches shared state, including writing the packets,
+// still happens here on the main thread, in connection order, so what gets sent doesn't depend on thread timing.
+void NetInterface::sendPacketsInParallel()
+{
+   U32 curTime = getCurrentTime();
+   S64 start = Platform::getHighPrecisionTimerValue();
+
+   mPacketSenders.clear();
+   for(S32 i = 0; i < mConnectionList.size(); i++)
+      if(mConnectionList[i]->isPacketSendDue(curTime))
+         mPacketSenders.push_back(mConnectionList[i]);
+
+   CollectScopeJob collectScopeJob(mPacketSenders);
+   mWorkerPool->run(&collectScopeJob, mPacketSenders.size());
+
+   // Apply the scope results, and weed out connections that turn out to have nothing to send
+   S32 senderCount = 0;
+   for(S32 i = 0; i < mPacketSenders.size(); i++)
+      if(mPacketSenders[i]->beginPacketSend(false, curTime))
+      {
+         mPacketSenders[i]->prepareUpdatePriorities();
+         mPacketSenders[senderCount] = mPacketSenders[i];
+         senderCount++;
+      }
+
+   mPacketSenders.resize(senderCount);
+
+   S64 scopeDone = Platform::getHighPrecisionTimerValue();
+   addPacketPhaseTime(PacketPhaseScope, Platform::getHighPrecisionMilliseconds(scopeDone - start));
+
+   ComputePrioritiesJob computePrioritiesJob(mPacketSenders);
+   mWorkerPool->run(&computePrioritiesJob, mPacketSenders.size());
+
+   S64 priorityDone = Platform::getHighPrecisionTimerValue();
+   addPacketPhaseTime(PacketPhasePriority, Platform::getHighPrecisionMilliseconds(priorityDone - scopeDone));
+
+   for(S32 i = 0; i < mPacketSenders.size(); i++)
+      mPacketSenders[i]->finishPacketSend(curTime);
+
+   addPacketPhaseTime(PacketPhaseWrite, Platform::getHighPrecisionMilliseconds(Platform::getHighPrecisionTimerValue() - priorityDone));
+
+   mPacketSenders.clear();
+}
+
+void NetInterface::setWorkerPool(WorkerPool *pool)
+{
+   mWorkerPool = pool;
+}
+
+WorkerPool *NetInterface::getWorkerPool() const
+{
+   return mWorkerPool;
+}
+
+void NetInterface::addPacketPhaseTime(PacketPhase phase, F64 milliseconds)
+{
+   mPacketPhaseTimes[phase] += milliseconds;
+}
+
+F64 NetInterface::getPacketPhaseTime(PacketPhase phase) const
+{
+   return mPacketPhaseTimes[phase];
+}
+
+void NetInterface::useManualClock(U32 startTime)
+{
+   TNLAssert(mDelayedPacketCount == 0, "Delayed packets would be held up, or let out early!");
+
+   mManualClock = true;
+   mCurrentTime = startTime;
+   mPacketArrivalTime = startTime;
+   mDelayWheelTime = startTime;
+}
+
+void NetInterface::resetPacketPhaseTimes()
+{
+   for(S32 i = 0; i < PacketPhaseCount; i++)
+      mPacketPhaseTimes[i] = 0;
+}
+
 void NetInterface::processConnections()
 {
-   mCurrentTime = Platform::getRealMilliseconds();
+   if(!mManualClock)
+      mCurrentTime = Platform::getRealMilliseconds();
    mPuzzleManager.tick(mCurrentTime);
 
+   mQueueingSends = true;
+
    // first see if there are any delayed packets that need to be sent...
-   while(mSendPacketList && S32(mSendPacketList->sendTime - getCurrentTime()) < 0)
+   processDelayedPackets();
+
+   NetObject::collapseDirtyList(); // collapse all the mask bits...
+
+   if(mWorkerPool)
+      sendPacketsInParallel();
+   else
    {
-      DelaySendPacket *next = mSendPacketList->nextPacket;
-      if(mSendPacketList->isReceive)
-      {
-         if(mSendPacketList->receiveTo.isValid())
-         {
-            BitStream b(mSendPacketList->packetData, mSendPacketList->packetSize);
-            b.setMaxSizes(mSendPacketList->packetSize, 0);
-            b.reset();
-            RefPtr<NetConnection> conn = mSendPacketList->receiveTo.getPointer(); // if this packet causes a disconnection, keep the conn until this function exits
-            conn->readRawPacket(&b);
-         }
-      }
-      else
-      {
-         mSocket.sendto(mSendPacketList->remoteAddress,
-            mSendPacketList->packetData, mSendPacketList->packetSize);
-      }
-      mSendPacketList->~DelaySendPacket(); // properly free stuff like SafePtr
-      free(mSendPacketList);
-      mSendPacketList = next;
+      // Connections add their own scope and priority times as they go; whatever is left over was spent writing
+      F64 otherPhases = mPacketPhaseTimes[PacketPhaseScope] + mPacketPhaseTimes[PacketPhasePriority];
+      S64 start = Platform::getHighPrecisionTimerValue();
+
+      for(S32 i = 0; i < mConnectionList.size(); i++)
+         mConnectionList[i]->checkPacketSend(false, getCurrentTime());
+
+      F64 elapsed = Platform::getHighPrecisionMilliseconds(Platform::getHighPrecisionTimerValue() - start);
+      otherPhases = mPacketPhaseTimes[PacketPhaseScope] + mPacketPhaseTimes[PacketPhasePriority] - otherPhases;
+
+      addPacketPhaseTime(PacketPhaseWrite, elapsed - otherPhases);
    }
 
-   NetObject::collapseDirtyList(); // collapse all the mask bits...
-   for(S32 i = 0; i < mConnectionList.size(); i++)
-      mConnectionList[i]->checkPacketSend(false, getCurrentTime());
+   flushSendQueue();
+   mQueueingSends = false;
 
    if(U32(getCurrentTime() - mLastTimeoutCheckTime) > TimeoutCheckInterval)
    {
@@ -446,15 +1041,49 @@ void NetInterface::processConnections()
 
 void NetInterface::checkIncomingPackets()
 {
-   PacketStream stream;
-   NetError error;
-   Address sourceAddress;
+   if(!mManualClock)
+      mCurrentTime = Platform::getRealMilliseconds();
 
-   mCurrentTime = Platform::getRealMilliseconds();
+   if(mIOThread)
+   {
+      S32 count;
+      QueuedPacket *packets;
 
-   // read out all the available packets:
-   while((error = stream.recvfrom(mSocket, &sourceAddress)) == NoError)
-      processPacket(sourceAddress, &stream);
+      while((packets = mIOThread->mIncoming.beginRead(&count)) != NULL)
+      {
+         // Packets can come in after we started, and the time shouldn't run backwards for them
+         if(!mManualClock)
+            mCurrentTime = Platform::getRealMilliseconds();
+
+         for(S32 i = 0; i < count; i++)
+         {
+            mPacketArrivalTime = packets[i].arrivalTime;
+
+            BitStream stream(packets[i].data, packets[i].size, 0);
+            processPacket(packets[i].address, &stream);
+         }
+
+         mIOThread->mIncoming.endRead(count);
+         mIOThread->madeRoom();
+      }
+
+      return;
+   }
+
+   mPacketArrivalTime = mCurrentTime;
+
+   // read out all the available packets, a batch at a time; a short batch means the socket is empty
+   S32 receivedCount = ReceiveBatchSize;
+
+   while(receivedCount == ReceiveBatchSize &&
+         mSocket.recvfromBatch(mReceivedPackets.address(), ReceiveBatchSize, MaxPacketDataSize, &receivedCount) == NoError)
+   {
+      for(S32 i = 0; i < receivedCount; i++)
+      {
+         BitStream stream(mReceivedPackets[i].buffer, mReceivedPackets[i].size, 0);
+         processPacket(mReceivedPackets[i].address, &stream);
+      }
+   }
 }
 
 void NetInterface::processPacket(const Address &sourceAddress, BitStream *pStream)
@@ -477,7 +1106,7 @@ void NetInterface::processPacket(const Address &sourceAddress, BitStream *pStrea
             sendtoDelayed(NULL, conn, pStream, conn->mSimulatedReceiveLatency);
          }
          else
-            conn->readRawPacket(pStream);
+            conn->readRawPacket(pStream, mPacketArrivalTime);
       }
    }
    else
@@ -554,7 +1183,7 @@ void NetInterface::sendConnectChallengeRequest(NetConnection *conn)
 
    conn->mConnectSendCount++;
    conn->mConnectLastSendTime = getCurrentTime();
-   out.sendto(mSocket, conn->getNetAddress());
+   sendto(conn->getNetAddress(), &out);
 }
 
 void NetInterface::handleConnectChallengeRequest(const Address &addr, BitStream *stream)
@@ -596,7 +1225,7 @@ void NetInterface::sendConnectChallengeResponse(const Address &addr, Nonce &clie
    }
    logprintf(LogConsumer::LogNetInterface, "Sending Challenge Response: %8x", identityToken);
 
-   out.sendto(mSocket, addr);
+   sendto(addr, &out);
 }
 
 //-----------------------------------------------------------------------------
@@ -732,7 +1361,7 @@ void NetInterface::sendConnectRequest(NetConnection *conn)
    conn->mConnectSendCount++;
    conn->mConnectLastSendTime = getCurrentTime();
 
-   out.sendto(mSocket, conn->getNetAddress());
+   sendto(conn->getNetAddress(), &out);
 }
 
 void NetInterface::handleConnectRequest(const Address &address, BitStream *stream)
@@ -867,7 +1496,7 @@ void NetInterface::sendConnectAccept(NetConnection *conn)
       out.hashAndEncrypt(NetConnection::MessageSignatureBytes, encryptPos, &theCipher);
    }
 
-   out.sendto(mSocket, conn->getNetAddress());
+   sendto(conn->getNetAddress(), &out);
 }
 
 void NetInterface::handleConnectAccept(const Address &address, BitStream *stream)
@@ -936,7 +1565,7 @@ void NetInterface::sendConnectReject(ConnectionParameters *conn, const Address &
    conn->mServerNonce.write(&out);
    out.writeEnum(reason, NetConnection::TerminationReasons);
    out.writeString("");
-   out.sendto(mSocket, theAddress);
+   sendto(theAddress, &out);
 }
 
 void NetInterface::handleConnectReject(const Address &address, BitStream *stream)
@@ -1024,7 +1653,7 @@ void NetInterface::sendPunchPackets(NetConnection *conn)
 
    for(S32 i = 0; i < theParams.mPossibleAddresses.size(); i++)
    {
-      out.sendto(mSocket, theParams.mPossibleAddresses[i]);
+      sendto(theParams.mPossibleAddresses[i], &out);
 
       logprintf(LogConsumer::LogNetInterface, "Sending punch packet (%s, %s) to %s",
          ByteBuffer(theParams.mNonce.data, Nonce::NonceSize).encodeBase64()->getBuffer(),
@@ -1190,7 +1819,7 @@ void NetInterface::sendArrangedConnectRequest(NetConnection *conn)
    conn->mConnectSendCount++;
    conn->mConnectLastSendTime = getCurrentTime();
 
-   out.sendto(mSocket, conn->getNetAddress());
+   sendto(conn->getNetAddress(), &out);
 }
 
 // server
@@ -1342,7 +1971,7 @@ void NetInterface::disconnect(NetConnection *conn, NetConnection::TerminationRea
             SymmetricCipher theCipher(theParams.mSharedSecret);
             out.hashAndEncrypt(NetConnection::MessageSignatureBytes, encryptPos, &theCipher);
          }
-         out.sendto(mSocket, conn->getNetAddress());
+         sendto(conn->getNetAddress(), &out);
       }
       removeConnection(conn);
    }
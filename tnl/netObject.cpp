@@ -34,6 +34,7 @@ namespace TNL {
 GhostConnection *NetObject::mRPCSourceConnection = NULL;
 GhostConnection *NetObject::mRPCDestConnection = NULL;
 bool NetObject::mIsInitialUpdate = false;
+U32 NetObject::mNextPriorityRevision = 0;
 
 NetObject::NetObject()
 {
@@ -43,6 +44,7 @@ NetObject::NetObject()
    mPrevDirtyList = NULL;
    mNextDirtyList = NULL;
    mDirtyMaskBits = 0;
+   invalidateUpdatePriority();
 }
 
 // Copy constructor
@@ -53,6 +55,7 @@ NetObject::NetObject(const NetObject &t)
    mPrevDirtyList = NULL;
    mNextDirtyList = NULL;
    mDirtyMaskBits = 0;
+   invalidateUpdatePriority();
 }
 
 
@@ -90,6 +93,13 @@ void NetObject::setMaskBits(U32 orMask)
    }
    mDirtyMaskBits |= orMask;
    TNLAssert(mDirtyMaskBits == 0 || (mPrevDirtyList != NULL || mNextDirtyList != NULL || mDirtyList == this), "Invalid dirty list state.");
+
+   invalidateUpdatePriority();
+}
+
+void NetObject::invalidateUpdatePriority()
+{
+   mPriorityRevision = ++mNextPriorityRevision;
 }
 
 void NetObject::clearMaskBits(U32 orMask)
@@ -184,6 +194,16 @@ F32 NetObject::getUpdatePriority(GhostConnection*, U32, S32 updateSkips)
    //return 0;
 }
 
+F32 NetObject::getUpdatePriorityPerSkip()
+{
+   return -1;
+}
+
+bool NetObject::hasBatchedUpdatePriority()
+{
+   return false;
+}
+
 U32 NetObject::packUpdate(GhostConnection*, U32, BitStream*)
 {
    return 0;
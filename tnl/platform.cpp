@@ -42,6 +42,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <time.h>
 
 #endif
 
@@ -420,13 +421,17 @@ class UnixTimer
       UnixTimer()
       {
       }
+      // Microseconds; milliseconds are too coarse for timing individual phases of a server tick.  The monotonic
+      // clock keeps ticking steadily when NTP or the user sets the wall clock.
       S64 getCurrentTime()
       {
-         return x86UNIXGetTickCount();
+         struct timespec t;
+         ::clock_gettime(CLOCK_MONOTONIC, &t);
+         return S64(t.tv_sec) * 1000000 + t.tv_nsec / 1000;
       }
       F64 convertToMS(S64 delta)
       {
-         return F64(delta);
+         return F64(delta) / 1000.0;
       }
 };
 
@@ -29,6 +29,7 @@
 
 #ifndef TNL_OS_WIN32
 #include "stdint.h"
+#include <unistd.h>
 #endif
 
 namespace TNL
@@ -335,4 +336,146 @@ void ThreadQueue::dispatchResponseCalls()
    unlock();
 }
 
+//-----------------------------------------------------------------------------
+
+WorkerPool::Job::~Job()
+{
+}
+
+WorkerPool::WorkerThread::WorkerThread(WorkerPool *pool)
+{
+   mPool = pool;
+}
+
+U32 WorkerPool::WorkerThread::run()
+{
+   mPool->workerLoop();
+   return 0;
+}
+
+WorkerPool::WorkerPool(U32 threadCount)
+{
+   mJob = NULL;
+   mItemCount = 0;
+   mNextItem = 0;
+   mQuitting = false;
+
+#ifndef TNL_NO_THREADS
+   for(U32 i = 0; i < threadCount; i++)
+   {
+      WorkerThread *thread = new WorkerThread(this);
+      mThreads.push_back(thread);
+      thread->start();
+   }
+#endif
+}
+
+WorkerPool::~WorkerPool()
+{
+   mLock.lock();
+   mQuitting = true;
+   mLock.unlock();
+
+   // Wake everyone up, and wait for them to acknowledge before we pull the rug out from under them
+   mWorkAvailable.increment(mThreads.size());
+   for(S32 i = 0; i < mThreads.size(); i++)
+      mWorkerFinished.wait();
+
+   for(S32 i = 0; i < mThreads.size(); i++)
+      delete mThreads[i];
+}
+
+U32 WorkerPool::getThreadCount() const
+{
+   return mThreads.size();
+}
+
+bool WorkerPool::runNextItem()
+{
+   mLock.lock();
+
+   if(!mJob || mNextItem >= mItemCount)
+   {
+      mLock.unlock();
+      return false;
+   }
+
+   Job *job = mJob;
+   S32 index = mNextItem;
+   mNextItem++;
+
+   mLock.unlock();
+
+   job->runItem(index);
+   return true;
+}
+
+void WorkerPool::workerLoop()
+{
+   for(;;)
+   {
+      mWorkAvailable.wait();
+
+      mLock.lock();
+      bool quitting = mQuitting;
+      mLock.unlock();
+
+      if(!quitting)
+         while(runNextItem())
+            ;
+
+      mWorkerFinished.increment();
+
+      if(quitting)
+         return;
+   }
+}
+
+void WorkerPool::run(Job *job, S32 itemCount)
+{
+   if(itemCount <= 0)
+      return;
+
+   // Not worth waking anyone up for
+   if(mThreads.size() == 0 || itemCount == 1)
+   {
+      for(S32 i = 0; i < itemCount; i++)
+         job->runItem(i);
+      return;
+   }
+
+   mLock.lock();
+   mJob = job;
+   mItemCount = itemCount;
+   mNextItem = 0;
+   mLock.unlock();
+
+   mWorkAvailable.increment(mThreads.size());
+
+   while(runNextItem())
+      ;
+
+   // Each worker signals once it has finished its last item, so once we've heard from all of them, the job is done
+   for(S32 i = 0; i < mThreads.size(); i++)
+      mWorkerFinished.wait();
+
+   mLock.lock();
+   mJob = NULL;
+   mLock.unlock();
+}
+
+U32 WorkerPool::getProcessorCount()
+{
+#if defined(TNL_OS_WIN32)
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   long count = sysconf(_SC_NPROCESSORS_ONLN);
+   return count > 0 ? U32(count) : 1;
+#else
+   return 1;
+#endif
+}
+
 };
@@ -43,7 +43,7 @@ namespace TNL {
 ///
 /// It will assert if you try to get more than ChunkSize bytes at a time,
 /// and it deals with the logic of allocating new blocks and giving out
-/// word-aligned chunks.
+/// word-aligned chunks (or chunks aligned however the constructor asks).
 ///
 /// Note that new/free/realloc WILL NOT WORK on memory gotten from the
 /// DataChunker. This also only grows (you can call freeBlocks to deallocate
@@ -60,20 +60,23 @@ class DataChunker
    struct DataBlock
    {
       DataBlock *next;        ///< linked list pointer to the next DataBlock for this chunker
-      U8 *data;               ///< allocated pointer for the base of this page
+      U8 *allocated;          ///< allocated pointer for this page
+      U8 *data;               ///< base of this page, aligned
       S32 curIndex;           ///< current allocation point within this DataBlock
-      DataBlock(S32 size);
+      DataBlock(S32 size, S32 alignment);
       ~DataBlock();
    };
    DataBlock *curBlock;       ///< current page we're allocating data from.  If the
                               ///< data size request is greater than the memory space currently
                               ///< available in the current page, a new page will be allocated.
    S32 chunkSize;             ///< The size allocated for each page in the DataChunker
+   S32 alignment;             ///< Every allocation starts on a multiple of this; a power of 2
   public:
    void *alloc(S32 size);     ///< allocate a pointer to memory of size bytes from the DataChunker
    void freeBlocks();         ///< free all pages currently allocated in the DataChunker
 
-   DataChunker(S32 size=ChunkSize); ///< Construct a DataChunker with a page size of size bytes.
+   /// Construct a DataChunker with a page size of size bytes, handing out memory aligned to align bytes.
+   DataChunker(S32 size=ChunkSize, S32 align=4);
    ~DataChunker();
 
    /// Swaps the memory allocated in one data chunker for another.  This can be used to implement
@@ -99,7 +102,7 @@ class ClassChunker: private DataChunker
    S32 elementSize;  ///< the size of each element, or the size of a pointer, whichever is greater
    T *freeListHead;  ///< a pointer to a linked list of freed elements for reuse
 public:
-   ClassChunker(S32 size = DataChunker::ChunkSize) : DataChunker(size)
+   ClassChunker(S32 size = DataChunker::ChunkSize, S32 align = 4) : DataChunker(size, align)
    {
       numAllocated = 0;
       elementSize = getMax(U32(sizeof(T)), U32(sizeof(T *)));
@@ -125,6 +125,13 @@ protected:
    /// Override to check if there is data pending on this GhostConnection.
    bool isDataToTransmit();
 
+   /// Runs the scope query, saving the results for prepareWritePacket() rather than applying them.
+   void collectScope();
+   /// Kills off ghosts that went out of scope, getting the ghost array ready for computeUpdatePriorities().
+   void prepareUpdatePriorities();
+   /// Asks each ghost with pending updates for its priority; only touches this connection's GhostInfos.
+   void computeUpdatePriorities();
+
 //----------------------------------------------------------------
 // ghost manager functions/code:
 //----------------------------------------------------------------
@@ -151,6 +158,34 @@ protected:
    SafePtr<NetObject> mScopeObject; ///< The local NetObject that performs scoping queries to determine what
                                     ///  objects to ghost to the client.
 
+   Vector<NetObject *> mPendingScope;  ///< Objects found in scope by collectScope(), waiting for prepareWritePacket().
+   bool mCollectingScope;              ///< True while collectScope() is running; objectInScope() just records objects.
+   bool mScopeCollected;               ///< True if mPendingScope is ready to be applied.
+   bool mUpdatePrioritiesReady;        ///< True if computeUpdatePriorities() has run for the next packet.
+   U32 mMaxGhostIndex;                 ///< Highest ghost index with pending updates, found by prepareUpdatePriorities().
+
+   U32 mGhostUpdatesSent;              ///< Ghost updates written into packets
+   U32 mGhostUpdatesSkipped;           ///< Updates left waiting because higher priority ones filled the packet, summed over packets
+
+   /// Number of ghosts whose updates are put in priority order at a time; if the packet has room for more,
+   /// the next batch is sorted out of the remainder.  Much cheaper than sorting everything when lots of
+   /// ghosts need updating but only a few fit in a packet.
+   static const S32 UpdateBatchSize = 32;
+
+   S32 sortUpdateBatch(S32 count, S32 batchSize);
+
+   /// Returns the object whose state the priorities of all the other ghosts depend on, such as the
+   /// player's ship.  Cached priorities are thrown out whenever this object changes.  Defaults to the
+   /// scope object.
+   virtual NetObject *getPriorityReferenceObject();
+
+   Vector<GhostInfo *> mPriorityBatch;   ///< Ghosts waiting for computeBatchedUpdatePriorities(), reused every packet.
+
+   /// Fills in the priority of each of the ghosts, whose objects all returned true from
+   /// NetObject::hasBatchedUpdatePriority().  Subclasses that know what those objects are can compute
+   /// the priorities in bulk; the default just calls getUpdatePriority() on each one.
+   virtual void computeBatchedUpdatePriorities(GhostInfo **ghosts, S32 count);
+
    void clearGhostInfo();
    void deleteLocalGhosts();
    bool validateGhostArray();
@@ -181,6 +216,10 @@ public:
    /// Returns the sequence number of this ghosting session.
    U32 getGhostingSequence() { return mGhostingSequence; }
 
+   S32 getGhostCount() { return mGhostFreeIndex; }          ///< Returns the number of objects currently ghosted to the remote host.
+   U32 getGhostUpdatesSent() { return mGhostUpdatesSent; }
+   U32 getGhostUpdatesSkipped() { return mGhostUpdatesSkipped; }
+
    enum GhostConstants {
       ID_BIT_SIZE = 4,
       ID_BIT_OFFSET = 3,
@@ -268,6 +307,13 @@ struct GhostInfo
    U32 index;      ///< Fixed index of the object in the mGhostRefs array for the connection, and the ghostId of the object on the client.
    S32 arrayIndex; ///< Position of the object in the mGhostArray for the connection, which changes as the object is pushed to zero, non-zero and free.
 
+   bool priorityCached;       ///< True if the fields below hold a priority that can be reused.
+   F32 cachedPriority;        ///< Result of the last call to the object's getUpdatePriority().
+   U32 cachedSkipCount;       ///< updateSkipCount passed to that call.
+   U32 cachedUpdateMask;      ///< updateMask passed to that call.
+   U32 cachedRevision;        ///< Object's priority revision at the time.
+   U32 cachedReferenceRevision;  ///< Priority revision of the connection's priority reference object at the time.
+
     enum Flags
     {
       InScope = BIT(0),             ///< This GhostInfo's NetObject is currently in scope for this connection.
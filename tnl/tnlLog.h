@@ -91,6 +91,7 @@ public:
 
       LogLevelError           = BIT(22),     // Logs errors and warnings in levels
       ConsoleMsg              = BIT(23),     // Message that goes only to the console
+      NetStatsFilter          = BIT(24),     // Per-client network stats, logged by servers to a file of their own
       
       All = 0xFFFFFFFF,
       AllErrorTypes = LogFatalError | LogError | LogWarning | LogLevelError | ConfigurationError
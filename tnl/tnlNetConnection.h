@@ -47,6 +47,10 @@
 #include "tnlConnectionStringTable.h"
 #endif
 
+#ifndef _TNL_RATECONTROLLER_H_
+#include "tnlRateController.h"
+#endif
+
 namespace TNL {
 
 class NetConnection;
@@ -212,6 +216,7 @@ class NetConnection : public Object
 
 protected:
    U32 mLastPacketRecvTime; ///< Time of the receipt of the last data packet.
+   U32 mPacketArrivalTime;  ///< When the packet being read arrived; round trip times are measured to this.
    U32 mWriteMaxBitSize;
 
 public:
@@ -296,6 +301,20 @@ protected:
                                                                      ///  Information about what the instance wrote into the packet can be attached
                                                                      ///  to the notify object.
 
+   /// @name Parallel packet preparation
+   ///
+   /// When the NetInterface has a WorkerPool, it splits the work of sending packets into phases, so
+   /// the expensive parts can be done for every connection at once on the worker threads.  Hooks
+   /// marked as worker-safe may run on any thread, and must only modify this connection.
+   ///
+   /// @{
+
+   virtual void collectScope();              ///< Worker-safe.  Work out what the remote host can see, before prepareWritePacket() runs.
+   virtual void prepareUpdatePriorities();   ///< Called on the main thread once we know a packet will be written.
+   virtual void computeUpdatePriorities();   ///< Worker-safe.  Work out what to send in the packet about to be written.
+
+   /// @}
+
    virtual void packetReceived(PacketNotify *note);                  ///< Called when the packet associated with the specified notify is known to have been received by the remote host.
                                                                      ///
                                                                      ///  Packets are guaranteed to be notified in the order in which they were sent.
@@ -318,8 +337,9 @@ public:
    U32 getLastSendSequence() { return mLastSendSeq; }
 
 protected:
-   /// Reads a raw packet from a BitStream, as dispatched from NetInterface.
-   void readRawPacket(BitStream *bstream);
+   /// Reads a raw packet from a BitStream, as dispatched from NetInterface.  arrivalTime is when it came off
+   /// the wire, which may be well before the interface got around to handing it over.
+   void readRawPacket(BitStream *bstream, U32 arrivalTime);
    /// Writes a full packet of the specified type into the BitStream
    void writeRawPacket(BitStream *bstream, NetPacketType packetType);
 
@@ -380,6 +400,7 @@ public:
       // packet stream notify stuff:
       bool rateChanged;  ///< True if this packet requested a change of rate.
       U32  sendTime;     ///< Platform::getRealMilliseconds() when packet was sent.
+      U32  packetSize;   ///< Bytes sent in the packet, once it's written.
       ConnectionStringTable::PacketList stringList; ///< List of string table entries sent in this packet
 
       PacketNotify *nextPacket; ///< Pointer to the next packet sent on this connection
@@ -408,6 +429,15 @@ private:
    U32 mSimulatedReceiveLatency;
    F32 mSimulatedSendPacketLoss; ///< Function to simulate packet loss on a network
    F32 mSimulatedReceivePacketLoss;
+   U32 mSimulatedSendJitter;     ///< Up to this much more latency, different for each packet
+   U32 mSimulatedLinkBandwidth;  ///< Bytes per second the simulated link carries, or 0 for no limit
+   U32 mSimulatedLinkQueueLimit; ///< Longest a packet may wait for the simulated link before it's dropped, in ms
+   F32 mSimulatedLinkBacklog;    ///< Milliseconds of packets waiting for the simulated link, as of mSimulatedLinkTime
+   U32 mSimulatedLinkTime;
+   U32 mSimulatedRandomState;    ///< Drives simulated losses and jitter, so they can be repeated
+
+   F32 getSimulatedRandom();                                ///< Next number from mSimulatedRandomState, from 0 up to 1
+   bool simulateSendLink(U32 packetSize, U32 &delay);       ///< False if the packet is lost, else delay is set to its latency
 
    bool mUseZeroLatencyForTesting;  ///< Override packet SendPeriod for testing purposes ONLY 
 
@@ -428,12 +458,15 @@ private:
    };
 
    void computeNegotiatedRate(); ///< Called internally when the local or remote rate changes.
+   void applyRateController();   ///< Takes up the rate controller's latest send period and packet size.
+   U32 getPacketSendDelay();     ///< Milliseconds to wait after the last packet before sending another.
    NetRate mLocalRate;           ///< Current communications rate negotiated for this connection.
    NetRate mRemoteRate;          ///< Maximum allowable communications rate for this connection.
 
    bool mLocalRateChanged;       ///< Set to true when the local connection's rate has changed.
    U32 mCurrentPacketSendSize;   ///< Current size of each packet sent to the remote host.
    U32 mCurrentPacketSendPeriod; ///< Millisecond delay between sent packets.
+   RateController *mRateController; ///< Adjusts the send period and packet size as the link allows; NULL to keep the negotiated rate.
 
    Address mNetAddress;       ///< The network address of the host this instance is connected to.
 
@@ -507,6 +540,23 @@ public:
       mSimulatedSendLatency = (latency + 1) / 2;
    }
 
+   /// Conditions for this connection's outgoing packets to go through, for seeing how it copes with bad links.
+   /// Given the same seed, and the same timing, the same packets are lost and delayed the same way every time.
+   struct SimulatedLink
+   {
+      U32 latency;      ///< Milliseconds every packet takes to get there
+      U32 jitter;       ///< Up to this many more milliseconds, picked at random for each packet
+      F32 packetLoss;   ///< Chance of any one packet being lost
+      U32 bandwidth;    ///< Bytes per second the link carries, or 0 for no limit; packets wait their turn behind each other
+      U32 queueLimit;   ///< Packets that would wait longer than this many ms for their turn are dropped; 0 for no limit
+      U32 seed;         ///< Starting point for the random losses and jitter
+
+      SimulatedLink();
+   };
+
+   /// Replaces the simulated send loss and latency; receive loss and latency are left alone.
+   void setSimulatedLink(const SimulatedLink &link);
+
    U32 getSimulatedSendLatency()       { return mSimulatedSendLatency;       }
    U32 getSimulatedReceiveLatency()    { return mSimulatedReceiveLatency;    }
    F32 getSimulatedSendPacketLoss()    { return mSimulatedSendPacketLoss;    }
@@ -531,6 +581,11 @@ public:
    /// Returns true if the remote side if this connection is on a remote host.
    bool isNetworkConnection() { return mRemoteConnection.isNull(); }
 
+   /// Hands pacing over to controller, which this connection will delete; NULL sends at the negotiated rate.
+   /// Adaptive connections ignore it.
+   void setRateController(RateController *controller);
+   RateController *getRateController() { return mRateController; }
+
    /// Returns the running average packet round trip time.
    F32 getRoundTripTime()
       { return mRoundTripTime; }
@@ -559,6 +614,15 @@ public:
    /// If force is true and there is space in the window, it will always send a packet.
    void checkPacketSend(bool force, U32 currentTime);
 
+   /// Returns true if checkPacketSend(false, currentTime) would try to send a packet.  Doesn't change anything.
+   bool isPacketSendDue(U32 currentTime);
+
+   /// First half of checkPacketSend() -- returns true if a packet should be written with finishPacketSend().
+   bool beginPacketSend(bool force, U32 currentTime);
+
+   /// Second half of checkPacketSend() -- writes and sends the packet.
+   void finishPacketSend(U32 currentTime);
+
    /// Connection state flags for a NetConnection instance.  If this list is modifed, please check if netInterface.cpp needs updates as well
    enum NetConnectionState {
       NotConnected=0,            ///< Initial state of a NetConnection instance - not connected
@@ -658,6 +722,20 @@ public:
    U32 mPacketSendBytesTotal;
    U32 mPacketRecvCount;
    U32 mPacketSendCount;
+
+   /// What the bits of each packet we send are spent on; each layer of the connection counts what it writes.
+   enum TrafficCategory {
+      TrafficOverhead,     ///< Packet headers, acks and rate info
+      TrafficMoves,        ///< Moves and control object state
+      TrafficEvents,       ///< Events, including RPCs
+      TrafficGhosts,       ///< Ghost updates
+      TrafficCategoryCount
+   };
+
+   U64 mTrafficBitsSent[TrafficCategoryCount];
+   U32 mEventsRetransmitted;     ///< Guaranteed events that had to be sent again because their packet was lost
+
+   void addTrafficBits(TrafficCategory category, U32 bits) { mTrafficBitsSent[category] += bits; }
 };
 
 static const U32 MinimumPaddingBits = 128;       ///< Padding space that is required at the end of each packet for bit flag writes and such.
@@ -37,6 +37,10 @@
 
 #include "tnlClientPuzzle.h"
 
+#ifndef _TNL_DATACHUNKER_H_
+#include "tnlDataChunker.h"
+#endif
+
 #ifndef _TNL_NETOBJECT_H_
 #include "tnlNetObject.h"
 #endif
@@ -50,6 +54,7 @@ namespace TNL {
 class AsymmetricKey;
 class Certificate;
 struct ConnectionParameters;
+class WorkerPool;
 
 /// NetInterface class.
 ///
@@ -168,6 +173,14 @@ public:
       FirstValidInfoPacketId        = 8, /// The first valid ID for a NetInterface subclass's info packets.
    };
 
+   /// Stages of writing packets, for profiling
+   enum PacketPhase {
+      PacketPhaseScope,       ///< Working out which objects each client can see
+      PacketPhasePriority,    ///< Deciding which ghost updates are most important
+      PacketPhaseWrite,       ///< Serializing and sending packets
+      PacketPhaseCount
+   };
+
 protected:
    Vector<NetConnection *> mConnectionList;        /// List of all the connections that are in a connected state on this NetInterface.
    Vector<NetConnection *> mConnectionHashTable;   /// A resizable hash table for all connected connections.  This is a flat hash table (no buckets).
@@ -191,25 +204,84 @@ protected:
    /// @}
 
    U32 mCurrentTime;            /// Current time tracked by this NetInterface.
+   bool mManualClock;           /// Set if mCurrentTime only moves when advanceTime() is called.
    bool mRequiresKeyExchange;   /// True if all connections outgoing and incoming require key exchange.
    U32  mLastTimeoutCheckTime;  /// Last time all the active connections were checked for timeouts.
    U8  mRandomHashData[12];     /// Data that gets hashed with connect challenge requests to prevent connection spoofing.
    bool mAllowConnections;      /// Set if this NetInterface allows connections from remote instances.
 
+   WorkerPool *mWorkerPool;             /// If set, used to prepare packets for all connections at once.  Not owned by us.
+   Vector<NetConnection *> mPacketSenders;   /// Scratch list of connections sending this round, used by sendPacketsInParallel().
+
+   enum {
+      ReceiveBatchSize = 32,       /// Packets read from the socket at a time by checkIncomingPackets().
+      CacheLineSize = 64,
+      PacketBuffersPerChunk = 32,  /// PacketBuffers the pool allocates at a time.
+   };
+
+   /// Room for one packet, from mPacketBuffers.  Sized and aligned to whole cache lines, so a packet never shares
+   /// a line with its neighbours.
+   struct PacketBuffer
+   {
+      U8 data[(MaxPacketDataSize + CacheLineSize - 1) & ~(CacheLineSize - 1)];
+   };
+
+   ClassChunker<PacketBuffer> mPacketBuffers;   /// Pool for delayed, queued and received packets; main thread only.
+
+   bool mQueueingSends;             /// Set while processConnections() writes packets; sendto() then holds them for flushSendQueue().
+   Vector<Datagram> mSendQueue;     /// Packets held; each buffer is a PacketBuffer, given back once it's sent.
+   Vector<Datagram> mReceivedPackets;  /// ReceiveBatchSize PacketBuffers for checkIncomingPackets().
+
+   /// Holds a packet to be sent by flushSendQueue().
+   void queuePacket(const Address &address, const U8 *data, U32 size);
+
+   /// The same, but for a packet already in a PacketBuffer, which is handed over rather than copied.
+   void queuePacketBuffer(const Address &address, PacketBuffer *buffer, U32 size);
+
+   /// Hands every packet queued since the last flush to the socket at once.
+   void flushSendQueue();
+
+   enum {
+      IOQueueSize = 256,           /// Packets that can wait each way between the game thread and the I/O thread.
+      IOThreadWaitTimeout = 1000,  /// Longest, in ms, the I/O thread sleeps without being woken; only a backstop.
+   };
+
+   class IOThread;
+   friend class IOThread;
+   IOThread *mIOThread;             /// Owns the socket when set; see startIOThread().
+   U32 mPacketArrivalTime;          /// When the packet being handled by processPacket() came in.
+
    /// Structure used to track packets that are delayed in sending for simulating a high-latency connection.
    ///
-   /// The DelaySendPacket is allocated as sizeof(DelaySendPacket) + packetSize;
+   /// Both the DelaySendPacket and its data come from pools, so simulating lag doesn't cost an allocation per packet.
    struct DelaySendPacket
    {
-      DelaySendPacket *nextPacket; /// The next packet in the list of delayed packets.
+      DelaySendPacket *nextPacket; /// The next packet in the same slot of the delay wheel.
       Address remoteAddress;       /// The address to send this packet to.
       U32 sendTime;                /// Time when we should send the packet.
       U32 packetSize;              /// Size, in bytes, of the packet data.
       SafePtr<NetConnection> receiveTo; // Used if delayed receiving
       bool isReceive;
-      U8 packetData[1];            /// Packet data.
+      PacketBuffer *packetData;    /// Packet data.
+   };
+
+   enum {
+      DelayWheelSlots = 1024,      /// Milliseconds covered by one turn of the delay wheel; a power of 2.
    };
-   DelaySendPacket *mSendPacketList; /// List of delayed packets pending to send.
+
+   /// Delayed packets, in a timing wheel: each slot holds the packets due in one millisecond, in the order they were
+   /// delayed, along with any due a whole number of turns later.  Slots before mDelayWheelTime have been emptied.
+   DelaySendPacket *mDelayWheelHead[DelayWheelSlots];
+   DelaySendPacket *mDelayWheelTail[DelayWheelSlots];
+   U32 mDelayWheelTime;
+   S32 mDelayedPacketCount;
+   ClassChunker<DelaySendPacket> mDelaySendPackets;
+
+   /// Adds a packet to the end of its slot in the delay wheel.
+   void addDelayedPacket(DelaySendPacket *packet);
+
+   /// Sends or delivers every delayed packet that's come due.
+   void processDelayedPackets();
 
    enum NetInterfaceConstants {
       ChallengeRetryCount = 4,     /// Number of times to send connect challenge requests before giving up.
@@ -320,6 +392,14 @@ protected:
 
    /// Disconnects the given connection and removes it from the NetInterface
    void disconnect(NetConnection *conn, NetConnection::TerminationReason reason, const char *reasonString);
+
+   class CollectScopeJob;
+   class ComputePrioritiesJob;
+
+   /// Sends packets on all connections that are due, doing the expensive preparation on the WorkerPool
+   void sendPacketsInParallel();
+
+   F64 mPacketPhaseTimes[PacketPhaseCount];
    /// @}
 public:
    /// @param   bindAddress    Local network address to bind this interface to.
@@ -348,10 +428,27 @@ public:
    /// Sets whether or not this NetInterface allows connections from remote hosts.
    void setAllowsConnections(bool conn) { mAllowConnections = conn; }
 
-   /// Returns the Socket associated with this NetInterface
+   /// Returns the Socket associated with this NetInterface.  Leave it alone while there's an I/O thread.
    Socket &getSocket() { return mSocket; }
 
-   /// Sends a packet to the remote address over this interface's socket.
+   /// Starts a thread that does all the reading and writing on this interface's socket, trading packets with
+   /// checkIncomingPackets() and sendto() through lock-free queues.  Packets are read and timestamped as they
+   /// come in, and sent as soon as they're written, however long the game thread takes between calls.  Returns
+   /// false if threads aren't available, or while journaling, which needs everything on one thread.
+   bool startIOThread();
+
+   /// Stops the I/O thread, once it has sent everything waiting; the socket goes back to the calling thread.
+   void stopIOThread();
+
+   bool hasIOThread() const;
+
+   /// Like Socket::waitForReadable(), but for a set of interfaces, some of which may have I/O threads.  Those
+   /// wake us as soon as they've read something.
+   static bool waitForPackets(NetInterface *const *interfaces, S32 count, U32 timeoutMillis);
+
+   /// Sends a packet to the remote address over this interface's socket.  Packets sent while processConnections()
+   /// is writing the connections' packets are held until it's done, and then sent all together; those always
+   /// return NoError.  With an I/O thread, returns WouldBlock if its queue is full.
    NetError sendto(const Address &address, BitStream *stream);
 
    /// Sends a packet to the remote address after millisecondDelay time has elapsed.
@@ -373,6 +470,17 @@ public:
    /// and pending connections.
    void processConnections();
 
+   /// Sets the WorkerPool used for scoping and prioritizing ghosts on all connections at once, or NULL to
+   /// prepare each connection's packets in turn.  The pool must outlive this NetInterface, or be cleared first.
+   void setWorkerPool(WorkerPool *pool);
+   WorkerPool *getWorkerPool() const;
+
+   /// Adds to the running total of main-thread milliseconds spent on phase
+   void addPacketPhaseTime(PacketPhase phase, F64 milliseconds);
+   /// Returns total main-thread milliseconds spent on phase since the last resetPacketPhaseTimes()
+   F64 getPacketPhaseTime(PacketPhase phase) const;
+   void resetPacketPhaseTimes();
+
    /// Returns the list of connections on this NetInterface.
    Vector<NetConnection *> &getConnectionList() { return mConnectionList; }
 
@@ -381,6 +489,12 @@ public:
 
    /// returns the current process time for this NetInterface
    U32 getCurrentTime() { return mCurrentTime; }
+
+   /// Stops this NetInterface from following the real clock, setting it to startTime; from then on its time only
+   /// moves when advanceTime() is called.  Lets tests on simulated links run the same way every time, and faster
+   /// than real time.  Must be called before any packets are sent.
+   void useManualClock(U32 startTime);
+   void advanceTime(U32 milliseconds) { mCurrentTime += milliseconds; }
 };
 
 };
@@ -217,6 +217,9 @@ class NetObject : public Object
    static bool mIsInitialUpdate; ///< Managed by GhostConnection - set to true when this is an initial update
    SafePtr<NetObject> mServerObject; ///< Direct pointer to the parent object on the server if it is a local connection
    GhostConnection *mOwningConnection; ///< The connection that owns this ghost, if it's a ghost
+
+   U32 mPriorityRevision;              ///< Changes whenever something that might affect our update priority changes.
+   static U32 mNextPriorityRevision;   ///< Revisions are unique across all objects, so a different object never looks unchanged.
 protected:
    enum NetFlag
    {
@@ -236,6 +239,11 @@ protected:
 
    /// Returns true if this pack/unpackUpdate is the initial one for the object
    bool isInitialUpdate() { return mIsInitialUpdate; }
+
+   /// Tells GhostConnections that priorities they have cached for this object are out of date.  setMaskBits()
+   /// calls this automatically; call it directly if the priority depends on something that can change without
+   /// a state change, such as position.
+   void invalidateUpdatePriority();
 public:
    NetObject();
    ~NetObject();
@@ -297,6 +305,22 @@ public:
    /// update.
    virtual F32 getUpdatePriority(GhostConnection *connection, U32 updateMask, S32 updateSkips);
 
+   /// Allows GhostConnections to cache update priorities.
+   ///
+   /// If getUpdatePriority() grows by a fixed amount for each skipped update, and otherwise only depends on
+   /// this object's state and that of the connection's priority reference object, return that amount here.
+   /// GhostConnection will then only call getUpdatePriority() when one of those objects has changed,
+   /// adding the growth for any skips in between.  The default, a negative value, disables caching.
+   virtual F32 getUpdatePriorityPerSkip();
+
+   /// Returns true if this object's priority should be computed by GhostConnection::computeBatchedUpdatePriorities()
+   /// together with all the other such objects, rather than by calling getUpdatePriority() on it.  Lets a
+   /// connection that knows what these objects are work out all their priorities in one pass.  Defaults to false.
+   virtual bool hasBatchedUpdatePriority();
+
+   /// Returns a number that changes whenever invalidateUpdatePriority() is called.
+   U32 getUpdatePriorityRevision() const { return mPriorityRevision; }
+
    /// Write the object's state to a packet.
    ///
    /// packUpdate is called on an object when it is to be written into a
@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------------
+//
+//   Torque Network Library
+//   Copyright (C) 2004 GarageGames.com, Inc.
+//   For more information see http://www.opentnl.org
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   For use in products that are not compatible with the terms of the GNU 
+//   General Public License, alternative licensing options are available 
+//   from GarageGames.com.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//------------------------------------------------------------------------------------
+
+
+
+#ifndef _TNL_RATECONTROLLER_H_
+#define _TNL_RATECONTROLLER_H_
+
+#ifndef _TNL_TYPES_H_
+#include "tnlTypes.h"
+#endif
+
+namespace TNL
+{
+
+/// Ways a fixed rate NetConnection can pace its packets.
+enum RateControlType
+{
+   RateControlFixed,          ///< Always send at the negotiated rate, whatever becomes of the packets
+   RateControlDelayBased,     ///< Back off when round trips grow or packets go missing, and reach for more when they don't
+   RateControlTypeCount
+};
+
+/// Decides how often a fixed rate NetConnection sends its packets, and how big they may be.
+///
+/// The connection starts it off with the rate negotiated with the remote host, then tells it about every data
+/// packet that gets through (with the round trip it took) and every one that is lost; the controller answers with
+/// the send period and packet size to use from then on.  Connections without one send at the negotiated rate.
+/// Adaptive connections pace themselves with their packet window instead, and don't use one.
+class RateController
+{
+public:
+   virtual ~RateController() { }
+
+   /// Returns a new controller of the given type, or NULL for RateControlFixed, which doesn't need one
+   static RateController *create(RateControlType type);
+
+   static RateControlType stringToType(const char *type);   ///< Anything unknown is RateControlFixed
+   static const char *typeToString(RateControlType type);
+
+   /// Starts over from the negotiated rate.  minSendPeriod and maxBandwidth are our own side's limits, which the
+   /// controller may work its way up to when the link can take more than the remote host asked for.
+   virtual void setNegotiatedRate(U32 sendPeriod, U32 packetSize, U32 minSendPeriod, U32 maxBandwidth) = 0;
+
+   /// A packet of packetSize bytes was acked at time, roundTripTime ms after it was sent
+   virtual void packetAcked(U32 time, U32 packetSize, U32 roundTripTime) = 0;
+   virtual void packetLost(U32 time, U32 packetSize) = 0;
+
+   virtual U32 getSendPeriod() const = 0;    ///< Milliseconds between packets
+   virtual U32 getPacketSize() const = 0;    ///< Largest packet to send, in bytes
+};
+
+
+/// Keeps the link's queue short, in the spirit of BBR.
+///
+/// The lowest round trip seen recently is taken as the link's own delay; anything beyond it is time spent waiting
+/// in a queue somewhere.  Once per round trip, if the queue has grown (or packets are being lost wholesale) the
+/// send rate drops to a little under what has actually been getting through, so the queue drains; if it hasn't,
+/// and we're using the rate we have, the rate creeps up to see if there's more to be had.  Scattered losses
+/// without a queue don't slow us down, but do make us send smaller packets, more often, so each loss costs less.
+class DelayBasedRateController : public RateController
+{
+   enum {
+      MinRoundTripWindow = 10000,      ///< The lowest round trip is forgotten after this many ms, in case the route changed
+      MinDecisionInterval = 100,       ///< Never change the rate more often than this, in ms
+      MinQueueDelay = 20,              ///< Queueing delays below this many ms are jitter, not congestion
+      MinPacketSize = 128,             ///< Bytes; anything smaller is mostly header
+      MaxPacketSize = 1200,            ///< Bytes; bigger packets risk being fragmented on tunnels and VPNs
+      LossyPacketSize = 576,           ///< Bytes; packets are kept to this on links that lose a lot of them
+   };
+
+   static const F32 LossAverageWeight;    ///< How much each packet counts toward the running loss rate
+   static const F32 LossyRate;            ///< Loss rate above which packets are kept small
+   static const F32 CongestedLossRate;    ///< Loss rate above which we slow down even without a queue
+   static const F32 DrainFactor;          ///< Fraction of the delivered rate to drop to when congested
+   static const F32 FullUseFactor;        ///< Delivering this fraction of the rate counts as using all of it
+   static const F32 ProbeFactor;          ///< How much faster to try when all is well
+   static const F32 MinBandwidthFactor;   ///< Never go below this fraction of the negotiated bandwidth
+
+   U32 mNegotiatedPeriod;
+   U32 mMinSendPeriod;
+   F32 mNegotiatedBandwidth;     ///< All bandwidths are in bytes per second
+   F32 mMaxBandwidth;
+   F32 mBandwidth;               ///< Rate we're aiming for
+
+   U32 mMinRoundTrip;
+   U32 mMinRoundTripTime;        ///< When mMinRoundTrip was seen
+   bool mHaveRoundTrip;
+   F32 mLossRate;                ///< Running average of the fraction of packets lost
+
+   U32 mIntervalStart;           ///< Decisions are made on what happened since this time
+   U32 mIntervalMinRoundTrip;
+   U32 mIntervalBytesAcked;
+
+   U32 mSendPeriod;
+   U32 mPacketSize;
+
+   U32 getDecisionInterval() const;
+   void endInterval(U32 time);
+   void computeSendRate();
+
+public:
+   DelayBasedRateController();
+
+   void setNegotiatedRate(U32 sendPeriod, U32 packetSize, U32 minSendPeriod, U32 maxBandwidth);
+
+   void packetAcked(U32 time, U32 packetSize, U32 roundTripTime);
+   void packetLost(U32 time, U32 packetSize);
+
+   U32 getSendPeriod() const;
+   U32 getPacketSize() const;
+
+   F32 getBandwidth() const;     ///< Bytes per second we're aiming for
+   F32 getLossRate() const;
+};
+
+};
+
+#endif
@@ -0,0 +1,122 @@
+//-----------------------------------------------------------------------------------
+//
+//   Torque Network Library
+//   Copyright (C) 2004 GarageGames.com, Inc.
+//   For more information see http://www.opentnl.org
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License as published by
+//   the Free Software Foundation; either version 2 of the License, or
+//   (at your option) any later version.
+//
+//   For use in products that are not compatible with the terms of the GNU 
+//   General Public License, alternative licensing options are available 
+//   from GarageGames.com.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public License
+//   along with this program; if not, write to the Free Software
+//   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//------------------------------------------------------------------------------------
+
+
+#ifndef _TNL_RINGBUFFER_H_
+#define _TNL_RINGBUFFER_H_
+
+#ifndef _TNL_TYPES_H_
+#include "tnlTypes.h"
+#endif
+
+#ifndef _TNL_ASSERT_H_
+#include "tnlAssert.h"
+#endif
+
+#include <atomic>
+
+namespace TNL
+{
+
+/// Fixed-size queue for handing items from one thread to another without locking.
+///
+/// Exactly one thread may write to a RingBuffer, and exactly one (other) thread may read from it.  Items are
+/// filled in and read where they sit: the writer asks for free slots with beginWrite(), fills them, and hands
+/// them over with endWrite(); the reader takes them with beginRead() and gives the slots back with endRead().
+/// Slots are only handed out in one contiguous run, so either may get fewer than are available when the run
+/// reaches the end of the buffer; asking again gets the rest.
+template <class T> class RingBuffer
+{
+   T *mItems;
+   U32 mSize;                       ///< Always a power of 2, so indices can simply be masked
+   std::atomic<U32> mReadIndex;     ///< Slots handed back by the reader; only ever counts up
+   std::atomic<U32> mWriteIndex;    ///< Slots handed over by the writer; only ever counts up
+
+   RingBuffer(const RingBuffer &);              // No copying
+   RingBuffer &operator=(const RingBuffer &);
+
+public:
+   /// Constructor -- size must be a power of 2
+   RingBuffer(U32 size)
+   {
+      TNLAssert(size && (size & (size - 1)) == 0, "RingBuffer size must be a power of 2!");
+
+      mItems = new T[size];
+      mSize = size;
+      mReadIndex = 0;
+      mWriteIndex = 0;
+   }
+
+   /// Destructor
+   ~RingBuffer()
+   {
+      delete[] mItems;
+   }
+
+   /// Writer only.  Returns free slots to fill, setting count to how many there are; NULL if the buffer is full.
+   T *beginWrite(S32 *count)
+   {
+      U32 write = mWriteIndex.load(std::memory_order_relaxed);
+      U32 free = mSize - (write - mReadIndex.load(std::memory_order_acquire));
+      U32 untilEnd = mSize - (write & (mSize - 1));
+
+      *count = S32(free < untilEnd ? free : untilEnd);
+      return *count ? &mItems[write & (mSize - 1)] : NULL;
+   }
+
+   /// Writer only.  Hands the first count slots from beginWrite() over to the reader.
+   void endWrite(S32 count)
+   {
+      mWriteIndex.store(mWriteIndex.load(std::memory_order_relaxed) + count, std::memory_order_release);
+   }
+
+   /// Reader only.  Returns items waiting to be read, setting count to how many there are; NULL if there are none.
+   T *beginRead(S32 *count)
+   {
+      U32 read = mReadIndex.load(std::memory_order_relaxed);
+      U32 waiting = mWriteIndex.load(std::memory_order_acquire) - read;
+      U32 untilEnd = mSize - (read & (mSize - 1));
+
+      *count = S32(waiting < untilEnd ? waiting : untilEnd);
+      return *count ? &mItems[read & (mSize - 1)] : NULL;
+   }
+
+   /// Reader only.  Gives the first count items from beginRead() back to the writer.
+   void endRead(S32 count)
+   {
+      mReadIndex.store(mReadIndex.load(std::memory_order_relaxed) + count, std::memory_order_release);
+   }
+
+   /// Either thread.  True if nothing is waiting to be read, though the writer may be about to change that.
+   bool isEmpty() const
+   {
+      return mReadIndex.load(std::memory_order_acquire) == mWriteIndex.load(std::memory_order_acquire);
+   }
+};
+
+};
+
+#endif
@@ -200,6 +200,64 @@ public:
    void dispatchResponseCalls();
 };
 
+/// Fixed set of worker threads for splitting a batch of independent work items across processors.
+///
+/// A WorkerPool runs one Job at a time.  The calling thread helps out, and run() doesn't return
+/// until every item of the job has been processed, so results can be gathered in a fixed order
+/// afterwards regardless of which thread handled which item.  With zero threads (or when TNL is
+/// built with TNL_NO_THREADS), everything runs on the calling thread, in order.
+class WorkerPool
+{
+public:
+   /// A batch of work items, numbered 0 to itemCount - 1.
+   class Job
+   {
+   public:
+      virtual ~Job();
+
+      /// Processes one item.  May be called from any thread, so must only touch data belonging to that item,
+      /// or data that nobody is modifying while the job runs.
+      virtual void runItem(S32 index) = 0;
+   };
+
+private:
+   class WorkerThread : public Thread
+   {
+      WorkerPool *mPool;
+   public:
+      WorkerThread(WorkerPool *pool);
+      U32 run();
+   };
+   friend class WorkerThread;
+
+   Vector<WorkerThread *> mThreads;
+
+   Mutex mLock;                  ///< Protects the fields below
+   Semaphore mWorkAvailable;     ///< Incremented once per worker when a job starts, or when it's time to quit
+   Semaphore mWorkerFinished;    ///< Incremented by each worker as it runs out of items
+
+   Job *mJob;
+   S32 mItemCount;
+   S32 mNextItem;
+   bool mQuitting;
+
+   bool runNextItem();           ///< Grabs the next unclaimed item and runs it; returns false if there were none left
+   void workerLoop();
+
+public:
+   WorkerPool(U32 threadCount);  ///< Constructor
+   ~WorkerPool();                ///< Destructor -- waits for the workers to exit
+
+   /// Number of worker threads, not counting the thread that calls run()
+   U32 getThreadCount() const;
+
+   /// Runs job->runItem() for every item, and returns when all are done
+   void run(Job *job, S32 itemCount);
+
+   /// Best guess at the number of processors on this machine, or 1 if we can't tell
+   static U32 getProcessorCount();
+};
+
 /// Declares a ThreadQueue method on a subclass of ThreadQueue.
 #define TNL_DECLARE_THREADQ_METHOD(func, args) \
    void func args; \
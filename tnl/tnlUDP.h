@@ -144,6 +144,14 @@ enum NetError {
    UnknownError,          ///< There was some other, unknown error.
 };
 
+/// One datagram in a batch sent with Socket::sendtoBatch() or read with Socket::recvfromBatch().
+struct Datagram
+{
+   Address address;  ///< Where the datagram is going, or where it came from.
+   U8 *buffer;       ///< The datagram's data; for reads, space for it, supplied by the caller.
+   S32 size;         ///< Bytes to send, or bytes read.
+};
+
 /// The Socket class encapsulates a platform's network socket.
 class Socket
 {
@@ -152,6 +160,7 @@ class Socket
 public:
    enum {
       DefaultBufferSize = 32768, ///< The default send and receive buffer sizes
+      MaxBatchSize = 64,         ///< Most datagrams handed to the OS in one system call by the batch functions
    };
 
    /// Opens a socket on the specified address/port
@@ -177,6 +186,17 @@ public:
    /// @param   bytesRead       Specifies the number of bytes which were actually in the packet.
    NetError recvfrom(Address *address, U8 *buffer, S32 bufferSize, S32 *bytesRead);
 
+   /// Sends a batch of packets.  On Linux this takes one system call (sendmmsg) per MaxBatchSize packets;
+   /// elsewhere, and while journaling, it's the same as calling sendto() for each.
+   ///
+   /// Returns the first error hit.  sentCount is set to the number of packets sent before it.
+   NetError sendtoBatch(const Datagram *datagrams, S32 count, S32 *sentCount);
+
+   /// Reads up to count waiting packets, with one system call (recvmmsg) on Linux, into the buffers provided in
+   /// datagrams, each of which must hold bufferSize bytes.  Returns WouldBlock if nothing was waiting.  Packets
+   /// too big for bufferSize are dropped rather than handed back cut short.
+   NetError recvfromBatch(Datagram *datagrams, S32 count, S32 bufferSize, S32 *receivedCount);
+
    /// Returns the Address corresponding to this socket, as bound on the local machine.
    Address getBoundAddress();
 
@@ -189,6 +209,11 @@ public:
    virtual NetError send(const U8 *buffer, S32 bufferSize);
 
    bool isWritable(U32 timeout = 0);
+
+   /// Waits until a packet arrives on any of the sockets, or timeoutMillis passes.
+   ///
+   /// Returns true if there is something to read.  A timeout of 0 only checks.
+   static bool waitForReadable(Socket *const *sockets, S32 socketCount, U32 timeoutMillis);
 };
 
 //inline void read(BitStream &s, IPAddress *val)
@@ -101,6 +101,11 @@ typedef in_addr IN_ADDR;
 
 #include <stdio.h>
 
+// sendmmsg() and recvmmsg() need glibc 2.14 or later, which defines MSG_WAITFORONE along with them
+#if defined(TNL_OS_LINUX) && defined(MSG_WAITFORONE)
+#  define TNL_HAS_MMSG
+#endif
+
 
 #if !defined(NO_IPX_SUPPORT)
 #  include <wsipx.h>
@@ -411,6 +416,169 @@ NetError Socket::recvfrom(Address *address, U8 *buffer, S32 bufferSize, S32 *out
    return NoError;
 }
 
+#ifdef TNL_HAS_MMSG
+static bool mmsgUnsupported = false;   // Set if the kernel turns out to be too old for sendmmsg() and recvmmsg()
+#endif
+
+NetError Socket::sendtoBatch(const Datagram *datagrams, S32 count, S32 *sentCount)
+{
+   *sentCount = 0;
+
+#ifdef TNL_HAS_MMSG
+   // The journal records packets one at a time, so we can only batch when it's not running
+   if(Journal::getCurrentMode() == Journal::Inactive && !mmsgUnsupported)
+   {
+      mmsghdr messages[MaxBatchSize];
+      iovec iovecs[MaxBatchSize];
+      SOCKADDR addresses[MaxBatchSize];
+
+      while(*sentCount < count)
+      {
+         S32 batchSize = getMin(count - *sentCount, S32(MaxBatchSize));
+         S32 prepared = 0;
+
+         // Send everything up to the first packet we can't, if any
+         for(; prepared < batchSize; prepared++)
+         {
+            const Datagram &datagram = datagrams[*sentCount + prepared];
+
+            if(datagram.address.transport != mTransportProtocol)
+               break;
+
+            socklen_t addressSize;
+            TNLToSocketAddress(datagram.address, &addresses[prepared], &addressSize);
+
+            iovecs[prepared].iov_base = datagram.buffer;
+            iovecs[prepared].iov_len = datagram.size;
+
+            memset(&messages[prepared], 0, sizeof(mmsghdr));
+            messages[prepared].msg_hdr.msg_name = &addresses[prepared];
+            messages[prepared].msg_hdr.msg_namelen = addressSize;
+            messages[prepared].msg_hdr.msg_iov = &iovecs[prepared];
+            messages[prepared].msg_hdr.msg_iovlen = 1;
+         }
+
+         if(prepared == 0)
+            return InvalidPacketProtocol;
+
+         S32 sent = sendmmsg(mPlatformSocket, messages, prepared, 0);
+
+         if(sent == SOCKET_ERROR)
+         {
+            if(errno != ENOSYS)
+               return getLastError();
+
+            mmsgUnsupported = true;
+            break;
+         }
+
+         // The OS may take fewer than we offered; the rest go around again
+         *sentCount += sent;
+      }
+
+      if(*sentCount == count)
+         return NoError;
+   }
+#endif
+
+   for(; *sentCount < count; (*sentCount)++)
+   {
+      const Datagram &datagram = datagrams[*sentCount];
+      NetError error = sendto(datagram.address, datagram.buffer, datagram.size);
+
+      if(error != NoError)
+         return error;
+   }
+
+   return NoError;
+}
+
+NetError Socket::recvfromBatch(Datagram *datagrams, S32 count, S32 bufferSize, S32 *receivedCount)
+{
+   *receivedCount = 0;
+
+#ifdef TNL_HAS_MMSG
+   if(Journal::getCurrentMode() == Journal::Inactive && !mmsgUnsupported)
+   {
+      mmsghdr messages[MaxBatchSize];
+      iovec iovecs[MaxBatchSize];
+      SOCKADDR addresses[MaxBatchSize];
+
+      S32 batchSize = getMin(count, S32(MaxBatchSize));
+
+      // Dropping a truncated packet leaves its slot free, so we go around again until the batch is full or the
+      // socket is empty
+      while(*receivedCount < batchSize)
+      {
+         Datagram *slots = datagrams + *receivedCount;
+         S32 offered = batchSize - *receivedCount;
+
+         for(S32 i = 0; i < offered; i++)
+         {
+            iovecs[i].iov_base = slots[i].buffer;
+            iovecs[i].iov_len = bufferSize;
+
+            memset(&messages[i], 0, sizeof(mmsghdr));
+            messages[i].msg_hdr.msg_name = &addresses[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+         }
+
+         S32 received = recvmmsg(mPlatformSocket, messages, offered, MSG_DONTWAIT, NULL);
+
+         if(received == SOCKET_ERROR)
+         {
+            if(*receivedCount > 0)
+               return NoError;      // Whatever went wrong, the caller will hear about it on its next read
+
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+               return WouldBlock;
+
+            if(errno != ENOSYS)
+               return getLastError();
+
+            mmsgUnsupported = true;
+            break;
+         }
+
+         S32 kept = 0;
+         for(S32 i = 0; i < received; i++)
+         {
+            // Bigger than any packet of ours, so what's left of it is no use to anyone
+            if(messages[i].msg_hdr.msg_flags & MSG_TRUNC)
+               continue;
+
+            if(kept != i)
+               memcpy(slots[kept].buffer, slots[i].buffer, messages[i].msg_len);
+
+            SocketToTNLAddress(&addresses[i], &slots[kept].address);
+            slots[kept].size = messages[i].msg_len;
+            kept++;
+         }
+
+         *receivedCount += kept;
+
+         if(received < offered)
+            break;
+      }
+
+      if(!mmsgUnsupported)
+         return *receivedCount > 0 ? NoError : WouldBlock;
+   }
+#endif
+
+   for(; *receivedCount < count; (*receivedCount)++)
+   {
+      Datagram &datagram = datagrams[*receivedCount];
+
+      if(recvfrom(&datagram.address, datagram.buffer, bufferSize, &datagram.size) != NoError)
+         break;
+   }
+
+   return *receivedCount > 0 ? NoError : WouldBlock;
+}
+
 NetError Socket::connect(const Address &theAddress)
 {
    SOCKADDR destAddress;
@@ -482,6 +650,38 @@ bool Socket::isWritable(U32 timeoutMillis)
    return FD_ISSET(mPlatformSocket, &fds);
 }
 
+bool Socket::waitForReadable(Socket *const *sockets, S32 socketCount, U32 timeoutMillis)
+{
+   fd_set fds;
+   FD_ZERO(&fds);
+
+   S32 maxSocket = -1;
+   for(S32 i = 0; i < socketCount; i++)
+   {
+      if(sockets[i]->mPlatformSocket == INVALID_SOCKET)
+         continue;
+
+      FD_SET(sockets[i]->mPlatformSocket, &fds);
+      if(sockets[i]->mPlatformSocket > maxSocket)
+         maxSocket = sockets[i]->mPlatformSocket;
+   }
+
+   timeval timeoutval;
+   timeoutval.tv_sec = timeoutMillis / 1000;
+   timeoutval.tv_usec = (timeoutMillis % 1000) * 1000;
+
+   // Nothing to wait on; just let the time pass
+   if(maxSocket == -1)
+   {
+      Platform::sleep(timeoutMillis);
+      return false;
+   }
+
+   S32 result = ::select(maxSocket + 1, &fds, 0, 0, &timeoutval);
+
+   return result != SOCKET_ERROR && result > 0;
+}
+
 #if defined ( TNL_OS_WIN32 )
 void Socket::getInterfaceAddresses(Vector<Address> *addressVector)
 {
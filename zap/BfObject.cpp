@@ -872,6 +872,12 @@ void BfObject::setScopeAlways()
 }
 
 
+const F32 BfObject::UpdatePriorityRange = 500;
+const F32 BfObject::UpdatePriorityApproachBonus = 0.7f;
+const F32 BfObject::UpdatePriorityInitialBonus = 2.5f;
+const F32 BfObject::UpdatePriorityPerSkip = 0.2f;
+
+// Any changes here need to be made to UpdatePriorityBatch too
 F32 BfObject::getUpdatePriority(GhostConnection *connection, U32 updateMask, S32 updateSkips)
 {
    GameConnection *gc = dynamic_cast<GameConnection *>(connection);
@@ -906,17 +912,38 @@ F32 BfObject::getUpdatePriority(GhostConnection *connection, U32 updateMask, S32
 
 
       // initial scoping factor is distance based.
-      add += (500 - distance) / 500;
+      add += (UpdatePriorityRange - distance) / UpdatePriorityRange;
 
       // give some extra love to things that are moving towards the scope object
       if(deltav.dot(deltap) < 0)
-         add += 0.7f;
+         add += UpdatePriorityApproachBonus;
    }
 
    // and a little more love if this object has not yet been scoped.
    if(updateMask == 0xFFFFFFFF)
-      add += 2.5;
-   return add + updateSkips * 0.2f;
+      add += UpdatePriorityInitialBonus;
+   return add + updateSkips * UpdatePriorityPerSkip;
+}
+
+
+// Everything else in getUpdatePriority() depends only on our state and that of the connection's control object,
+// so the connection can cache our priority until one of those changes
+F32 BfObject::getUpdatePriorityPerSkip()
+{
+   return UpdatePriorityPerSkip;
+}
+
+
+// Lets GameConnection work out our priority along with everybody else's in an UpdatePriorityBatch
+bool BfObject::hasBatchedUpdatePriority()
+{
+   return true;
+}
+
+
+void BfObject::onExtentChanged()
+{
+   invalidateUpdatePriority();
 }
 
 
@@ -1072,6 +1099,16 @@ void BfObject::findObjects(U8 typeNumber, Vector<DatabaseObject *> &fillVector,
 }
 
 
+// Same as findObjects(), but if this is the search getIdleQuery() asked for, the game may already have done it
+void BfObject::findIdleObjects(TestFunc objectTypeTest, Vector<DatabaseObject *> &fillVector, const Rect &ext) const
+{
+   if(mGame && mGame->findPreparedIdleObjects(this, objectTypeTest, ext, fillVector))
+      return;
+
+   findObjects(objectTypeTest, fillVector, ext);
+}
+
+
 BfObject *BfObject::findObjectLOS(U8 typeNumber, U32 stateIndex, const Point &rayStart, const Point &rayEnd,
                                       float &collisionTime, Point &collisionNormal) const
 {
@@ -1241,6 +1278,12 @@ void BfObject::idle(IdleCallPath path)
 }
 
 
+bool BfObject::getIdleQuery(U32 timeDelta, TestFunc &testFunc, Rect &queryRect) const
+{
+   return false;
+}
+
+
 void BfObject::writeControlState(BitStream *)
 {
    // Do nothing
@@ -243,6 +243,8 @@ protected:
    StringTableEntry mKillString;     // Alternate descr of what shot projectile (e.g. "Red turret"), used when shooter is not a ship or robot
    Game *mGame;
 
+   void onExtentChanged();    // Our update priority depends on where we are
+
 public:
    BfObject();                // Constructor
    virtual ~BfObject();       // Destructor
@@ -282,10 +284,19 @@ public:
    void setOwner(ClientInfo *clientInfo);
    ClientInfo *getOwner();
 
+   // Terms of getUpdatePriority(), shared with UpdatePriorityBatch
+   static const F32 UpdatePriorityRange;           // Priority drops by 1 over this distance from the control object
+   static const F32 UpdatePriorityApproachBonus;   // Added for objects approaching the control object
+   static const F32 UpdatePriorityInitialBonus;    // Added for objects that haven't been sent yet
+   static const F32 UpdatePriorityPerSkip;         // Added for each update that has been skipped
+
    F32 getUpdatePriority(GhostConnection *connection, U32 updateMask, S32 updateSkips);
+   F32 getUpdatePriorityPerSkip();     // Subclasses whose priority isn't linear in updateSkips should return -1
+   bool hasBatchedUpdatePriority();    // Subclasses that override getUpdatePriority() must return false
 
    void findObjects(U8 typeNumber, Vector<DatabaseObject *> &fillVector, const Rect &extents) const;
    void findObjects(TestFunc, Vector<DatabaseObject *> &fillVector, const Rect &extents) const;
+   void findIdleObjects(TestFunc, Vector<DatabaseObject *> &fillVector, const Rect &extents) const;  // Uses results of getIdleQuery()
 
    // For a few objects, their renderable outline differs from where the user needs to grab them in the editor... 
    // This primarily affects line items like gofasts and teleporters, where the main item is the outline, but
@@ -315,6 +326,10 @@ public:
 
    virtual void idle(IdleCallPath path);              
 
+   // Objects whose server idle() starts off by searching the database should describe that search here, so
+   // ServerGame can do it on a worker thread ahead of time.  They then need to do it with findIdleObjects().
+   virtual bool getIdleQuery(U32 timeDelta, TestFunc &testFunc, Rect &queryRect) const;
+
    virtual void writeControlState(BitStream *stream); 
    virtual void readControlState(BitStream *stream);  
    virtual F32 getHealth() const;                           
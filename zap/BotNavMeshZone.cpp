@@ -40,7 +40,7 @@ namespace Zap
 {
 
 // Declare our statics
-static const S32 MAX_ZONES = 10000;                              // Don't make this go above S16 max - 1 (32,766), AStar::findPath is limited
+static const S32 MAX_ZONES = U16_MAX - 1;                        // Zone IDs are U16s, and U16_MAX means no zone
 const S32 BotNavMeshZone::BufferRadius = Ship::CollisionRadius;  // Radius to buffer objects when creating the holes for zones
 
 // Extra padding around the game extents to allow outsize zones to be created.
@@ -273,24 +273,33 @@ bool BotNavMeshZone::buildConnectionsRecastStyle(const Vector<BotNavMeshZone *>
 
          neighbor.borderCenter.set((neighbor.borderStart + neighbor.borderEnd) * 0.5);
 
+         BotNavMeshZone *zone0 = allZones->get(polyToZoneMap[polyId0]);
+         BotNavMeshZone *zone1 = allZones->get(polyToZoneMap[polyId1]);
+
          // Test if polygons are under a Core or SpeedZone using prior knowledge of mesh placement
-         bool poly0isCore = (polyId0 > coreRecastPolyStartIdx && polyId0 < szRecastPolyStartIdx);
-         bool poly1isCore = (polyId1 > coreRecastPolyStartIdx && polyId1 < szRecastPolyStartIdx);
+         bool poly0isCore = (polyId0 >= coreRecastPolyStartIdx && polyId0 < szRecastPolyStartIdx);
+         bool poly1isCore = (polyId1 >= coreRecastPolyStartIdx && polyId1 < szRecastPolyStartIdx);
 
          bool poly0isSz = (polyId0 > szRecastPolyStartIdx);
          bool poly1isSz = (polyId1 > szRecastPolyStartIdx);
 
+         // Going into a Core zone is high cost so bots try another way; see AStar::getTravelCost()
+         if(poly0isCore)
+            zone0->setWalkable(false);
+         if(poly1isCore)
+            zone1->setWalkable(false);
+
+         // Same either way
+         neighbor.distTo = zone0->getCenter().distanceTo(neighbor.borderCenter) +
+                           neighbor.borderCenter.distanceTo(zone1->getCenter());
+
          // Logic for poly0 to get poly1 as a neighbor
          if(!poly0isSz)  // Connections only go one direction for SpeedZone
          {
             neighbor.zoneID = polyToZoneMap[polyId1];
 
-            // Going into a Core zone is high cost so bots try another way
-            if(poly1isCore && !poly0isCore)
-               neighbor.distTo = CoreTraversalCost;
-
             // Save poly1 as neighbor to poly0 (copies neighbor implicitly)
-            allZones->get(polyToZoneMap[polyId0])->mNeighbors.push_back(neighbor);
+            zone0->mNeighbors.push_back(neighbor);
          }
 
          // Now do the same for poly1 to get poly0 as a neighbor
@@ -298,11 +307,7 @@ bool BotNavMeshZone::buildConnectionsRecastStyle(const Vector<BotNavMeshZone *>
          {
             neighbor.zoneID = polyToZoneMap[polyId0];
 
-            // Going into a Core zone is high cost so bots try another way
-            if(poly0isCore && !poly1isCore)
-               neighbor.distTo = CoreTraversalCost;
-
-            allZones->get(polyToZoneMap[polyId1])->mNeighbors.push_back(neighbor);
+            zone1->mNeighbors.push_back(neighbor);
          }
       }
    }
@@ -1077,246 +1082,243 @@ F32 AStar::heuristic(const Vector<BotNavMeshZone *> *zones, S32 fromZone, S32 to
 }
 
 
-// Returns a path, including the startZone and targetZone 
-Vector<Point> AStar::findPath(const Vector<BotNavMeshZone *> *zones, S32 startZone, S32 targetZone, const Point &target)
+// Cost of moving from fromZone into one of its neighbors
+F32 AStar::getTravelCost(const Vector<BotNavMeshZone *> *zones, S32 fromZone, const NeighboringZone &neighbor)
 {
-   // Because of these variables...
-   static U16 onClosedList = 0;
-   static U16 onOpenList;
+   if(!zones->get(neighbor.zoneID)->getWalkable() && zones->get(fromZone)->getWalkable())
+      return neighbor.distTo + BotNavMeshZone::CoreTraversalCost;
+
+   return neighbor.distTo;
+}
+
 
-   // ...these arrays can be reused without further initialization
-   static U16 whichList[MAX_ZONES];       // Record whether a zone is on the open or closed list
-   static S16 openList[MAX_ZONES + 1]; 
-   static S16 openZone[MAX_ZONES]; 
-   static S16 parentZones[MAX_ZONES]; 
+// Constructor
+AStar::AStar()
+{
+   mGeneration = 0;
+   mExpandedCount = 0;
+}
 
-   static F32 Fcost[MAX_ZONES];   
-   static F32 Gcost[MAX_ZONES];    
-   static F32 Hcost[MAX_ZONES];   
 
-   S16 numberOfOpenListItems = 0;
-   bool foundPath;
+U32 AStar::getExpandedCount() const
+{
+   return mExpandedCount;
+}
 
-   S32 newOpenListItemID = 0;         // Used for creating new IDs for zones to make heap work
 
-   Vector<Point> path;
+// Makes sure a zone's state is from this search, resetting it if it's left over from an earlier one
+AStar::ZoneState &AStar::getState(U16 zone)
+{
+   ZoneState &state = mZoneStates[zone];
 
-   // This block here lets us repeatedly reuse the whichList array without resetting it or recreating it
-   // which, for larger numbers of zones should be a real time saver.  It's not clear if it is particularly
-   // more efficient for the zone counts we typically see in Bitfighter levels.
-   if(onClosedList > U16_MAX - 3 ) // Reset whichList when we've run out of headroom
+   if(state.generation != mGeneration)
    {
-      for(S32 i = 0; i < MAX_ZONES; i++) 
-         whichList[i] = 0;
-      onClosedList = 0;   
+      state.generation = mGeneration;
+      state.heapIndex = Unvisited;
    }
-   onClosedList = onClosedList + 2; // Changing the values of onOpenList and onClosed list is faster than redimming whichList() array
-   onOpenList = onClosedList - 1;
 
-   Gcost[startZone] = 0;         // That's the cost of going from the startZone to the startZone!
-   Fcost[0] = Hcost[0] = heuristic(zones, startZone, targetZone);
+   return state;
+}
+
+
+// Moves the zone at heapIndex up the open list until its parent is no more expensive
+void AStar::siftUp(S32 heapIndex)
+{
+   U16 zone = mOpenList[heapIndex];
+   F32 fCost = mZoneStates[zone].fCost;
+
+   while(heapIndex > 0)
+   {
+      S32 parentIndex = (heapIndex - 1) / 2;
+      U16 parentZone = mOpenList[parentIndex];
+
+      if(mZoneStates[parentZone].fCost <= fCost)
+         break;
 
-   numberOfOpenListItems = 1;    // Start with one open item: the startZone
+      mOpenList[heapIndex] = parentZone;
+      mZoneStates[parentZone].heapIndex = heapIndex;
+      heapIndex = parentIndex;
+   }
 
-   openList[1] = 0;              // Start with 1 item in the open list (must be index 1), which is maintained as a binary heap
-   openZone[0] = startZone;
+   mOpenList[heapIndex] = zone;
+   mZoneStates[zone].heapIndex = heapIndex;
+}
+
+
+// Moves the zone at heapIndex down the open list until neither child is cheaper
+void AStar::siftDown(S32 heapIndex)
+{
+   U16 zone = mOpenList[heapIndex];
+   F32 fCost = mZoneStates[zone].fCost;
+   S32 count = mOpenList.size();
 
-   // Loop until a path is found or deemed nonexistent.
    while(true)
    {
-      if(numberOfOpenListItems == 0)      // List is empty, we're done
-      {
-         foundPath = false; 
+      S32 childIndex = heapIndex * 2 + 1;
+      if(childIndex >= count)
          break;
-      }  
-      else
-      {
-         // The open list is not empty, so take the first cell off of the list.
-         //   Since the list is a binary heap, this will be the lowest F cost cell on the open list.
-         S32 parentZone = openZone[openList[1]];
 
-         if(parentZone == targetZone)
-         {
-            foundPath = true; 
-            break;
-         }
+      if(childIndex + 1 < count && mZoneStates[mOpenList[childIndex + 1]].fCost < mZoneStates[mOpenList[childIndex]].fCost)
+         childIndex++;
 
-         whichList[parentZone] = onClosedList;   // add the item to the closed list
-         numberOfOpenListItems--;   
+      U16 childZone = mOpenList[childIndex];
 
-         //   Open List = Binary Heap: Delete this item from the open list, which
-         // is maintained as a binary heap. For more information on binary heaps, see:
-         //   http://www.policyalmanac.org/games/binaryHeaps.htm
-            
-         //   Delete the top item in binary heap and reorder the heap, with the lowest F cost item rising to the top.
-         openList[1] = openList[numberOfOpenListItems + 1];   // Move the last item in the heap up to slot #1
-         S16 v = 1; 
+      if(mZoneStates[childZone].fCost >= fCost)
+         break;
 
-         //   Loop until the new item in slot #1 sinks to its proper spot in the heap.
-         while(true) // ***
-         {
-            S16 u = v;      
-            if (2 * u + 1 < numberOfOpenListItems) // if both children exist
-            {
-               // Check if the F cost of the parent is greater than each child,
-               // and select the lowest of the two children
-               if(Fcost[openList[u]] >= Fcost[openList[2*u]]) 
-                  v = 2 * u;
-               if(Fcost[openList[v]] >= Fcost[openList[2*u+1]]) 
-                  v = 2 * u + 1;      
-            }
-            else if (2 * u < numberOfOpenListItems) // if only child (#1) exists
-            {
-                // Check if the F cost of the parent is greater than child #1   
-               if(Fcost[openList[u]] >= Fcost[openList[2*u]]) 
-                  v = 2 * u;
-            }
+      mOpenList[heapIndex] = childZone;
+      mZoneStates[childZone].heapIndex = heapIndex;
+      heapIndex = childIndex;
+   }
 
-            if(u != v) // If parent's F is > one of its children, swap them...
-            {
-               S16 temp = openList[u];
-               openList[u] = openList[v];
-               openList[v] = temp;         
-            }
-            else
-               break; // ...otherwise, exit loop
-         } // ***
+   mOpenList[heapIndex] = zone;
+   mZoneStates[zone].heapIndex = heapIndex;
+}
 
-         // Check the adjacent zones. (Its "children" -- these path children
-         //   are similar, conceptually, to the binary heap children mentioned
-         //   above, but don't confuse them. They are different.
-         // Add these adjacent child squares to the open list
-         //   for later consideration if appropriate.
 
-         Vector<NeighboringZone> neighboringZones = zones->get(parentZone)->mNeighbors;
+// Takes the cheapest zone off the open list, and marks it closed
+U16 AStar::popOpenList()
+{
+   U16 zone = mOpenList[0];
+   mZoneStates[zone].heapIndex = Closed;
 
-         for(S32 a = 0; a < neighboringZones.size(); a++)
-         {
-            NeighboringZone zone = neighboringZones[a];
-            S32 zoneID = zone.zoneID;
+   U16 last = mOpenList.last();
+   mOpenList.pop_back();
 
-            //   Check if zone is already on the closed list (items on the closed list have
-            //   already been considered and can now be ignored).
-            if(whichList[zoneID] == onClosedList) 
-               continue;
+   if(mOpenList.size() > 0)
+   {
+      mOpenList[0] = last;
+      siftDown(0);
+   }
 
-            //   Add zone to the open list if it's not already on it
-            TNLAssert(newOpenListItemID < MAX_ZONES, "Too many nav zones... try increasing MAX_ZONES!");
-            if(whichList[zoneID] != onOpenList && newOpenListItemID < MAX_ZONES) 
-            {   
-               // Create a new open list item in the binary heap
-               newOpenListItemID = newOpenListItemID + 1;   // Give each new item a unique id
-               S32 m = numberOfOpenListItems + 1;
-               openList[m] = newOpenListItemID;             // Place the new open list item (actually, its ID#) at the bottom of the heap
-               openZone[newOpenListItemID] = zoneID;        // Record zone as a newly opened
-
-               Hcost[openList[m]] = heuristic(zones, zoneID, targetZone);
-               Gcost[zoneID] = Gcost[parentZone] + zone.distTo;
-               Fcost[openList[m]] = Gcost[zoneID] + Hcost[openList[m]];
-               parentZones[zoneID] = parentZone; 
-
-               // Move the new open list item to the proper place in the binary heap.
-               // Starting at the bottom, successively compare to parent items,
-               // swapping as needed until the item finds its place in the heap
-               // or bubbles all the way to the top (if it has the lowest F cost).
-               while(m > 1 && Fcost[openList[m]] <= Fcost[openList[m/2]]) 
-               {
-                  S16 temp = openList[m/2];
-                  openList[m/2] = openList[m];
-                  openList[m] = temp;
-                  m = m/2;
-               }
+   return zone;
+}
 
-               // Finally, put zone on the open list
-               whichList[zoneID] = onOpenList;
-               numberOfOpenListItems++;
-            }
 
-            // If zone is already on the open list, check to see if this 
-            //   path to that cell from the starting location is a better one. 
-            //   If so, change the parent of the cell and its G and F costs.
+// Fills path with the way from startZone to target, which is in targetZone.  Returns false, leaving path empty,
+// if there is no way there.  Nothing is allocated once our scratch space and path have grown to fit the level.
+//
+// The path has the target first, then the center of the target zone, then alternating gateways and zone centers
+// back to the center of startZone.  Fortunately, we want our list to have the closest zone last (see getWaypoint),
+// so it all works out nicely.
+bool AStar::findPath(const Vector<BotNavMeshZone *> *zones, S32 startZone, S32 targetZone, const Point &target,
+                     Vector<Point> &path)
+{
+   path.clear();
+
+   if(mZoneStates.size() < zones->size())
+      mZoneStates.resize(zones->size());     // New states come in zeroed, so with a generation that's never current
 
-            else // zone was already on the open list
-            {
-               // Figure out the G cost of this possible new path
-               S32 tempGcost = (S32)(Gcost[parentZone] + zone.distTo);
-               
-               // If this path is shorter (G cost is lower) then change
-               // the parent cell, G cost and F cost.
-               if(tempGcost < Gcost[zoneID])
-               {
-                  parentZones[zoneID] = parentZone; // Change the square's parent
-                  Gcost[zoneID] = (F32)tempGcost;        // and its G cost         
-
-                  // Because changing the G cost also changes the F cost, if
-                  // the item is on the open list we need to change the item's
-                  // recorded F cost and its position on the open list to make
-                  // sure that we maintain a properly ordered open list.
-
-                  for(S32 i = 1; i <= numberOfOpenListItems; i++) // Look for the item in the heap
-                  {
-                     if(openZone[openList[i]] == zoneID) 
-                     {
-                        Fcost[openList[i]] = Gcost[zoneID] + Hcost[openList[i]]; // Change the F cost
-                        
-                        // See if changing the F score bubbles the item up from it's current location in the heap
-                        S32 m = i;
-                        while(m > 1 && Fcost[openList[m]] < Fcost[openList[m/2]]) 
-                        {
-                           S16 temp = openList[m/2];
-                           openList[m/2] = openList[m];
-                           openList[m] = temp;
-                           m = m/2;
-                        }
-                   
-                        break; 
-                     } 
-                  }
-               }
+   // Bumping the generation marks every zone's state as stale without touching them
+   mGeneration++;
+   if(mGeneration == 0)
+   {
+      for(S32 i = 0; i < mZoneStates.size(); i++)
+         mZoneStates[i].generation = 0;
+      mGeneration = 1;
+   }
 
-            } // else if whichList(zoneID) = onOpenList   
-         } // for loop looping through neighboring zones list
-      }  
+   mOpenList.clear();
+   mExpandedCount = 0;
 
-      // If target is added to open list then path has been found.
-      if(whichList[targetZone] == onOpenList)
+   ZoneState &start = getState(startZone);
+   start.gCost = 0;        // That's the cost of going from the startZone to the startZone!
+   start.fCost = heuristic(zones, startZone, targetZone);
+   start.parentZone = startZone;
+
+   mOpenList.push_back(startZone);
+   start.heapIndex = 0;
+
+   bool foundPath = false;
+
+   while(mOpenList.size() > 0)
+   {
+      U16 parentZone = popOpenList();
+      mExpandedCount++;
+
+      if(parentZone == targetZone)
       {
-         foundPath = true; 
+         foundPath = true;
          break;
       }
+
+      F32 parentGCost = mZoneStates[parentZone].gCost;
+      const Vector<NeighboringZone> &neighbors = zones->get(parentZone)->mNeighbors;
+
+      for(S32 i = 0; i < neighbors.size(); i++)
+      {
+         const NeighboringZone &neighbor = neighbors[i];
+         ZoneState &state = getState(neighbor.zoneID);
+
+         if(state.heapIndex == Closed)
+            continue;
+
+         F32 gCost = parentGCost + getTravelCost(zones, parentZone, neighbor);
+
+         if(state.heapIndex == Unvisited)
+         {
+            state.gCost = gCost;
+            state.fCost = gCost + heuristic(zones, neighbor.zoneID, targetZone);
+            state.parentZone = parentZone;
+
+            mOpenList.push_back(neighbor.zoneID);
+            siftUp(mOpenList.size() - 1);
+         }
+
+         // Already on the open list -- see if this is a cheaper way to get there
+         else if(gCost < state.gCost)
+         {
+            state.fCost -= state.gCost - gCost;
+            state.gCost = gCost;
+            state.parentZone = parentZone;
+
+            siftUp(state.heapIndex);
+         }
+      }
    }
 
-   // Save the path if it exists
    if(!foundPath)
-   {      
-      TNLAssert(path.size() == 0, "Expected empty path!");
-      return path;
-   }
+      return false;
 
-   // Working backwards from the target to the starting location by checking
-   // each cell's parent, figure out the length of the path.
-   //
-   // Fortunately, we want our list to have the closest zone last (see getWaypoint),
-   // so it all works out nicely.
-   //
    // We'll store both the zone center and the gateway to the neighboring zone.  This
    // will help keep the robot from getting hung up on blocked but technically visible
    // paths, such as when we are trying to fly around a protruding wall stub.
 
    path.push_back(target);                               // First point is the actual target itself
    path.push_back(zones->get(targetZone)->getCenter());  // Second is the center of the target's zone
-      
-   S32 zone = targetZone;
+
+   U16 zone = targetZone;
 
    while(zone != startZone)
    {
-      path.push_back(findGateway(zones, parentZones[zone], zone));   // Don't switch findGateway arguments, some path is one way (teleporters).
-      zone = parentZones[zone];                                      // Find the parent of the current cell
+      U16 parentZone = mZoneStates[zone].parentZone;
+
+      path.push_back(findGateway(zones, parentZone, zone));   // Don't switch findGateway arguments, some path is one way (teleporters).
+      zone = parentZone;
       path.push_back(zones->get(zone)->getCenter());
    }
 
    path.push_back(zones->get(startZone)->getCenter());
-   return path;
+   return true;
+}
+
+
+// Lays the points out the way findPath() does: target, target zone's center, then gateways and centers back to the start
+void AStar::layOutPath(const Vector<BotNavMeshZone *> *zones, const Vector<U16> &route, const Point &target,
+                       Vector<Point> &path)
+{
+   path.clear();
+
+   path.push_back(target);
+   path.push_back(zones->get(route.last())->getCenter());
+
+   for(S32 i = route.size() - 1; i > 0; i--)
+   {
+      path.push_back(findGateway(zones, route[i - 1], route[i]));
+      path.push_back(zones->get(route[i - 1])->getCenter());
+   }
+
+   path.push_back(zones->get(route[0])->getCenter());
 }
 
 
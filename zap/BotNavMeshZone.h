@@ -35,7 +35,7 @@ public:
 
    Point borderCenter;     // Simply a point half way between borderStart and borderEnd
    Point center;           // Center of zone
-   F32 distTo;
+   F32 distTo;             // Length of the trip from this zone's center through borderCenter to the neighbor's center
 };
 
 
@@ -48,9 +48,11 @@ class BotNavMeshZone : public DatabaseObject
 {
    typedef GeomObject Parent;
 
+   friend class BotZoneCache;
+
 private:   
    U16 mZoneId;                              // Unique ID for each zone
-   bool mWalkable;                           // Flag for if this zone can currently be traversed
+   bool mWalkable;                           // False for zones under a Core, which are expensive to go through
 
    static void populateZoneList(GridDatabase *mBotZoneDatabase, Vector<BotNavMeshZone *> *allZones);  // Populates allZones
 
@@ -95,15 +97,49 @@ public:
 ////////////////////////////////////////
 ////////////////////////////////////////
 
+// Finds paths through the bot zones.  Each AStar has its own scratch space, grown to fit the biggest level it has
+// searched, so separate AStars can search at the same time from different threads.
 class AStar
 {
 private:
+   static const S32 Unvisited = -1;
+   static const S32 Closed = -2;
+
+   struct ZoneState
+   {
+      U32 generation;      // Everything else is left over from an earlier search unless this matches mGeneration
+      S32 heapIndex;       // Position in mOpenList, or Unvisited or Closed
+      F32 gCost;           // Cost of the cheapest way here found so far
+      F32 fCost;           // gCost plus our guess at the rest of the way
+      U16 parentZone;
+   };
+
+   Vector<ZoneState> mZoneStates;      // Indexed by zone ID
+   Vector<U16> mOpenList;              // Binary heap of zones, cheapest fCost first
+   U32 mGeneration;
+   U32 mExpandedCount;
+
+   ZoneState &getState(U16 zone);
+   void siftUp(S32 heapIndex);
+   void siftDown(S32 heapIndex);
+   U16 popOpenList();
+
    static F32 heuristic(const Vector<BotNavMeshZone *> *zones, S32 fromZone, S32 toZone);
-   static Point findGateway(const Vector<BotNavMeshZone *> *zones, S32 zone1, S32 zone2);
 
 public:
-   static Vector<Point> findPath (const Vector<BotNavMeshZone *> *zones, S32 startZone, S32 targetZone, const Point &target);
-   
+   AStar();    // Constructor
+
+   bool findPath(const Vector<BotNavMeshZone *> *zones, S32 startZone, S32 targetZone, const Point &target,
+                 Vector<Point> &path);
+
+   U32 getExpandedCount() const;       // Zones taken off the open list during the last search
+
+   static Point findGateway(const Vector<BotNavMeshZone *> *zones, S32 zone1, S32 zone2);
+   static F32 getTravelCost(const Vector<BotNavMeshZone *> *zones, S32 fromZone, const NeighboringZone &neighbor);
+
+   // Fills path with the points for flying through route, a list of neighboring zones from start to target
+   static void layOutPath(const Vector<BotNavMeshZone *> *zones, const Vector<U16> &route, const Point &target,
+                          Vector<Point> &path);
 };
 
 
@@ -0,0 +1,238 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "BotPathCache.h"
+
+#include "tnlAssert.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace Zap
+{
+
+// Constructor
+BotPathCache::BotPathCache()
+{
+   mZones = NULL;
+
+   mRouteHits = 0;
+   mFlowFieldHits = 0;
+   mSearches = 0;
+}
+
+
+void BotPathCache::reset(const Vector<BotNavMeshZone *> *zones)
+{
+   mZones = zones;
+
+   mEntrances.clear();
+   mEntrances.resize(zones->size());
+
+   for(S32 i = 0; i < zones->size(); i++)
+   {
+      const Vector<NeighboringZone> &neighbors = zones->get(i)->mNeighbors;
+
+      for(S32 j = 0; j < neighbors.size(); j++)
+         if(neighbors[j].zoneID < zones->size())
+            mEntrances[neighbors[j].zoneID].push_back(pair<U16, S32>(U16(i), j));
+   }
+
+   mSearchCount.resize(zones->size());
+   mFlowFieldIndex.resize(zones->size());
+   mCost.resize(zones->size());
+
+   invalidate();
+}
+
+
+void BotPathCache::invalidate()
+{
+   mRoutes.clear();
+   mFlowFields.clear();
+
+   // Portal costs are worked out ahead of time, so they go stale along with everything else
+   if(mZones)
+      mHierarchy.build(mZones);
+
+   for(S32 i = 0; i < mSearchCount.size(); i++)
+   {
+      mSearchCount[i] = 0;
+      mFlowFieldIndex[i] = -1;
+   }
+}
+
+
+const BotZoneHierarchy *BotPathCache::getHierarchy() const
+{
+   return &mHierarchy;
+}
+
+
+Vector<Point> BotPathCache::findPath(U16 startZone, U16 targetZone, const Point &target)
+{
+   TNLAssert(mZones, "Call reset() before looking for paths!");
+
+   if(mFlowFieldIndex[targetZone] >= 0)
+   {
+      mFlowFieldHits++;
+      return followFlowField(mFlowFields[mFlowFieldIndex[targetZone]], startZone, targetZone, target);
+   }
+
+   pair<U16, U16> routeIndex(startZone, targetZone);
+
+   map<pair<U16, U16>, Vector<Point> >::iterator it = mRoutes.find(routeIndex);
+
+   if(it != mRoutes.end())
+   {
+      mRouteHits++;
+      return it->second;
+   }
+
+   Vector<Point> &path = mRoutes[routeIndex];
+   if(mHierarchy.isLongDistance(startZone, targetZone))
+      mHierarchy.findPath(mHierarchySearch, startZone, targetZone, target, path);
+   else
+      mSearch.findPath(mZones, startZone, targetZone, target, path);
+
+   countSearch(targetZone);
+
+   return path;
+}
+
+
+bool BotPathCache::hasPath(U16 startZone, U16 targetZone) const
+{
+   return mFlowFieldIndex[targetZone] >= 0 || mRoutes.find(pair<U16, U16>(startZone, targetZone)) != mRoutes.end();
+}
+
+
+// For paths found somewhere else, such as by a PathRequestBatch
+void BotPathCache::addPath(U16 startZone, U16 targetZone, const Vector<Point> &path)
+{
+   mRoutes[pair<U16, U16>(startZone, targetZone)] = path;
+   countSearch(targetZone);
+}
+
+
+void BotPathCache::countSearch(U16 targetZone)
+{
+   mSearches++;
+
+   // Enough bots are heading this way that it's cheaper to figure out the way there from everywhere at once
+   mSearchCount[targetZone]++;
+   if(mSearchCount[targetZone] >= FlowFieldThreshold && mFlowFields.size() < MaxFlowFields)
+      buildFlowField(targetZone);
+}
+
+
+// Dijkstra outward from the target, using the same crossing costs as AStar
+void BotPathCache::buildFlowField(U16 targetZone)
+{
+   Vector<U16> flowField;
+   flowField.resize(mZones->size());
+
+   for(S32 i = 0; i < mZones->size(); i++)
+   {
+      flowField[i] = U16_MAX;
+      mCost[i] = F32_MAX;
+   }
+
+   flowField[targetZone] = targetZone;
+   mCost[targetZone] = 0;
+
+   greater<pair<F32, U16> > lowestFirst;
+
+   mOpenList.clear();
+   mOpenList.push_back(pair<F32, U16>(0, targetZone));
+
+   while(!mOpenList.empty())
+   {
+      pop_heap(mOpenList.begin(), mOpenList.end(), lowestFirst);
+      pair<F32, U16> open = mOpenList.back();
+      mOpenList.pop_back();
+
+      U16 zone = open.second;
+
+      if(open.first > mCost[zone])     // Already reached some cheaper way
+         continue;
+
+      for(S32 i = 0; i < mEntrances[zone].size(); i++)
+      {
+         U16 fromZone = mEntrances[zone][i].first;
+         const NeighboringZone &neighbor = mZones->get(fromZone)->mNeighbors[mEntrances[zone][i].second];
+
+         F32 cost = open.first + AStar::getTravelCost(mZones, fromZone, neighbor);
+
+         if(cost < mCost[fromZone])
+         {
+            mCost[fromZone] = cost;
+            flowField[fromZone] = zone;
+
+            mOpenList.push_back(pair<F32, U16>(cost, fromZone));
+            push_heap(mOpenList.begin(), mOpenList.end(), lowestFirst);
+         }
+      }
+   }
+
+   mFlowFieldIndex[targetZone] = mFlowFields.size();
+   mFlowFields.push_back(flowField);
+}
+
+
+Vector<Point> BotPathCache::followFlowField(const Vector<U16> &flowField, U16 startZone, U16 targetZone,
+                                            const Point &target) const
+{
+   Vector<Point> path;
+
+   if(flowField[startZone] == U16_MAX)
+      return path;
+
+   Vector<U16> route;
+   route.push_back(startZone);
+
+   while(route.last() != targetZone)
+      route.push_back(flowField[route.last()]);
+
+   AStar::layOutPath(mZones, route, target, path);
+
+   return path;
+}
+
+
+U16 BotPathCache::getNextZone(U16 fromZone, U16 targetZone) const
+{
+   if(mFlowFieldIndex[targetZone] < 0)
+      return U16_MAX;
+
+   return mFlowFields[mFlowFieldIndex[targetZone]][fromZone];
+}
+
+
+bool BotPathCache::hasFlowField(U16 targetZone) const
+{
+   return targetZone < mFlowFieldIndex.size() && mFlowFieldIndex[targetZone] >= 0;
+}
+
+
+U32 BotPathCache::getRouteHits() const
+{
+   return mRouteHits;
+}
+
+
+U32 BotPathCache::getFlowFieldHits() const
+{
+   return mFlowFieldHits;
+}
+
+
+U32 BotPathCache::getSearches() const
+{
+   return mSearches;
+}
+
+
+};
@@ -0,0 +1,84 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _BOT_PATH_CACHE_H_
+#define _BOT_PATH_CACHE_H_
+
+#include "BotNavMeshZone.h"     // For AStar
+#include "BotZoneHierarchy.h"
+
+#include "tnlVector.h"
+
+#include <map>
+#include <vector>
+
+using namespace TNL;
+using namespace std;
+
+namespace Zap
+{
+
+// Paths between bot zones, shared by all the robots in a level.  Routes are remembered by (start zone, target
+// zone); once enough searches head for the same target zone, a flow field is built for it so every zone knows
+// its next step toward that target without searching at all.  Anything that changes what zones cost to cross
+// needs to call invalidate().  On big levels, searches between distant zones go through a BotZoneHierarchy.
+class BotPathCache
+{
+public:
+   static const U32 FlowFieldThreshold = 4;     // Searches toward a target zone before it gets a flow field
+   static const S32 MaxFlowFields = 16;
+
+private:
+   const Vector<BotNavMeshZone *> *mZones;
+
+   AStar mSearch;
+   BotZoneHierarchy mHierarchy;                 // Only built for big levels
+   BotZoneHierarchy::Search mHierarchySearch;
+   map<pair<U16, U16>, Vector<Point> > mRoutes;
+
+   Vector<U32> mSearchCount;                    // Searches toward each zone since the last invalidate()
+   Vector<S32> mFlowFieldIndex;                 // Index into mFlowFields for each target zone, -1 if there is none
+   Vector<Vector<U16> > mFlowFields;            // Next zone toward the target for every zone, U16_MAX if unreachable
+
+   // Flow fields are built backwards from the target, so we need to know where each zone can be entered from
+   Vector<Vector<pair<U16, S32> > > mEntrances;   // (zone, index into its mNeighbors) for each zone's way in
+
+   Vector<F32> mCost;                           // Scratch space for buildFlowField()
+   std::vector<pair<F32, U16> > mOpenList;
+
+   U32 mRouteHits;
+   U32 mFlowFieldHits;
+   U32 mSearches;
+
+   void countSearch(U16 targetZone);
+   void buildFlowField(U16 targetZone);
+   Vector<Point> followFlowField(const Vector<U16> &flowField, U16 startZone, U16 targetZone, const Point &target) const;
+
+public:
+   BotPathCache();      // Constructor
+
+   void reset(const Vector<BotNavMeshZone *> *zones);    // Call when zones have been rebuilt
+   void invalidate();                                    // Call when crossing costs have changed
+
+   const BotZoneHierarchy *getHierarchy() const;
+
+   // Same layout as AStar::findPath(): target first, nearest point last; empty if there is no path
+   Vector<Point> findPath(U16 startZone, U16 targetZone, const Point &target);
+
+   bool hasPath(U16 startZone, U16 targetZone) const;    // True if findPath() wouldn't need to search
+   void addPath(U16 startZone, U16 targetZone, const Vector<Point> &path);
+
+   U16 getNextZone(U16 fromZone, U16 targetZone) const;  // U16_MAX if unknown without searching
+   bool hasFlowField(U16 targetZone) const;
+
+   U32 getRouteHits() const;
+   U32 getFlowFieldHits() const;
+   U32 getSearches() const;
+};
+
+
+};
+
+#endif
@@ -0,0 +1,379 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "BotZoneCache.h"
+
+#include "GameSettings.h"
+#include "LevelSource.h"
+#include "ServerGame.h"
+#include "gameType.h"
+#include "stringUtils.h"
+
+#include "tnlLog.h"
+#include "tnlPlatform.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace Zap
+{
+
+// File layout, all little-endian:
+//
+//    "BFZN", U32 version, U8 hash length, hash, U32 zone count, then for each zone:
+//       U8 walkable, U16 vertex count, vertices (F32 x, F32 y), U16 neighbor count, then for each neighbor:
+//          U16 zone, borderStart, borderEnd, borderCenter, center (F32 x, F32 y each), F32 distTo
+
+static const char Magic[4] = { 'B', 'F', 'Z', 'N' };
+
+
+static void writeU8(Vector<U8> &data, U8 val)
+{
+   data.push_back(val);
+}
+
+
+static void writeU16(Vector<U8> &data, U16 val)
+{
+   data.push_back(U8(val));
+   data.push_back(U8(val >> 8));
+}
+
+
+static void writeU32(Vector<U8> &data, U32 val)
+{
+   for(S32 i = 0; i < 4; i++)
+      data.push_back(U8(val >> (i * 8)));
+}
+
+
+static void writePoint(Vector<U8> &data, const Point &point)
+{
+   U32 bits[2];
+   memcpy(&bits[0], &point.x, sizeof(U32));
+   memcpy(&bits[1], &point.y, sizeof(U32));
+
+   writeU32(data, bits[0]);
+   writeU32(data, bits[1]);
+}
+
+
+// Reads values off the front of a buffer, and notices if it runs out
+class CacheReader
+{
+private:
+   const Vector<U8> &mData;
+   S32 mPos;
+   bool mOk;
+
+   bool has(S32 bytes)
+   {
+      if(mPos + bytes > mData.size())
+         mOk = false;
+
+      return mOk;
+   }
+
+public:
+   explicit CacheReader(const Vector<U8> &data) : mData(data)     // Constructor
+   {
+      mPos = 0;
+      mOk = true;
+   }
+
+   bool isOk() const  { return mOk; }
+   bool isDone() const { return mPos == mData.size(); }
+
+   U8 readU8()
+   {
+      return has(1) ? mData[mPos++] : 0;
+   }
+
+   U16 readU16()
+   {
+      if(!has(2))
+         return 0;
+
+      U16 val = U16(mData[mPos] | (mData[mPos + 1] << 8));
+      mPos += 2;
+      return val;
+   }
+
+   U32 readU32()
+   {
+      if(!has(4))
+         return 0;
+
+      U32 val = 0;
+      for(S32 i = 0; i < 4; i++)
+         val |= U32(mData[mPos + i]) << (i * 8);
+
+      mPos += 4;
+      return val;
+   }
+
+   F32 readF32()
+   {
+      U32 bits = readU32();
+      F32 val;
+      memcpy(&val, &bits, sizeof(val));
+      return val;
+   }
+
+   Point readPoint()
+   {
+      F32 x = readF32();
+      F32 y = readF32();
+      return Point(x, y);
+   }
+
+   string readString(S32 length)
+   {
+      if(!has(length))
+         return "";
+
+      string val((const char *)&mData[mPos], length);
+      mPos += length;
+      return val;
+   }
+};
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+string BotZoneCache::getFileName(const string &dir, const string &levelHash)
+{
+   return joindir(dir, levelHash + ".zones");
+}
+
+
+bool BotZoneCache::write(const string &fileName, const string &levelHash, const Vector<BotNavMeshZone *> *allZones)
+{
+   Vector<U8> data;
+
+   for(S32 i = 0; i < 4; i++)
+      writeU8(data, U8(Magic[i]));
+
+   writeU32(data, FormatVersion);
+
+   writeU8(data, U8(levelHash.length()));
+   for(U32 i = 0; i < levelHash.length(); i++)
+      writeU8(data, U8(levelHash[i]));
+
+   writeU32(data, allZones->size());
+
+   for(S32 i = 0; i < allZones->size(); i++)
+   {
+      BotNavMeshZone *zone = allZones->get(i);
+      const Vector<Point> *outline = zone->getOutline();
+
+      writeU8(data, zone->getWalkable() ? 1 : 0);
+
+      writeU16(data, U16(outline->size()));
+      for(S32 j = 0; j < outline->size(); j++)
+         writePoint(data, outline->get(j));
+
+      writeU16(data, U16(zone->mNeighbors.size()));
+      for(S32 j = 0; j < zone->mNeighbors.size(); j++)
+      {
+         const NeighboringZone &neighbor = zone->mNeighbors[j];
+
+         writeU16(data, neighbor.zoneID);
+         writePoint(data, neighbor.borderStart);
+         writePoint(data, neighbor.borderEnd);
+         writePoint(data, neighbor.borderCenter);
+         writePoint(data, neighbor.center);
+
+         U32 bits;
+         memcpy(&bits, &neighbor.distTo, sizeof(bits));
+         writeU32(data, bits);
+      }
+   }
+
+   // Write to a temp file first, so a half-written file never gets picked up by some other server
+   string tempName = fileName + ".tmp";
+
+   FILE *file = fopen(tempName.c_str(), "wb");
+   if(!file)
+   {
+      logprintf(LogConsumer::LogWarning, "Could not save bot zones to %s", fileName.c_str());
+      return false;
+   }
+
+   bool ok = fwrite(data.address(), 1, data.size(), file) == U32(data.size());
+   ok = (fclose(file) == 0) && ok;
+
+   if(ok)
+   {
+      remove(fileName.c_str());     // rename() won't replace an existing file on Windows
+      ok = rename(tempName.c_str(), fileName.c_str()) == 0;
+   }
+
+   if(!ok)
+   {
+      remove(tempName.c_str());
+      logprintf(LogConsumer::LogWarning, "Could not save bot zones to %s", fileName.c_str());
+   }
+
+   return ok;
+}
+
+
+bool BotZoneCache::read(const string &fileName, const string &levelHash, GridDatabase *botZoneDatabase,
+                        Vector<BotNavMeshZone *> *allZones, bool triangulateZones)
+{
+   // Clearing allZones clears the botZoneDatabase too, as the zones remove themselves from it
+   allZones->deleteAndClear();
+
+   FILE *file = fopen(fileName.c_str(), "rb");
+   if(!file)
+      return false;
+
+   Vector<U8> data;
+   U8 buffer[4096];
+
+   for(size_t bytes; (bytes = fread(buffer, 1, sizeof(buffer), file)) > 0; )
+      for(size_t i = 0; i < bytes; i++)
+         data.push_back(buffer[i]);
+
+   fclose(file);
+
+   CacheReader reader(data);
+
+   bool ok = reader.readString(4) == string(Magic, 4) && reader.readU32() == FormatVersion;
+   ok = ok && reader.readString(reader.readU8()) == levelHash;
+
+   U32 zoneCount = ok ? reader.readU32() : 0;
+   ok = ok && zoneCount > 0 && zoneCount < U16_MAX;
+
+   for(U32 i = 0; ok && i < zoneCount; i++)
+   {
+      BotNavMeshZone *zone = new BotNavMeshZone(i);
+
+      if(!triangulateZones)
+         zone->disableTriangulation();
+
+      zone->setWalkable(reader.readU8() != 0);
+
+      U16 vertCount = reader.readU16();
+      for(U16 j = 0; j < vertCount; j++)
+         zone->addVert(reader.readPoint(), true);
+
+      U16 neighborCount = reader.readU16();
+      zone->mNeighbors.resize(neighborCount);
+
+      for(U16 j = 0; j < neighborCount; j++)
+      {
+         NeighboringZone &neighbor = zone->mNeighbors[j];
+
+         neighbor.zoneID       = reader.readU16();
+         neighbor.borderStart  = reader.readPoint();
+         neighbor.borderEnd    = reader.readPoint();
+         neighbor.borderCenter = reader.readPoint();
+         neighbor.center       = reader.readPoint();
+         neighbor.distTo       = reader.readF32();
+
+         ok = ok && neighbor.zoneID < zoneCount;
+      }
+
+      ok = ok && reader.isOk() && vertCount >= 3;
+
+      if(ok)
+         zone->addToZoneDatabase(botZoneDatabase);
+      else
+         delete zone;
+   }
+
+   BotNavMeshZone::populateZoneList(botZoneDatabase, allZones);
+
+   ok = ok && reader.isDone() && allZones->size() == S32(zoneCount);
+
+   if(!ok)
+   {
+      logprintf(LogConsumer::LogWarning, "Ignoring damaged or outdated bot zone file %s", fileName.c_str());
+      allZones->deleteAndClear();
+   }
+
+   return ok;
+}
+
+
+extern bool writeToConsole();
+
+S32 BotZoneCache::bakeLevels(GameSettings *settings, const string &levelDir, const string &cacheDir)
+{
+   writeToConsole();
+
+   // Global levelgens run on every level, and can add anything they like
+   if(settings->getIniSettings()->globalLevelScript != "")
+   {
+      printf("Levels have a global levelgen script; their bot zones can't be saved ahead of time\n");
+      return 0;
+   }
+
+   if(!makeSureFolderExists(cacheDir))
+   {
+      printf("Could not create bot zone folder %s\n", cacheDir.c_str());
+      return 0;
+   }
+
+   const string extensions[] = { "level" };
+   Vector<string> levels;
+   getFilesFromFolder(levelDir, levels, extensions, ARRAYSIZE(extensions));
+
+   // The games below borrow our settings -- they mustn't delete them, along with the FolderManager all settings share
+   GameSettingsPtr gameSettings(settings, [](GameSettings *) { });
+
+   S32 baked = 0;
+
+   for(S32 i = 0; i < levels.size(); i++)
+   {
+      string levelFile = joindir(levelDir, levels[i]);
+      string hash = Game::md5.getHashFromFile(levelFile);
+      string fileName = getFileName(cacheDir, hash);
+
+      if(fileExists(fileName))
+      {
+         printf("%-30s already done\n", levels[i].c_str());
+         continue;
+      }
+
+      ServerGame *game = new ServerGame(Address(), gameSettings, LevelSourcePtr(new StringLevelSource("")), false, false);
+      game->loadLevelFromString(readFile(levelFile), game->getGameObjDatabase(), levelFile);
+
+      // Levelgens can add walls and such while the level is loading, so their zones aren't the same every time
+      if(game->getGameType() && game->getGameType()->getScriptName() != "")
+      {
+         printf("%-30s skipped (has a levelgen)\n", levels[i].c_str());
+         delete game;
+         continue;
+      }
+
+      game->computeWorldObjectExtents();
+
+      Vector<BotNavMeshZone *> zones;
+      U32 start = Platform::getRealMilliseconds();
+
+      if(BotNavMeshZone::buildBotMeshZones(game->getBotZoneDatabase(), game->getGameObjDatabase(), &zones,
+                                           game->getWorldExtents(), false) && write(fileName, hash, &zones))
+      {
+         printf("%-30s %5d zones in %u ms\n", levels[i].c_str(), zones.size(), Platform::getRealMilliseconds() - start);
+         baked++;
+      }
+      else
+         printf("%-30s failed\n", levels[i].c_str());
+
+      zones.deleteAndClear();
+      delete game;
+   }
+
+   printf("Saved bot zones for %d of %d levels to %s\n", baked, levels.size(), cacheDir.c_str());
+
+   return baked;
+}
+
+
+};
@@ -0,0 +1,46 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _BOT_ZONE_CACHE_H_
+#define _BOT_ZONE_CACHE_H_
+
+#include "BotNavMeshZone.h"
+
+#include "tnlVector.h"
+
+#include <string>
+
+using namespace TNL;
+using namespace std;
+
+namespace Zap
+{
+
+class GameSettings;
+
+// Saves the bot zones built for a level, and their neighbor tables, to a small binary file named after the level's
+// hash, so the next time the same level loads its zones can be read back instead of built all over again.  Files
+// with the wrong version or hash, or that are damaged, are ignored, and the zones get built as usual.
+class BotZoneCache
+{
+public:
+   static const U32 FormatVersion = 1;       // Bump when the file layout, or the way zones are built, changes
+
+   static string getFileName(const string &dir, const string &levelHash);
+
+   static bool write(const string &fileName, const string &levelHash, const Vector<BotNavMeshZone *> *allZones);
+
+   // Replaces whatever is in botZoneDatabase and allZones; leaves them both empty if fileName can't be used
+   static bool read(const string &fileName, const string &levelHash, GridDatabase *botZoneDatabase,
+                    Vector<BotNavMeshZone *> *allZones, bool triangulateZones);
+
+   // Builds and saves zones for every level in levelDir that doesn't have them yet; returns how many were saved
+   static S32 bakeLevels(GameSettings *settings, const string &levelDir, const string &cacheDir);
+};
+
+
+};
+
+#endif
@@ -0,0 +1,496 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "BotZoneHierarchy.h"
+
+#include "MathUtils.h"
+#include "Rect.h"
+
+#include <algorithm>
+#include <functional>
+#include <math.h>
+
+namespace Zap
+{
+
+// Constructor
+BotZoneHierarchy::Search::Search()
+{
+   mZoneGeneration = 0;
+   mNodeGeneration = 0;
+   mExpandedCount = 0;
+}
+
+
+// New entries come in zeroed, so with a stamp that's never current
+void BotZoneHierarchy::Search::fit(S32 zoneCount, S32 nodeCount)
+{
+   if(mZoneStamp.size() < zoneCount)
+   {
+      mZoneStamp.resize(zoneCount);
+      mZoneCost.resize(zoneCount);
+      mZoneParent.resize(zoneCount);
+   }
+
+   if(mNodeStamp.size() < nodeCount)
+   {
+      mNodeStamp.resize(nodeCount);
+      mNodeCost.resize(nodeCount);
+      mNodeParent.resize(nodeCount);
+      mNodeTargetStamp.resize(nodeCount);
+      mNodeTargetCost.resize(nodeCount);
+   }
+}
+
+
+void BotZoneHierarchy::Search::nextZoneGeneration()
+{
+   mZoneGeneration++;
+
+   if(mZoneGeneration == 0)
+   {
+      for(S32 i = 0; i < mZoneStamp.size(); i++)
+         mZoneStamp[i] = 0;
+      mZoneGeneration = 1;
+   }
+}
+
+
+void BotZoneHierarchy::Search::nextNodeGeneration()
+{
+   mNodeGeneration++;
+
+   if(mNodeGeneration == 0)
+   {
+      for(S32 i = 0; i < mNodeStamp.size(); i++)
+      {
+         mNodeStamp[i] = 0;
+         mNodeTargetStamp[i] = 0;
+      }
+      mNodeGeneration = 1;
+   }
+}
+
+
+bool BotZoneHierarchy::Search::isReached(U16 zone) const
+{
+   return mZoneStamp[zone] == mZoneGeneration;
+}
+
+
+U32 BotZoneHierarchy::Search::getExpandedCount() const
+{
+   return mExpandedCount;
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+// Constructor
+BotZoneHierarchy::BotZoneHierarchy()
+{
+   mZones = NULL;
+   mBuilt = false;
+}
+
+
+void BotZoneHierarchy::clear()
+{
+   mBuilt = false;
+
+   mZoneCluster.clear();
+   mZoneNode.clear();
+   mNodeZone.clear();
+   mNodeEdges.clear();
+   mClusterNodes.clear();
+   mEntrances.clear();
+}
+
+
+void BotZoneHierarchy::build(const Vector<BotNavMeshZone *> *zones)
+{
+   clear();
+
+   mZones = zones;
+
+   S32 zoneCount = zones->size();
+
+   if(zoneCount < MinZones)
+      return;
+
+   // Lay a grid over the zones, with about ZonesPerCluster zones in each square
+   Rect extents(zones->get(0)->getCenter(), zones->get(0)->getCenter());
+   for(S32 i = 1; i < zoneCount; i++)
+      extents.unionPoint(zones->get(i)->getCenter());
+
+   F32 width  = MAX(extents.getWidth(), 1.0f);
+   F32 height = MAX(extents.getHeight(), 1.0f);
+
+   S32 clusterCount = zoneCount / ZonesPerCluster;
+   S32 columns = MAX(1, S32(ceil(sqrt(clusterCount * width / height))));
+   S32 rows    = MAX(1, S32(ceil(F32(clusterCount) / columns)));
+
+   mZoneCluster.resize(zoneCount);
+   for(S32 i = 0; i < zoneCount; i++)
+   {
+      Point center = zones->get(i)->getCenter();
+
+      S32 column = MIN(columns - 1, S32((center.x - extents.min.x) * columns / width));
+      S32 row    = MIN(rows - 1,    S32((center.y - extents.min.y) * rows / height));
+
+      mZoneCluster[i] = row * columns + column;
+   }
+
+   mClusterNodes.resize(rows * columns);
+   mEntrances.resize(zoneCount);
+   mZoneNode.resize(zoneCount);
+
+   for(S32 i = 0; i < zoneCount; i++)
+      mZoneNode[i] = -1;
+
+   // Any zone with a way into or out of another cluster is a portal
+   for(S32 i = 0; i < zoneCount; i++)
+   {
+      const Vector<NeighboringZone> &neighbors = zones->get(i)->mNeighbors;
+
+      for(S32 j = 0; j < neighbors.size(); j++)
+      {
+         U16 zone = neighbors[j].zoneID;
+
+         mEntrances[zone].push_back(pair<U16, S32>(U16(i), j));
+
+         if(mZoneCluster[zone] == mZoneCluster[i])
+            continue;
+
+         U16 ends[2] = { U16(i), zone };
+
+         for(S32 k = 0; k < 2; k++)
+            if(mZoneNode[ends[k]] < 0)
+            {
+               mZoneNode[ends[k]] = mNodeZone.size();
+               mClusterNodes[mZoneCluster[ends[k]]].push_back(mNodeZone.size());
+               mNodeZone.push_back(ends[k]);
+            }
+      }
+   }
+
+   mNodeEdges.resize(mNodeZone.size());
+
+   // Portals in different clusters are joined where their zones touch...
+   for(S32 i = 0; i < mNodeZone.size(); i++)
+   {
+      U16 zone = mNodeZone[i];
+      const Vector<NeighboringZone> &neighbors = zones->get(zone)->mNeighbors;
+
+      for(S32 j = 0; j < neighbors.size(); j++)
+         if(mZoneCluster[neighbors[j].zoneID] != mZoneCluster[zone])
+         {
+            Edge edge;
+            edge.node = mZoneNode[neighbors[j].zoneID];
+            edge.cost = AStar::getTravelCost(zones, zone, neighbors[j]);
+
+            mNodeEdges[i].push_back(edge);
+         }
+   }
+
+   // ...and portals in the same cluster by the cheapest way between them that stays inside it
+   Search search;
+   search.fit(zoneCount, mNodeZone.size());
+
+   for(S32 i = 0; i < mClusterNodes.size(); i++)
+   {
+      const Vector<S32> &nodes = mClusterNodes[i];
+
+      for(S32 j = 0; j < nodes.size(); j++)
+      {
+         searchCluster(search, mNodeZone[nodes[j]], U16_MAX, false);
+
+         for(S32 k = 0; k < nodes.size(); k++)
+            if(k != j && search.isReached(mNodeZone[nodes[k]]))
+            {
+               Edge edge;
+               edge.node = nodes[k];
+               edge.cost = search.mZoneCost[mNodeZone[nodes[k]]];
+
+               mNodeEdges[nodes[j]].push_back(edge);
+            }
+      }
+   }
+
+   mBuilt = true;
+}
+
+
+void BotZoneHierarchy::searchCluster(Search &search, U16 zone, U16 stopZone, bool reverse) const
+{
+   search.nextZoneGeneration();
+
+   S32 cluster = mZoneCluster[zone];
+   greater<pair<F32, U16> > lowestFirst;
+
+   search.mZoneStamp[zone] = search.mZoneGeneration;
+   search.mZoneCost[zone] = 0;
+   search.mZoneParent[zone] = zone;
+
+   search.mZoneOpenList.clear();
+   search.mZoneOpenList.push_back(pair<F32, U16>(0, zone));
+
+   while(!search.mZoneOpenList.empty())
+   {
+      pop_heap(search.mZoneOpenList.begin(), search.mZoneOpenList.end(), lowestFirst);
+      pair<F32, U16> open = search.mZoneOpenList.back();
+      search.mZoneOpenList.pop_back();
+
+      U16 current = open.second;
+
+      if(open.first > search.mZoneCost[current])      // Already reached some cheaper way
+         continue;
+
+      search.mExpandedCount++;
+
+      if(current == stopZone)
+         break;
+
+      S32 count = reverse ? mEntrances[current].size() : mZones->get(current)->mNeighbors.size();
+
+      for(S32 i = 0; i < count; i++)
+      {
+         U16 next;
+         F32 cost;
+
+         if(reverse)
+         {
+            next = mEntrances[current][i].first;
+            cost = open.first + AStar::getTravelCost(mZones, next, mZones->get(next)->mNeighbors[mEntrances[current][i].second]);
+         }
+         else
+         {
+            const NeighboringZone &neighbor = mZones->get(current)->mNeighbors[i];
+            next = neighbor.zoneID;
+            cost = open.first + AStar::getTravelCost(mZones, current, neighbor);
+         }
+
+         if(mZoneCluster[next] != cluster)
+            continue;
+
+         if(!search.isReached(next) || cost < search.mZoneCost[next])
+         {
+            search.mZoneStamp[next] = search.mZoneGeneration;
+            search.mZoneCost[next] = cost;
+            search.mZoneParent[next] = current;
+
+            search.mZoneOpenList.push_back(pair<F32, U16>(cost, next));
+            push_heap(search.mZoneOpenList.begin(), search.mZoneOpenList.end(), lowestFirst);
+         }
+      }
+   }
+}
+
+
+bool BotZoneHierarchy::refine(Search &search, U16 fromZone, U16 toZone) const
+{
+   searchCluster(search, fromZone, toZone, false);
+
+   if(!search.isReached(toZone))
+      return false;
+
+   search.mLocalRoute.clear();
+   for(U16 zone = toZone; zone != fromZone; zone = search.mZoneParent[zone])
+      search.mLocalRoute.push_back(zone);
+
+   for(S32 i = search.mLocalRoute.size() - 1; i >= 0; i--)
+      search.mRoute.push_back(search.mLocalRoute[i]);
+
+   return true;
+}
+
+
+bool BotZoneHierarchy::findPath(Search &search, U16 startZone, U16 targetZone, const Point &target,
+                                Vector<Point> &path) const
+{
+   TNLAssert(mBuilt, "Nothing to search!");
+
+   path.clear();
+
+   S32 nodeCount = mNodeZone.size();
+   S32 startNode = nodeCount;          // The start and target get nodes of their own while we search
+   S32 targetNode = nodeCount + 1;
+
+   search.fit(mZones->size(), nodeCount + 2);
+   search.nextNodeGeneration();
+   search.mExpandedCount = 0;
+
+   U32 generation = search.mNodeGeneration;
+   S32 startCluster = mZoneCluster[startZone];
+   S32 targetCluster = mZoneCluster[targetZone];
+   Point targetCenter = mZones->get(targetZone)->getCenter();
+
+   greater<pair<F32, S32> > lowestFirst;
+   search.mNodeOpenList.clear();
+
+   // Start off from every portal we can reach without leaving the start's cluster -- or go straight to the target
+   searchCluster(search, startZone, U16_MAX, false);
+
+   const Vector<S32> &startNodes = mClusterNodes[startCluster];
+   for(S32 i = 0; i < startNodes.size() + 1; i++)
+   {
+      S32 node;
+      U16 zone;
+
+      if(i < startNodes.size())
+      {
+         node = startNodes[i];
+         zone = mNodeZone[node];
+      }
+      else if(startCluster == targetCluster)
+      {
+         node = targetNode;
+         zone = targetZone;
+      }
+      else
+         break;
+
+      if(!search.isReached(zone))
+         continue;
+
+      F32 cost = search.mZoneCost[zone];
+
+      search.mNodeStamp[node] = generation;
+      search.mNodeCost[node] = cost;
+      search.mNodeParent[node] = startNode;
+
+      search.mNodeOpenList.push_back(pair<F32, S32>(cost + mZones->get(zone)->getCenter().distanceTo(targetCenter), node));
+      push_heap(search.mNodeOpenList.begin(), search.mNodeOpenList.end(), lowestFirst);
+   }
+
+   // The last leg goes from a portal in the target's cluster
+   searchCluster(search, targetZone, U16_MAX, true);
+
+   const Vector<S32> &targetNodes = mClusterNodes[targetCluster];
+   for(S32 i = 0; i < targetNodes.size(); i++)
+   {
+      U16 zone = mNodeZone[targetNodes[i]];
+
+      if(search.isReached(zone))
+      {
+         search.mNodeTargetStamp[targetNodes[i]] = generation;
+         search.mNodeTargetCost[targetNodes[i]] = search.mZoneCost[zone];
+      }
+   }
+
+   // Now the portals themselves
+   bool found = false;
+
+   while(!search.mNodeOpenList.empty())
+   {
+      pop_heap(search.mNodeOpenList.begin(), search.mNodeOpenList.end(), lowestFirst);
+      pair<F32, S32> open = search.mNodeOpenList.back();
+      search.mNodeOpenList.pop_back();
+
+      S32 node = open.second;
+      F32 heuristic = (node == targetNode) ? 0 : mZones->get(mNodeZone[node])->getCenter().distanceTo(targetCenter);
+
+      if(open.first > search.mNodeCost[node] + heuristic)      // Already reached some cheaper way
+         continue;
+
+      search.mExpandedCount++;
+
+      if(node == targetNode)
+      {
+         found = true;
+         break;
+      }
+
+      S32 edgeCount = mNodeEdges[node].size();
+      bool nearTarget = search.mNodeTargetStamp[node] == generation;
+
+      for(S32 i = 0; i < edgeCount + (nearTarget ? 1 : 0); i++)
+      {
+         S32 next;
+         F32 cost;
+
+         if(i < edgeCount)
+         {
+            next = mNodeEdges[node][i].node;
+            cost = search.mNodeCost[node] + mNodeEdges[node][i].cost;
+         }
+         else
+         {
+            next = targetNode;
+            cost = search.mNodeCost[node] + search.mNodeTargetCost[node];
+         }
+
+         if(search.mNodeStamp[next] == generation && cost >= search.mNodeCost[next])
+            continue;
+
+         search.mNodeStamp[next] = generation;
+         search.mNodeCost[next] = cost;
+         search.mNodeParent[next] = node;
+
+         F32 nextHeuristic = (next == targetNode) ? 0 : mZones->get(mNodeZone[next])->getCenter().distanceTo(targetCenter);
+
+         search.mNodeOpenList.push_back(pair<F32, S32>(cost + nextHeuristic, next));
+         push_heap(search.mNodeOpenList.begin(), search.mNodeOpenList.end(), lowestFirst);
+      }
+   }
+
+   if(!found)
+      return false;
+
+   search.mNodeRoute.clear();
+   for(S32 node = targetNode; node != startNode; node = search.mNodeParent[node])
+      search.mNodeRoute.push_back(node);
+
+   // Fill in the zones between portals; neighboring portals in different clusters are already next to each other
+   search.mRoute.clear();
+   search.mRoute.push_back(startZone);
+
+   for(S32 i = search.mNodeRoute.size() - 1; i >= 0; i--)
+   {
+      S32 node = search.mNodeRoute[i];
+      U16 fromZone = search.mRoute.last();
+      U16 toZone = (node == targetNode) ? targetZone : mNodeZone[node];
+
+      if(toZone == fromZone)
+         continue;
+
+      if(mZoneCluster[toZone] != mZoneCluster[fromZone])
+         search.mRoute.push_back(toZone);
+      else if(!refine(search, fromZone, toZone))
+         return false;
+   }
+
+   AStar::layOutPath(mZones, search.mRoute, target, path);
+
+   return true;
+}
+
+
+bool BotZoneHierarchy::isBuilt() const
+{
+   return mBuilt;
+}
+
+
+bool BotZoneHierarchy::isLongDistance(U16 startZone, U16 targetZone) const
+{
+   return mBuilt && mZoneCluster[startZone] != mZoneCluster[targetZone];
+}
+
+
+S32 BotZoneHierarchy::getClusterCount() const
+{
+   return mClusterNodes.size();
+}
+
+
+S32 BotZoneHierarchy::getNodeCount() const
+{
+   return mNodeZone.size();
+}
+
+
+};
@@ -0,0 +1,114 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _BOT_ZONE_HIERARCHY_H_
+#define _BOT_ZONE_HIERARCHY_H_
+
+#include "BotNavMeshZone.h"
+
+#include "tnlVector.h"
+
+#include <vector>
+
+using namespace TNL;
+using namespace std;
+
+namespace Zap
+{
+
+// A coarse graph laid over the bot zones of a big level, so paths across the map don't have to look at every zone
+// on the way.  Zones are grouped into clusters on a grid; zones with a neighbor in another cluster (teleporters
+// included) are portals, and the cheapest way between each pair of portals in a cluster is worked out ahead of time.
+// A search connects its start and target zones to the portals of their clusters, searches the portals, then fills
+// in the zones between consecutive portals with small searches that stay inside one cluster.  Since every zone on a
+// cluster border is a portal, paths cost the same as a direct search's, though ties may be broken differently.
+class BotZoneHierarchy
+{
+public:
+   static const S32 MinZones = 500;             // Levels with fewer zones are quick enough to search directly
+   static const S32 ZonesPerCluster = 32;
+
+   // Scratch space for findPath(); searches at the same time need their own
+   class Search
+   {
+      friend class BotZoneHierarchy;
+
+   private:
+      U32 mZoneGeneration;
+      U32 mNodeGeneration;
+      U32 mExpandedCount;
+
+      Vector<U32> mZoneStamp;                   // mZoneCost and mZoneParent are stale unless this matches mZoneGeneration
+      Vector<F32> mZoneCost;
+      Vector<U16> mZoneParent;
+      std::vector<pair<F32, U16> > mZoneOpenList;
+
+      Vector<U32> mNodeStamp;                   // Same idea for the portal nodes, with mNodeGeneration
+      Vector<F32> mNodeCost;
+      Vector<S32> mNodeParent;
+      Vector<U32> mNodeTargetStamp;
+      Vector<F32> mNodeTargetCost;              // Cost from the node to the target, if it's in the target's cluster
+      std::vector<pair<F32, S32> > mNodeOpenList;
+
+      Vector<S32> mNodeRoute;
+      Vector<U16> mRoute;
+      Vector<U16> mLocalRoute;
+
+      void fit(S32 zoneCount, S32 nodeCount);
+      void nextZoneGeneration();
+      void nextNodeGeneration();
+      bool isReached(U16 zone) const;
+
+   public:
+      Search();      // Constructor
+
+      U32 getExpandedCount() const;             // Zones and portals looked at during the last search
+   };
+
+private:
+   struct Edge
+   {
+      S32 node;
+      F32 cost;
+   };
+
+   const Vector<BotNavMeshZone *> *mZones;
+   bool mBuilt;
+
+   Vector<S32> mZoneCluster;                    // Cluster of each zone
+   Vector<S32> mZoneNode;                       // Portal node of each zone, -1 if it isn't a portal
+   Vector<U16> mNodeZone;                       // Zone of each portal node
+   Vector<Vector<Edge> > mNodeEdges;
+   Vector<Vector<S32> > mClusterNodes;          // Portal nodes in each cluster
+
+   Vector<Vector<pair<U16, S32> > > mEntrances; // (zone, index into its mNeighbors) for each zone's way in
+
+   // Dijkstra from zone, without leaving its cluster, stopping once stopZone is reached.  With reverse, costs are
+   // for getting from each zone to zone, and no parents are kept.
+   void searchCluster(Search &search, U16 zone, U16 stopZone, bool reverse) const;
+
+   // Appends the zones after fromZone on the way to toZone, both in the same cluster
+   bool refine(Search &search, U16 fromZone, U16 toZone) const;
+
+public:
+   BotZoneHierarchy();     // Constructor
+
+   void build(const Vector<BotNavMeshZone *> *zones);    // Does nothing for levels under MinZones
+   void clear();
+
+   bool isBuilt() const;
+   bool isLongDistance(U16 startZone, U16 targetZone) const;   // Worth searching here rather than directly?
+
+   // Same layout as AStar::findPath(); returns false, leaving path empty, if there's no way there
+   bool findPath(Search &search, U16 startZone, U16 targetZone, const Point &target, Vector<Point> &path) const;
+
+   S32 getClusterCount() const;
+   S32 getNodeCount() const;
+};
+
+
+};
+
+#endif
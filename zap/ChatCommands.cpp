@@ -920,6 +920,26 @@ void shuffleTeams(ClientGame *game, const Vector<string> &words)
 }
 
 
+void showScriptStatsHandler(ClientGame *game, const Vector<string> &words)
+{
+   if(game->hasAdmin("!!! Need admin permissions to see script stats"))
+   {
+      if(game->getGameType())
+         game->getGameType()->c2sShowScriptStats();
+   }
+}
+
+
+void showNetStatsHandler(ClientGame *game, const Vector<string> &words)
+{
+   if(game->hasAdmin("!!! Need admin permissions to see network stats"))
+   {
+      if(game->getGameType())
+         game->getGameType()->c2sShowNetStats();
+   }
+}
+
+
 void banPlayerHandler(ClientGame *game, const Vector<string> &words)
 {
    if(game->hasAdmin("!!! Need admin permissions to ban players"))
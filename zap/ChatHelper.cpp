@@ -82,6 +82,8 @@ namespace Zap
    { "rename",             &ChatCommands::renamePlayerHandler,       { NAME, STR },  2, ADMIN_COMMANDS,  0,  1,  {"<from>","<to>"},       "Give a player a new name" },
    { "maxbots",            &ChatCommands::setMaxBotsHandler,         { xINT },       1, ADMIN_COMMANDS,  0,  1,  {"<count>"},             "Set the maximum bots allowed for this server" },
    { "shuffle",            &ChatCommands::shuffleTeams,              { },            0, ADMIN_COMMANDS,  0,  1,  { "" },                  "Randomly reshuffle teams" },
+   { "scriptstats",        &ChatCommands::showScriptStatsHandler,    { },            0, ADMIN_COMMANDS,  0,  1,  { "" },                  "Show the time and memory each bot and levelgen has used" },
+   { "netstats",           &ChatCommands::showNetStatsHandler,       { },            0, ADMIN_COMMANDS,  0,  1,  { "" },                  "Show each player's round trip time, packet loss, bandwidth and ghosts" },
 #ifdef TNL_DEBUG
    { "pause",              &ChatCommands::pauseHandler,              { },            0, ADMIN_COMMANDS,  0,  1,  { "" },                  "TODO: add 'PAUSED' display while paused" },
 #endif
@@ -39,11 +39,7 @@ Console::~Console()
    if(mConsole)
       quit();
 
-   if(L)
-   {
-      lua_close(L);
-      L = NULL;
-   }
+   shutdown();    // L has an allocator of ours, so it has to be closed the way LuaScriptRunner does it
 }
 
 
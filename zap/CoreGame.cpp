@@ -5,6 +5,7 @@
 
 #include "CoreGame.h"
 
+#include "ServerGame.h"
 #include "SoundSystem.h"
 
 #ifndef ZAP_DEDICATED
@@ -867,6 +868,11 @@ void CoreItem::damageObject(DamageInfo *theInfo)
       setMaskBits(ExplodedMask);                         
       disableCollision();
 
+      // Bots can stop steering around us -- same buffer as when the zones were built
+      Vector<Point> botZoneArea;
+      getBufferForBotZone(BotNavMeshZone::BufferRadius + 5, botZoneArea);
+      static_cast<ServerGame *>(getGame())->openBotZones(botZoneArea);
+
       return;
    }
 
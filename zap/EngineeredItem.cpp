@@ -654,7 +654,7 @@ bool EngineeredItem::isSnapped() const
 }
 
 
-bool EngineeredItem::isEnabled()
+bool EngineeredItem::isEnabled() const
 {
    return mHealth >= DisabledLevel;
 }
@@ -2184,6 +2184,44 @@ void Turret::unpackUpdate(GhostConnection *connection, BitStream *stream)
 }
 
 
+Point Turret::getAimPos() const
+{
+   return getPos() + mAnchorNormal * TURRET_OFFSET;
+}
+
+
+// Area in front of the turret where it looks for targets
+Rect Turret::getTargetSearchRect() const
+{
+   Point aimPos = getAimPos();
+   Point cross(mAnchorNormal.y, -mAnchorNormal.x);
+
+   Rect queryRect(aimPos, aimPos);
+   queryRect.unionPoint(aimPos + cross * TurretPerceptionDistance);
+   queryRect.unionPoint(aimPos - cross * TurretPerceptionDistance);
+   queryRect.unionPoint(aimPos + mAnchorNormal * TurretPerceptionDistance);
+
+   return queryRect;
+}
+
+
+bool Turret::getIdleQuery(U32 timeDelta, TestFunc &testFunc, Rect &queryRect) const
+{
+   if(isGhost() || !isEnabled())
+      return false;
+
+   testFunc = (TestFunc)isTurretTargetType;
+   queryRect = getTargetSearchRect();
+
+   return true;
+}
+
+
+// Scratch space for Turret::idle(), which only runs on the main thread
+static Vector<BfObject *> targetCandidates;
+static Vector<Point> targetDeltas;
+static RayBatch targetRays;
+
 // Choose target, aim, and, if possible, fire
 void Turret::idle(IdleCallPath path)
 {
@@ -2200,23 +2238,19 @@ void Turret::idle(IdleCallPath path)
    mFireTimer.update(mCurrentMove.time);
 
    // Choose best target:
-   Point aimPos = getPos() + mAnchorNormal * TURRET_OFFSET;
-   Point cross(mAnchorNormal.y, -mAnchorNormal.x);
+   Point aimPos = getAimPos();
 
-   Rect queryRect(aimPos, aimPos);
-   queryRect.unionPoint(aimPos + cross * TurretPerceptionDistance);
-   queryRect.unionPoint(aimPos - cross * TurretPerceptionDistance);
-   queryRect.unionPoint(aimPos + mAnchorNormal * TurretPerceptionDistance);
    fillVector.clear();
-   findObjects((TestFunc)isTurretTargetType, fillVector, queryRect);    // Get all potential targets
+   findIdleObjects((TestFunc)isTurretTargetType, fillVector, getTargetSearchRect());    // Get all potential targets
 
    WeaponInfo weaponInfo = WeaponInfo::getWeaponInfo(mWeaponFireType);
 
-   BfObject *bestTarget = NULL;
-   F32 bestRange = F32_MAX;
-   Point bestDelta;
+   // Targets we could aim at if nothing's in the way, and the rays to see whether anything is; the wall checks are
+   // all cast together once we know which targets are worth checking
+   targetCandidates.clear();
+   targetDeltas.clear();
+   targetRays.clear();
 
-   Point delta;
    for(S32 i = 0; i < fillVector.size(); i++)
    {
       if(isShipType(fillVector[i]->getObjectTypeNumber()))
@@ -2250,7 +2284,7 @@ void Turret::idle(IdleCallPath path)
       Point leadPos = potential->getPos() + Vs * t;
 
       // Calculate distance
-      delta = (leadPos - aimPos);
+      Point delta = (leadPos - aimPos);
 
       Point angleCheck = delta;
       angleCheck.normalize();
@@ -2259,12 +2293,30 @@ void Turret::idle(IdleCallPath path)
       if(angleCheck.dot(mAnchorNormal) <= -0.1f)
          continue;
 
-      // See if we can see it...
-      Point n;
-      if(findObjectLOS((TestFunc)isWallType, ActualState, aimPos, potential->getPos(), t, n))
+      targetCandidates.push_back(potential);
+      targetDeltas.push_back(delta);
+      targetRays.addRay(aimPos, potential->getPos());
+   }
+
+   // See which ones we can see...
+   if(targetRays.getRayCount() > 0)
+      getDatabase()->castRays((TestFunc)isWallType, ActualState, targetRays, false);
+
+   BfObject *bestTarget = NULL;
+   F32 bestRange = F32_MAX;
+   Point bestDelta;
+
+   for(S32 i = 0; i < targetCandidates.size(); i++)
+   {
+      if(targetRays.isBlocked(i))
          continue;
 
+      BfObject *potential = targetCandidates[i];
+      const Point &delta = targetDeltas[i];
+
       // See if we're gonna clobber our own stuff...
+      F32 t;
+      Point n;
       disableCollision();
       Point delta2 = delta;
       delta2.normalize(weaponInfo.projLiveTime * (F32)weaponInfo.projVelocity / 1000.f);
@@ -82,7 +82,7 @@ public:
    Point getEditorSelectionOffset(F32 currentScale);
 #endif
 
-   bool isEnabled();    // True if still active, false otherwise
+   bool isEnabled() const;    // True if still active, false otherwise
 
    void explode();
    bool isDestroyed();
@@ -311,6 +311,9 @@ private:
 
    F32 getSelectionOffsetMagnitude();
 
+   Point getAimPos() const;
+   Rect getTargetSearchRect() const;
+
 #ifndef ZAP_DEDICATED
    static EditorAttributeMenuUI *mAttributeMenuUI; // Menu for attribute editing
 #endif
@@ -347,6 +350,7 @@ public:
 
    void render();
    void idle(IdleCallPath path);
+   bool getIdleQuery(U32 timeDelta, TestFunc &testFunc, Rect &queryRect) const;
    void onAddedToGame(Game *theGame);
 
    U32 packUpdate(GhostConnection *connection, U32 updateMask, BitStream *stream);
@@ -5,11 +5,14 @@
 
 #include "EventManager.h"
 
+#include "BfObject.h"
 #include "CoreGame.h"
 #include "playerInfo.h"          // For RobotPlayerInfo constructor
 #include "robot.h"
 #include "Zone.h"
 
+#include "tnlThread.h"
+
 //#include "../lua/luaprofiler-2.0.2/src/luaprofiler.h"      // For... the profiler!
 
 #ifndef ZAP_DEDICATED
@@ -25,21 +28,6 @@ namespace Zap
 {
 
 
-struct Subscription {
-   LuaScriptRunner *subscriber;
-   ScriptContext context;
-};
-
-
-// Statics:
-bool EventManager::anyPending = false; 
-static Vector<Subscription>      subscriptions         [EventManager::EventTypes];
-static Vector<Subscription>      pendingSubscriptions  [EventManager::EventTypes];
-static Vector<LuaScriptRunner *> pendingUnsubscriptions[EventManager::EventTypes];
-
-bool EventManager::mConstructed = false;  // Prevent duplicate instantiation
-
-
 struct EventDef {
    const char *name;
    const char *function;
@@ -54,17 +42,16 @@ static const EventDef eventDefs[] = {
 #undef EVENT
 };
 
-static EventManager *eventManager = NULL;   // Singleton event manager, one copy is used by all listeners
+static EventManager *eventManager = NULL;          // Shared event manager, used by all listeners outside of extra server instances
+static EventManager *currentEventManager = NULL;   // Set while an extra server instance is running
 
 
 // C++ constructor
 EventManager::EventManager()
 {
-   TNLAssert(!mConstructed, "There is only one EventManager to rule them all!");
-
    mIsPaused = false;
    mStepCount = -1;
-   mConstructed = true;
+   mAnyPending = false;
 }
 
 
@@ -91,9 +78,12 @@ void EventManager::shutdown()
 }
 
 
-// Provide access to the single EventManager instance; lazily initialized
+// Provide access to the current EventManager instance; the shared one is lazily initialized
 EventManager *EventManager::get()
 {
+   if(currentEventManager)
+      return currentEventManager;
+
    if(!eventManager)
       eventManager = new EventManager();      // Deleted in shutdown(), which is called from Game destuctor
 
@@ -101,13 +91,19 @@ EventManager *EventManager::get()
 }
 
 
+void EventManager::setCurrent(EventManager *current)
+{
+   currentEventManager = current;
+}
+
+
 void EventManager::subscribe(LuaScriptRunner *subscriber, EventType eventType, ScriptContext context, bool failSilently)
 {
    // First, see if we're already subscribed
    if(isSubscribed(subscriber, eventType) || isPendingSubscribed(subscriber, eventType))
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
+   lua_State *L = subscriber->getLuaState();
 
    // Make sure the script has the proper event listener
    bool ok = LuaScriptRunner::loadFunction(L, subscriber->getScriptId(), eventDefs[eventType].function);     // -- function
@@ -128,8 +124,8 @@ void EventManager::subscribe(LuaScriptRunner *subscriber, EventType eventType, S
    s.subscriber = subscriber;
    s.context = context;
 
-   pendingSubscriptions[eventType].push_back(s);
-   anyPending = true;
+   mPendingSubscriptions[eventType].push_back(s);
+   mAnyPending = true;
 
    lua_pop(L, -1);    // Remove function from stack                                  -- <<empty stack>>
 }
@@ -141,18 +137,18 @@ void EventManager::unsubscribe(LuaScriptRunner *subscriber, EventType eventType)
    {
       removeFromPendingSubscribeList(subscriber, eventType);
 
-      pendingUnsubscriptions[eventType].push_back(subscriber);
-      anyPending = true;
+      mPendingUnsubscriptions[eventType].push_back(subscriber);
+      mAnyPending = true;
    }
 }
 
 
 void EventManager::removeFromPendingSubscribeList(LuaScriptRunner *subscriber, EventType eventType)
 {
-   for(S32 i = 0; i < pendingSubscriptions[eventType].size(); i++)
-      if(pendingSubscriptions[eventType][i].subscriber == subscriber)
+   for(S32 i = 0; i < mPendingSubscriptions[eventType].size(); i++)
+      if(mPendingSubscriptions[eventType][i].subscriber == subscriber)
       {
-         pendingSubscriptions[eventType].erase_fast(i);
+         mPendingSubscriptions[eventType].erase_fast(i);
          return;
       }
 }
@@ -160,10 +156,10 @@ void EventManager::removeFromPendingSubscribeList(LuaScriptRunner *subscriber, E
 
 void EventManager::removeFromPendingUnsubscribeList(LuaScriptRunner *subscriber, EventType eventType)
 {
-   for(S32 i = 0; i < pendingUnsubscriptions[eventType].size(); i++)
-      if(pendingUnsubscriptions[eventType][i] == subscriber)
+   for(S32 i = 0; i < mPendingUnsubscriptions[eventType].size(); i++)
+      if(mPendingUnsubscriptions[eventType][i] == subscriber)
       {
-         pendingUnsubscriptions[eventType].erase_fast(i);
+         mPendingUnsubscriptions[eventType].erase_fast(i);
          return;
       }
 }
@@ -171,10 +167,10 @@ void EventManager::removeFromPendingUnsubscribeList(LuaScriptRunner *subscriber,
 
 void EventManager::removeFromSubscribedList(LuaScriptRunner *subscriber, EventType eventType)
 {
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
-      if(subscriptions[eventType][i].subscriber == subscriber)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
+      if(mSubscriptions[eventType][i].subscriber == subscriber)
       {
-         subscriptions[eventType].erase_fast(i);
+         mSubscriptions[eventType].erase_fast(i);
          return;
       }
 }
@@ -192,8 +188,8 @@ void EventManager::unsubscribeImmediate(LuaScriptRunner *subscriber, EventType e
 // Check if we're subscribed to an event
 bool EventManager::isSubscribed(LuaScriptRunner *subscriber, EventType eventType)
 {
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
-      if(subscriptions[eventType][i].subscriber == subscriber)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
+      if(mSubscriptions[eventType][i].subscriber == subscriber)
          return true;
 
    return false;
@@ -202,8 +198,8 @@ bool EventManager::isSubscribed(LuaScriptRunner *subscriber, EventType eventType
 
 bool EventManager::isPendingSubscribed(LuaScriptRunner *subscriber, EventType eventType)
 {
-   for(S32 i = 0; i < pendingSubscriptions[eventType].size(); i++)
-      if(pendingSubscriptions[eventType][i].subscriber == subscriber)
+   for(S32 i = 0; i < mPendingSubscriptions[eventType].size(); i++)
+      if(mPendingSubscriptions[eventType][i].subscriber == subscriber)
          return true;
 
    return false;
@@ -212,8 +208,8 @@ bool EventManager::isPendingSubscribed(LuaScriptRunner *subscriber, EventType ev
 
 bool EventManager::isPendingUnsubscribed(LuaScriptRunner *subscriber, EventType eventType)
 {
-   for(S32 i = 0; i < pendingUnsubscriptions[eventType].size(); i++)
-      if(pendingUnsubscriptions[eventType][i] == subscriber)
+   for(S32 i = 0; i < mPendingUnsubscriptions[eventType].size(); i++)
+      if(mPendingUnsubscriptions[eventType][i] == subscriber)
          return true;
 
    return false;
@@ -223,23 +219,23 @@ bool EventManager::isPendingUnsubscribed(LuaScriptRunner *subscriber, EventType
 // Process all pending subscriptions and unsubscriptions
 void EventManager::update()
 {
-   if(anyPending)
+   if(mAnyPending)
    {
       for(S32 i = 0; i < EventTypes; i++)
-         for(S32 j = 0; j < pendingUnsubscriptions[i].size(); j++)     // Unsubscribing first means less searching!
-            removeFromSubscribedList(pendingUnsubscriptions[i][j], (EventType) i);
+         for(S32 j = 0; j < mPendingUnsubscriptions[i].size(); j++)     // Unsubscribing first means less searching!
+            removeFromSubscribedList(mPendingUnsubscriptions[i][j], (EventType) i);
 
       for(S32 i = 0; i < EventTypes; i++)
-         for(S32 j = 0; j < pendingSubscriptions[i].size(); j++)     
-            subscriptions[i].push_back(pendingSubscriptions[i][j]);
+         for(S32 j = 0; j < mPendingSubscriptions[i].size(); j++)     
+            mSubscriptions[i].push_back(mPendingSubscriptions[i][j]);
 
       for(S32 i = 0; i < EventTypes; i++)
       {
-         pendingSubscriptions[i].clear();
-         pendingUnsubscriptions[i].clear();
+         mPendingSubscriptions[i].clear();
+         mPendingUnsubscriptions[i].clear();
       }
 
-      anyPending = false;
+      mAnyPending = false;
    }
 }
 
@@ -250,15 +246,14 @@ void EventManager::fireEvent(EventType eventType)
    if(suppressEvents(eventType))   
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 0, subscriptions[eventType][i].context);
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 0, mSubscriptions[eventType][i].context);
          
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -270,8 +265,33 @@ void EventManager::fireEvent(EventType eventType)
 }
 
 
+// Runs onTick for scripts with Lua states of their own, on worker threads
+class ParallelTickJob : public WorkerPool::Job
+{
+   const Vector<Subscription> &mSubscriptions;
+   const Vector<U32> &mDeltaTs;
+
+public:
+   ParallelTickJob(const Vector<Subscription> &subscriptions, const Vector<U32> &deltaTs) :   // Constructor
+      mSubscriptions(subscriptions), mDeltaTs(deltaTs)
+   {
+      // Do nothing
+   }
+
+   void runItem(S32 index)
+   {
+      const Subscription &subscription = mSubscriptions[index];
+      lua_State *L = subscription.subscriber->getLuaState();
+
+      lua_pushinteger(L, mDeltaTs[index]);  // -- deltaT
+      setScriptContext(L, subscription.context);
+      subscription.subscriber->runCmdOnWorker(eventDefs[EventManager::TickEvent].function, 1);
+   }
+};
+
+
 // onTick
-void EventManager::fireEvent(EventType eventType, U32 deltaT)
+void EventManager::fireEvent(EventType eventType, U32 deltaT, WorkerPool *pool)
 {
    if(suppressEvents(eventType))   
       return;
@@ -279,16 +299,31 @@ void EventManager::fireEvent(EventType eventType, U32 deltaT)
    if(eventType == TickEvent)
       mStepCount--;   
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+   // With a pool, scripts with their own Lua states are left for the workers
+   Vector<Subscription> parallelSubscriptions;
+   Vector<U32> parallelDeltaTs;
 
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
-      lua_pushinteger(L, deltaT);   // -- deltaT
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 1, subscriptions[eventType][i].context);
+      // Scripts over their time budget sit out a tick or two, and get the time they missed when they're back
+      U32 subscriberDeltaT = deltaT;
+      if(eventType == TickEvent && mSubscriptions[eventType][i].subscriber->deferTick(subscriberDeltaT))
+         continue;
+
+      if(pool && eventType == TickEvent && mSubscriptions[eventType][i].subscriber->hasOwnLuaState())
+      {
+         parallelSubscriptions.push_back(mSubscriptions[eventType][i]);
+         parallelDeltaTs.push_back(subscriberDeltaT);
+         continue;
+      }
+
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
+      lua_pushinteger(L, subscriberDeltaT);   // -- deltaT
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 1, mSubscriptions[eventType][i].context);
          
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -297,6 +332,24 @@ void EventManager::fireEvent(EventType eventType, U32 deltaT)
          i--;
       }
    }
+
+   if(parallelSubscriptions.size() == 0)
+      return;
+
+   // The scripts all see the game as it is now; most of what they do to it happens afterwards, script by script, in
+   // the same order they'd have run in one at a time
+   ParallelTickJob job(parallelSubscriptions, parallelDeltaTs);
+
+   Vector<LuaScriptRunner *> scripts(parallelSubscriptions.size());
+   for(S32 i = 0; i < parallelSubscriptions.size(); i++)
+      scripts.push_back(parallelSubscriptions[i].subscriber);
+
+   LuaScriptRunner::startParallelRun(scripts);
+   pool->run(&job, parallelSubscriptions.size());
+   LuaScriptRunner::endParallelRun();
+
+   for(S32 i = 0; i < parallelSubscriptions.size(); i++)
+      parallelSubscriptions[i].subscriber->finishWorkerRun();
 }
 
 
@@ -306,16 +359,15 @@ void EventManager::fireEvent(EventType eventType, CoreItem *core)
    if(suppressEvents(eventType))
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
       core->push(L);                // -- core
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 1, subscriptions[eventType][i].context);
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 1, mSubscriptions[eventType][i].context);
          
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -333,16 +385,15 @@ void EventManager::fireEvent(EventType eventType, Ship *ship)
    if(suppressEvents(eventType))   
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
       ship->push(L);                // -- ship
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 1, subscriptions[eventType][i].context);
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 1, mSubscriptions[eventType][i].context);
          
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -360,12 +411,11 @@ void EventManager::fireEvent(EventType eventType, Ship *ship, BfObject *damaging
    if(suppressEvents(eventType))
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
       ship->push(L);                // -- ship
 
       if(damagingObject)
@@ -378,9 +428,9 @@ void EventManager::fireEvent(EventType eventType, Ship *ship, BfObject *damaging
       else
          lua_pushnil(L);
 
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 3, subscriptions[eventType][i].context);
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 3, mSubscriptions[eventType][i].context);
          
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -400,13 +450,12 @@ void EventManager::fireEvent(LuaScriptRunner *sender, EventType eventType, const
    if(suppressEvents(eventType))   
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
-      if(sender == subscriptions[eventType][i].subscriber)    // Don't alert sender about own message!
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
+      if(sender == mSubscriptions[eventType][i].subscriber)    // Don't alert sender about own message!
          continue;
 
       lua_pushstring(L, message);   // -- message
@@ -418,9 +467,9 @@ void EventManager::fireEvent(LuaScriptRunner *sender, EventType eventType, const
 
       lua_pushboolean(L, global);   // -- message, player, isGlobal
 
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 3, subscriptions[eventType][i].context);
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 3, mSubscriptions[eventType][i].context);
          
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -429,15 +478,52 @@ void EventManager::fireEvent(LuaScriptRunner *sender, EventType eventType, const
          i--;
       }
    }
+}
+
+
+// Copies the value at index in one Lua state onto the stack of another.  Only simple values and game objects
+// can make the trip; anything else arrives as nil.
+static void pushCopy(lua_State *from, S32 index, lua_State *to)
+{
+   switch(lua_type(from, index))
+   {
+      case LUA_TBOOLEAN:
+         lua_pushboolean(to, lua_toboolean(from, index));
+         break;
+
+      case LUA_TNUMBER:
+         lua_pushnumber(to, lua_tonumber(from, index));
+         break;
+
+      case LUA_TSTRING:
+      {
+         size_t len;
+         const char *str = lua_tolstring(from, index, &len);
+         lua_pushlstring(to, str, len);
+         break;
+      }
+
+      case LUA_TUSERDATA:
+      {
+         BfObject *obj = luaW_to<BfObject>(from, index);
 
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+         if(obj)
+            obj->push(to);
+         else
+            lua_pushnil(to);
+         break;
+      }
+
+      default:
+         lua_pushnil(to);
+   }
 }
 
 
 // onDataReceived
 void EventManager::fireEvent(LuaScriptRunner *sender, EventType eventType)
 {
-   lua_State *L = LuaScriptRunner::getL();
+   lua_State *L = sender->getLuaState();
 
    if(suppressEvents(eventType))
    {
@@ -451,12 +537,28 @@ void EventManager::fireEvent(LuaScriptRunner *sender, EventType eventType)
    // we need to make a copy of them first so we can add them back for subsequent calls.
 
 
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
-      if(sender == subscriptions[eventType][i].subscriber)    // Don't alert sender about own message!
+      if(sender == mSubscriptions[eventType][i].subscriber)    // Don't alert sender about own message!
          continue;
 
-      Subscription subscription = subscriptions[eventType][i];
+      Subscription subscription = mSubscriptions[eventType][i];
+      lua_State *subscriberL = subscription.subscriber->getLuaState();
+
+      // Subscribers with Lua states of their own get copies of what they can
+      if(subscriberL != L)
+      {
+         for(S32 j = 1; j <= argCount; j++)
+            pushCopy(L, j, subscriberL);
+
+         if(fire(subscriberL, subscription.subscriber, eventDefs[eventType].function, argCount, subscription.context))
+         {
+            clearStack(subscriberL);
+            i--;
+         }
+
+         continue;
+      }
 
       // Duplicate the first argCount items on the stack
       for(S32 j = 1; j <= argCount; j++)
@@ -464,7 +566,7 @@ void EventManager::fireEvent(LuaScriptRunner *sender, EventType eventType)
 
       bool error = fire(L, subscription.subscriber, eventDefs[eventType].function, argCount, subscription.context);
 
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -490,19 +592,18 @@ void EventManager::fireEvent(LuaScriptRunner *player, EventType eventType, LuaPl
    if(suppressEvents(eventType))   
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
-      if(player == subscriptions[eventType][i].subscriber)    // Don't trouble player with own joinage or leavage!
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
+      if(player == mSubscriptions[eventType][i].subscriber)    // Don't trouble player with own joinage or leavage!
          continue;
 
       playerInfo->push(L);          // -- playerInfo
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 1, subscriptions[eventType][i].context);
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 1, mSubscriptions[eventType][i].context);
 
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -520,21 +621,20 @@ void EventManager::fireEvent(EventType eventType, Ship *ship, Zone *zone)
    if(suppressEvents(eventType))   
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
       // Passing ship, zone, zoneType, zoneId
       ship->push(L);                                     // -- ship
       zone->push(L);                                     // -- ship, zone   
       lua_pushinteger(L, zone->getObjectTypeNumber());   // -- ship, zone, zone->objTypeNumber
       lua_pushinteger(L, zone->getUserAssignedId());     // -- ship, zone, zone->objTypeNumber, zone->id
 
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 4, subscriptions[eventType][i].context);
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 4, mSubscriptions[eventType][i].context);
 
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -552,21 +652,20 @@ void EventManager::fireEvent(EventType eventType, MoveObject *object, Zone *zone
    if(suppressEvents(eventType))   
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
       // Passing object, zone, zoneType, zoneId
       object->push(L);                                   // -- object
       zone->push(L);                                     // -- object, zone   
       lua_pushinteger(L, zone->getObjectTypeNumber());   // -- object, zone, zone->objTypeNumber
       lua_pushinteger(L, zone->getUserAssignedId());     // -- object, zone, zone->objTypeNumber, zone->id
 
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 4, subscriptions[eventType][i].context);
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 4, mSubscriptions[eventType][i].context);
 
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -584,12 +683,11 @@ void EventManager::fireEvent(EventType eventType, S32 score, S32 team, LuaPlayer
    if(suppressEvents(eventType))
       return;
 
-   lua_State *L = LuaScriptRunner::getL();
-
-   TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
-
-   for(S32 i = 0; i < subscriptions[eventType].size(); i++)
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
    {
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
       lua_pushinteger(L, score);   // -- score
       lua_pushinteger(L, team);    // -- score, team
 
@@ -598,9 +696,9 @@ void EventManager::fireEvent(EventType eventType, S32 score, S32 team, LuaPlayer
       else
          lua_pushnil(L);
 
-      bool error = fire(L, subscriptions[eventType][i].subscriber, eventDefs[eventType].function, 3, subscriptions[eventType][i].context);
+      bool error = fire(L, mSubscriptions[eventType][i].subscriber, eventDefs[eventType].function, 3, mSubscriptions[eventType][i].context);
 
-      // If an error occurred, the subscriber is gone; subscriptions[eventType].size() is now smaller, and the
+      // If an error occurred, the subscriber is gone; mSubscriptions[eventType].size() is now smaller, and the
       // next one we need to handle is at index i.  i will increment at the end of this block, so we need to 
       // compensate for that by decrementing it here.
       if(error)
@@ -612,6 +710,32 @@ void EventManager::fireEvent(EventType eventType, S32 score, S32 team, LuaPlayer
 }
 
 
+// onPathReady -- only the bot that asked for the path hears about it
+void EventManager::fireEvent(LuaScriptRunner *subscriber, EventType eventType, S32 handle, bool found)
+{
+   if(suppressEvents(eventType))
+      return;
+
+   for(S32 i = 0; i < mSubscriptions[eventType].size(); i++)
+   {
+      lua_State *L = mSubscriptions[eventType][i].subscriber->getLuaState();
+      TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
+
+      if(mSubscriptions[eventType][i].subscriber != subscriber)
+         continue;
+
+      lua_pushinteger(L, handle);   // -- handle
+      lua_pushboolean(L, found);    // -- handle, found
+      bool error = fire(L, subscriber, eventDefs[eventType].function, 2, mSubscriptions[eventType][i].context);
+
+      if(error)
+         clearStack(L);
+
+      break;
+   }
+}
+
+
 // Actually fire the event, called by one of the fireEvent() methods above
 // Returns true if there was an error, false if everything ran ok
 bool EventManager::fire(lua_State *L, LuaScriptRunner *scriptRunner, const char *function, S32 argCount, ScriptContext context)
@@ -641,7 +765,7 @@ bool EventManager::fire(lua_State *L, LuaScriptRunner *scriptRunner, const char
 // If true, events will not fire!
 bool EventManager::suppressEvents(EventType eventType)
 {
-   if(subscriptions[eventType].size() == 0)
+   if(mSubscriptions[eventType].size() == 0)
       return true;
 
    return mIsPaused && mStepCount <= 0;    // Paused bots should still respond to events as long as stepCount > 0
@@ -12,6 +12,8 @@
 #include "tnlVector.h"
 
 
+namespace TNL { class WorkerPool; }
+
 using namespace TNL;
 
 namespace Zap
@@ -25,7 +27,10 @@ class Robot;
 class Ship;
 class Zone;
 
-struct Subscription; 
+struct Subscription {
+   LuaScriptRunner *subscriber;
+   ScriptContext context;
+};
 
 class EventManager
 {
@@ -59,6 +64,7 @@ class EventManager
    EVENT(ScoreChangedEvent,      "ScoreChanged",      "onScoreChanged",      "Use with event handler: `onScoreChanged(num scoreChange, num teamIndex, PlayerInfo player)`"      ) \
    EVENT(GameOverEvent,          "GameOver",          "onGameOver",          "Use with event handler: `onGameOver()`"                                                           ) \
    EVENT(CoreDestroyedEvent,     "CoreDestroyed",     "onCoreDestroyed",     "Use with event handler: `onCoreDestroyed(CoreItem core)`"                                         ) \
+   EVENT(PathReadyEvent,         "PathReady",         "onPathReady",         "Use with event handler: `onPathReady(num handle, bool found)`"                                    ) \
 
 public:
 
@@ -86,7 +92,11 @@ private:
       
    bool mIsPaused;
    S32 mStepCount;           // If running for a certain number of steps, this will be > 0, while mIsPaused will be true
-   static bool mConstructed;
+
+   Vector<Subscription>      mSubscriptions         [EventTypes];
+   Vector<Subscription>      mPendingSubscriptions  [EventTypes];
+   Vector<LuaScriptRunner *> mPendingUnsubscriptions[EventTypes];
+   bool mAnyPending;
 
 public:
    EventManager();                       // C++ constructor
@@ -95,13 +105,13 @@ public:
 
    static void shutdown();
 
-   static EventManager *get();         // Provide access to the single EventManager instance
-   bool suppressEvents(EventType eventType);
+   static EventManager *get();         // Provide access to the current EventManager instance
+
+   // Each instance of a multi-instance server keeps its own subscriptions, and makes its EventManager current while
+   // it runs; NULL goes back to the shared one used everywhere else
+   static void setCurrent(EventManager *current);
 
-   //static Vector<Subscription> subscriptions[EventTypes];
-   //static Vector<Subscription> pendingSubscriptions[EventTypes];
-   //static Vector<pendingUnsubscriptions *> pendingUnsubscriptions[EventTypes];
-   static bool anyPending;
+   bool suppressEvents(EventType eventType);
 
    void subscribe  (LuaScriptRunner *subscriber, EventType eventType, ScriptContext context, bool failSilently = false);
    void unsubscribe(LuaScriptRunner *subscriber, EventType eventType);
@@ -112,7 +122,8 @@ public:
 
    // We'll have several different signatures for this one...
    void fireEvent(EventType eventType);
-   void fireEvent(EventType eventType, U32 deltaT);      // Tick
+   void fireEvent(EventType eventType, U32 deltaT, WorkerPool *pool = NULL);    // Tick; scripts with their own
+                                                                                 // Lua states run on pool, if given
    void fireEvent(EventType eventType, CoreItem *core);  // CoreDestroyed
    void fireEvent(EventType eventType, Ship *ship);      // ShipSpawned
    void fireEvent(EventType eventType, Ship *ship, BfObject *damagingObject, BfObject *shooter);  // ShipKilled
@@ -122,6 +133,7 @@ public:
    void fireEvent(EventType eventType, Ship *ship, Zone *zone); // ShipEnteredZoneEvent, ShipLeftZoneEvent
    void fireEvent(EventType eventType, S32 score, S32 team, LuaPlayerInfo *playerInfo);
    void fireEvent(EventType eventType, MoveObject *object, Zone *zone); // ObjectEnteredZoneEvent, ObjectLeftZoneEvent
+   void fireEvent(LuaScriptRunner *subscriber, EventType eventType, S32 handle, bool found);  // PathReady
 
    // Allow the pausing of event firing for debugging purposes
    void setPaused(bool isPaused);
@@ -6,6 +6,8 @@
 #include "GameManager.h"
 
 #include "ServerGame.h"
+#include "EventManager.h"
+#include "gameNetInterface.h"
 
 #ifndef ZAP_DEDICATED
 #  include "UIErrorMessage.h"
@@ -19,6 +21,7 @@ namespace Zap
 
 // Declare statics
 ServerGame *GameManager::mServerGame = NULL;
+Vector<ServerGame *> GameManager::mServerGames;
 #ifndef ZAP_DEDICATED
    Vector<ClientGame *> GameManager::mClientGames;
 #endif
@@ -51,21 +54,135 @@ void GameManager::setServerGame(ServerGame *serverGame)
    TNLAssert(!mServerGame, "Already have a ServerGame!");
 
    mServerGame = serverGame;
+   mServerGames.push_back(serverGame);
 }
 
 
 void GameManager::deleteServerGame()
 {
+   while(mServerGames.size() > 1)
+      deleteServerGame(mServerGames.last());
+
    // mServerGame might be NULL here; for example when quitting after losing a connection to the game server
    delete mServerGame;     // Kill the serverGame (leaving the clients running)
    mServerGame = NULL;
+   mServerGames.clear();
 }
 
 
+// Idles each ServerGame in turn, with it current, so code that goes through getServerGame() or EventManager::get()
+// reaches the right one
 void GameManager::idleServerGame(U32 timeDelta)
 {
-   if(mServerGame)
-      mServerGame->idle(timeDelta);
+   if(mServerGames.size() <= 1)
+   {
+      if(mServerGame)
+         mServerGame->idle(timeDelta);
+
+      return;
+   }
+
+   for(S32 i = 0; i < mServerGames.size(); i++)
+   {
+      setCurrentServerGame(mServerGames[i]);
+      mServerGames[i]->idle(timeDelta);
+   }
+
+   setCurrentServerGame(mServerGames[0]);
+}
+
+
+const Vector<ServerGame *> *GameManager::getServerGames()
+{
+   return &mServerGames;
+}
+
+
+void GameManager::addServerGame(ServerGame *serverGame)
+{
+   TNLAssert(mServerGames.size() > 0, "Need a primary ServerGame first!");
+   TNLAssert(serverGame->isExtraInstance(), "Expected an extra instance here!");
+
+   mServerGames.push_back(serverGame);
+}
+
+
+void GameManager::deleteServerGame(ServerGame *serverGame)
+{
+   S32 index = mServerGames.getIndex(serverGame);
+   TNLAssert(index > 0, "Only extra instances can be deleted this way!");
+
+   // Bots unsubscribe from events as they go, so make sure they find their own EventManager
+   setCurrentServerGame(serverGame);
+   delete serverGame;
+
+   mServerGames.erase(index);
+   setCurrentServerGame(mServerGames[0]);
+}
+
+
+void GameManager::setCurrentServerGame(ServerGame *serverGame)
+{
+   mServerGame = serverGame;
+   EventManager::setCurrent(serverGame->getEventManager());
+   serverGame->setAddTarget();      // Objects created by scripts belong to this game too
+}
+
+
+// Returns how long all ServerGames can go without idling, if no packets come in
+U32 GameManager::getTimeUntilServerIdleNeeded()
+{
+   // Levels load one per idle, as fast as we can go
+   if(mHostingModePhase == LoadingLevels || mHostingModePhase == DoneLoadingLevels)
+      return 0;
+
+   U32 wait = U32_MAX;
+
+   for(S32 i = 0; i < mServerGames.size(); i++)
+   {
+      U32 gameWait = mServerGames[i]->getTimeUntilIdleNeeded();
+      if(gameWait < wait)
+         wait = gameWait;
+   }
+
+   return wait == U32_MAX ? 0 : wait;
+}
+
+
+// Sleeps until a packet arrives for any ServerGame, or timeout passes; returns true if there are packets to read
+bool GameManager::waitForServerPackets(U32 timeout)
+{
+   static Vector<NetInterface *> interfaces;    // Reused from call to call
+
+   interfaces.clear();
+   for(S32 i = 0; i < mServerGames.size(); i++)
+      interfaces.push_back(mServerGames[i]->getNetInterface());
+
+   return NetInterface::waitForPackets(interfaces.address(), interfaces.size(), timeout);
+}
+
+
+// Handles packets that arrived between ticks right away, rather than leaving them until the next one
+void GameManager::checkIncomingServerPackets()
+{
+   if(mHostingModePhase == LoadingLevels)
+      return;
+
+   if(mServerGames.size() <= 1)
+   {
+      if(mServerGame)
+         mServerGame->getNetInterface()->checkIncomingPackets();
+
+      return;
+   }
+
+   for(S32 i = 0; i < mServerGames.size(); i++)
+   {
+      setCurrentServerGame(mServerGames[i]);
+      mServerGames[i]->getNetInterface()->checkIncomingPackets();
+   }
+
+   setCurrentServerGame(mServerGames[0]);
 }
 
 
@@ -31,7 +31,8 @@ public:
    };
 
 private:
-   static ServerGame *mServerGame;
+   static ServerGame *mServerGame;              // Game being run right now; the primary one, except while idling the others
+   static Vector<ServerGame *> mServerGames;    // Every ServerGame in this process, primary first
 #ifndef ZAP_DEDICATED
    static Vector<ClientGame *> mClientGames;
 #endif
@@ -45,9 +46,20 @@ public:
    // ServerGame related
    static void setServerGame(ServerGame *serverGame);
    static ServerGame *getServerGame();
-   static void deleteServerGame();
+   static void deleteServerGame();                          // Delete all ServerGames
    static void idleServerGame(U32 timeDelta);
 
+   // Extra instances of a multi-instance dedicated server
+   static const Vector<ServerGame *> *getServerGames();
+   static void addServerGame(ServerGame *serverGame);
+   static void deleteServerGame(ServerGame *serverGame);    // Delete specified extra instance
+   static void setCurrentServerGame(ServerGame *serverGame);
+
+   // For the dedicated server's main loop, which sleeps on the games' sockets between ticks
+   static U32 getTimeUntilServerIdleNeeded();
+   static bool waitForServerPackets(U32 timeout);
+   static void checkIncomingServerPackets();
+
    // ClientGame related
 #ifndef ZAP_DEDICATED
    static const Vector<ClientGame *> *getClientGames();
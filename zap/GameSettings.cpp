@@ -11,6 +11,7 @@
 #include "stringUtils.h"      // For itos
 #include "LuaWrapper.h"       // For printing Lua class hiearchy
 #include "LevelSource.h"
+#include "BotZoneCache.h"
 
 #include "tnlTypes.h"         // For TNL_OS_WIN32 def
 #include "tnlLog.h"           // For logprintf
@@ -85,6 +86,7 @@ ParamInfo paramDefs[] = {
 { "hostdescr",             ONE_REQUIRED,   HOST_DESCRIPTION,      1, "<string>",  "Set a brief description of the server, which will be visible when players browse for game servers. Use double quotes (\") for descriptions containing spaces.", "You must specify a description (use quotes) with the -hostdescr option" },
 { "maxplayers",            ONE_REQUIRED,   MAX_PLAYERS_PARAM,     1, "<int>",     "Max players allowed in a game (default is 128)", "You must specify the max number of players on your server with the -maxplayers option" }, 
 { "hostaddr",              ONE_REQUIRED,   HOST_ADDRESS,          1, "<address>", "Specify host address for the server to listen to when hosting",                        "You must specify a host address for the host to listen on (e.g. IP:Any:28000 or IP:192.169.1.100:5500)" },
+{ "instances",             ONE_REQUIRED,   INSTANCES,             1, "<int>",     "Run this many independent games in one dedicated server, on consecutive ports starting with the one from -hostaddr (default is 1)", "You must specify the number of games to run with the -instances option" },
 
 // Specifying levels
 { "levels",                ALL_REMAINING,  LEVEL_LIST,            2, "<level 1> [level 2]...", "Specify the levels to play. Note that all remaining items on the command line will be interpreted as levels, so this must be the last parameter.", "You must specify one or more levels to load with the -levels option" },
@@ -109,6 +111,7 @@ ParamInfo paramDefs[] = {
 { "lag",                   ONE_REQUIRED,   SIMULATED_LAG,         4, "<int>",     "Simulate the specified amount of server lag (in milliseconds) Note: Client only!",                          "You must specify a lag (in ms) with the -lag option" },
 { "stutter",               ONE_REQUIRED,   SIMULATED_STUTTER,     4, "<int>",     "Simulate VPS CPU stutter (in milliseconds/second) Note: Server only!",                                      "You must specify a value (in ms) with the -stutter option.  Values clamped to 0-1000" },
 { "forceupdate",           NO_PARAMETERS,  FORCE_UPDATE,          4, "",          "Trick game into thinking it needs to update",                                            "" },
+{ "tick-stats",            NO_PARAMETERS,  TICK_STATS,            4, "",          "Log how evenly the game ticks, and how much CPU each tick takes, every 10 seconds",         "" },
 
 // Also, see the directives section below!
 
@@ -133,6 +136,7 @@ DirectiveInfo directiveDefs[] = {
 // Advanced server management options
 { "getres",  FOUR_REQUIRED,  SEND_RESOURCE, 5, GameSettings::getRes,    "<server address> <admin password> <resource name> <LEVEL|LEVELGEN|BOT>", "Send a resource to a remote server. Address must be specified in the form IP:nnn.nnn.nnn.nnn:port. The server must be running, have an admin password set, and have resource management enabled ([Host] section in the bitfighter.ini file).", "Usage: bitfighter getres <server address> <admin password> <resource name> <LEVEL|LEVELGEN|BOT>" },
 { "sendres", FOUR_REQUIRED,  GET_RESOURCE,  5, GameSettings::sendRes,   "<server address> <admin password> <resource name> <LEVEL|LEVELGEN|BOT>", "Retrieve a resource from a remote server, with same requirements as -sendres.",                                                                                                                                                                "Usage: bitfighter sendres <server address> <admin password> <resource name> <LEVEL|LEVELGEN|BOT>" },
+{ "bakezones", ONE_REQUIRED, BAKE_BOT_ZONES, 5, GameSettings::bakeBotZones, "<level folder>", "Build bot zones for every level in the specified folder (or subfolder under the levels folder), and save them in the botzones folder so servers can skip building them when the levels load. Levels that already have saved zones, or that use levelgens, are skipped.", "You must specify the folder with the levels to build zones for with the -bakezones option" },
 
 // Other commands
 { "rules",   NO_PARAMETERS,  SHOW_RULES,        6, GameSettings::showRules,      "",  "Print a list of \"rules of the game\" and other possibly useful data", "" },
@@ -412,6 +416,15 @@ U32 GameSettings::getMaxPlayers()
 }
 
 
+// Number of games a dedicated server runs side by side; always at least 1
+U32 GameSettings::getInstanceCount()
+{
+   S32 instances = S32(getU32(INSTANCES));
+
+   return instances < 1 ? 1 : U32(instances);
+}
+
+
 // Write all our settings to bitfighter.ini
 void GameSettings::save()
 {
@@ -1026,6 +1039,29 @@ void GameSettings::sendRes(GameSettings *settings, const Vector<string> &words)
 }
 
 
+////////////////////////////////////////
+////////////////////////////////////////
+// Save bot zones ahead of time with the -bakezones command
+
+extern bool writeToConsole();
+
+void GameSettings::bakeBotZones(GameSettings *settings, const Vector<string> &words)
+{
+   FolderManager *folderManager = settings->getFolderManager();
+   string levelDir = folderManager->resolveLevelDir(words[0]);
+
+   if(levelDir == "")
+   {
+      writeToConsole();
+      printf("Could not find level folder %s\n", words[0].c_str());
+      exitToOs(1);
+   }
+
+   BotZoneCache::bakeLevels(settings, levelDir, folderManager->botZoneDir);
+   exitToOs(0);
+}
+
+
 ////////////////////////////////////////
 ////////////////////////////////////////
 // Dump rules with the -rules option
@@ -47,6 +47,7 @@ enum ParamId {
    HOST_DESCRIPTION,
    MAX_PLAYERS_PARAM,
    HOST_ADDRESS,
+   INSTANCES,
 
    LEVEL_LIST,
    USE_FILE,
@@ -70,9 +71,11 @@ enum ParamId {
    SIMULATED_LAG,
    SIMULATED_STUTTER,
    FORCE_UPDATE,
+   TICK_STATS,
 
    SEND_RESOURCE,
    GET_RESOURCE,
+   BAKE_BOT_ZONES,
    SHOW_RULES,
    SHOW_LUA_CLASSES,
    HELP,
@@ -219,6 +222,7 @@ public:
 
    string getHostAddress();
    U32 getMaxPlayers();
+   U32 getInstanceCount();
 
    void save();
 
@@ -281,6 +285,7 @@ public:
 
    static void getRes(GameSettings *settings, const Vector<string> &words);
    static void sendRes(GameSettings *settings, const Vector<string> &words);
+   static void bakeBotZones(GameSettings *settings, const Vector<string> &words);
    static void showRules(GameSettings *settings, const Vector<string> &words);
    static void showHelp(GameSettings *settings, const Vector<string> &words);
    static void showVersion(GameSettings *settings, const Vector<string> &words);
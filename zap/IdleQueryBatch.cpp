@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "IdleQueryBatch.h"
+
+#include "BfObject.h"
+
+namespace Zap
+{
+
+// Constructor
+IdleQueryBatch::IdleQueryBatch()
+{
+   mDatabase = NULL;
+   mQueryCount = 0;
+   mCurrentObject = -1;
+   mPreparedCount = 0;
+   mUsedCount = 0;
+}
+
+
+// Destructor
+IdleQueryBatch::~IdleQueryBatch()
+{
+   mDatabaseQueries.deleteAndClear();
+}
+
+
+void IdleQueryBatch::prepare(GridDatabase *database, const Vector<DatabaseObject *> &objects, U32 timeDelta, WorkerPool *pool)
+{
+   mDatabase = database;
+   mQueryCount = 0;
+   mCurrentObject = -1;
+
+   mQueryIndex.resize(objects.size());
+
+   for(S32 i = 0; i < objects.size(); i++)
+   {
+      mQueryIndex[i] = -1;
+
+      BfObject *object = static_cast<BfObject *>(objects[i]);
+
+      if(object->isDeleted())
+         continue;
+
+      TestFunc testFunc;
+      Rect queryRect;
+
+      if(!object->getIdleQuery(timeDelta, testFunc, queryRect))
+         continue;
+
+      // Entries, and their result lists, get reused from tick to tick
+      if(mQueryCount == mQueries.size())
+         mQueries.resize(mQueryCount + 1);
+
+      PreparedQuery &query = mQueries[mQueryCount];
+      query.object = object;
+      query.testFunc = testFunc;
+      query.queryRect = queryRect;
+      query.used = false;
+
+      mQueryIndex[i] = mQueryCount;
+      mQueryCount++;
+   }
+
+   S32 chunkCount = (mQueryCount + ChunkSize - 1) / ChunkSize;
+
+   while(mDatabaseQueries.size() < chunkCount)
+      mDatabaseQueries.push_back(new DatabaseQuery());
+
+   pool->run(this, chunkCount);
+
+   mPreparedCount += mQueryCount;
+}
+
+
+// Runs one chunk of queries -- only reads from the database, and only writes to that chunk's entries
+void IdleQueryBatch::runItem(S32 index)
+{
+   DatabaseQuery *databaseQuery = mDatabaseQueries[index];
+
+   S32 end = (index + 1) * ChunkSize;
+   if(end > mQueryCount)
+      end = mQueryCount;
+
+   for(S32 i = index * ChunkSize; i < end; i++)
+   {
+      PreparedQuery &query = mQueries[i];
+
+      databaseQuery->clearResults();
+      mDatabase->findObjects(query.testFunc, *databaseQuery, query.queryRect);
+
+      query.results.clear();
+      for(S32 j = 0; j < databaseQuery->getResults().size(); j++)
+         query.results.push_back(databaseQuery->getResults()[j]);
+
+      query.revision = mDatabase->getRevision(query.queryRect);
+   }
+}
+
+
+void IdleQueryBatch::setCurrentObject(S32 index)
+{
+   mCurrentObject = index;
+}
+
+
+// Objects may be deleted once idling is done, so make sure nothing can refer to them
+void IdleQueryBatch::finish()
+{
+   mCurrentObject = -1;
+   mQueryCount = 0;
+   mQueryIndex.clear();
+}
+
+
+bool IdleQueryBatch::findObjects(const BfObject *object, TestFunc testFunc, const Rect &queryRect,
+                                 Vector<DatabaseObject *> &fillVector)
+{
+   if(mCurrentObject < 0 || mQueryIndex[mCurrentObject] < 0)
+      return false;
+
+   PreparedQuery &query = mQueries[mQueryIndex[mCurrentObject]];
+
+   if(query.used || query.object != object || query.testFunc != testFunc || !(query.queryRect == queryRect))
+      return false;
+
+   query.used = true;    // Good for one search only; anything after that could depend on what the object did with it
+
+   // Did anything come, go, or move around there since?
+   if(object->getDatabase() != mDatabase || mDatabase->getRevision(queryRect) != query.revision)
+      return false;
+
+   for(S32 i = 0; i < query.results.size(); i++)
+      fillVector.push_back(query.results[i]);
+
+   mUsedCount++;
+
+   return true;
+}
+
+
+void IdleQueryBatch::collectTotals(U32 &prepared, U32 &used)
+{
+   prepared += mPreparedCount;
+   used += mUsedCount;
+
+   mPreparedCount = 0;
+   mUsedCount = 0;
+}
+
+
+};
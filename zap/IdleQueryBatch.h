@@ -0,0 +1,72 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _IDLE_QUERY_BATCH_H_
+#define _IDLE_QUERY_BATCH_H_
+
+#include "gridDB.h"
+
+#include "tnlThread.h"
+
+using namespace TNL;
+
+namespace Zap
+{
+
+class BfObject;
+
+// Runs the database searches that objects' idle() methods start with (see BfObject::getIdleQuery()) on a
+// WorkerPool, before ServerGame idles the objects one at a time.  Objects still idle in their usual order, so
+// an earlier object can change what a later one would find; each result is remembered along with the revision of
+// the part of the database it came from, and is only handed out if nothing there has changed since.  Otherwise
+// the object just does its own search, so results are always the same as without the batch.
+class IdleQueryBatch : public WorkerPool::Job
+{
+private:
+   struct PreparedQuery
+   {
+      BfObject *object;
+      TestFunc testFunc;
+      Rect queryRect;
+      U32 revision;                       // GridDatabase::getRevision(queryRect) when the search was done
+      bool used;
+      Vector<DatabaseObject *> results;
+   };
+
+   static const S32 ChunkSize = 16;       // Queries per work item; each chunk shares a DatabaseQuery
+
+   GridDatabase *mDatabase;
+   Vector<PreparedQuery> mQueries;
+   Vector<S32> mQueryIndex;               // Index into mQueries for each object passed to prepare(), or -1
+   Vector<DatabaseQuery *> mDatabaseQueries;
+   S32 mQueryCount;
+   S32 mCurrentObject;                    // Index of the object being idled, or -1
+
+   U32 mPreparedCount;
+   U32 mUsedCount;
+
+public:
+   IdleQueryBatch();             // Constructor
+   virtual ~IdleQueryBatch();    // Destructor
+
+   // Searches for every object in objects that has an idle query, spreading the work over pool
+   void prepare(GridDatabase *database, const Vector<DatabaseObject *> &objects, U32 timeDelta, WorkerPool *pool);
+   void runItem(S32 index);
+
+   // ServerGame calls this with each object's index in the list passed to prepare() right before idling it
+   void setCurrentObject(S32 index);
+   void finish();
+
+   // Fills fillVector and returns true if the search object is about to do was already done, and is still good
+   bool findObjects(const BfObject *object, TestFunc testFunc, const Rect &queryRect, Vector<DatabaseObject *> &fillVector);
+
+   // Adds up how many queries were prepared, and how many of those were used, since the last call
+   void collectTotals(U32 &prepared, U32 &used);
+};
+
+
+};
+
+#endif
@@ -14,6 +14,8 @@
 
 #include "tnlAssert.h"
 
+#include <sys/stat.h>
+
 
 namespace Zap
 {
@@ -267,6 +269,36 @@ bool LevelSource::populateLevelInfoFromSource(const string &fullFilename, S32 in
 }
 
 
+// Games cycling through the same levels (such as the instances of a multi-instance dedicated server) read and hash
+// each level file once, and only again if it has been modified since
+string LevelSource::loadLevelFile(const string &filename, Game *game, GridDatabase *gameObjectDatabase)
+{
+   struct stat st;
+   if(stat(filename.c_str(), &st) != 0)
+      return "";
+
+   CachedLevelFile &cached = mLevelFileCache[filename];
+
+   if(cached.contents == "" || cached.modTime != S64(st.st_mtime) || cached.size != S64(st.st_size))
+   {
+      cached.contents = readFile(filename);
+      cached.hash = Game::md5.getHashFromFile(filename);     // Hash the file as is, BOM and all, as the master expects
+      cached.modTime = S64(st.st_mtime);
+      cached.size = S64(st.st_size);
+   }
+
+   if(cached.contents == "")
+   {
+      mLevelFileCache.erase(filename);
+      return "";
+   }
+
+   game->loadLevelFromString(cached.contents, gameObjectDatabase, filename);
+
+   return cached.hash;
+}
+
+
 // Should be overridden in each subclass of LevelSource
 bool LevelSource::loadLevels(FolderManager *folderManager)
 {
@@ -327,13 +359,12 @@ string MultiLevelSource::loadLevel(S32 index, Game *game, GridDatabase *gameObje
       return "";
    }
 
-   if(game->loadLevelFromFile(filename, gameObjectDatabase))
-      return Game::md5.getHashFromFile(filename);    // TODO: Combine this with the reading of the file we're doing anyway in initLevelFromFile()
-   else
-   {
+   string hash = loadLevelFile(filename, game, gameObjectDatabase);
+
+   if(hash == "")
       logprintf("Unable to process level file \"%s\".  Skipping...", levelInfo->filename.c_str());
-      return "";
-   }
+
+   return hash;
 }
 
 
@@ -428,13 +459,12 @@ string FileListLevelSource::loadLevel(S32 index, Game *game, GridDatabase *gameO
       return "";
    }
 
-   if(game->loadLevelFromFile(filename, gameObjectDatabase))
-      return Game::md5.getHashFromFile(filename);   
-   else
-   {
+   string hash = loadLevelFile(filename, game, gameObjectDatabase);
+
+   if(hash == "")
       logprintf("Unable to process level file \"%s\".  Skipping...", levelInfo->filename.c_str());
-      return "";
-   }
+
+   return hash;
 }
 
 
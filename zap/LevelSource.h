@@ -14,6 +14,7 @@
 
 #include <string>
 #include <memory>
+#include <map>
 
 using namespace TNL;
 using namespace std;
@@ -61,9 +62,24 @@ struct FolderManager;
 
 class LevelSource
 {
+private:
+   struct CachedLevelFile
+   {
+      string contents;
+      string hash;
+      S64 modTime;
+      S64 size;
+   };
+
+   // Level files as last read from disk; every game hosting from this LevelSource shares these
+   map<string, CachedLevelFile> mLevelFileCache;
+
 protected:
    Vector<LevelInfo> mLevelInfos;   // Info about these levels
 
+   // Loads filename into gameObjDatabase, rereading it only if it changed on disk.  Returns md5 hash of level, or "".
+   string loadLevelFile(const string &filename, Game *game, GridDatabase *gameObjDatabase);
+
 public:
    static const string TestFileName;
 
@@ -270,6 +270,12 @@ F32 LineItem::getUpdatePriority(GhostConnection *connection, U32 updateMask, S32
 }
 
 
+bool LineItem::hasBatchedUpdatePriority()
+{
+   return false;     // Our getUpdatePriority() needs to be called
+}
+
+
 S32 LineItem::getWidth() const
 {
    return mWidth;
@@ -0,0 +1,260 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "LuaAllocator.h"
+
+#include "tnlAssert.h"
+#include "tnlLog.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace Zap
+{
+
+// Constructor
+LuaAllocator::LuaAllocator(lua_State *L, bool pooled)
+{
+   mL = L;
+   mBaseAlloc = lua_getallocf(L, &mBaseAllocData);
+
+   mPooled = pooled;
+   mClosing = false;
+
+   for(S32 i = 0; i < SizeClassCount; i++)
+      mFreeBlocks[i] = NULL;
+
+   mChunkFree = NULL;
+   mChunkEnd = NULL;
+   mPooledBlocks = 0;
+
+   mBytesAllocated = 0;
+   mBytesInUse = 0;
+}
+
+
+// Destructor
+LuaAllocator::~LuaAllocator()
+{
+   TNLAssert(mChunks.size() == 0, "Chunks should have been handed back when the state closed!");
+}
+
+
+void LuaAllocator::install(lua_State *L, bool pooled)
+{
+   LuaAllocator *allocator = new LuaAllocator(L, pooled);    // Deleted in closeState()
+   lua_setallocf(L, allocate, allocator);
+}
+
+
+LuaAllocator *LuaAllocator::get(lua_State *L)
+{
+   void *data;
+   if(lua_getallocf(L, &data) != allocate)
+      return NULL;
+
+   return (LuaAllocator *)data;
+}
+
+
+// LuaJIT frees everything its own allocator handed out in one go when a state closes, but only if that's still
+// the allocator the state is using.  So we let it free its objects one by one until none of them are in our pools,
+// then hand our chunks back and get out of the way before it gets that far.
+void LuaAllocator::closeState(lua_State *L)
+{
+   LuaAllocator *allocator = get(L);
+
+   if(allocator)
+   {
+      allocator->mClosing = true;
+
+      if(allocator->mPooledBlocks == 0)
+         allocator->releaseChunks();
+   }
+
+   lua_close(L);
+
+   if(!allocator)
+      return;
+
+   // Some of our blocks were never freed, so LuaJIT never got its allocator back.  Nothing can use those blocks
+   // now the state is gone, so the chunks go back regardless; LuaJIT's own arena is lost with them.
+   if(allocator->mChunks.size() > 0)
+   {
+      logprintf(LogConsumer::LogError, "Lua state closed with %d pooled blocks still outstanding",
+                allocator->mPooledBlocks);
+      allocator->freeChunks();
+   }
+
+   delete allocator;
+}
+
+
+void *LuaAllocator::allocate(void *data, void *ptr, size_t oldSize, size_t newSize)
+{
+   return ((LuaAllocator *)data)->reallocate(ptr, oldSize, newSize);
+}
+
+
+// Same contract as lua_Alloc: frees when newSize is 0, allocates when ptr is NULL, and otherwise resizes
+void *LuaAllocator::reallocate(void *ptr, size_t oldSize, size_t newSize)
+{
+   if(newSize > oldSize)
+      mBytesAllocated += newSize - oldSize;
+
+   mBytesInUse += newSize;
+   mBytesInUse -= ptr ? oldSize : 0;
+
+   if(!mPooled)
+      return mBaseAlloc(mBaseAllocData, ptr, oldSize, newSize);
+
+   bool oldPooled = ptr && oldSize <= MaxPooledSize && ownsBlock(ptr);
+   S32 oldClass = oldPooled ? S32((oldSize - 1) / SizeClassSize) : -1;
+   S32 newClass = newSize > 0 && newSize <= MaxPooledSize ? S32((newSize - 1) / SizeClassSize) : -1;
+
+   // Neither block is ours, so it's LuaJIT's business
+   if(!oldPooled && newClass == -1)
+      return mBaseAlloc(mBaseAllocData, ptr, oldSize, newSize);
+
+   // Still fits where it is
+   if(oldPooled && oldClass == newClass)
+      return ptr;
+
+   void *newPtr = NULL;
+
+   if(newClass != -1)
+      newPtr = allocatePooled(newClass);
+   else if(newSize > 0)
+      newPtr = mBaseAlloc(mBaseAllocData, NULL, 0, newSize);
+
+   if(newSize > 0 && !newPtr)
+      return NULL;                  // Lua expects the old block to be left alone when it can't get a new one
+
+   if(ptr && newPtr)
+      memcpy(newPtr, ptr, std::min(oldSize, newSize));
+
+   if(oldPooled)
+      freePooled(ptr, oldClass);
+   else if(ptr)
+      mBaseAlloc(mBaseAllocData, ptr, oldSize, 0);
+
+   return newPtr;
+}
+
+
+void *LuaAllocator::allocatePooled(S32 sizeClass)
+{
+   TNLAssert(!mClosing, "Nothing should be allocated while the state is closing!");
+
+   mPooledBlocks++;
+
+   FreeBlock *block = mFreeBlocks[sizeClass];
+
+   if(block)
+   {
+      mFreeBlocks[sizeClass] = block->next;
+      return block;
+   }
+
+   size_t blockSize = (sizeClass + 1) * SizeClassSize;
+
+   if(size_t(mChunkEnd - mChunkFree) < blockSize)
+   {
+      // What's left of the old chunk is too small to be worth keeping track of, and is simply not used
+      char *chunk = (char *)mBaseAlloc(mBaseAllocData, NULL, 0, ChunkSize);
+
+      if(!chunk)
+      {
+         mPooledBlocks--;
+         return NULL;
+      }
+
+      char **chunks = mChunks.address();
+      mChunks.insert(S32(std::upper_bound(chunks, chunks + mChunks.size(), chunk) - chunks), chunk);
+      mChunkFree = chunk;
+      mChunkEnd = chunk + ChunkSize;
+   }
+
+   void *ptr = mChunkFree;
+   mChunkFree += blockSize;
+
+   return ptr;
+}
+
+
+void LuaAllocator::freePooled(void *ptr, S32 sizeClass)
+{
+   mPooledBlocks--;
+
+   // Closing states never allocate again, so there's no point in keeping a free list
+   if(mClosing)
+   {
+      if(mPooledBlocks == 0)
+         releaseChunks();
+
+      return;
+   }
+
+   FreeBlock *block = (FreeBlock *)ptr;
+   block->next = mFreeBlocks[sizeClass];
+   mFreeBlocks[sizeClass] = block;
+}
+
+
+bool LuaAllocator::ownsBlock(const void *ptr) const
+{
+   if(mChunks.size() == 0)
+      return false;
+
+   // Find the last chunk that starts at or before ptr
+   char * const *chunks = mChunks.address();
+   char * const *next = std::upper_bound(chunks, chunks + mChunks.size(), (char *)ptr);
+
+   if(next == chunks)
+      return false;
+
+   return (const char *)ptr < *(next - 1) + ChunkSize;
+}
+
+
+// Only once the state is closing and all our blocks are free; LuaJIT takes back over from here
+void LuaAllocator::releaseChunks()
+{
+   TNLAssert(mClosing && mPooledBlocks == 0, "Chunks are still in use!");
+
+   freeChunks();
+
+   lua_setallocf(mL, mBaseAlloc, mBaseAllocData);
+}
+
+
+void LuaAllocator::freeChunks()
+{
+   for(S32 i = 0; i < mChunks.size(); i++)
+      mBaseAlloc(mBaseAllocData, mChunks[i], ChunkSize, 0);
+
+   mChunks.clear();
+}
+
+
+bool LuaAllocator::isPooled() const
+{
+   return mPooled;
+}
+
+
+U64 LuaAllocator::getBytesAllocated() const
+{
+   return mBytesAllocated;
+}
+
+
+U64 LuaAllocator::getBytesInUse() const
+{
+   return mBytesInUse;
+}
+
+
+};
@@ -0,0 +1,82 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _LUA_ALLOCATOR_H_
+#define _LUA_ALLOCATOR_H_
+
+#include "LuaInc.h"
+
+#include "tnlTypes.h"
+#include "tnlVector.h"
+
+using namespace TNL;
+
+namespace Zap
+{
+
+// Sits between a Lua state and LuaJIT's own allocator, keeping count of the memory the state asks for.  When
+// pooled, small blocks (most tables, strings and closures) come from per-state free lists, one for each size
+// class, carved out of larger chunks; bigger blocks still go to LuaJIT.
+//
+// On 64-bit builds LuaJIT needs all its objects in the low 2GB, and only its own allocator knows how to put them
+// there, so we can't replace it outright: our chunks come from it too.  That also means a state must be closed
+// with closeState(), never lua_close(), so LuaJIT gets its allocator back before it tears everything down.
+class LuaAllocator
+{
+private:
+   enum {
+      SizeClassSize = 16,                                // Pooled block sizes are multiples of this
+      MaxPooledSize = 256,                               // Anything bigger goes straight to LuaJIT
+      SizeClassCount = MaxPooledSize / SizeClassSize,
+      ChunkSize = 64 * 1024,                             // Pools are carved out of chunks this big
+   };
+
+   struct FreeBlock
+   {
+      FreeBlock *next;
+   };
+
+   lua_State *mL;
+   lua_Alloc mBaseAlloc;                  // LuaJIT's allocator, and its data
+   void *mBaseAllocData;
+
+   bool mPooled;
+   bool mClosing;
+
+   FreeBlock *mFreeBlocks[SizeClassCount];
+   Vector<char *> mChunks;                // Sorted by address, so we can tell our blocks from LuaJIT's
+   char *mChunkFree;                      // Part of the newest chunk not yet handed out
+   char *mChunkEnd;
+   S32 mPooledBlocks;                     // Handed out and not yet returned
+
+   U64 mBytesAllocated;
+   U64 mBytesInUse;
+
+   LuaAllocator(lua_State *L, bool pooled);     // Constructor
+   ~LuaAllocator();                             // Destructor
+
+   static void *allocate(void *data, void *ptr, size_t oldSize, size_t newSize);
+
+   void *reallocate(void *ptr, size_t oldSize, size_t newSize);
+   void *allocatePooled(S32 sizeClass);
+   void freePooled(void *ptr, S32 sizeClass);
+   bool ownsBlock(const void *ptr) const;
+   void releaseChunks();
+   void freeChunks();
+
+public:
+   static void install(lua_State *L, bool pooled);    // Put an allocator in front of a newly opened state
+   static LuaAllocator *get(lua_State *L);            // NULL if the state doesn't have one
+   static void closeState(lua_State *L);              // Use instead of lua_close() on states with an allocator
+
+   bool isPooled() const;
+   U64 getBytesAllocated() const;         // Everything the state has asked for; nothing is subtracted for frees
+   U64 getBytesInUse() const;
+};
+
+
+};
+
+#endif
@@ -4,6 +4,7 @@
 //------------------------------------------------------------------------------
 
 #include "LuaScriptRunner.h"   // Header
+#include "LuaAllocator.h"
 #include "LuaModule.h"
 #include "BfObject.h"
 #include "ship.h"
@@ -25,7 +26,9 @@
 #include <clipper.hpp>
 
 #include "tnlLog.h"            // For logprintf
+#include "tnlPlatform.h"       // For getHighPrecisionTimerValue
 #include "tnlRandom.h"
+#include "tnlThread.h"
 
 #include <iostream>            // For enum code
 #include <sstream>             // For enum code
@@ -41,6 +44,10 @@ namespace Zap
 // Declare and Initialize statics:
 lua_State *LuaScriptRunner::L = NULL;
 string LuaScriptRunner::mScriptingDir;
+bool LuaScriptRunner::mRunningInParallel = false;
+bool LuaScriptRunner::mCountInstructions = false;
+bool LuaScriptRunner::mPooledAllocation = false;
+U32 LuaScriptRunner::mTickBudget = 0;
 
 deque<string> LuaScriptRunner::mCachedScripts;
 
@@ -48,7 +55,7 @@ void LuaScriptRunner::clearScriptCache()
 {
 	while(mCachedScripts.size() != 0)
 	{
-		deleteScript(mCachedScripts.front().c_str());
+		deleteScript(L, mCachedScripts.front().c_str());
 		mCachedScripts.pop_front();
 	}
 }
@@ -70,6 +77,19 @@ LuaScriptRunner::LuaScriptRunner()
    mScriptId = "script" + itos(mNextScriptId++);
    mScriptType = ScriptTypeInvalid;
 
+   mOwnL = NULL;
+   mRunningOnWorker = false;
+   mParallelIndex = 0;
+   mWorkerErrorHasStack = false;
+
+   mCallStartTime = 0;
+   mCallWaitTime = 0;
+   mCallDepth = 0;
+   mCallBudgeted = false;
+   mCallInstructions = 0;
+   mBudgetDebt = 0;
+   mDeferredTickTime = 0;
+
    LUAW_CONSTRUCTOR_INITIALIZATIONS;
 }
 
@@ -86,8 +106,11 @@ LuaScriptRunner::~LuaScriptRunner()
    // Clean-up any game objects that were added in Lua with '.new()' but not added
    // with bf:addItem()
 
-   // And delete the script's environment table from the Lua instance
-   deleteScript(getScriptId());
+   // And delete the script's environment table from the Lua instance, or the whole instance if it's ours alone
+   if(mOwnL)
+      LuaAllocator::closeState(mOwnL);
+   else
+      deleteScript(L, getScriptId());
 
    LUAW_DESTRUCTOR_CLEANUP;
 }
@@ -107,12 +130,613 @@ void LuaScriptRunner::shutdown()
 {
    if(L)
    {
-      lua_close(L);
+      LuaAllocator::closeState(L);
       L = NULL;
    }
 }
 
 
+////////////////////////////////////////
+////////////////////////////////////////
+// Profiling
+
+static const S32 InstructionHookInterval = 1000;   // Instructions run between calls to the hook
+static const U32 BudgetKillMultiple = 10;          // Calls running this many times the budget get stopped
+
+// Constructor
+LuaScriptProfile::LuaScriptProfile()
+{
+   calls = 0;
+   time = 0;
+   instructions = 0;
+   bytesAllocated = 0;
+   deferredTicks = 0;
+}
+
+
+void LuaScriptProfile::add(const LuaScriptProfile &profile)
+{
+   calls          += profile.calls;
+   time           += profile.time;
+   instructions   += profile.instructions;
+   bytesAllocated += profile.bytesAllocated;
+   deferredTicks  += profile.deferredTicks;
+}
+
+
+static U64 getBytesAllocated(lua_State *L)
+{
+   LuaAllocator *allocator = LuaAllocator::get(L);
+   return allocator ? allocator->getBytesAllocated() : 0;
+}
+
+
+// Called on every state we create, once it's been opened
+void LuaScriptRunner::prepareLuaState(lua_State *L)
+{
+   LuaAllocator::install(L, mPooledAllocation);
+
+   if(mCountInstructions || mTickBudget > 0)
+      lua_sethook(L, instructionHook, LUA_MASKCOUNT, InstructionHookInterval);
+}
+
+
+// Charges the script now running for the instructions since the last call, and stops it if it's been running far
+// too long.  LuaJIT doesn't call hooks from compiled code, so loops it has compiled escape both.
+void LuaScriptRunner::instructionHook(lua_State *L, lua_Debug *ar)
+{
+   lua_getfield(L, LUA_REGISTRYINDEX, PROFILED_SCRIPT_KEY);    // -- runner
+   LuaScriptRunner *runner = (LuaScriptRunner *)lua_touserdata(L, -1);
+   lua_pop(L, 1);                                              // --
+
+   if(!runner)
+      return;
+
+   runner->mCallInstructions += InstructionHookInterval;
+
+   if(mTickBudget == 0 || !runner->mCallBudgeted)
+      return;
+
+   S64 runTime = Platform::getHighPrecisionTimerValue() - runner->mCallStartTime - runner->mCallWaitTime;
+   F64 elapsed = Platform::getHighPrecisionMilliseconds(runTime);
+
+   if(elapsed > mTickBudget * BudgetKillMultiple)
+      luaL_error(L, "Script ran for %d ms, over %d times its budget of %d ms; stopping it", 
+                 S32(elapsed), BudgetKillMultiple, mTickBudget);
+}
+
+
+// Only affects L, and states created from here on
+void LuaScriptRunner::setProfilingOptions(bool countInstructions, U32 tickBudget)
+{
+   mCountInstructions = countInstructions;
+   mTickBudget = tickBudget;
+
+   if(!L)
+      return;
+
+   if(mCountInstructions || mTickBudget > 0)
+      lua_sethook(L, instructionHook, LUA_MASKCOUNT, InstructionHookInterval);
+   else
+      lua_sethook(L, NULL, 0, 0);
+}
+
+
+bool LuaScriptRunner::isCountingInstructions()
+{
+   return mCountInstructions;
+}
+
+
+void LuaScriptRunner::setPooledAllocation(bool pooled)
+{
+   mPooledAllocation = pooled;
+}
+
+
+// Only scripts with a Lua state to themselves know how much memory they're holding on to
+U64 LuaScriptRunner::getMemoryInUse()
+{
+   LuaAllocator *allocator = mOwnL ? LuaAllocator::get(mOwnL) : NULL;
+   return allocator ? allocator->getBytesInUse() : 0;
+}
+
+
+const LuaScriptProfile &LuaScriptRunner::getProfile() const
+{
+   return mProfile;
+}
+
+
+LuaScriptProfile LuaScriptRunner::takeRecentProfile()
+{
+   LuaScriptProfile profile = mRecentProfile;
+   mRecentProfile = LuaScriptProfile();
+
+   return profile;
+}
+
+
+string LuaScriptRunner::getProfileName()
+{
+   return mScriptName == "" ? string(getScriptId()) : extractFilename(mScriptName);
+}
+
+
+// Each tick works off one budget's worth of whatever time we've spent over it.  Until it's all worked off, we
+// skip onTick, and the time we miss gets passed along when we run again.
+bool LuaScriptRunner::deferTick(U32 &deltaT)
+{
+   if(mTickBudget == 0)
+      return false;
+
+   mBudgetDebt = max(mBudgetDebt - mTickBudget, 0.0);
+
+   if(mBudgetDebt > 0)
+   {
+      mDeferredTickTime += deltaT;
+      mProfile.deferredTicks++;
+      mRecentProfile.deferredTicks++;
+      return true;
+   }
+
+   deltaT += mDeferredTickTime;
+   mDeferredTickTime = 0;
+
+   return false;
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+// Scripts with Lua states of their own
+
+// While scripts run on worker threads, only one of them at a time may call into the game
+static Mutex gameCallLock;
+
+// Calls that have to wait their turn are made in the order the scripts would have run in one at a time.  A script's
+// turn comes when every script before it has finished.  turnSignals only grows, so the same semaphores get used tick
+// after tick; each is only signaled if its script is waiting on it, so none are left holding a count between runs.
+static Mutex turnLock;
+static Vector<bool> finishedTurns;
+static Vector<bool> waitingTurns;
+static Vector<Semaphore *> turnSignals;
+static S32 currentTurn;
+
+
+// Returns the script that owns the Lua state, or NULL for L
+static LuaScriptRunner *getOwningScript(lua_State *L)
+{
+   lua_getfield(L, LUA_REGISTRYINDEX, OWNING_SCRIPT_KEY);   // -- script
+   LuaScriptRunner *script = static_cast<LuaScriptRunner *>(lua_touserdata(L, -1));
+   lua_pop(L, 1);                                           // --
+
+   return script;
+}
+
+
+// Calls the function in upvalue 1 with our args
+static int callNow(lua_State *L)
+{
+   S32 argCount = lua_gettop(L);
+
+   lua_pushvalue(L, lua_upvalueindex(1));    // -- <<args>>, fn
+   lua_insert(L, 1);                         // -- fn, <<args>>
+
+   if(!LuaScriptRunner::isRunningInParallel())
+   {
+      lua_call(L, argCount, LUA_MULTRET);    // -- <<results>>
+      return lua_gettop(L);
+   }
+
+   LuaScriptRunner *script = getOwningScript(L);
+
+   // Catch any error, so we don't leave the lock held
+   script->lockGameCalls();
+   S32 error = lua_pcall(L, argCount, LUA_MULTRET, 0);
+   script->unlockGameCalls();
+
+   if(error)
+      return lua_error(L);                   // Pass the message on
+
+   return lua_gettop(L);
+}
+
+
+// Waits until the scripts ahead of ours have finished, then calls the function in upvalue 1 with our args
+static int callInTurn(lua_State *L)
+{
+   if(LuaScriptRunner::isRunningInParallel())
+      getOwningScript(L)->waitForTurn();
+
+   return callNow(L);
+}
+
+
+// Calls the function in upvalue 1 right away if our first arg is the bot this Lua state belongs to, otherwise
+// waits our turn
+static int callNowOnSelf(lua_State *L)
+{
+   if(!LuaScriptRunner::isRunningInParallel())
+      return callNow(L);
+
+   BfObject *obj = luaW_to<BfObject>(L, 1);
+   LuaScriptRunner *script = getOwningScript(L);
+
+   if(obj && dynamic_cast<LuaScriptRunner *>(obj) == script)
+      return callNow(L);
+
+   script->waitForTurn();
+   return callNow(L);
+}
+
+
+// While scripts run on worker threads, calls that could change the game are saved, along with their args, so
+// finishWorkerRun() can make them on the main thread, in order, once everyone is done.  They return nothing.
+static int callLater(lua_State *L)
+{
+   if(!LuaScriptRunner::isRunningInParallel())
+      return callNow(L);
+
+   S32 argCount = lua_gettop(L);
+
+   lua_getfield(L, LUA_REGISTRYINDEX, QUEUED_CALLS_KEY);    // -- <<args>>, queue
+   lua_createtable(L, argCount + 1, 1);                     // -- <<args>>, queue, call
+
+   lua_pushvalue(L, lua_upvalueindex(1));                   // -- <<args>>, queue, call, fn
+   lua_rawseti(L, -2, 1);                                   // -- <<args>>, queue, call
+
+   for(S32 i = 1; i <= argCount; i++)
+   {
+      lua_pushvalue(L, i);                                  // -- <<args>>, queue, call, arg
+      lua_rawseti(L, -2, i + 1);                            // -- <<args>>, queue, call
+   }
+
+   lua_pushinteger(L, argCount);                            // -- <<args>>, queue, call, argCount
+   lua_setfield(L, -2, "n");                                // -- <<args>>, queue, call
+
+   lua_rawseti(L, -2, (S32)lua_objlen(L, -2) + 1);          // -- <<args>>, queue
+
+   return 0;
+}
+
+
+// Methods that only look at the game.  While scripts run in parallel, the only things changing are the bots' moves
+// (see selfMethods) and what callInTurn() calls; these don't look at either.
+static const char *readOnlyMethods[] = {
+   "BfObject.getObjType", "BfObject.getId", "BfObject.getPos", "BfObject.getTeamIndex", "BfObject.getGeom",
+   "BfObject.isSelected", "BfObject.getOwner",
+   "CoreItem.getCurrentHealth", "CoreItem.getFullHealth", "CoreItem.getRotationSpeed",
+   "EngineeredItem.isActive", "EngineeredItem.getMountAngle", "EngineeredItem.getHealth",
+   "EngineeredItem.getDisabledThreshold", "EngineeredItem.getHealRate", "EngineeredItem.getEngineered",
+   "Turret.getAimAngle",
+   "LineItem.getGlobal",
+   "LuaScriptRunner.pointCanSeePoint", "LuaScriptRunner.findObjectById", "LuaScriptRunner.findAllObjects",
+   "LuaScriptRunner.findAllObjectsInArea", "LuaScriptRunner.getGameInfo", "LuaScriptRunner.getPlayerCount",
+   "NexusZone.isOpen",
+   "PickupItem.isVis", "PickupItem.getRegenTime",
+   "SlipZone.getSlipFactor",
+   "ItemSpawn.getSpawnTime",
+   "Teleporter.getDest", "Teleporter.getDestCount", "Teleporter.getEngineered", "Teleporter.getDelay",
+   "TextItem.getText",
+   "Zone.containsPoint",
+   "WallItem.getWidth",
+   "FlagItem.isInInitLoc", "FlagItem.getFlagCount",
+   "GoalZone.hasFlag",
+   "Item.getRad", "Item.getShip", "Item.isInCaptureZone", "Item.getCaptureZone",
+   "GameInfo.getGameType", "GameInfo.getGameTypeName", "GameInfo.getFlagCount", "GameInfo.getWinningScore",
+   "GameInfo.getGameTimeTotal", "GameInfo.getGameTimeRemaining", "GameInfo.getLeadingScore", "GameInfo.getLeadingTeam",
+   "GameInfo.getTeamCount", "GameInfo.getLevelName", "GameInfo.isTeamGame", "GameInfo.getEventScore",
+   "GameInfo.getPlayers", "GameInfo.isNexusOpen", "GameInfo.getNexusTimeLeft", "GameInfo.getTeam",
+   "MoveObject.getVel", "MoveObject.getAngle",
+   "MountableItem.getShip", "MountableItem.isOnShip",
+   "Asteroid.getSizeIndex", "Asteroid.getSizeCount",
+   "PlayerInfo.getName", "PlayerInfo.getShip", "PlayerInfo.getTeamIndex", "PlayerInfo.getRating",
+   "PlayerInfo.getScore", "PlayerInfo.isRobot", "PlayerInfo.getScriptName",
+   "Projectile.getRad", "Projectile.getWeapon", "Projectile.getVel",
+   "Burst.getWeapon",
+   "Seeker.getWeapon",
+   "Robot.getAnglePt", "Robot.canSeePoint", "Robot.isPathReady", "Robot.getPath", "Robot.hasWeapon",
+   "Robot.hasModule", "Robot.findVisibleObjects", "Robot.findClosestEnemy", "Robot.getFiringSolution",
+   "Robot.getInterceptCourse",
+   "Ship.isAlive", "Ship.getPlayerInfo", "Ship.isModActive", "Ship.getEnergy", "Ship.getHealth", "Ship.hasFlag",
+   "Ship.getFlagCount", "Ship.getActiveWeapon", "Ship.getMountedItems", "Ship.getLoadout",
+   "SpeedZone.getDir", "SpeedZone.getSpeed", "SpeedZone.getSnapping",
+   "Team.getIndex", "Team.getName", "Team.getScore", "Team.getPlayerCount", "Team.getPlayers", "Team.getColor",
+};
+
+// Methods that set or look at a bot's move.  A bot's own move is its business, but other bots' moves change as
+// those bots run.
+static const char *selfMethods[] = {
+   "Robot.setAngle", "Robot.setThrust", "Robot.setThrustToPt", "Robot.fireWeapon", "Robot.fireModule", "Ship.getAngle",
+};
+
+// Methods that give an answer, but change something other scripts can see: paths go into a cache all bots share,
+// and new objects are numbered from a shared counter, as is every class's new().  copyMoveFromObject() looks at
+// another bot's move.  The rest change the game, but say how it went, which a saved call couldn't.
+static const char *inTurnMethods[] = {
+   "Robot.getWaypoint", "Robot.requestPath", "Robot.copyMoveFromObject", "BfObject.clone",
+   "Robot.engineerDeployObject", "EngineeredItem.setEngineered", "EngineeredItem.setHealRate",
+   "Teleporter.setEngineered",
+};
+
+// Functions not associated with a class that share something with other scripts: the game's random numbers, and files
+static const char *inTurnFunctions[] = {
+   "getRandomNumber", "readFromFile", "writeToFile",
+};
+
+
+static bool isListed(const char *classname, const char *name, const char **list, U32 count)
+{
+   string fullName = string(classname) + "." + name;
+
+   for(U32 i = 0; i < count; i++)
+      if(fullName == list[i])
+         return true;
+
+   return false;
+}
+
+
+// Used as the LuaWrapper function wrapper in scripts' own Lua states -- takes a class name, a function's name and
+// the function, and returns what gets registered in its place.  Anything not listed above changes the game, and
+// waits for callLater().
+static int wrapClassFunction(lua_State *L)
+{
+   const char *classname = lua_tostring(L, 1);
+   const char *name = lua_tostring(L, 2);                   // -- classname, name, fn
+
+   // Metamethods only look at Lua tables, and are called far too often to be worth locking
+   if(strncmp(name, "__", 2) == 0)
+      return 1;
+
+   lua_CFunction wrapper;
+
+   if(isListed(classname, name, readOnlyMethods, ARRAYSIZE(readOnlyMethods)))
+      wrapper = callNow;
+   else if(isListed(classname, name, selfMethods, ARRAYSIZE(selfMethods)))
+      wrapper = callNowOnSelf;
+   else if(strcmp(name, "new") == 0 || isListed(classname, name, inTurnMethods, ARRAYSIZE(inTurnMethods)))
+      wrapper = callInTurn;
+   else
+      wrapper = callLater;
+
+   lua_pushcclosure(L, wrapper, 1);                         // -- classname, name, wrapped_fn
+   return 1;
+}
+
+
+// Other functions not associated with a class don't touch the game, so can always be called right away
+static void pushLooseFunction(lua_State *L, const char *name, lua_CFunction function)
+{
+   lua_pushcfunction(L, function);                          // -- fn
+
+   lua_getfield(L, LUA_REGISTRYINDEX, QUEUED_CALLS_KEY);    // -- fn, queue
+   bool ownState = !lua_isnil(L, -1);
+   lua_pop(L, 1);                                           // -- fn
+
+   if(!ownState)
+      return;
+
+   bool inTurn = false;
+   for(U32 i = 0; i < ARRAYSIZE(inTurnFunctions); i++)
+      if(strcmp(name, inTurnFunctions[i]) == 0)
+         inTurn = true;
+
+   lua_pushcclosure(L, inTurn ? callInTurn : callNow, 1);   // -- wrapped_fn
+}
+
+
+bool LuaScriptRunner::createOwnLuaState()
+{
+   TNLAssert(!mOwnL, "Already have a Lua state!");
+
+   mOwnL = lua_open();
+
+   if(!mOwnL)
+   {
+      logError("Could not create a Lua state for this script.");
+      return false;
+   }
+
+   prepareLuaState(mOwnL);
+
+   // Set these up before anything gets registered
+   lua_newtable(mOwnL);
+   lua_setfield(mOwnL, LUA_REGISTRYINDEX, QUEUED_CALLS_KEY);
+
+   lua_pushlightuserdata(mOwnL, this);
+   lua_setfield(mOwnL, LUA_REGISTRYINDEX, OWNING_SCRIPT_KEY);
+
+   lua_pushcfunction(mOwnL, wrapClassFunction);
+   lua_setfield(mOwnL, LUA_REGISTRYINDEX, LUAW_FUNCTION_WRAPPER_KEY);
+
+   if(!configureNewLuaInstance(mOwnL))
+   {
+      LuaAllocator::closeState(mOwnL);
+      mOwnL = NULL;
+      return false;
+   }
+
+   return true;
+}
+
+
+bool LuaScriptRunner::hasOwnLuaState() const
+{
+   return mOwnL != NULL;
+}
+
+
+lua_State *LuaScriptRunner::getLuaState() const
+{
+   return mOwnL ? mOwnL : L;
+}
+
+
+// Only the main thread should call these, before and after the worker threads run scripts.  scripts are listed in
+// the order they'd run in one at a time.
+void LuaScriptRunner::startParallelRun(const Vector<LuaScriptRunner *> &scripts)
+{
+   finishedTurns.resize(scripts.size());
+   waitingTurns.resize(scripts.size());
+   currentTurn = 0;
+
+   while(turnSignals.size() < scripts.size())
+      turnSignals.push_back(new Semaphore());
+
+   for(S32 i = 0; i < scripts.size(); i++)
+   {
+      scripts[i]->mParallelIndex = i;
+      finishedTurns[i] = false;
+      waitingTurns[i] = false;
+
+      // Anything Lua lets go of waits for finishWorkerRun(), so game objects are only ever deleted on the main thread
+      lua_gc(scripts[i]->getLuaState(), LUA_GCSTOP, 0);
+   }
+
+   mRunningInParallel = true;
+}
+
+
+void LuaScriptRunner::endParallelRun()
+{
+   mRunningInParallel = false;
+
+   finishedTurns.clear();
+   waitingTurns.clear();
+}
+
+
+bool LuaScriptRunner::isRunningInParallel()
+{
+   return mRunningInParallel;
+}
+
+
+void LuaScriptRunner::runCmdOnWorker(const char *function, S32 argCount)
+{
+   TNLAssert(mOwnL, "Scripts sharing L can't run on worker threads!");
+
+   mRunningOnWorker = true;
+   runCmd(function, argCount, 0);
+   mRunningOnWorker = false;
+
+   // Pass the turn along to the first script that hasn't finished yet
+   turnLock.lock();
+
+   finishedTurns[mParallelIndex] = true;
+
+   S32 lastTurn = currentTurn;
+   while(currentTurn < finishedTurns.size() && finishedTurns[currentTurn])
+      currentTurn++;
+
+   if(currentTurn != lastTurn && currentTurn < waitingTurns.size() && waitingTurns[currentTurn])
+      turnSignals[currentTurn]->increment();
+
+   turnLock.unlock();
+}
+
+
+// Blocks until every script ahead of ours in this parallel run has finished.  Since scripts are handed to the workers
+// in order, those scripts have all been started already, so they will finish.
+void LuaScriptRunner::waitForTurn()
+{
+   turnLock.lock();
+   bool ourTurn = (currentTurn == mParallelIndex);
+   waitingTurns[mParallelIndex] = !ourTurn;
+   turnLock.unlock();
+
+   if(ourTurn)
+      return;
+
+   S64 start = Platform::getHighPrecisionTimerValue();
+   turnSignals[mParallelIndex]->wait();
+   mCallWaitTime += Platform::getHighPrecisionTimerValue() - start;
+}
+
+
+void LuaScriptRunner::lockGameCalls()
+{
+   S64 start = Platform::getHighPrecisionTimerValue();
+   gameCallLock.lock();
+   mCallWaitTime += Platform::getHighPrecisionTimerValue() - start;
+}
+
+
+void LuaScriptRunner::unlockGameCalls()
+{
+   gameCallLock.unlock();
+}
+
+
+bool LuaScriptRunner::finishWorkerRun()
+{
+   lua_gc(mOwnL, LUA_GCRESTART, 0);
+
+   // Whatever the script asked for before any error still happens
+   bool error = runQueuedCalls();
+
+   if(!error && mWorkerError != "")
+   {
+      terminateWithError(mWorkerError, mWorkerErrorHasStack);
+      error = true;
+   }
+
+   mWorkerError = "";
+
+   return error;
+}
+
+
+// Returns true if one of the calls hit an error
+bool LuaScriptRunner::runQueuedCalls()
+{
+   lua_State *L = getLuaState();
+
+   lua_getfield(L, LUA_REGISTRYINDEX, QUEUED_CALLS_KEY);    // -- queue
+   S32 callCount = (S32)lua_objlen(L, -1);
+
+   if(callCount == 0)
+   {
+      lua_pop(L, 1);                                        // --
+      return false;
+   }
+
+   // Start a new queue, in case one of these calls sets off something that runs us again
+   lua_newtable(L);                                         // -- queue, newQueue
+   lua_setfield(L, LUA_REGISTRYINDEX, QUEUED_CALLS_KEY);    // -- queue
+
+   for(S32 i = 1; i <= callCount; i++)
+   {
+      lua_rawgeti(L, 1, i);                                 // -- queue, call
+      lua_getfield(L, -1, "n");                             // -- queue, call, argCount
+      S32 argCount = (S32)lua_tointeger(L, -1);
+      lua_pop(L, 1);                                        // -- queue, call
+
+      for(S32 j = 1; j <= argCount + 1; j++)
+         lua_rawgeti(L, 2, j);                              // -- queue, call, fn, <<args>>
+
+      if(lua_pcall(L, argCount, 0, 0))                      // -- queue, call, [error]
+      {
+         string text = "In a call saved while running on a worker thread:\n" + string(lua_tostring(L, -1));
+         clearStack(L);
+
+         terminateWithError(text, false);
+         return true;
+      }
+
+      lua_pop(L, 1);                                        // -- queue
+   }
+
+   clearStack(L);
+   return false;
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
 const char *LuaScriptRunner::getScriptId()
 {
    return mScriptId.c_str();
@@ -131,6 +755,8 @@ bool LuaScriptRunner::runScript(bool cacheScript)
 // Starts with a function on the stack
 void LuaScriptRunner::setEnvironment()
 {                                    
+   lua_State *L = getLuaState();
+
    // Grab the script's environment table from the registry, place it on the stack
    lua_getfield(L, LUA_REGISTRYINDEX, getScriptId());    // Push REGISTRY[scriptId] onto stack           -- function, table
    lua_setfenv(L, -2);                                   // Set that table to be the env for function    -- function
@@ -187,6 +813,8 @@ bool LuaScriptRunner::loadAndRunGlobalFunction(lua_State *L, const char *key, Sc
 // This function can safely throw errors.
 void LuaScriptRunner::pushStackTracer()
 {
+   lua_State *L = getLuaState();
+
    // _stackTracer is a function included in lua_helper_functions that manages the stack trace; it should ALWAYS be present.
    if(!loadFunction(L, getScriptId(), "_stackTracer"))
    {
@@ -200,8 +828,10 @@ void LuaScriptRunner::pushStackTracer()
 // Use this method to load an external script directly into the currently running script's
 // environment.  This loaded script will be cleared when the parent script terminates
 bool LuaScriptRunner::loadCompileRunEnvironmentScript(const string &scriptName) {
+   lua_State *L = getLuaState();
+
    // The timer is loaded in each script
-   loadCompileScript(joindir(mScriptingDir, scriptName).c_str());
+   loadCompileScript(L, joindir(mScriptingDir, scriptName).c_str());
    setEnvironment();
 
    S32 err = lua_pcall(L, 0, 0, 0);
@@ -228,6 +858,12 @@ bool LuaScriptRunner::loadScript(bool cacheScript)
 
    static const S32 MAX_CACHE_SIZE = 16;
 
+   lua_State *L = getLuaState();
+
+   // Compiled scripts are cached in L; a state of our own is new, and won't have seen any
+   if(mOwnL)
+      cacheScript = false;
+
    // On a dedicated server, we'll always cache our scripts; on a regular server, we'll cache script except when the user is testing
    // from the editor.  In that case, we'll want to see script changes take place immediately, and we're willing to pay a small
    // performance penalty on level load to get that.
@@ -239,7 +875,7 @@ bool LuaScriptRunner::loadScript(bool cacheScript)
       pushStackTracer();            // -- _stackTracer
 
       if(!cacheScript)
-         loadCompileScript(mScriptName.c_str());
+         loadCompileScript(L, mScriptName.c_str());
       else  
       {
          bool found = false;
@@ -259,12 +895,12 @@ bool LuaScriptRunner::loadScript(bool cacheScript)
             if(cacheSize > MAX_CACHE_SIZE)
             {
                // Remove oldest script from the cache
-               deleteScript(mCachedScripts.front().c_str());
+               deleteScript(L, mCachedScripts.front().c_str());
                mCachedScripts.pop_front();
             }
 
             // Load new script into cache using full name as registry key
-            loadCompileSaveScript(mScriptName.c_str(), mScriptName.c_str());
+            loadCompileSaveScript(L, mScriptName.c_str(), mScriptName.c_str());
             mCachedScripts.push_back(mScriptName);
          }
 
@@ -306,6 +942,8 @@ bool LuaScriptRunner::loadScript(bool cacheScript)
 // Returns true if string ran successfully
 bool LuaScriptRunner::runString(const string &code)
 {
+   lua_State *L = getLuaState();
+
    luaL_loadstring(L, code.c_str());
    setEnvironment();
    return !lua_pcall(L, 0, 0, 0);      // lua_pcall returns 0 in case of success
@@ -327,6 +965,8 @@ bool LuaScriptRunner::runMain(const Vector<string> &args)
    if(mScriptName == "")
       return true;
 
+   lua_State *L = getLuaState();
+
    TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
 
    setLuaArgs(args);
@@ -378,9 +1018,59 @@ void improveErrorMessages_global(string &msg, const string &startStr)
 }
 
 
-// Returns true if there was an error, false if everything ran ok
+// Times the call, and counts what it allocates and the instructions it runs.
+// Returns true if there was an error, false if everything ran ok.
 bool LuaScriptRunner::runCmd(const char* function, S32 argCount, S32 returnValueCount)
 {
+   lua_State *L = getLuaState();
+
+   // The instruction hook charges whichever script the registry names; remember who we're interrupting, if anyone
+   lua_getfield(L, LUA_REGISTRYINDEX, PROFILED_SCRIPT_KEY);    // -- <<args>>, outerRunner
+   void *outerRunner = lua_touserdata(L, -1);
+   lua_pop(L, 1);                                              // -- <<args>>
+
+   lua_pushlightuserdata(L, this);                             // -- <<args>>, this
+   lua_setfield(L, LUA_REGISTRYINDEX, PROFILED_SCRIPT_KEY);    // -- <<args>>
+
+   S64 startTime = Platform::getHighPrecisionTimerValue();
+   U64 startBytes = getBytesAllocated(L);
+   U64 startInstructions = mCallInstructions;
+
+   // main() runs once, as the script starts, so it isn't held to the per-tick budget
+   if(mCallDepth == 0)
+   {
+      mCallStartTime = startTime;
+      mCallWaitTime = 0;
+      mCallBudgeted = strcmp(function, "main") != 0;
+   }
+
+   mCallDepth++;
+   bool error = runCmdUnprofiled(function, argCount, returnValueCount);
+   mCallDepth--;
+
+   lua_pushlightuserdata(L, outerRunner);                      // -- <<results>>, outerRunner
+   lua_setfield(L, LUA_REGISTRYINDEX, PROFILED_SCRIPT_KEY);    // -- <<results>>
+
+   LuaScriptProfile call;
+   call.calls = 1;
+   call.time = Platform::getHighPrecisionMilliseconds(Platform::getHighPrecisionTimerValue() - startTime);
+   call.instructions = mCountInstructions ? mCallInstructions - startInstructions : 0;
+   call.bytesAllocated = getBytesAllocated(L) - startBytes;
+
+   mProfile.add(call);
+   mRecentProfile.add(call);
+
+   // Calls into us from inside one of our own calls are already being timed
+   if(mCallDepth == 0 && mCallBudgeted)
+      mBudgetDebt += call.time - Platform::getHighPrecisionMilliseconds(mCallWaitTime);
+
+   return error;
+}
+
+
+bool LuaScriptRunner::runCmdUnprofiled(const char* function, S32 argCount, S32 returnValueCount)
+{
+   lua_State *L = getLuaState();
    S32 stackDepth = lua_gettop(L);
 
    // argCount args are already on the stack... we'll refer to these as collectively as <<args>>
@@ -407,7 +1097,8 @@ bool LuaScriptRunner::runCmd(const char* function, S32 argCount, S32 returnValue
          // we never copy them into C++ land; we just duplicate them from the stack as needed.  For other
          // functions, we have the arguments in C++, so we can just push them onto the stack multiple times
          // for firing an event for multiple listeners.
-         TNLAssert((!strcmp(function, "onDataReceived") && top == (argCount + 1)) || (strcmp(function, "onDataReceived") && top == 1), \
+         // Scripts with their own Lua states get their own copies of the data, so there won't be any extras.
+         TNLAssert((!strcmp(function, "onDataReceived") && (top == (argCount + 1) || mOwnL)) || top == 1, \
             "Unexpected number of items on stack!");
          lua_insert(L, top);                                // -- <<whatever>>, function, <<args>>, _stackTracer
          lua_insert(L, top);                                // -- <<whatever>>, _stackTracer, function, <<args>>
@@ -444,13 +1135,14 @@ bool LuaScriptRunner::runCmd(const char* function, S32 argCount, S32 returnValue
 
    // There was an error... handle it!l
 
+   string text;
+
    if(error == -1)         // Handler was removed after subscription
    {
       // The only way this can get triggered is if the handler function has been deleted by the time 
       // we get here (we check for its existence when a script subscribes).  In practice, this has 
       // probably never happened.  
-      string text = "Cannot find Lua function " + string(function) + "()!\n";
-      logprintf(LogConsumer::LogError, "%s\n%s", getErrorMessagePrefix(), text.c_str());
+      text = "Cannot find Lua function " + string(function) + "()!\n";
    }
    else                    // A "normal" error occurred (i.e. error in the code)
    {
@@ -458,18 +1150,34 @@ bool LuaScriptRunner::runCmd(const char* function, S32 argCount, S32 returnValue
       lua_pop(L, 1);       // Remove the message from the stack, so it won't appear in our stack dump
 
       improveErrorMessages(msg);    // Modifies msg
-      string text = "In method " + string(function) + "():\n" + msg;
+      text = "In method " + string(function) + "():\n" + msg;
+   }
 
-      logprintf(LogConsumer::LogError, "%s\n%s", getErrorMessagePrefix(), text.c_str());
-      logprintf(LogConsumer::LogError, "Dump of Lua/C++ stack:");
+   lua_settop(L, stackDepth - argCount);   // Remove <<args>> and other cruft     -- <<whatever>>
+
+   // Logging and killing the script have to wait until we're back on the main thread
+   if(mRunningOnWorker)
+   {
+      mWorkerError = text;
+      mWorkerErrorHasStack = (error != -1);
    }
+   else
+      terminateWithError(text, error != -1);
+
+   return true;
+}
+
+
+void LuaScriptRunner::terminateWithError(const string &text, bool hasStack)
+{
+   logprintf(LogConsumer::LogError, "%s\n%s", getErrorMessagePrefix(), text.c_str());
+
+   if(hasStack)
+      logprintf(LogConsumer::LogError, "Dump of Lua/C++ stack:");
 
    logprintf(LogConsumer::LogError, "Terminating script");
 
    killScript();
-   lua_settop(L, stackDepth - argCount);   // Remove <<args>> and other cruft     -- <<whatever>>
-
-   return true;
 }
 
 
@@ -495,10 +1203,12 @@ bool LuaScriptRunner::startLua(const string &scriptingDir)
       return false;
    }
 
+   prepareLuaState(L);
+
    if(!configureNewLuaInstance(L))
    {
       // An error message will have been printed by configureNewLuaInstance()
-      lua_close(L);
+      LuaAllocator::closeState(L);
       L = NULL;
       return false;
    }
@@ -521,10 +1231,10 @@ bool LuaScriptRunner::configureNewLuaInstance(lua_State *L)
       luaL_openlibs(L);    // Load the standard libraries
 
       // This allows the safe use of 'require' in our scripts
-      setModulePath();
+      setModulePath(L);
 
       // Register all our classes in the global namespace... they will be copied below when we copy the environment
-      registerClasses();            // Perform class and global function registration once per lua_State
+      registerClasses(L);           // Perform class and global function registration once per lua_State
       registerLooseFunctions(L);    // Register some functions not associated with a particular class
 
       // Set scads of global vars in the Lua instance that mimic the use of the enums we use everywhere.
@@ -533,19 +1243,19 @@ bool LuaScriptRunner::configureNewLuaInstance(lua_State *L)
       setGlobalObjectArrays(L);
 
       // Immediately execute the lua helper functions (these are global and need to be loaded before sandboxing)
-      loadCompileRunHelper("lua_helper_functions.lua");
+      loadCompileRunHelper(L, "lua_helper_functions.lua");
 
       // Load our vector library
-      loadCompileRunHelper("luavec.lua");
+      loadCompileRunHelper(L, "luavec.lua");
 
       // Load our helper functions and store copies of the compiled code in the registry where we can use them for starting new scripts
-      loadCompileSaveHelper("robot_helper_functions.lua",    ROBOT_HELPER_FUNCTIONS_KEY);
-      loadCompileSaveHelper("levelgen_helper_functions.lua", LEVELGEN_HELPER_FUNCTIONS_KEY);
-      loadCompileSaveHelper("timer.lua",                     SCRIPT_TIMER_KEY);
+      loadCompileSaveHelper(L, "robot_helper_functions.lua",    ROBOT_HELPER_FUNCTIONS_KEY);
+      loadCompileSaveHelper(L, "levelgen_helper_functions.lua", LEVELGEN_HELPER_FUNCTIONS_KEY);
+      loadCompileSaveHelper(L, "timer.lua",                     SCRIPT_TIMER_KEY);
 
       // Perform sandboxing now
       // Only code executed before this point can access dangerous functions
-      loadCompileRunHelper("sandbox.lua");
+      loadCompileRunHelper(L, "sandbox.lua");
 
       return true;
    }
@@ -557,17 +1267,17 @@ bool LuaScriptRunner::configureNewLuaInstance(lua_State *L)
 }
 
 
-void LuaScriptRunner::loadCompileSaveHelper(const string &scriptName, const char *registryKey)
+void LuaScriptRunner::loadCompileSaveHelper(lua_State *L, const string &scriptName, const char *registryKey)
 {
-   loadCompileSaveScript(joindir(mScriptingDir, scriptName).c_str(), registryKey);
+   loadCompileSaveScript(L, joindir(mScriptingDir, scriptName).c_str(), registryKey);
 }
 
 
 // Load a script from the scripting directory by basename (e.g. "my_script.lua").
 // Throws LuaException when there's an error compiling or running the script.
-void LuaScriptRunner::loadCompileRunHelper(const string &scriptName)
+void LuaScriptRunner::loadCompileRunHelper(lua_State *L, const string &scriptName)
 {
-   loadCompileScript(joindir(mScriptingDir, scriptName).c_str());
+   loadCompileScript(L, joindir(mScriptingDir, scriptName).c_str());
    if(lua_pcall(L, 0, 0, 0))
       throw LuaException("Error running " + scriptName + ": " + string(lua_tostring(L, -1)));
 }
@@ -575,16 +1285,16 @@ void LuaScriptRunner::loadCompileRunHelper(const string &scriptName)
 
 // Load script from specified file, compile it, and store it in the registry.
 // All callers of this script have catch blocks, so we can throw errors if something goes wrong.
-void LuaScriptRunner::loadCompileSaveScript(const char *filename, const char *registryKey)
+void LuaScriptRunner::loadCompileSaveScript(lua_State *L, const char *filename, const char *registryKey)
 {
-   loadCompileScript(filename);                       // Throws if there is an error
+   loadCompileScript(L, filename);                     // Throws if there is an error
    lua_setfield(L, LUA_REGISTRYINDEX, registryKey);   // Save compiled code in registry
 }
 
 
 // Load script and place on top of the stack.
 // All callers of this script have catch blocks, so we can throw errors if something goes wrong.
-void LuaScriptRunner::loadCompileScript(const char *filename)
+void LuaScriptRunner::loadCompileScript(lua_State *L, const char *filename)
 {
    // luaL_loadfile: Loads a file as a Lua chunk. This function uses lua_load to load the chunk in the file named filename. 
    // If filename is NULL, then it loads from the standard input. The first line in the file is ignored if it starts with a #.
@@ -599,7 +1309,7 @@ void LuaScriptRunner::loadCompileScript(const char *filename)
 
 
 // Delete script's environment from the registry -- actually set the registry entry to nil so the table can be collected
-void LuaScriptRunner::deleteScript(const char *name)
+void LuaScriptRunner::deleteScript(lua_State *L, const char *name)
 {
    // If a script is not found, or there is some other problem with the bot (or levelgen), we might get here before our L has been
    // set up.  If L hasn't been defined, there's no point in mucking with the registry, right?
@@ -613,6 +1323,8 @@ void LuaScriptRunner::deleteScript(const char *name)
 
 bool LuaScriptRunner::prepareEnvironment()              
 {
+   lua_State *L = getLuaState();
+
    if(!L)
    {
       logprintf(LogConsumer::LogError, "%s %s.", getErrorMessagePrefix(), 
@@ -679,7 +1391,7 @@ static string getStackTraceLine(lua_State *L, S32 level)
 */
 
 // Register classes needed by all script runners
-void LuaScriptRunner::registerClasses()
+void LuaScriptRunner::registerClasses(lua_State *L)
 {
    LuaW_Registrar::registerClasses(L);    // Register all objects that use our automatic registration scheme
 }
@@ -705,6 +1417,7 @@ void LuaScriptRunner::registerClasses()
 // By Lua convention, we'll put the name of the script into the 0th element.
 void LuaScriptRunner::setLuaArgs(const Vector<string> &args)
 {
+   lua_State *L = getLuaState();
    S32 stackDepth = lua_gettop(L);
 
    lua_getfield(L, LUA_REGISTRYINDEX, getScriptId()); // Put script's env table onto the stack  -- ..., env_table
@@ -728,7 +1441,7 @@ void LuaScriptRunner::setLuaArgs(const Vector<string> &args)
 
 
 // Set up paths so that we can use require to load code in our scripts 
-void LuaScriptRunner::setModulePath()   
+void LuaScriptRunner::setModulePath(lua_State *L)
 {
    TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
 
@@ -1112,7 +1825,7 @@ void LuaScriptRunner::registerLooseFunctions(lua_State *L)
          for(U32 i = 0; i < profiles.size(); i++)
          {
             LuaStaticFunctionProfile &profile = profiles[i];
-            lua_pushcfunction(L, profile.function);                 // -- fn
+            pushLooseFunction(L, profile.functionName, profile.function);   // -- fn
             lua_setglobal(L, profile.functionName);                 // --
          }
       }
@@ -1124,7 +1837,7 @@ void LuaScriptRunner::registerLooseFunctions(lua_State *L)
          for(U32 i = 0; i < profiles.size(); i++)
          {
             LuaStaticFunctionProfile &profile = profiles[i];
-            lua_pushcfunction(L, profile.function);                 // -- table, fn
+            pushLooseFunction(L, profile.functionName, profile.function);   // -- table, fn
             lua_setfield(L, -2, profile.functionName);              // -- table
          }
          lua_setglobal(L, (*it).first.c_str());                     // --
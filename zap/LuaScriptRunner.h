@@ -42,6 +42,24 @@ class MenuItem;
 #define ROBOT_HELPER_FUNCTIONS_KEY    "robot_helper_functions"
 #define LEVELGEN_HELPER_FUNCTIONS_KEY "levelgen_helper_functions"
 #define SCRIPT_TIMER_KEY "script_timer"
+#define QUEUED_CALLS_KEY "queued_calls"
+#define OWNING_SCRIPT_KEY "owning_script"
+#define PROFILED_SCRIPT_KEY "profiled_script"
+
+
+// What a script has cost us, over some stretch of time
+struct LuaScriptProfile
+{
+   U32 calls;              // Functions called with runCmd()
+   F64 time;               // Wall time spent in them, in ms
+   U64 instructions;       // Only counted when profiling; code LuaJIT has compiled isn't counted
+   U64 bytesAllocated;     // Memory asked for by the script's Lua state while it ran; nothing is subtracted for frees
+   U32 deferredTicks;      // Ticks the script sat out for being over its budget
+
+   LuaScriptProfile();     // Constructor
+   void add(const LuaScriptProfile &profile);
+};
+
 
 class LuaScriptRunner
 {
@@ -51,13 +69,42 @@ private:
 
    static string mScriptingDir;
 
+   static bool mRunningInParallel;
+
+   static bool mCountInstructions;
+   static bool mPooledAllocation;
+   static U32 mTickBudget;
+
+   LuaScriptProfile mProfile;          // Since the script started
+   LuaScriptProfile mRecentProfile;    // Since takeRecentProfile() was last called
+   S64 mCallStartTime;                 // When the outermost runCmd() now running started
+   S64 mCallWaitTime;                  // How long it has spent since then waiting on other scripts, in timer ticks
+   U32 mCallDepth;
+   bool mCallBudgeted;                 // False while main() is running
+   U64 mCallInstructions;              // Counted by instructionHook() whenever it runs on our behalf
+   F64 mBudgetDebt;                    // Time used beyond our budget, in ms, still to be worked off
+   U32 mDeferredTickTime;              // Ticks we sat out, to be handed to onTick when we next run
+
+   lua_State *mOwnL;             // This script's own Lua state, if it has one; otherwise it shares L
+   bool mRunningOnWorker;        // True while a worker thread is running one of our functions
+   S32 mParallelIndex;           // Where we'd have run in line, had the scripts run one at a time
+   string mWorkerError;          // Error hit while doing so, to be reported back on the main thread
+   bool mWorkerErrorHasStack;
+
    void setLuaArgs(const Vector<string> &args);
-   static void setModulePath();
+   static void setModulePath(lua_State *L);
+
+   static void loadCompileSaveHelper(lua_State *L, const string &scriptName, const char *registryKey);
+   static void loadCompileRunHelper(lua_State *L, const string &scriptName);
+   static void loadCompileSaveScript(lua_State *L, const char *filename, const char *registryKey);
+   static void loadCompileScript(lua_State *L, const char *filename);
 
-   static void loadCompileSaveHelper(const string &scriptName, const char *registryKey);
-   static void loadCompileRunHelper(const string &scriptName);
-   static void loadCompileSaveScript(const char *filename, const char *registryKey);
-   static void loadCompileScript(const char *filename);
+   void terminateWithError(const string &text, bool hasStack);
+   bool runQueuedCalls();
+
+   bool runCmdUnprofiled(const char *function, S32 argCount, S32 returnValueCount);
+   static void prepareLuaState(lua_State *L);
+   static void instructionHook(lua_State *L, lua_Debug *ar);
 
    void pushStackTracer();      // Put error handler function onto the stack
 
@@ -92,12 +139,12 @@ protected:
    virtual bool prepareEnvironment();
 
    static int luaPanicked(lua_State *L);  // Handle a total freakout by Lua
-   static void registerClasses();
+   static void registerClasses(lua_State *L);
    void setEnvironment();                 // Sets the environment for the function on the top of the stack to that associated with name
 
    bool loadCompileRunEnvironmentScript(const string &scriptName);
 
-   static void deleteScript(const char *name);  // Remove saved script from the Lua registry
+   static void deleteScript(lua_State *L, const char *name);  // Remove saved script from the Lua registry
 
    static void registerLooseFunctions(lua_State *L);   // Register some functions not associated with a particular class
 
@@ -139,6 +186,41 @@ public:
 
    static bool configureNewLuaInstance(lua_State *L); // Prepare a new Lua environment for use
 
+   // Scripts normally share L.  One with a Lua state of its own can have its functions run on a worker thread,
+   // alongside other such scripts; while that goes on, calls that could change the game are saved up, and made
+   // on the main thread afterwards by finishWorkerRun().  Calls that change the game but have to give an answer
+   // wait until the scripts that would have run before ours are done.  Create the state before preparing the
+   // environment.
+   bool createOwnLuaState();
+   bool hasOwnLuaState() const;
+   lua_State *getLuaState() const;                    // Our own state, or L if we don't have one
+
+   static void startParallelRun(const Vector<LuaScriptRunner *> &scripts);
+   static void endParallelRun();
+   static bool isRunningInParallel();
+
+   void runCmdOnWorker(const char *function, S32 argCount);   // Like runCmd(), but safe on a worker thread
+   void waitForTurn();                                        // Only while running on a worker
+   void lockGameCalls();                                      // Ditto; neither's waits count against our budget
+   void unlockGameCalls();
+   bool finishWorkerRun();                                    // Back on the main thread; returns true if there was an error
+
+   // Every runCmd() is timed, and the memory it allocates counted.  Counting instructions needs a debug hook, which
+   // slows scripts down, so it only happens when asked for.  With a budget, in ms, scripts that take more than that
+   // per tick sit out ticks until they've made up for it, and calls that run past ten times that are stopped.  Time
+   // spent waiting on other scripts running alongside isn't counted against it, and main() is left out of it.
+   static void setProfilingOptions(bool countInstructions, U32 tickBudget);
+   static bool isCountingInstructions();
+
+   static void setPooledAllocation(bool pooled);      // Only affects states created from here on; see LuaAllocator
+
+   const LuaScriptProfile &getProfile() const;
+   LuaScriptProfile takeRecentProfile();              // Returns what we've cost since the last call, and starts again
+   virtual string getProfileName();
+   U64 getMemoryInUse();                              // In bytes; 0 for scripts sharing L
+
+   bool deferTick(U32 &deltaT);                       // True if we're over budget and should sit this tick out
+
    bool runString(const string &code);
    bool runMain();                                    // Run a script's main() function
    bool runMain(const Vector<string> &args);          // Run a script's main() function, putting args into Lua's arg table
@@ -162,6 +244,8 @@ public:
    template <class T>
    void tickTimer(U32 deltaT)
    {
+      lua_State *L = getLuaState();
+
       TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
       clearStack(L);
 
@@ -181,6 +265,7 @@ public:
    template<typename T>
    T getLuaGlobalVar(const char* varName)
    {
+      lua_State *L = getLuaState();
       S32 stackDepth = lua_gettop(L);
 
       lua_getfield(L, LUA_REGISTRYINDEX, getScriptId());   // Push REGISTRY[scriptId] onto stack            -- registry table
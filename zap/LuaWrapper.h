@@ -53,6 +53,8 @@ extern "C"
 #include "LuaBase.h"   
 #include "LuaException.h"   
 
+#include "tnlThread.h"
+
 #include <string>
 #include <vector>
 #include <map>
@@ -70,6 +72,7 @@ using namespace Zap;
 #define LUAW_WRAPPER_KEY   "LuaWrapper"
 #define LUAW_USING_PROXY_KEY "usingproxy"
 #define LUAW_USING_PROXY_METATABLE_KEY "usingproxymetatable"
+#define LUAW_FUNCTION_WRAPPER_KEY "LuaWrapperFunctionWrapper"
 
 // A simple utility function to adjust a given index
 // Useful for when a parameter index needs to be adjusted
@@ -84,6 +87,14 @@ inline int luaW_correctindex(lua_State* L, int index, int correction)
 template <class T> class LuaProxy;
 
 
+// Guards the lists of proxies objects keep, which scripts running on worker threads may add to or remove from
+inline TNL::Mutex &luaW_getProxyLock()
+{
+   static TNL::Mutex lock;
+   return lock;
+}
+
+
 // Here we will specify whether to use our proxy system for objects managed in LuaW
 // or use (mostly) upstream behavior
 inline bool luaW_shouldCreateProxy(lua_State* L)
@@ -234,21 +245,15 @@ inline bool luaW_isUsingProxy(lua_State* L, void *objptr)
 
 
 // Set whether or not our object uses a proxy
+//
+// If we're using a proxy, then pass that as objOrProxy; it will be used as the usingproxy table key.
+// This is because we use the luaW_Userdata to find out if an object is using a proxy.  luaW_Userdata
+// will contain the proxy for proxied object otherwise it contains the object itself
 template <typename T>
-void luaW_setUsingProxy(lua_State* L, T* obj, bool usingProxy)
+void luaW_setUsingProxy(lua_State* L, void *objOrProxy, bool usingProxy)
 {
    luaW_wrapperfield<T>(L, LUAW_USING_PROXY_KEY);     // -- ... usingproxy_table
-
-   // If we're using a proxy, then use that as the usingproxy table key.  This is because
-   // we use the luaW_Userdata to find out if an object is using a proxy.  luaW_Userdata
-   // will contain the proxy for proxied object otherwise it contains the object itself
-   if(usingProxy)
-   {
-      LuaProxy<T> *proxy = obj->getLuaProxy();
-      lua_pushlightuserdata(L, proxy);                // -- ... usingproxy_table, &proxy
-   }
-   else
-      lua_pushlightuserdata(L, obj);                  // -- ... usingproxy_table, &obj
+   lua_pushlightuserdata(L, objOrProxy);              // -- ... usingproxy_table, &obj_or_proxy
 
    lua_pushboolean(L, usingProxy);                    // -- ... usingproxy_table, &obj_or_proxy, bool
    lua_rawset(L, -3);                                 // -- ... usingproxy_table
@@ -386,12 +391,14 @@ void luaW_push(lua_State* L, T* obj)
    // Should we be using proxies for our objects?
    if(luaW_shouldCreateProxy(L))
    {
-      // Get the object's proxy, or create one if it doesn't yet exist
-      LuaProxy<T> *proxy = obj->getLuaProxy();
+      // Get the object's proxy for this Lua state, or create one if it doesn't yet exist.  Every state has
+      // its own cache table, so that tells us which of the object's proxies is the one we want.
+      luaW_wrapperfield<T>(L, LUAW_CACHE_KEY);           // -- cache_table
+      const void *owner = lua_topointer(L, -1);
+      LuaProxy<T> *proxy = LuaProxy<T>::find(obj, owner);
 
       if(proxy)         // Retrieve the userdata for this proxy from our cache table
       {
-         luaW_wrapperfield<T>(L, LUAW_CACHE_KEY);        // -- cache_table
          LuaWrapper<T>::identifier(L, obj);              // -- cache_table, id
 
          // lua_gettable pushes onto the stack the value t[k], where t is the value at the given valid
@@ -409,8 +416,10 @@ void luaW_push(lua_State* L, T* obj)
       }
       else
       {
+         lua_pop(L, 1);                                  // --
+
          // Create a new proxy
-         proxy = new LuaProxy<T>(obj);
+         proxy = new LuaProxy<T>(obj, owner);
 
          // Add a new entry to our cache table (a weak table; more about those here: http://lua-users.org/wiki/WeakTablesTutorial).
          // Note that from here on down, we'll fall back on the normal LuaW push code, except for the bit at the end where
@@ -438,7 +447,7 @@ void luaW_push(lua_State* L, T* obj)
          lua_pop(L, 1); // ... obj
          TNLAssert(lua_isuserdata(L, -1) || dumpStack(L, "Expect userdata"), "Expected userdata!");
 
-         luaW_setUsingProxy(L, obj, true);
+         luaW_setUsingProxy<T>(L, proxy, true);
          luaW_hold<T>(L, obj);     // Tell luaW to collect the proxy when it's done with it
       }
    }  // useLuaProxy
@@ -467,7 +476,7 @@ void luaW_push(lua_State* L, T* obj)
 
           lua_pop(L, 1); // ... obj
 
-          luaW_setUsingProxy(L, obj, false);
+          luaW_setUsingProxy<T>(L, obj, false);
           luaW_hold<T>(L, obj);     // Tell luaW to manage this object
       }
       else
@@ -708,24 +717,43 @@ int luaW_gc(lua_State* L)
    return 0;
 }
 
+// Pushes fn onto the stack.  If a function has been stored in the registry under LUAW_FUNCTION_WRAPPER_KEY,
+// it is called with classname, name and fn, and whatever it returns is pushed instead; that lets the
+// application change how functions registered in a particular Lua state get called.
+inline void luaW_pushfunction(lua_State* L, const char* classname, const char* name, lua_CFunction fn)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, LUAW_FUNCTION_WRAPPER_KEY); // ... wrapper
+    if (lua_isnil(L, -1))
+    {
+        lua_pop(L, 1); // ...
+        lua_pushcfunction(L, fn); // ... fn
+        return;
+    }
+
+    lua_pushstring(L, classname); // ... wrapper classname
+    lua_pushstring(L, name); // ... wrapper classname name
+    lua_pushcfunction(L, fn); // ... wrapper classname name fn
+    lua_call(L, 3, 1); // ... wrapped_fn
+}
+
 // Takes two tables and registers them with Lua to the table on the top of the
 // stack. 
 //
 // This function is only called from LuaWrapper internally. 
-inline void luaW_registerfuncs(lua_State* L, const luaL_Reg defaulttable[], const luaL_Reg table[])
+inline void luaW_registerfuncs(lua_State* L, const char* classname, const luaL_Reg defaulttable[], const luaL_Reg table[])
 {
     // ... T
-#if LUA_VERSION_NUM == 502
-    if (defaulttable)
-        luaL_setfuncs(L, defaulttable, 0); // ... T
-    if (table)
-        luaL_setfuncs(L, table, 0); // ... T
-#else
-    if (defaulttable)
-        luaL_register(L, NULL, defaulttable); // ... T
-    if (table)
-        luaL_register(L, NULL, table); // ... T
-#endif
+    for (const luaL_Reg* reg = defaulttable; reg && reg->name; reg++)
+    {
+        luaW_pushfunction(L, classname, reg->name, reg->func); // ... T fn
+        lua_setfield(L, -2, reg->name); // ... T
+    }
+
+    for (const luaL_Reg* reg = table; reg && reg->name; reg++)
+    {
+        luaW_pushfunction(L, classname, reg->name, reg->func); // ... T fn
+        lua_setfield(L, -2, reg->name); // ... T
+    }
 }
 
 // Initializes the LuaWrapper tables used to track internal state. 
@@ -856,13 +884,13 @@ void luaW_setfuncs(lua_State* L, const char* classname, const luaL_Reg* table,
 
     // Open table
     lua_newtable(L); // ... T
-    luaW_registerfuncs(L, allocator ? defaulttable : NULL, table); // ... T
+    luaW_registerfuncs(L, classname, allocator ? defaulttable : NULL, table); // ... T
 
     // Open metatable, set up extends table
     luaL_newmetatable(L, classname); // ... T mt
     lua_newtable(L); // ... T mt {}
     lua_setfield(L, -2, LUAW_EXTENDS_KEY); // ... T mt
-    luaW_registerfuncs(L, defaultmetatable, metatable); // ... T mt
+    luaW_registerfuncs(L, classname, defaultmetatable, metatable); // ... T mt
     lua_setfield(L, -2, "metatable"); // ... T
 }
 
@@ -1155,30 +1183,66 @@ public:
 
 
 
+// An object pushed into several Lua states gets a proxy in each; the object points to the first, and
+// each proxy to the next
 template <class T>
 class LuaProxy
 {
 private:
     bool mDefunct;
     T *mProxiedObject;
+    const void *mOwner;      // Identifies the Lua state we were pushed into
+    LuaProxy<T> *mNext;
 
 public:
     // Default constructor
     LuaProxy() { TNLAssert(false, "Not used"); }
 
     // Typical constructor
-    explicit LuaProxy(T *obj)
+    LuaProxy(T *obj, const void *owner)
     {
+      luaW_getProxyLock().lock();
+
       mProxiedObject = obj;
+      mOwner = owner;
+      mNext = obj->getLuaProxy();
       obj->setLuaProxy(this);
       mDefunct = false;
+
+      luaW_getProxyLock().unlock();
     }
 
    // Destructor
    ~LuaProxy()
    {
+      luaW_getProxyLock().lock();
+
+      // Take ourselves out of the object's list
       if(!mDefunct)
-         mProxiedObject->mLuaProxy = NULL;
+      {
+         LuaProxy<T> **link = &mProxiedObject->mLuaProxy;
+         while(*link != this)
+            link = &(*link)->mNext;
+
+         *link = mNext;
+      }
+
+      luaW_getProxyLock().unlock();
+   }
+
+
+   // Returns obj's proxy for the Lua state identified by owner, or NULL if it doesn't have one yet
+   static LuaProxy<T> *find(T *obj, const void *owner)
+   {
+      luaW_getProxyLock().lock();
+
+      LuaProxy<T> *proxy = obj->getLuaProxy();
+      while(proxy && proxy->mOwner != owner)
+         proxy = proxy->mNext;
+
+      luaW_getProxyLock().unlock();
+
+      return proxy;
    }
 
 
@@ -1186,6 +1250,17 @@ public:
    bool isDefunct()        { return mDefunct;       }
 
    void setDefunct(bool isDefunct) { mDefunct = isDefunct; }
+
+   // Marks this proxy and all those after it defunct, when the object they're for is deleted
+   void setAllDefunct()
+   {
+      luaW_getProxyLock().lock();
+
+      for(LuaProxy<T> *proxy = this; proxy; proxy = proxy->mNext)
+         proxy->mDefunct = true;
+
+      luaW_getProxyLock().unlock();
+   }
 };
 
 
@@ -1232,7 +1307,7 @@ public:
 
 // And this goes in the destructor of the "wrapped class"
 #define LUAW_DESTRUCTOR_CLEANUP \
-   if(mLuaProxy) mLuaProxy->setDefunct(true)
+   if(mLuaProxy) mLuaProxy->setAllDefunct()
 
 
 
@@ -0,0 +1,113 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "PathRequestBatch.h"
+
+namespace Zap
+{
+
+// Constructor
+PathRequestBatch::PathRequestBatch()
+{
+   mZones = NULL;
+   mHierarchy = NULL;
+   mRequestCount = 0;
+}
+
+
+// Destructor
+PathRequestBatch::~PathRequestBatch()
+{
+   mSearches.deleteAndClear();
+   mHierarchySearches.deleteAndClear();
+}
+
+
+void PathRequestBatch::clear()
+{
+   mRequestCount = 0;
+}
+
+
+S32 PathRequestBatch::addRequest(U16 startZone, U16 targetZone, const Point &target)
+{
+   // Entries, and their paths, get reused from batch to batch
+   if(mRequestCount == mRequests.size())
+      mRequests.resize(mRequestCount + 1);
+
+   Request &request = mRequests[mRequestCount];
+   request.startZone = startZone;
+   request.targetZone = targetZone;
+   request.target = target;
+   request.found = false;
+   request.path.clear();
+
+   return mRequestCount++;
+}
+
+
+void PathRequestBatch::solve(const Vector<BotNavMeshZone *> *zones, WorkerPool *pool, const BotZoneHierarchy *hierarchy)
+{
+   mZones = zones;
+   mHierarchy = (hierarchy && hierarchy->isBuilt()) ? hierarchy : NULL;
+
+   S32 chunkCount = (mRequestCount + ChunkSize - 1) / ChunkSize;
+
+   while(mSearches.size() < chunkCount)
+      mSearches.push_back(new AStar());
+
+   while(mHierarchy && mHierarchySearches.size() < chunkCount)
+      mHierarchySearches.push_back(new BotZoneHierarchy::Search());
+
+   if(pool)
+      pool->run(this, chunkCount);
+   else
+      for(S32 i = 0; i < chunkCount; i++)
+         runItem(i);
+}
+
+
+// Solves one chunk of requests -- zones and the hierarchy are only read, and only this chunk's requests and
+// searches are written
+void PathRequestBatch::runItem(S32 index)
+{
+   AStar *search = mSearches[index];
+
+   S32 end = (index + 1) * ChunkSize;
+   if(end > mRequestCount)
+      end = mRequestCount;
+
+   for(S32 i = index * ChunkSize; i < end; i++)
+   {
+      Request &request = mRequests[i];
+
+      if(mHierarchy && mHierarchy->isLongDistance(request.startZone, request.targetZone))
+         request.found = mHierarchy->findPath(*mHierarchySearches[index], request.startZone, request.targetZone,
+                                              request.target, request.path);
+      else
+         request.found = search->findPath(mZones, request.startZone, request.targetZone, request.target, request.path);
+   }
+}
+
+
+S32 PathRequestBatch::getRequestCount() const
+{
+   return mRequestCount;
+}
+
+
+bool PathRequestBatch::isFound(S32 index) const
+{
+   return mRequests[index].found;
+}
+
+
+const Vector<Point> &PathRequestBatch::getPath(S32 index) const
+{
+   return mRequests[index].path;
+}
+
+
+};
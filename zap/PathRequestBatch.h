@@ -0,0 +1,63 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _PATH_REQUEST_BATCH_H_
+#define _PATH_REQUEST_BATCH_H_
+
+#include "BotNavMeshZone.h"     // For AStar
+#include "BotZoneHierarchy.h"
+
+#include "tnlThread.h"
+
+using namespace TNL;
+
+namespace Zap
+{
+
+// A set of bot path searches solved together on a WorkerPool.  Requests are split into chunks, and each chunk
+// searches with its own AStar (and BotZoneHierarchy::Search).  Requests, paths and AStars are all reused by the next batch, so once they have
+// grown to fit, solving a batch doesn't allocate anything.
+class PathRequestBatch : public WorkerPool::Job
+{
+private:
+   struct Request
+   {
+      U16 startZone;
+      U16 targetZone;
+      Point target;
+      bool found;
+      Vector<Point> path;
+   };
+
+   static const S32 ChunkSize = 8;        // Requests per work item
+
+   const Vector<BotNavMeshZone *> *mZones;
+   const BotZoneHierarchy *mHierarchy;
+   Vector<Request> mRequests;
+   S32 mRequestCount;
+   Vector<AStar *> mSearches;             // One per chunk
+   Vector<BotZoneHierarchy::Search *> mHierarchySearches;
+
+public:
+   PathRequestBatch();              // Constructor
+   virtual ~PathRequestBatch();     // Destructor
+
+   void clear();
+   S32 addRequest(U16 startZone, U16 targetZone, const Point &target);    // Returns the request's index
+
+   // Solves every request, spreading the work over pool; with no pool, everything is solved right here.  Requests
+   // between distant zones go through hierarchy, if there is one and it has been built.
+   void solve(const Vector<BotNavMeshZone *> *zones, WorkerPool *pool, const BotZoneHierarchy *hierarchy = NULL);
+   void runItem(S32 index);
+
+   S32 getRequestCount() const;
+   bool isFound(S32 index) const;
+   const Vector<Point> &getPath(S32 index) const;     // Same layout as AStar::findPath()
+};
+
+
+};
+
+#endif
@@ -16,6 +16,9 @@
 #include "Teleporter.h"
 #include "BanList.h"             // For banList kick duration
 #include "BotNavMeshZone.h"      // For zone clearing code
+#include "BotZoneCache.h"
+#include "WallSegmentManager.h"  // For configuring wall databases
+#include "WallVisibility.h"
 #include "LevelSource.h"
 #include "LevelDatabase.h"
 
@@ -24,9 +27,12 @@
 #include "GeomUtils.h"
 
 #include "GameRecorder.h"
+#include "IdleQueryBatch.h"
 
 #include "IniFile.h"
 
+#include "tnlThread.h"
+
 
 using namespace TNL;
 
@@ -34,7 +40,7 @@ namespace Zap
 {
 
 
-static bool instantiated;           // Just a little something to keep us from creating multiple ServerGames...
+static S32 instances;              // Just a little something to keep us from creating multiple ServerGames by accident...
 
 
 // Constructor -- be sure to see Game constructor too!  Lots going on there!
@@ -42,10 +48,15 @@ ServerGame::ServerGame(const Address &address, GameSettingsPtr settings, LevelSo
       Game(address, settings),
       mRobotManager(this, settings)
 {
-   TNLAssert(!instantiated, "Only one ServerGame at a time, please!  If this trips while testing, "
+   // ...extra instances of a multi-instance server are created once GameManager has the primary one
+   TNLAssert(instances == 0 || GameManager::getServerGame(), "Only one ServerGame at a time, please!  If this trips while testing, "
       "it is probably because a test failed before another instance could be deleted.  Try disabling "
       "this assert, see what test fails, and fix it.  Then re-enable it, please!");
-   instantiated = true;
+   instances++;
+
+   // Extra instances keep their own script event subscriptions, which GameManager makes current while they run
+   ServerGame *primaryGame = GameManager::getServerGame();
+   mEventManager = primaryGame ? new EventManager() : NULL;    // Deleted in destructor
 
    mLevelSource = levelSource;
 
@@ -68,7 +79,10 @@ ServerGame::ServerGame(const Address &address, GameSettingsPtr settings, LevelSo
 
    mShuttingDown = false;
 
-   EventManager::get()->setPaused(false);
+   if(mEventManager)
+      mEventManager->setPaused(false);
+   else
+      EventManager::get()->setPaused(false);
 
    mInfoFlags = 0;                           // Currently used to specify test mode and debug builds
    mCurrentLevelIndex = 0;
@@ -98,6 +112,33 @@ ServerGame::ServerGame(const Address &address, GameSettingsPtr settings, LevelSo
    mNetInterface->setAllowsConnections(true);
    mMasterUpdateTimer.reset(UpdateServerStatusTime);
 
+   if(settings->getIniSettings()->networkIOThread)
+   {
+      if(mNetInterface->startIOThread())
+         logprintf(LogConsumer::ServerFilter, "Sending and receiving packets on a separate thread");
+      else
+         logprintf(LogConsumer::LogWarning, "Could not start a separate thread for network I/O; packets will be handled between ticks");
+   }
+
+   LuaScriptRunner::setProfilingOptions(settings->getIniSettings()->scriptProfiling, settings->getIniSettings()->scriptTickBudget);
+   mScriptStatsTimer.reset(ScriptStatsLogTime);
+
+   U32 netStatsLogTime = settings->getIniSettings()->netStatsLogTime;
+   mConnectionStatsTimer.reset(netStatsLogTime > 0 ? netStatsLogTime * ONE_SECOND : ConnectionStatsTime);
+
+   // Only servers that log network stats get a file for them
+   mNetStatsLog = NULL;
+   if(netStatsLogTime > 0 && !isExtraInstance())
+   {
+      mNetStatsLog = new FileLogConsumer();     // Deleted in destructor
+      mNetStatsLog->init(joindir(settings->getFolderManager()->logDir, "bitfighter_netstats.log"), "a");
+      mNetStatsLog->setMsgTypes(LogConsumer::NetStatsFilter);
+
+      logprintf(LogConsumer::NetStatsFilter, "time,client,address,seconds,rtt,packets_sent,packets_lost,bytes_received,bytes_sent,"
+                                             "overhead_bytes,move_bytes,event_bytes,ghost_bytes,events_resent,ghost_updates,"
+                                             "ghost_skips,ghosts_avg,ghosts_max");
+   }
+
    mSuspendor = NULL;
 
    mGameInfo = NULL;
@@ -119,9 +160,32 @@ ServerGame::ServerGame(const Address &address, GameSettingsPtr settings, LevelSo
    botControlTickTimer.reset(BotControlTickInterval);
 
    mLevelSwitchTimer.setPeriod(LevelSwitchTime);
-   GameManager::setHostingModePhase(GameManager::NotHosting);
+
+   if(!isExtraInstance())
+      GameManager::setHostingModePhase(GameManager::NotHosting);
 
    mGameRecorderServer = NULL;
+
+   mWorkerPool = NULL;
+   mOwnsWorkerPool = false;
+   mIdleQueryBatch = NULL;
+   S32 workerThreads = settings->getIniSettings()->workerThreads;
+
+   if(workerThreads > 0)
+   {
+      // Instances idle one after another, so they can all take turns with the same threads
+      if(primaryGame && primaryGame->getWorkerPool())
+         mWorkerPool = primaryGame->getWorkerPool();
+      else
+      {
+         mWorkerPool = new WorkerPool(workerThreads);    // Deleted in destructor
+         mOwnsWorkerPool = true;
+      }
+
+      mNetInterface->setWorkerPool(mWorkerPool);
+      mIdleQueryBatch = new IdleQueryBatch();         // Deleted in destructor
+      logprintf(LogConsumer::ServerFilter, "Preparing packets and object searches with %d worker threads", workerThreads);
+   }
 }
 
 
@@ -135,15 +199,31 @@ ServerGame::~ServerGame()
 
    clearAddTarget();
 
-   instantiated = false;
+   instances--;
 
    delete mGameInfo;
    delete mBotZoneDatabase;
 
-   GameManager::setHostingModePhase(GameManager::NotHosting);
+   if(!isExtraInstance())     // The hosting phase belongs to the primary ServerGame
+      GameManager::setHostingModePhase(GameManager::NotHosting);
 
    if(mGameRecorderServer)
       delete mGameRecorderServer;
+
+   delete mNetStatsLog;
+
+   mNetInterface->setWorkerPool(NULL);
+   if(mOwnsWorkerPool)
+      delete mWorkerPool;
+   delete mIdleQueryBatch;
+
+   if(mEventManager)
+   {
+      if(EventManager::get() == mEventManager)
+         EventManager::setCurrent(NULL);
+
+      delete mEventManager;
+   }
 }
 
 
@@ -164,6 +244,134 @@ void ServerGame::cleanUp()
 }
 
 
+struct ScriptStats
+{
+   string name;
+   LuaScriptProfile profile;
+};
+
+
+static S32 QSORT_CALLBACK ScriptTimeSort(ScriptStats *a, ScriptStats *b)
+{
+   if(a->profile.time == b->profile.time)
+      return 0;
+
+   return a->profile.time < b->profile.time ? 1 : -1;
+}
+
+
+// Log the scripts that used the most time since we last looked
+void ServerGame::logScriptStats()
+{
+   Vector<LuaScriptRunner *> scripts;
+   getScripts(scripts);
+
+   Vector<ScriptStats> stats(scripts.size());
+   for(S32 i = 0; i < scripts.size(); i++)
+   {
+      ScriptStats stat;
+      stat.name = scripts[i]->getProfileName();
+      stat.profile = scripts[i]->takeRecentProfile();
+
+      if(stat.profile.calls > 0)
+         stats.push_back(stat);
+   }
+
+   stats.sort(ScriptTimeSort);
+
+   for(S32 i = 0; i < stats.size() && i < ScriptStatsLogCount; i++)
+   {
+      const LuaScriptProfile &profile = stats[i].profile;
+      logprintf(LogConsumer::ServerFilter, "Script %s: %d calls, %.1f ms, %llu instructions, %llu KB allocated, %d ticks deferred",
+                stats[i].name.c_str(), profile.calls, profile.time, (unsigned long long)profile.instructions,
+                (unsigned long long)(profile.bytesAllocated / 1024), profile.deferredTicks);
+   }
+}
+
+
+// Start a new stretch of network stats for each client, and write a CSV line for each one just finished if
+// we're logging them
+void ServerGame::endConnectionStatsPeriod()
+{
+   bool logging = mSettings->getIniSettings()->netStatsLogTime > 0;
+   string timeStamp = logging ? getTimeStamp() : "";
+
+   for(S32 i = 0; i < getClientCount(); i++)
+   {
+      ClientInfo *clientInfo = getClientInfo(i);
+
+      if(clientInfo->isRobot())
+         continue;
+
+      GameConnection *conn = clientInfo->getConnection();
+      conn->endConnectionStatsPeriod();
+
+      if(!logging)
+         continue;
+
+      ConnectionStats stats = conn->getConnectionStats();
+      string name = replaceString(clientInfo->getName().getString(), "\"", "\"\"");    // CSV escapes quotes by doubling them
+
+      logprintf(LogConsumer::NetStatsFilter, "%s,\"%s\",%s,%.1f,%.0f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.1f,%d",
+                timeStamp.c_str(), name.c_str(), conn->getNetAddressString(), stats.period / 1000.0f,
+                stats.roundTripTime, stats.packetsSent, stats.packetsLost, stats.bytesReceived, stats.getTotalBytesSent(),
+                stats.bytesSent[NetConnection::TrafficOverhead], stats.bytesSent[NetConnection::TrafficMoves],
+                stats.bytesSent[NetConnection::TrafficEvents], stats.bytesSent[NetConnection::TrafficGhosts],
+                stats.eventsRetransmitted, stats.ghostUpdatesSent, stats.ghostUpdatesSkipped,
+                stats.getAverageGhostsInScope(), stats.maxGhostsInScope);
+   }
+}
+
+
+// Report where the time spent sending packets went during the level that just ended, how much scoping work was
+// saved by caching, and how many object searches were done ahead of time, then start counting afresh
+void ServerGame::logPacketStats()
+{
+   F64 scope    = mNetInterface->getPacketPhaseTime(NetInterface::PacketPhaseScope);
+   F64 priority = mNetInterface->getPacketPhaseTime(NetInterface::PacketPhasePriority);
+   F64 write    = mNetInterface->getPacketPhaseTime(NetInterface::PacketPhaseWrite);
+
+   if(scope + priority + write > 0)
+      logprintf(LogConsumer::ServerFilter, "Packet preparation: scope %.1f ms, priority %.1f ms, write %.1f ms (%d worker threads)",
+                scope, priority, write, mWorkerPool ? S32(mWorkerPool->getThreadCount()) : 0);
+
+   mNetInterface->resetPacketPhaseTimes();
+
+   // How well the scope caches are doing: objects we had to look at, vs. what we'd have looked at without them
+   U32 objectsExamined = 0;
+   U32 objectsCovered = 0;
+
+   for(S32 i = 0; i < getClientCount(); i++)
+      if(!getClientInfo(i)->isRobot() && getClientInfo(i)->getConnection())
+         getClientInfo(i)->getConnection()->getScopeCache().collectTotals(objectsExamined, objectsCovered);
+
+   if(mGameType)
+      mGameType->collectScopeStats(objectsExamined, objectsCovered);
+
+   if(objectsCovered > 0)
+      logprintf(LogConsumer::ServerFilter, "Scope queries re-evaluated %u of %u objects (%.1f%%)",
+                objectsExamined, objectsCovered, 100.0 * objectsExamined / objectsCovered);
+
+   // Searches that had to be redone because something got in the way first are wasted work
+   U32 queriesPrepared = 0;
+   U32 queriesUsed = 0;
+
+   if(mIdleQueryBatch)
+      mIdleQueryBatch->collectTotals(queriesPrepared, queriesUsed);
+
+   if(queriesPrepared > 0)
+      logprintf(LogConsumer::ServerFilter, "Idle searches: %u of %u done on worker threads were used (%.1f%%)",
+                queriesUsed, queriesPrepared, 100.0 * queriesUsed / queriesPrepared);
+}
+
+
+bool ServerGame::findPreparedIdleObjects(const BfObject *object, TestFunc testFunc, const Rect &queryRect,
+                                         Vector<DatabaseObject *> &fillVector)
+{
+   return mIdleQueryBatch && mIdleQueryBatch->findObjects(object, testFunc, queryRect, fillVector);
+}
+
+
 // Return true when handled
 bool ServerGame::voteStart(ClientInfo *clientInfo, VoteType type, S32 number)
 {
@@ -260,6 +468,24 @@ LevelInfo ServerGame::getLevelInfo(S32 index)
 }
 
 
+LevelSourcePtr ServerGame::getLevelSource() const
+{
+   return mLevelSource;
+}
+
+
+EventManager *ServerGame::getEventManager() const
+{
+   return mEventManager;
+}
+
+
+WorkerPool *ServerGame::getWorkerPool() const
+{
+   return mWorkerPool;
+}
+
+
 // Creates a set of LevelInfos that are empty except for the filename.  They will be fleshed out later.
 // This gets called when you first load the host menu
 //void ServerGame::buildBasicLevelInfoList(const Vector<string> &levelList)
@@ -577,6 +803,8 @@ void ServerGame::cycleLevel(S32 nextLevel)
    delete mGameRecorderServer;
    mGameRecorderServer = NULL;
 
+   logPacketStats();
+
    cleanUp();
    mLevelSwitchTimer.clear();
    mScopeAlwaysList.clear();
@@ -641,6 +869,7 @@ void ServerGame::cycleLevel(S32 nextLevel)
    }
 
    computeWorldObjectExtents();                       // Compute world Extents nice and early
+   configureSpatialIndexes();                         // Needs those extents
 
    if(!mGameRecorderServer && !mShuttingDown && getSettings()->getIniSettings()->enableGameRecording)
       mGameRecorderServer = new GameRecorderServer(this);
@@ -657,8 +886,12 @@ void ServerGame::cycleLevel(S32 nextLevel)
    triangulate = !isDedicated();
 #endif
 
-   mGameType->mBotZoneCreationFailed = !BotNavMeshZone::buildBotMeshZones(mBotZoneDatabase, getGameObjDatabase(), &mAllZones,
-                                                                          getWorldExtents(), triangulate);
+   mGameType->mBotZoneCreationFailed = !buildBotZones(triangulate);
+   cancelBotPaths();       // They were headed for zones that no longer exist
+   mBotPathCache.reset(&mAllZones);
+
+   buildWallVisibility();
+
    if(mGameType->mBotZoneCreationFailed)
    {
       for(int i = 0; i < getClientCount(); i++)
@@ -708,6 +941,20 @@ void ServerGame::cycleLevel(S32 nextLevel)
 }
 
 
+// Now that we know how big the level is, switch each of our databases to the bucket layout specified in the INI
+void ServerGame::configureSpatialIndexes()
+{
+   IniSettings *iniSettings = mSettings->getIniSettings();
+   const Rect *extents = getWorldExtents();
+   WallSegmentManager *wallSegmentManager = getGameObjDatabase()->getWallSegmentManager();
+
+   getGameObjDatabase()->setSpatialIndex(iniSettings->gameObjectIndex, *extents);
+   wallSegmentManager->getWallSegmentDatabase()->setSpatialIndex(iniSettings->wallIndex, *extents);
+   wallSegmentManager->getWallEdgeDatabase()   ->setSpatialIndex(iniSettings->wallIndex, *extents);
+   mBotZoneDatabase->setSpatialIndex(iniSettings->botZoneIndex, *extents);
+}
+
+
 void ServerGame::onConnectedToMaster()
 {
    Parent::onConnectedToMaster();
@@ -1036,6 +1283,46 @@ inline string getPathFromFilename(const string &filename)
 }
 
 
+// Reads the level's zones back from the botzones folder if they were saved on an earlier load; otherwise builds them,
+// and saves them for next time.  Zones for levels with levelgens aren't saved, as the scripts can add walls as they
+// please, and neither are those on test servers, as every edit to a level in the editor would leave another file.
+bool ServerGame::buildBotZones(bool triangulate)
+{
+   FolderManager *folderManager = getSettings()->getFolderManager();
+   IniSettings *iniSettings = getSettings()->getIniSettings();
+
+   bool canSave = iniSettings->saveBotZones && folderManager->botZoneDir != "" && mLevelFileHash != "" &&
+                  getGameType()->getScriptName() == "" && iniSettings->globalLevelScript == "" && !isTestServer();
+
+   string fileName = canSave ? BotZoneCache::getFileName(folderManager->botZoneDir, mLevelFileHash) : "";
+
+   if(canSave && fileExists(fileName) &&
+      BotZoneCache::read(fileName, mLevelFileHash, mBotZoneDatabase, &mAllZones, triangulate))
+      return true;
+
+   if(!BotNavMeshZone::buildBotMeshZones(mBotZoneDatabase, getGameObjDatabase(), &mAllZones, getWorldExtents(), triangulate))
+      return false;
+
+   if(canSave && makeSureFolderExists(folderManager->botZoneDir))
+      BotZoneCache::write(fileName, mLevelFileHash, &mAllZones);
+
+   return true;
+}
+
+
+// Walls are all in place by now, and won't move until the next level
+void ServerGame::buildWallVisibility()
+{
+   IniSettings *iniSettings = mSettings->getIniSettings();
+
+   if(!iniSettings->wallVisibilityTree || !getGameObjDatabase()->buildWallVisibility())
+      return;
+
+   if(iniSettings->botZoneVisibility && !mGameType->mBotZoneCreationFailed)
+      getGameObjDatabase()->getWallVisibility()->buildZoneVisibility(&mAllZones, mWorkerPool);
+}
+
+
 bool ServerGame::loadLevel()
 {
    resetLevelInfo();    // Resets info about the level, not a LevelInfo...  In case you were wondering.
@@ -1248,6 +1535,16 @@ Robot *ServerGame::getBot(S32 index)
 }
 
 
+void ServerGame::getScripts(Vector<LuaScriptRunner *> &scripts)
+{
+   for(S32 i = 0; i < getBotCount(); i++)
+      scripts.push_back(getBot(i));
+
+   for(S32 i = 0; i < mLevelGens.size(); i++)
+      scripts.push_back(mLevelGens[i]);
+}
+
+
 S32 ServerGame::getBotCount() const
 {
    return mRobotManager.getBotCount();
@@ -1321,6 +1618,13 @@ bool ServerGame::isDedicated() const
 }
 
 
+// Extra instances are the ones a multi-instance server runs alongside its primary ServerGame
+bool ServerGame::isExtraInstance() const
+{
+   return mEventManager != NULL;
+}
+
+
 void ServerGame::setDedicated(bool dedicated)
 {
    mDedicated = dedicated;
@@ -1410,6 +1714,20 @@ void ServerGame::idle(U32 timeDelta)
    if(mMasterUpdateTimer.update(timeDelta))
       updateStatusOnMaster();
 
+   if(mScriptStatsTimer.update(timeDelta))
+   {
+      if(LuaScriptRunner::isCountingInstructions())
+         logScriptStats();
+
+      mScriptStatsTimer.reset();
+   }
+
+   if(mConnectionStatsTimer.update(timeDelta))
+   {
+      endConnectionStatsPeriod();
+      mConnectionStatsTimer.reset();
+   }
+
    // If we have a data transfer going on, process it
    if(!dataSender.isDone())
       dataSender.sendNextLine();
@@ -1460,6 +1778,9 @@ void ServerGame::idle(U32 timeDelta)
    // Compute it here to save recomputing it for every robot and other method that relies on it.
    computeWorldObjectExtents();
 
+   // Paths bots asked for last tick get solved all together, before the bots run again
+   solveBotPaths();
+
    U32 botControlTickElapsed = botControlTickTimer.getElapsed();
 
    if(botControlTickTimer.update(timeDelta))
@@ -1468,13 +1789,17 @@ void ServerGame::idle(U32 timeDelta)
       mRobotManager.clearMoves();
 
       // Fire TickEvent, in case anyone is listening
-      EventManager::get()->fireEvent(EventManager::TickEvent, botControlTickElapsed + timeDelta);
+      EventManager::get()->fireEvent(EventManager::TickEvent, botControlTickElapsed + timeDelta, mWorkerPool);
 
       botControlTickTimer.reset();
    }
    
    const Vector<DatabaseObject *> *gameObjects = mGameObjDatabase->findObjects_fast();
 
+   // Get a head start on the searches objects will do while idling; objects still idle one at a time, in order
+   if(mIdleQueryBatch)
+      mIdleQueryBatch->prepare(mGameObjDatabase.get(), *gameObjects, timeDelta, mWorkerPool);
+
    // Visit each game object, handling moves and running its idle method
    for(S32 i = gameObjects->size() - 1; i >= 0; i--)
    {
@@ -1487,11 +1812,17 @@ void ServerGame::idle(U32 timeDelta)
       Move thisMove = obj->getCurrentMove();
       thisMove.time = timeDelta;
 
+      if(mIdleQueryBatch)
+         mIdleQueryBatch->setCurrentObject(i);
+
       // Give the object its move, then have it idle
       obj->setCurrentMove(thisMove);
       obj->idle(BfObject::ServerIdleMainLoop);
    }
 
+   if(mIdleQueryBatch)
+      mIdleQueryBatch->finish();
+
    if(mGameType)
       mGameType->idle(BfObject::ServerIdleMainLoop, timeDelta);
 
@@ -1540,6 +1871,9 @@ void ServerGame::idle(U32 timeDelta)
    if(mGameRecorderServer)
       mGameRecorderServer->idle(timeDelta);
 
+   if(mGameType)
+      mGameType->prepareScopeQueries();   // Must come after everything has moved, and before any scoping
+
    mNetInterface->processConnections(); // Update to other clients right after idling everything else, so clients get more up to date information
 }
 
@@ -1833,6 +2167,28 @@ bool ServerGame::startHosting()
 }
 
 
+// A running game needs every frame, but a suspended one only has a few timers to look after until somebody connects;
+// an incoming packet will wake the dedicated server up before then anyway
+U32 ServerGame::getTimeUntilIdleNeeded()
+{
+   if(!mGameSuspended || !dataSender.isDone())
+      return 0;
+
+   U32 wait = SuspendedIdleTime;
+
+   if(mMasterUpdateTimer.getCurrent() < wait)
+      wait = mMasterUpdateTimer.getCurrent();
+
+   if(mTimeToSuspend.getCurrent() > 0 && mTimeToSuspend.getCurrent() < wait)
+      wait = mTimeToSuspend.getCurrent();
+
+   if(mSendLevelInfoDelayCount.getCurrent() > 0 && mSendLevelInfoDelayCount.getCurrent() < wait)
+      wait = mSendLevelInfoDelayCount.getCurrent();
+
+   return wait;
+}
+
+
 void ServerGame::gameEnded()
 {
    mLevelSwitchTimer.reset();
@@ -1972,6 +2328,107 @@ U16 ServerGame::findZoneContaining(const Point &p) const
 }
 
 
+BotPathCache *ServerGame::getBotPathCache()
+{
+   return &mBotPathCache;
+}
+
+
+// Called when something bots had been steering around, like a Core, goes away
+void ServerGame::openBotZones(const Vector<Point> &area)
+{
+   Rect extent(area);
+   bool changed = false;
+
+   fillVector.clear();
+   mBotZoneDatabase->findObjects(BotNavMeshZoneTypeNumber, fillVector, extent);
+
+   for(S32 i = 0; i < fillVector.size(); i++)
+   {
+      BotNavMeshZone *zone = static_cast<BotNavMeshZone *>(fillVector[i]);
+
+      if(!zone->getWalkable() && polygonContainsPoint(area.address(), area.size(), zone->getCenter()))
+      {
+         zone->setWalkable(true);
+         changed = true;
+      }
+   }
+
+   // Routes found while the zones were blocked could now be the long way around
+   if(changed)
+      mBotPathCache.invalidate();
+}
+
+
+void ServerGame::queueBotPath(Robot *robot, S32 handle, U16 startZone, U16 targetZone, const Point &target)
+{
+   PendingBotPath pending;
+   pending.robot = robot;
+   pending.handle = handle;
+   pending.startZone = startZone;
+   pending.targetZone = targetZone;
+   pending.target = target;
+   pending.batchIndex = -1;
+
+   mPendingBotPaths.push_back(pending);
+}
+
+
+// Searches for every path robots have asked for on mWorkerPool, then lets each robot know how it went
+void ServerGame::solveBotPaths()
+{
+   if(mPendingBotPaths.size() == 0)
+      return;
+
+   // Robots may ask for more paths when they hear about these; those will wait for next time
+   Vector<PendingBotPath> solving = mPendingBotPaths;
+   mPendingBotPaths.clear();
+
+   mBotPathBatch.clear();
+
+   for(S32 i = 0; i < solving.size(); i++)
+   {
+      PendingBotPath &pending = solving[i];
+
+      if(!mBotPathCache.hasPath(pending.startZone, pending.targetZone))
+         pending.batchIndex = mBotPathBatch.addRequest(pending.startZone, pending.targetZone, pending.target);
+   }
+
+   mBotPathBatch.solve(&mAllZones, mWorkerPool, mBotPathCache.getHierarchy());
+
+   Vector<Point> path;
+
+   for(S32 i = 0; i < solving.size(); i++)
+   {
+      PendingBotPath &pending = solving[i];
+
+      if(pending.batchIndex >= 0)
+      {
+         path = mBotPathBatch.getPath(pending.batchIndex);
+
+         // Two robots may have asked for the same path; the second is already in the cache
+         if(!mBotPathCache.hasPath(pending.startZone, pending.targetZone))
+            mBotPathCache.addPath(pending.startZone, pending.targetZone, path);
+      }
+      else
+         path = mBotPathCache.findPath(pending.startZone, pending.targetZone, pending.target);
+
+      if(pending.robot.isValid())
+         pending.robot->onPathSolved(pending.handle, pending.targetZone, path);
+   }
+}
+
+
+void ServerGame::cancelBotPaths()
+{
+   for(S32 i = 0; i < mPendingBotPaths.size(); i++)
+      if(mPendingBotPaths[i].robot.isValid())
+         mPendingBotPaths[i].robot->cancelPathRequest(mPendingBotPaths[i].handle);
+
+   mPendingBotPaths.clear();
+}
+
+
 void ServerGame::setGameType(GameType *gameType)
 {
    Parent::setGameType(gameType);
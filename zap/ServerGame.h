@@ -9,15 +9,19 @@
 #include "game.h"                // Parent class
 
 #include "BotNavMeshZone.h"
+#include "BotPathCache.h"
 #include "dataConnection.h"
 #include "LevelSource.h"         // For LevelSourcePtr def
 #include "LevelSpecifierEnum.h"
+#include "PathRequestBatch.h"
 #include "RobotManager.h"
 
 #include "Intervals.h"
 
 using namespace std;
 
+namespace TNL { class WorkerPool; class FileLogConsumer; }
+
 namespace Zap
 {
 
@@ -26,6 +30,8 @@ class LuaGameInfo;
 class Robot;
 class PolyWall;
 class WallItem;
+class IdleQueryBatch;
+class EventManager;
 class ItemSpawn;
 struct LevelInfo;
 
@@ -44,6 +50,9 @@ private:
       UpdateServerWhenHostGoesEmpty = FOUR_SECONDS, // How many seconds when host on server when server goes empty or not empty
       CheckServerStatusTime = FIVE_SECONDS,       // If it did not send updates, recheck after ms
       BotControlTickInterval = 33,                // Interval for how often should we let bots fire the onTick event (ms)
+      ScriptStatsLogTime = ONE_MINUTE,            // How often we log the costliest scripts when ScriptProfiling is on (ms)
+      ScriptStatsLogCount = 5,                    // How many of them to log
+      ConnectionStatsTime = TEN_SECONDS,          // How long each stretch of client network stats covers, unless NetStatsLogTime says (ms)
    };
 
    bool mTestMode;                        // True if being tested from editor
@@ -55,6 +64,9 @@ private:
    U32 mCurrentLevelIndex;                // Index of level currently being played
    Timer mLevelSwitchTimer;               // Track how long after game has ended before we actually switch levels
    Timer mMasterUpdateTimer;              // Periodically let the master know how we're doing
+   Timer mScriptStatsTimer;               // Periodically log which scripts cost us the most
+   Timer mConnectionStatsTimer;           // Periodically start a new stretch of client network stats, logging the last
+   FileLogConsumer *mNetStatsLog;         // Where they're logged, when NetStatsLogTime is set; extra instances share ours
 
    bool mShuttingDown;
    string mShutdownReason;                // Message to local user about why we're shutting down, optional
@@ -106,6 +118,7 @@ private:
 
    void cleanUp();
    bool loadLevel();                                  // Load the level pointed to by mCurrentLevelIndex
+   void configureSpatialIndexes();                    // Size our spatial databases to fit the level just loaded
    void runLevelGenScript(const string &scriptName);  // Run any levelgens specified by the level or in the INI
 
    AbstractTeam *getNewTeam();
@@ -119,6 +132,36 @@ private:
 
    GridDatabase *mBotZoneDatabase;
    Vector<BotNavMeshZone *> mAllZones;
+   BotPathCache mBotPathCache;
+
+   bool buildBotZones(bool triangulate);
+   void buildWallVisibility();
+
+   struct PendingBotPath
+   {
+      SafePtr<Robot> robot;
+      S32 handle;
+      U16 startZone;
+      U16 targetZone;
+      Point target;
+      S32 batchIndex;            // Index in mBotPathBatch, or -1 if mBotPathCache already knew the way
+   };
+
+   Vector<PendingBotPath> mPendingBotPaths;     // Asked for by robots since the last solveBotPaths()
+   PathRequestBatch mBotPathBatch;
+
+   void solveBotPaths();
+   void cancelBotPaths();
+
+   WorkerPool *mWorkerPool;      // Prepares packets for all clients at once; NULL if WorkerThreads is 0
+   bool mOwnsWorkerPool;         // Extra instances borrow the primary ServerGame's pool
+   IdleQueryBatch *mIdleQueryBatch;    // Searches for objects' idle() methods on mWorkerPool; NULL without a pool
+
+   EventManager *mEventManager;  // Script event subscriptions of an extra instance; NULL uses the shared EventManager
+
+   void logPacketStats();
+   void logScriptStats();
+   void endConnectionStatsPeriod();
    
 public:
    ServerGame(const Address &address, GameSettingsPtr settings, LevelSourcePtr levelSource, bool testMode, bool dedicated, bool hostOnServer = false);    // Constructor
@@ -137,6 +180,7 @@ public:
 
    // These are public so this can be accessed by tests
    static const U32 MaxTimeDelta = TWO_SECONDS;     
+   static const U32 SuspendedIdleTime = 250;        // Longest a suspended game goes between idles, to keep connections moving
    static const U32 LevelSwitchTime = FIVE_SECONDS;
 
    U32 mVoteTimer;
@@ -156,6 +200,7 @@ public:
 
    bool isTestServer() const;
    bool isDedicated() const;
+   bool isExtraInstance() const;
    void setDedicated(bool dedicated);
 
    bool isFull();      // More room at the inn?
@@ -192,7 +237,11 @@ public:
 
    void balanceTeams();
 
+   bool findPreparedIdleObjects(const BfObject *object, TestFunc testFunc, const Rect &queryRect,
+                                Vector<DatabaseObject *> &fillVector);
+
    Robot *getBot(S32 index);
+   void getScripts(Vector<LuaScriptRunner *> &scripts);   // Running bots and levelgens
    string addBot(const Vector<const char *> &args, ClientInfo::ClientClass clientClass);
    void addBot(Robot *robot);
    void removeBot(Robot *robot);
@@ -222,11 +271,15 @@ public:
    bool isServer() const;
    void idle(U32 timeDelta);
    bool isReadyToShutdown(U32 timeDelta, string &shutdownReason);
+   U32 getTimeUntilIdleNeeded();                      // 0 means idle every frame
    void gameEnded();
 
    S32 getCurrentLevelIndex();
    S32 getLevelCount();
    LevelInfo getLevelInfo(S32 index);
+   LevelSourcePtr getLevelSource() const;
+   EventManager *getEventManager() const;
+   WorkerPool *getWorkerPool() const;
    //void clearLevelInfos();
    void sendLevelListToLevelChangers(const string &message = "");
 
@@ -265,6 +318,11 @@ public:
    GridDatabase *getBotZoneDatabase() const;
    const Vector<BotNavMeshZone *> *getBotZones() const;
    U16 findZoneContaining(const Point &p) const;
+   BotPathCache *getBotPathCache();
+   void openBotZones(const Vector<Point> &area);      // Zones under area are no longer expensive to cross
+
+   // Searched for at the start of the next tick, when robot->onPathSolved() is called
+   void queueBotPath(Robot *robot, S32 handle, U16 startZone, U16 targetZone, const Point &target);
 
    void setGameType(GameType *gameType);
    void onObjectAdded(BfObject *obj);
@@ -0,0 +1,267 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "SpatialIndex.h"
+
+#include "stringUtils.h"
+
+#include "tnlAssert.h"
+
+namespace Zap
+{
+
+// Constructor
+BucketRange::BucketRange()
+{
+   level = 0;
+}
+
+
+bool BucketRange::operator==(const BucketRange &range) const
+{
+   return level     == range.level     &&
+          bins.minx == range.bins.minx && bins.miny == range.bins.miny &&
+          bins.maxx == range.bins.maxx && bins.maxy == range.bins.maxy;
+}
+
+
+bool BucketRange::operator!=(const BucketRange &range) const
+{
+   return !(*this == range);
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+SpatialIndex::~SpatialIndex()
+{
+   // Do nothing
+}
+
+
+// Static factory method -- caller is responsible for deleting the returned index
+SpatialIndex *SpatialIndex::create(SpatialIndexType type, const Rect &levelExtents)
+{
+   if(type == SpatialIndexHierarchicalGrid)
+      return new HierarchicalGridIndex(levelExtents);
+
+   return new WrappingGridIndex();
+}
+
+
+// Used when reading the INI; anything we don't recognize gets the legacy grid
+SpatialIndexType SpatialIndex::stringToType(const string &type)
+{
+   string lower = lcase(type);
+
+   if(lower == "hierarchical")
+      return SpatialIndexHierarchicalGrid;
+
+   return SpatialIndexWrappingGrid;
+}
+
+
+string SpatialIndex::typeToString(SpatialIndexType type)
+{
+   if(type == SpatialIndexHierarchicalGrid)
+      return "Hierarchical";
+
+   return "Grid";
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+// Constructor
+WrappingGridIndex::WrappingGridIndex()
+{
+   // Do nothing
+}
+
+
+// Destructor
+WrappingGridIndex::~WrappingGridIndex()
+{
+   // Do nothing
+}
+
+
+SpatialIndexType WrappingGridIndex::getType() const
+{
+   return SpatialIndexWrappingGrid;
+}
+
+
+S32 WrappingGridIndex::getBucketCount() const
+{
+   return BucketRowCount * BucketRowCount;
+}
+
+
+S32 WrappingGridIndex::getLevelCount() const
+{
+   return 1;
+}
+
+
+void WrappingGridIndex::getInsertRange(const Rect &extents, BucketRange &range) const
+{
+   range.level = 0;
+   getQueryBins(0, extents, range.bins);
+}
+
+
+// Translates extents into bins to search
+void WrappingGridIndex::getQueryBins(S32 level, const Rect &extents, IntRect &bins) const
+{
+   bins.minx = S32(extents.min.x) >> BucketWidthBitShift;
+   bins.miny = S32(extents.min.y) >> BucketWidthBitShift;
+   bins.maxx = S32(extents.max.x) >> BucketWidthBitShift;
+   bins.maxy = S32(extents.max.y) >> BucketWidthBitShift;
+
+   if(U32(bins.maxx - bins.minx) >= BucketRowCount)
+      bins.maxx = bins.minx + BucketRowCount - 1;
+
+   if(U32(bins.maxy - bins.miny) >= BucketRowCount)
+      bins.maxy = bins.miny + BucketRowCount - 1;
+}
+
+
+S32 WrappingGridIndex::getBucketIndex(S32 level, S32 x, S32 y) const
+{
+   return ((x & BucketMask) * BucketRowCount) + (y & BucketMask);
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+// Keep absurd extents from overflowing our integer math
+static S32 clampSize(F32 size)
+{
+   static const F32 MaxSize = F32(1 << 24);
+   return S32(size < MaxSize ? size : MaxSize);
+}
+
+
+// Constructor
+HierarchicalGridIndex::HierarchicalGridIndex(const Rect &levelExtents)
+{
+   Rect extents(levelExtents);
+   extents.expand(Point(ExtentMargin, ExtentMargin));
+
+   mOrigin = extents.min;
+
+   S32 width  = clampSize(extents.getWidth());
+   S32 height = clampSize(extents.getHeight());
+
+   // Don't let a huge level explode the number of cells on the finest level
+   S32 shift = MinCellBitShift;
+   while(S64((width >> shift) + 1) * S64((height >> shift) + 1) > MaxFinestCells)
+      shift++;
+
+   mBucketCount = 0;
+
+   // Keep adding coarser levels until one can hold the entire level in a 2x2 block of cells
+   for(S32 i = 0; i < MaxLevels; i++)
+   {
+      GridLevel level;
+      level.shift  = shift + i;
+      level.width  = (width  >> level.shift) + 1;
+      level.height = (height >> level.shift) + 1;
+      level.firstBucket = mBucketCount;
+
+      mLevels.push_back(level);
+      mBucketCount += level.width * level.height;
+
+      if(level.width <= 2 && level.height <= 2)
+         break;
+   }
+}
+
+
+// Destructor
+HierarchicalGridIndex::~HierarchicalGridIndex()
+{
+   // Do nothing
+}
+
+
+SpatialIndexType HierarchicalGridIndex::getType() const
+{
+   return SpatialIndexHierarchicalGrid;
+}
+
+
+S32 HierarchicalGridIndex::getBucketCount() const
+{
+   return mBucketCount;
+}
+
+
+S32 HierarchicalGridIndex::getLevelCount() const
+{
+   return mLevels.size();
+}
+
+
+// Convert a coordinate into a cell index, clamping anything outside the grid onto the border cells.
+// Clamping happens in floating point to avoid overflow when converting huge coordinates to ints.
+S32 HierarchicalGridIndex::toCell(F32 coord, F32 origin, const GridLevel &level, S32 cellCount) const
+{
+   F32 rel = coord - origin;
+
+   if(rel <= 0)
+      return 0;
+
+   if(rel >= F32(cellCount << level.shift))
+      return cellCount - 1;
+
+   return S32(rel) >> level.shift;
+}
+
+
+void HierarchicalGridIndex::fillBins(const GridLevel &level, const Rect &extents, IntRect &bins) const
+{
+   bins.minx = toCell(extents.min.x, mOrigin.x, level, level.width);
+   bins.miny = toCell(extents.min.y, mOrigin.y, level, level.height);
+   bins.maxx = toCell(extents.max.x, mOrigin.x, level, level.width);
+   bins.maxy = toCell(extents.max.y, mOrigin.y, level, level.height);
+}
+
+
+// Store object on the finest level where it covers at most 2x2 cells
+void HierarchicalGridIndex::getInsertRange(const Rect &extents, BucketRange &range) const
+{
+   for(S32 i = 0; i < mLevels.size(); i++)
+   {
+      fillBins(mLevels[i], extents, range.bins);
+      range.level = i;
+
+      if(range.bins.maxx - range.bins.minx <= 1 && range.bins.maxy - range.bins.miny <= 1)
+         return;
+   }
+
+   // If we get here, the object is bigger than the coarsest level can handle; leave it spread across the top level
+}
+
+
+void HierarchicalGridIndex::getQueryBins(S32 level, const Rect &extents, IntRect &bins) const
+{
+   TNLAssert(level >= 0 && level < mLevels.size(), "Invalid level!");
+   fillBins(mLevels[level], extents, bins);
+}
+
+
+S32 HierarchicalGridIndex::getBucketIndex(S32 level, S32 x, S32 y) const
+{
+   const GridLevel &gridLevel = mLevels[level];
+   return gridLevel.firstBucket + y * gridLevel.width + x;
+}
+
+
+};
@@ -0,0 +1,151 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _SPATIAL_INDEX_H_
+#define _SPATIAL_INDEX_H_
+
+#include "Rect.h"
+
+#include "tnlTypes.h"
+#include "tnlVector.h"
+
+#include <string>
+
+using namespace TNL;
+using namespace std;
+
+namespace Zap
+{
+
+// Different ways a GridDatabase can lay out its buckets
+enum SpatialIndexType {
+   SpatialIndexWrappingGrid,        // Fixed 16x16 grid that wraps around; needs no setup, but distant objects share buckets
+   SpatialIndexHierarchicalGrid,    // Stack of progressively coarser grids sized from the level extents
+   SpatialIndexTypeCount
+};
+
+
+// The set of buckets an object lives in: a rectangle of cells on a single level of the index
+struct BucketRange
+{
+   S32 level;
+   IntRect bins;
+
+   BucketRange();
+
+   bool operator==(const BucketRange &range) const;
+   bool operator!=(const BucketRange &range) const;
+};
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+// A SpatialIndex maps world coordinates onto bucket numbers.  The GridDatabase owns the buckets themselves,
+// and asks the index which ones to use when storing or searching for objects.
+class SpatialIndex
+{
+public:
+   virtual ~SpatialIndex();
+
+   virtual SpatialIndexType getType() const = 0;
+
+   virtual S32 getBucketCount() const = 0;
+   virtual S32 getLevelCount() const = 0;
+
+   // Figure out which buckets an object with the specified extents should be stored in
+   virtual void getInsertRange(const Rect &extents, BucketRange &range) const = 0;
+
+   // Figure out which cells on the specified level need to be searched to find everything overlapping extents
+   virtual void getQueryBins(S32 level, const Rect &extents, IntRect &bins) const = 0;
+
+   virtual S32 getBucketIndex(S32 level, S32 x, S32 y) const = 0;
+
+   static SpatialIndex *create(SpatialIndexType type, const Rect &levelExtents);    // Caller must delete
+
+   static SpatialIndexType stringToType(const string &type);
+   static string typeToString(SpatialIndexType type);
+};
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+// The original GridDatabase layout.  Cells are 256 pixels wide, and coordinates wrap every 16 cells, so
+// objects on large levels that are 4096 pixels apart end up sharing buckets.
+class WrappingGridIndex : public SpatialIndex
+{
+public:
+   enum {
+      BucketRowCount = 16,    // Number of buckets per grid row, and number of rows; should be power of 2
+      BucketMask = BucketRowCount - 1,
+   };
+
+   static const S32 BucketWidthBitShift = 8;    // Width/height of each bucket in pixels, in a form of 2 ^ n, 8 is 256 pixels
+
+   WrappingGridIndex();             // Constructor
+   virtual ~WrappingGridIndex();    // Destructor
+
+   SpatialIndexType getType() const;
+
+   S32 getBucketCount() const;
+   S32 getLevelCount() const;
+
+   void getInsertRange(const Rect &extents, BucketRange &range) const;
+   void getQueryBins(S32 level, const Rect &extents, IntRect &bins) const;
+
+   S32 getBucketIndex(S32 level, S32 x, S32 y) const;
+};
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+// Several grids stacked on top of one another, each covering the whole level, with each level's cells twice
+// the size of those on the level below.  Objects are stored on the finest level where they span no more than
+// two cells in each direction, so small things like ships and bullets live in small buckets while long walls
+// go into a handful of big ones.  Coordinates outside the level extents are clamped to the border cells,
+// so nothing is ever aliased onto a distant part of the map.
+class HierarchicalGridIndex : public SpatialIndex
+{
+   struct GridLevel
+   {
+      S32 shift;           // Cell size on this level is 2 ^ shift
+      S32 width;           // Cells across
+      S32 height;          // Cells down
+      S32 firstBucket;     // Index of bucket for cell (0,0) on this level
+   };
+
+   Point mOrigin;
+   Vector<GridLevel> mLevels;
+   S32 mBucketCount;
+
+   S32 toCell(F32 coord, F32 origin, const GridLevel &level, S32 cellCount) const;
+   void fillBins(const GridLevel &level, const Rect &extents, IntRect &bins) const;
+
+public:
+   static const S32 MinCellBitShift   = 8;       // Finest cells are at least 256 pixels across
+   static const S32 MaxFinestCells    = 16384;   // Cap on cells in the finest level; coarsens the grid on huge levels
+   static const S32 MaxLevels         = 8;
+   static const S32 ExtentMargin      = 512;     // Padding around the level, as things tend to wander a bit beyond the walls
+
+   explicit HierarchicalGridIndex(const Rect &levelExtents);    // Constructor
+   virtual ~HierarchicalGridIndex();                            // Destructor
+
+   SpatialIndexType getType() const;
+
+   S32 getBucketCount() const;
+   S32 getLevelCount() const;
+
+   void getInsertRange(const Rect &extents, BucketRange &range) const;
+   void getQueryBins(S32 level, const Rect &extents, IntRect &bins) const;
+
+   S32 getBucketIndex(S32 level, S32 x, S32 y) const;
+};
+
+
+};
+
+#endif
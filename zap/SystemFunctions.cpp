@@ -84,6 +84,52 @@ void initHosting(GameSettingsPtr settings, LevelSourcePtr levelSource, bool test
 }
 
 
+// Start the rest of the games asked for with -instances, once the primary one is hosting.  Each listens on the port
+// after the previous one's, and shares the primary's settings and levels, so the level list is only built once.
+void initExtraHosting(ServerGame *primaryGame)
+{
+   GameSettingsPtr settings = primaryGame->getSettingsPtr();
+   U32 instanceCount = settings->getInstanceCount();
+
+   if(instanceCount <= 1)
+      return;
+
+   Address address(IPProtocol, Address::Any, GameSettings::DEFAULT_GAME_PORT);
+   address.set(settings->getHostAddress());
+
+   U16 basePort = address.port;
+
+   for(U32 i = 1; i < instanceCount; i++)
+   {
+      if(U32(basePort) + i > 0xFFFF)
+      {
+         logprintf(LogConsumer::LogError, "Ran out of ports after %d game instances", i);
+         break;
+      }
+
+      address.port = U16(basePort + i);
+
+      ServerGame *serverGame = new ServerGame(address, settings, primaryGame->getLevelSource(), false, true);
+
+      GameManager::addServerGame(serverGame);
+      GameManager::setCurrentServerGame(serverGame);
+
+      serverGame->setReadyToConnectToMaster(true);
+      bool started = serverGame->startHosting();
+
+      GameManager::setCurrentServerGame(primaryGame);
+
+      if(!started)
+      {
+         GameManager::deleteServerGame(serverGame);
+         break;
+      }
+
+      logprintf(LogConsumer::ServerFilter, "Game instance %d hosting on %s", i + 1, address.toString());
+   }
+}
+
+
 void shutdownBitfighter();    // Forward declaration
 
 // If we can't load any levels, here's the plan...
@@ -387,6 +387,12 @@ F32 TextItem::getUpdatePriority(GhostConnection *connection, U32 updateMask, S32
 }
 
 
+bool TextItem::hasBatchedUpdatePriority()
+{
+   return false;     // Our getUpdatePriority() needs to be called
+}
+
+
 ///// Editor Methods
 
 void TextItem::onAttrsChanging() { onGeomChanged(); }    // Runs when text is being changed in the editor
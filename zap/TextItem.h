@@ -59,6 +59,7 @@ public:
    U32 packUpdate(GhostConnection *connection, U32 updateMask, BitStream *stream);
    void unpackUpdate(GhostConnection *connection, BitStream *stream);
    F32 getUpdatePriority(GhostConnection *connection, U32 updateMask, S32 updateSkips);
+   bool hasBatchedUpdatePriority();
 
    ///// Editor Methods
 
@@ -0,0 +1,110 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "TickStats.h"
+
+#include "tnlLog.h"
+#include "tnlPlatform.h"
+
+#include <math.h>
+
+namespace Zap
+{
+
+// Constructor
+TickStats::TickStats()
+{
+   mTargetInterval = 0;
+   mLastTickStart = 0;
+   mTickStart = 0;
+   mTickCpuStart = 0;
+
+   reset(Platform::getHighPrecisionTimerValue());
+}
+
+
+void TickStats::reset(S64 now)
+{
+   mReportStart = now;
+   mReportCpuStart = clock();
+
+   mTicks = 0;
+   mPacedTicks = 0;
+   mJitterTotal = 0;
+   mJitterSquaredTotal = 0;
+   mJitterMax = 0;
+   mWorkTotal = 0;
+   mWorkMax = 0;
+   mCpuTotal = 0;
+}
+
+
+static F64 cpuMilliseconds(clock_t ticks)
+{
+   return F64(ticks) * 1000 / CLOCKS_PER_SEC;
+}
+
+
+void TickStats::beginTick(U32 targetInterval, bool paced)
+{
+   mTickStart = Platform::getHighPrecisionTimerValue();
+   mTickCpuStart = clock();
+
+   if(mLastTickStart != 0 && paced)
+   {
+      F64 jitter = fabs(Platform::getHighPrecisionMilliseconds(mTickStart - mLastTickStart) - F64(targetInterval));
+
+      mJitterTotal += jitter;
+      mJitterSquaredTotal += jitter * jitter;
+      if(jitter > mJitterMax)
+         mJitterMax = jitter;
+
+      mPacedTicks++;
+   }
+
+   mLastTickStart = mTickStart;
+   mTargetInterval = targetInterval;
+}
+
+
+void TickStats::endTick()
+{
+   S64 now = Platform::getHighPrecisionTimerValue();
+
+   F64 work = Platform::getHighPrecisionMilliseconds(now - mTickStart);
+
+   mWorkTotal += work;
+   if(work > mWorkMax)
+      mWorkMax = work;
+
+   mCpuTotal += cpuMilliseconds(clock() - mTickCpuStart);
+   mTicks++;
+
+   if(Platform::getHighPrecisionMilliseconds(now - mReportStart) >= ReportInterval)
+   {
+      report(now);
+      reset(now);
+   }
+}
+
+
+void TickStats::report(S64 now)
+{
+   F64 elapsed = Platform::getHighPrecisionMilliseconds(now - mReportStart);
+   F64 cpuUsage = cpuMilliseconds(clock() - mReportCpuStart) * 100 / elapsed;
+
+   F64 jitterMean = mPacedTicks ? mJitterTotal / mPacedTicks : 0;
+   F64 jitterDeviation = mPacedTicks ? sqrt(mJitterSquaredTotal / mPacedTicks - jitterMean * jitterMean) : 0;
+
+   logprintf(LogConsumer::ServerFilter, "Tick stats: %u ticks in %.1fs (%u paced, target %u ms); jitter mean %.2f ms, "
+             "std dev %.2f ms, max %.2f ms", mTicks, elapsed / 1000, mPacedTicks, mTargetInterval, jitterMean,
+             jitterDeviation, mJitterMax);
+
+   logprintf(LogConsumer::ServerFilter, "Tick stats: %.3f ms per tick (max %.3f ms), %.3f ms CPU per tick, %.1f%% CPU overall",
+             mTicks ? mWorkTotal / mTicks : 0, mWorkMax, mTicks ? mCpuTotal / mTicks : 0, cpuUsage);
+}
+
+
+};
@@ -0,0 +1,55 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _TICK_STATS_H_
+#define _TICK_STATS_H_
+
+#include "tnlTypes.h"
+
+#include <time.h>
+
+using namespace TNL;
+
+namespace Zap
+{
+
+// Keeps track of how evenly the main loop ticks, and how much CPU each tick takes, and logs a summary every
+// ReportInterval.  Turned on with -tick-stats.
+class TickStats
+{
+private:
+   static const U32 ReportInterval = 10000;     // ms
+
+   S64 mReportStart;
+   S64 mLastTickStart;
+   S64 mTickStart;
+   clock_t mReportCpuStart;
+   clock_t mTickCpuStart;
+   U32 mTargetInterval;
+
+   U32 mTicks;
+   U32 mPacedTicks;             // Ticks that were supposed to come right after the previous one
+   F64 mJitterTotal;            // ms off from mTargetInterval, paced ticks only
+   F64 mJitterSquaredTotal;
+   F64 mJitterMax;
+   F64 mWorkTotal;              // ms spent ticking
+   F64 mWorkMax;
+   F64 mCpuTotal;               // ms of CPU used while ticking
+
+   void reset(S64 now);
+   void report(S64 now);
+
+public:
+   TickStats();      // Constructor
+
+   // paced is false when the tick came late on purpose, such as when all games are suspended
+   void beginTick(U32 targetInterval, bool paced);
+   void endTick();
+};
+
+
+};
+
+#endif
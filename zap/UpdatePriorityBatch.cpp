@@ -0,0 +1,160 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "UpdatePriorityBatch.h"
+
+#include "BfObject.h"
+
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  define BF_UPDATE_PRIORITY_SSE
+#  include <xmmintrin.h>
+#endif
+
+namespace Zap
+{
+
+// Constructor
+UpdatePriorityBatch::UpdatePriorityBatch()
+{
+   // Do nothing
+}
+
+
+// Destructor
+UpdatePriorityBatch::~UpdatePriorityBatch()
+{
+   // Do nothing
+}
+
+
+// Keeps the memory around, so a batch that gets reused every packet doesn't need to allocate
+void UpdatePriorityBatch::clear()
+{
+   mMinX.clear();
+   mMinY.clear();
+   mMaxX.clear();
+   mMaxY.clear();
+   mVelX.clear();
+   mVelY.clear();
+   mInitialBonus.clear();
+   mSkipBonus.clear();
+   mPriorities.clear();
+}
+
+
+void UpdatePriorityBatch::add(BfObject *object, U32 updateMask, S32 updateSkips)
+{
+   const Rect extent = object->getExtent();
+   const Point vel = object->getVel();
+
+   mMinX.push_back(extent.min.x);
+   mMinY.push_back(extent.min.y);
+   mMaxX.push_back(extent.max.x);
+   mMaxY.push_back(extent.max.y);
+   mVelX.push_back(vel.x);
+   mVelY.push_back(vel.y);
+   mInitialBonus.push_back(updateMask == 0xFFFFFFFF ? BfObject::UpdatePriorityInitialBonus : 0);
+   mSkipBonus.push_back(updateSkips * BfObject::UpdatePriorityPerSkip);
+}
+
+
+void UpdatePriorityBatch::compute(BfObject *referenceObject)
+{
+   S32 count = mMinX.size();
+   mPriorities.resize(count);
+
+   if(!referenceObject)
+   {
+      for(S32 i = 0; i < count; i++)
+         mPriorities[i] = mInitialBonus[i] + mSkipBonus[i];
+      return;
+   }
+
+   Point center = referenceObject->getExtent().getCenter();
+   Point vel = referenceObject->getVel();
+
+   S32 start = 0;
+
+#ifdef BF_UPDATE_PRIORITY_SSE
+   // Four objects at a time; same operations in the same order as computeRange(), so results are identical
+   S32 simdEnd = count & ~3;
+
+   const __m128 centerX = _mm_set1_ps(center.x);
+   const __m128 centerY = _mm_set1_ps(center.y);
+   const __m128 refVelX = _mm_set1_ps(vel.x);
+   const __m128 refVelY = _mm_set1_ps(vel.y);
+   const __m128 range = _mm_set1_ps(BfObject::UpdatePriorityRange);
+   const __m128 approachBonus = _mm_set1_ps(BfObject::UpdatePriorityApproachBonus);
+   const __m128 zero = _mm_setzero_ps();
+
+   for(; start < simdEnd; start += 4)
+   {
+      // Nearest point on each object's extent to the center of the reference object
+      __m128 nearestX = _mm_min_ps(_mm_max_ps(centerX, _mm_loadu_ps(&mMinX[start])), _mm_loadu_ps(&mMaxX[start]));
+      __m128 nearestY = _mm_min_ps(_mm_max_ps(centerY, _mm_loadu_ps(&mMinY[start])), _mm_loadu_ps(&mMaxY[start]));
+
+      __m128 deltaPX = _mm_sub_ps(nearestX, centerX);
+      __m128 deltaPY = _mm_sub_ps(nearestY, centerY);
+
+      __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(deltaPX, deltaPX), _mm_mul_ps(deltaPY, deltaPY)));
+
+      __m128 deltaVX = _mm_sub_ps(_mm_loadu_ps(&mVelX[start]), refVelX);
+      __m128 deltaVY = _mm_sub_ps(_mm_loadu_ps(&mVelY[start]), refVelY);
+
+      __m128 dot = _mm_add_ps(_mm_mul_ps(deltaVX, deltaPX), _mm_mul_ps(deltaVY, deltaPY));
+
+      __m128 priority = _mm_div_ps(_mm_sub_ps(range, distance), range);
+      priority = _mm_add_ps(priority, _mm_and_ps(_mm_cmplt_ps(dot, zero), approachBonus));
+      priority = _mm_add_ps(priority, _mm_loadu_ps(&mInitialBonus[start]));
+      priority = _mm_add_ps(priority, _mm_loadu_ps(&mSkipBonus[start]));
+
+      _mm_storeu_ps(&mPriorities[start], priority);
+   }
+#endif
+
+   computeRange(start, count, center, vel);
+}
+
+
+// Same calculation as BfObject::getUpdatePriority()
+void UpdatePriorityBatch::computeRange(S32 start, S32 end, const Point &center, const Point &vel)
+{
+   for(S32 i = start; i < end; i++)
+   {
+      F32 nearestX = center.x < mMinX[i] ? mMinX[i] : (center.x > mMaxX[i] ? mMaxX[i] : center.x);
+      F32 nearestY = center.y < mMinY[i] ? mMinY[i] : (center.y > mMaxY[i] ? mMaxY[i] : center.y);
+
+      F32 deltaPX = nearestX - center.x;
+      F32 deltaPY = nearestY - center.y;
+
+      F32 distance = (F32)sqrt(deltaPX * deltaPX + deltaPY * deltaPY);
+
+      F32 dot = (mVelX[i] - vel.x) * deltaPX + (mVelY[i] - vel.y) * deltaPY;
+
+      F32 priority = (BfObject::UpdatePriorityRange - distance) / BfObject::UpdatePriorityRange;
+      if(dot < 0)
+         priority += BfObject::UpdatePriorityApproachBonus;
+
+      priority += mInitialBonus[i];
+      mPriorities[i] = priority + mSkipBonus[i];
+   }
+}
+
+
+S32 UpdatePriorityBatch::size() const
+{
+   return mMinX.size();
+}
+
+
+F32 UpdatePriorityBatch::getPriority(S32 index) const
+{
+   return mPriorities[index];
+}
+
+
+};
@@ -0,0 +1,52 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _UPDATE_PRIORITY_BATCH_H_
+#define _UPDATE_PRIORITY_BATCH_H_
+
+#include "Point.h"
+
+#include "tnlTypes.h"
+#include "tnlVector.h"
+
+using namespace TNL;
+
+namespace Zap
+{
+
+class BfObject;
+
+// Computes BfObject::getUpdatePriority() for lots of objects at once.  Objects are gathered into one array
+// per field, which lets compute() work on several of them at a time with SIMD instructions where we have them.
+// Results match calling getUpdatePriority() on each object.
+class UpdatePriorityBatch
+{
+private:
+   Vector<F32> mMinX, mMinY, mMaxX, mMaxY;   // Object extents
+   Vector<F32> mVelX, mVelY;                 // Object velocities
+   Vector<F32> mInitialBonus;                // Extra priority for objects that haven't been sent yet
+   Vector<F32> mSkipBonus;                   // Extra priority for updates that have been waiting
+   Vector<F32> mPriorities;
+
+   void computeRange(S32 start, S32 end, const Point &center, const Point &vel);
+
+public:
+   UpdatePriorityBatch();
+   virtual ~UpdatePriorityBatch();
+
+   void clear();
+   void add(BfObject *object, U32 updateMask, S32 updateSkips);
+
+   // Pass the object priorities are relative to, usually the connection's control object, or NULL if there isn't one
+   void compute(BfObject *referenceObject);
+
+   S32 size() const;
+   F32 getPriority(S32 index) const;
+};
+
+
+};
+
+#endif
@@ -0,0 +1,440 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#include "WallVisibility.h"
+
+#include "gridDB.h"
+#include "BfObject.h"         // For isWallType()
+#include "BotNavMeshZone.h"
+#include "MathUtils.h"       // For MIN/MAX
+#include "moveObject.h"      // For ActualState
+
+#include "tnlLog.h"
+
+#include <algorithm>
+
+namespace Zap
+{
+
+static const F32 BoundsPadding = 0.5f;      // Keeps rounding from letting a ray slip past a box around an edge it hits
+
+
+// Constructor
+WallVisibility::WallVisibility()
+{
+   mBuilt = false;
+   mZoneCount = 0;
+}
+
+
+bool WallVisibility::build(const GridDatabase *database)
+{
+   clear();
+
+   Vector<DatabaseObject *> walls;
+   database->findObjects((TestFunc)isWallType, walls);
+
+   for(S32 i = 0; i < walls.size(); i++)
+   {
+      const Vector<Point> *poly = walls[i]->getCollisionPoly();
+
+      if(!poly)
+      {
+         // Objects with neither a polygon nor a circle never block anything; we can't handle ones with a circle
+         Point center;
+         F32 radius;
+
+         if(!walls[i]->getCollisionCircle(ActualState, center, radius))
+            continue;
+
+         clear();
+         return false;
+      }
+
+      // Same edges, in the same order, as polygonIntersectsSegmentDetailed() looks at with format true
+      for(S32 j = 0; j < poly->size(); j++)
+      {
+         Edge edge;
+         edge.start = poly->get(j > 0 ? j - 1 : poly->size() - 1);
+         edge.delta = poly->get(j) - edge.start;
+         edge.object = walls[i];
+
+         mEdges.push_back(edge);
+      }
+   }
+
+   if(mEdges.size() > 0)
+      buildNode(0, mEdges.size());
+
+   mBuilt = true;
+   return true;
+}
+
+
+// Returns the index of the new node
+S32 WallVisibility::buildNode(S32 first, S32 count)
+{
+   Rect bounds(mEdges[first].start, mEdges[first].start + mEdges[first].delta);
+   for(S32 i = first + 1; i < first + count; i++)
+      bounds.unionRect(Rect(mEdges[i].start, mEdges[i].start + mEdges[i].delta));
+
+   bounds.expand(Point(BoundsPadding, BoundsPadding));
+
+   S32 index = mNodes.size();
+   mNodes.resize(index + 1);
+   mNodes[index].bounds = bounds;
+   mNodes[index].first = first;
+   mNodes[index].count = count;
+   mNodes[index].second = -1;
+
+   if(count <= MaxLeafEdges)
+      return index;
+
+   // Split the edges in half across the long side of the box, by their midpoints
+   bool splitX = bounds.getWidth() >= bounds.getHeight();
+   S32 half = count / 2;
+
+   std::nth_element(mEdges.address() + first, mEdges.address() + first + half, mEdges.address() + first + count,
+                    [splitX](const Edge &a, const Edge &b)
+                    {
+                       return splitX ? 2 * a.start.x + a.delta.x < 2 * b.start.x + b.delta.x :
+                                       2 * a.start.y + a.delta.y < 2 * b.start.y + b.delta.y;
+                    });
+
+   buildNode(first, half);                            // Lands at index + 1
+   S32 second = buildNode(first + half, count - half);
+
+   mNodes[index].count = 0;
+   mNodes[index].second = second;
+
+   return index;
+}
+
+
+void WallVisibility::clear()
+{
+   mEdges.clear();
+   mNodes.clear();
+   mBuilt = false;
+
+   mZoneBits.clear();
+   mZoneCount = 0;
+}
+
+
+bool WallVisibility::isBuilt() const
+{
+   return mBuilt;
+}
+
+
+S32 WallVisibility::getEdgeCount() const
+{
+   return mEdges.size();
+}
+
+
+S32 WallVisibility::getNodeCount() const
+{
+   return mNodes.size();
+}
+
+
+// Slab test -- does the ray from start along delta get into box before maxTime, a fraction of delta?
+static bool rayHitsBox(const Point &start, const Point &delta, const Rect &box, F32 maxTime)
+{
+   F32 tMin = 0;
+   F32 tMax = maxTime;
+
+   for(S32 axis = 0; axis < 2; axis++)
+   {
+      F32 s = axis == 0 ? start.x : start.y;
+      F32 d = axis == 0 ? delta.x : delta.y;
+      F32 lo = axis == 0 ? box.min.x : box.min.y;
+      F32 hi = axis == 0 ? box.max.x : box.max.y;
+
+      if(d == 0)
+      {
+         if(s < lo || s > hi)
+            return false;
+
+         continue;
+      }
+
+      F32 t1 = (lo - s) / d;
+      F32 t2 = (hi - s) / d;
+
+      if(t1 > t2)
+         std::swap(t1, t2);
+
+      tMin = MAX(tMin, t1);
+      tMax = MIN(tMax, t2);
+
+      if(tMin > tMax)
+         return false;
+   }
+
+   return true;
+}
+
+
+DatabaseObject *WallVisibility::findFirstHit(const Point &rayStart, const Point &rayEnd, bool nearestHit,
+                                             F32 &collisionTime, Point &surfaceNormal) const
+{
+   collisionTime = 1;
+
+   if(mNodes.size() == 0)
+      return NULL;
+
+   Point dp = rayEnd - rayStart;
+   Rect rayExtents(rayStart, rayEnd);
+   const Edge *bestEdge = NULL;
+
+   S32 stack[64];       // Tree is balanced, so this is deeper than it'll ever get
+   S32 stackSize = 0;
+
+   stack[stackSize++] = 0;
+
+   while(stackSize > 0)
+   {
+      S32 nodeIndex = stack[--stackSize];
+      const Node &node = mNodes[nodeIndex];
+
+      if(!rayHitsBox(rayStart, dp, node.bounds, collisionTime))
+         continue;
+
+      if(node.count > 0)
+      {
+         for(S32 i = node.first; i < node.first + node.count; i++)
+         {
+            const Edge &edge = mEdges[i];
+
+            // Same math as polygonIntersectsSegmentDetailed()
+            F32 denom = dp.y * edge.delta.x - dp.x * edge.delta.y;
+            if(denom == 0)    // Parallel
+               continue;
+
+            F32 s = ((rayStart.x - edge.start.x) * edge.delta.y + (edge.start.y - rayStart.y) * edge.delta.x) / denom;
+            F32 t = ((rayStart.x - edge.start.x) * dp.y + (edge.start.y - rayStart.y) * dp.x) / denom;
+
+            // The database only finds objects whose extents overlap the ray's, not ones that merely touch them
+            if(s >= 0 && s < collisionTime && t >= 0 && t <= 1 && edge.object->isCollisionEnabled() &&
+                  edge.object->getExtent().intersects(rayExtents))
+            {
+               collisionTime = s;
+               bestEdge = &edge;
+
+               if(!nearestHit)
+                  break;
+            }
+         }
+
+         if(bestEdge && !nearestHit)
+            break;
+
+         continue;
+      }
+
+      // Visit the child nearer the start of the ray first, so farther boxes can be skipped once something is hit
+      S32 first = nodeIndex + 1;
+      S32 second = node.second;
+
+      Point firstCenter = mNodes[first].bounds.getCenter();
+      Point secondCenter = mNodes[second].bounds.getCenter();
+
+      if((firstCenter - rayStart).dot(dp) > (secondCenter - rayStart).dot(dp))
+         std::swap(first, second);
+
+      stack[stackSize++] = second;
+      stack[stackSize++] = first;
+   }
+
+   if(!bestEdge)
+      return NULL;
+
+   surfaceNormal.set(bestEdge->delta.y, -bestEdge->delta.x);
+   surfaceNormal.normalize();
+
+   return bestEdge->object;
+}
+
+
+// True if the segment from start to end passes right through edge; merely touching it doesn't count
+static bool segmentCrossesEdge(const Point &start, const Point &end, const Point &edgeStart, const Point &edgeDelta)
+{
+   Point dp = end - start;
+
+   F32 denom = dp.y * edgeDelta.x - dp.x * edgeDelta.y;
+   if(denom == 0)    // Parallel
+      return false;
+
+   F32 s = ((start.x - edgeStart.x) * edgeDelta.y + (edgeStart.y - start.y) * edgeDelta.x) / denom;
+   F32 t = ((start.x - edgeStart.x) * dp.y + (edgeStart.y - start.y) * dp.x) / denom;
+
+   return s > 0 && s < 1 && t > 0 && t < 1;
+}
+
+
+// Adds the index of every edge the segment from start to end passes right through
+void WallVisibility::findCrossedEdges(const Point &start, const Point &end, Vector<S32> &edges) const
+{
+   if(mNodes.size() == 0)
+      return;
+
+   Point dp = end - start;
+
+   S32 stack[64];
+   S32 stackSize = 0;
+
+   stack[stackSize++] = 0;
+
+   while(stackSize > 0)
+   {
+      S32 nodeIndex = stack[--stackSize];
+      const Node &node = mNodes[nodeIndex];
+
+      if(!rayHitsBox(start, dp, node.bounds, 1))
+         continue;
+
+      if(node.count > 0)
+      {
+         for(S32 i = node.first; i < node.first + node.count; i++)
+            if(mEdges[i].object->isCollisionEnabled() && segmentCrossesEdge(start, end, mEdges[i].start, mEdges[i].delta))
+               edges.push_back(i);
+
+         continue;
+      }
+
+      stack[stackSize++] = node.second;
+      stack[stackSize++] = nodeIndex + 1;
+   }
+}
+
+
+// True only if we can prove nothing in one zone can see anything in the other: a single wall edge cuts every line
+// between their corners.  Zones are convex, and where a line between them crosses the edge's line varies
+// monotonically as either end moves along a side, so an edge that cuts the lines between every pair of corners
+// cuts the line between any pair of points.  Zones hidden only by several walls together are left visible.
+bool WallVisibility::isZoneHidden(const Vector<Point> &outline1, const Point &center1,
+                                  const Vector<Point> &outline2, const Point &center2, Vector<S32> &candidates) const
+{
+   // Any edge that does the job must cut the line between the centers
+   candidates.clear();
+   findCrossedEdges(center1, center2, candidates);
+
+   for(S32 i = 0; i < candidates.size(); i++)
+   {
+      const Edge &edge = mEdges[candidates[i]];
+      bool cutsAll = true;
+
+      for(S32 j = 0; j < outline1.size() && cutsAll; j++)
+         for(S32 k = 0; k < outline2.size() && cutsAll; k++)
+            cutsAll = segmentCrossesEdge(outline1[j], outline2[k], edge.start, edge.delta);
+
+      if(cutsAll)
+         return true;
+   }
+
+   return false;
+}
+
+
+// Works out one zone's row of the visibility table, against the zones after it
+class WallVisibility::ZoneVisibilityJob : public WorkerPool::Job
+{
+   WallVisibility *mVisibility;
+   const Vector<BotNavMeshZone *> *mZones;
+   S32 mRowWords;
+
+public:
+   ZoneVisibilityJob(WallVisibility *visibility, const Vector<BotNavMeshZone *> *zones, S32 rowWords)
+   {
+      mVisibility = visibility;
+      mZones = zones;
+      mRowWords = rowWords;
+   }
+
+   void runItem(S32 index)
+   {
+      // Rows start on a word of their own, so nobody else writes to this one
+      U32 *row = mVisibility->mZoneBits.address() + index * mRowWords;
+      BotNavMeshZone *zone = mZones->get(index);
+
+      Vector<S32> candidates;
+
+      for(S32 j = index + 1; j < mZones->size(); j++)
+      {
+         BotNavMeshZone *other = mZones->get(j);
+
+         if(!mVisibility->isZoneHidden(*zone->getOutline(), zone->getCenter(), *other->getOutline(), other->getCenter(),
+                                       candidates))
+            row[j >> 5] |= 1U << (j & 31);
+      }
+   }
+};
+
+
+void WallVisibility::buildZoneVisibility(const Vector<BotNavMeshZone *> *zones, WorkerPool *pool)
+{
+   mZoneBits.clear();
+   mZoneCount = 0;
+
+   if(!mBuilt || zones->size() == 0)
+      return;
+
+   S32 count = zones->size();
+
+   if(count > MaxVisibilityZones)
+   {
+      logprintf(LogConsumer::LogWarning, "Level has %d bot zones; not working out which can see each other for more than %d",
+                count, MaxVisibilityZones);
+      return;
+   }
+
+   S32 rowWords = (count + 31) >> 5;
+
+   mZoneBits.resize(count * rowWords);
+   for(S32 i = 0; i < mZoneBits.size(); i++)
+      mZoneBits[i] = 0;
+
+   ZoneVisibilityJob job(this, zones, rowWords);
+
+   if(pool)
+      pool->run(&job, count);
+   else
+      for(S32 i = 0; i < count; i++)
+         job.runItem(i);
+
+   // Fill in the other half of the table, and let every zone see itself
+   for(S32 i = 0; i < count; i++)
+   {
+      mZoneBits[i * rowWords + (i >> 5)] |= 1U << (i & 31);
+
+      for(S32 j = i + 1; j < count; j++)
+         if(mZoneBits[i * rowWords + (j >> 5)] & (1U << (j & 31)))
+            mZoneBits[j * rowWords + (i >> 5)] |= 1U << (i & 31);
+   }
+
+   mZoneCount = count;
+}
+
+
+bool WallVisibility::hasZoneVisibility() const
+{
+   return mZoneCount > 0;
+}
+
+
+bool WallVisibility::canZonesSee(U16 zone1, U16 zone2) const
+{
+   if(zone1 >= mZoneCount || zone2 >= mZoneCount)
+      return true;
+
+   S32 rowWords = (mZoneCount + 31) >> 5;
+   return (mZoneBits[zone1 * rowWords + (zone2 >> 5)] & (1U << (zone2 & 31))) != 0;
+}
+
+
+};
@@ -0,0 +1,97 @@
+//------------------------------------------------------------------------------
+// Copyright Chris Eykamp
+// See LICENSE.txt for full copyright information
+//------------------------------------------------------------------------------
+
+#ifndef _WALL_VISIBILITY_H_
+#define _WALL_VISIBILITY_H_
+
+#include "Point.h"
+#include "Rect.h"
+
+#include "tnlThread.h"
+#include "tnlVector.h"
+
+using namespace TNL;
+
+namespace Zap
+{
+
+class GridDatabase;
+class DatabaseObject;
+class BotNavMeshZone;
+
+// Speeds up line-of-sight checks against walls, which don't move once a level has loaded.  The edges of every wall
+// are put in a bounding volume hierarchy, so a ray only has to be tested against the few edges near it, without
+// searching the database's buckets first.  Optionally, also works out which bot zones can see which others, so
+// checks between zones that are hidden from each other can be answered straight away.
+//
+// Adding, removing or moving a wall throws everything away; the database falls back on its usual searches until
+// the next build().
+class WallVisibility
+{
+private:
+   struct Edge
+   {
+      Point start;
+      Point delta;                  // end - start
+      DatabaseObject *object;
+   };
+
+   // Leaves hold edges first through first + count - 1; other nodes have count 0, and children at index + 1 and second
+   struct Node
+   {
+      Rect bounds;
+      S32 first;
+      S32 count;
+      S32 second;
+   };
+
+   static const S32 MaxLeafEdges = 4;
+   static const S32 MaxVisibilityZones = 4096;    // Keeps the table to 2 MB; levels with more zones go without
+
+   Vector<Edge> mEdges;
+   Vector<Node> mNodes;
+   bool mBuilt;
+
+   // Bit (i * mZoneCount + j) is set if zone j might be visible from zone i
+   Vector<U32> mZoneBits;
+   S32 mZoneCount;
+
+   S32 buildNode(S32 first, S32 count);
+
+   class ZoneVisibilityJob;
+   void findCrossedEdges(const Point &start, const Point &end, Vector<S32> &edges) const;
+   bool isZoneHidden(const Vector<Point> &outline1, const Point &center1,
+                     const Vector<Point> &outline2, const Point &center2, Vector<S32> &candidates) const;
+
+public:
+   WallVisibility();    // Constructor
+
+   // Gathers up the edges of all the walls in database; returns false, leaving nothing built, if one has no polygon
+   bool build(const GridDatabase *database);
+   void clear();
+
+   bool isBuilt() const;
+   S32 getEdgeCount() const;
+   S32 getNodeCount() const;
+
+   // Same as GridDatabase::findObjectLOS() against isWallType objects, with format true.  With nearestHit false,
+   // returns the first wall found in the way, which may not be the nearest one.  Safe to call from several threads.
+   DatabaseObject *findFirstHit(const Point &rayStart, const Point &rayEnd, bool nearestHit,
+                                F32 &collisionTime, Point &surfaceNormal) const;
+
+   // Works out which pairs of zones can't possibly see each other, on pool if there is one.  Only pairs with a
+   // single wall edge between them are ruled out; anything we can't be sure of is left visible, so a zone pair
+   // marked hidden really is.  Does nothing on levels with more than MaxVisibilityZones zones.
+   void buildZoneVisibility(const Vector<BotNavMeshZone *> *zones, WorkerPool *pool);
+   bool hasZoneVisibility() const;
+
+   // True if anything in zone1 might be visible from zone2, or if we don't know
+   bool canZonesSee(U16 zone1, U16 zone2) const;
+};
+
+
+};
+
+#endif
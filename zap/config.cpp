@@ -131,6 +131,22 @@ IniSettings::IniSettings()
 
    enableGameRecording = false;
 
+   gameObjectIndex = SpatialIndexHierarchicalGrid;
+   wallIndex       = SpatialIndexHierarchicalGrid;
+   botZoneIndex    = SpatialIndexHierarchicalGrid;
+
+   workerThreads = 0;
+   saveBotZones = true;
+   wallVisibilityTree = true;
+   botZoneVisibility = false;
+   parallelBotScripts = false;
+   scriptProfiling = false;
+   scriptTickBudget = 0;
+   pooledLuaAllocator = false;
+   networkIOThread = false;
+   rateControl = RateControlFixed;
+   netStatsLogTime = 0;
+
    voteEnable = false;     // Voting disabled by default
    voteLength = 12;
    voteLengthToChangeTeam = 10;
@@ -684,6 +700,24 @@ static void loadHostConfiguration(CIniFile *ini, IniSettings *iniSettings)
    iniSettings->globalLevelScript  = ini->GetValue(section, "GlobalLevelScript", iniSettings->globalLevelScript);
 
    iniSettings->enableGameRecording = ini->GetValueYN(section, "GameRecording", iniSettings->enableGameRecording);
+
+   iniSettings->gameObjectIndex = SpatialIndex::stringToType(ini->GetValue(section, "GameObjectIndex", SpatialIndex::typeToString(iniSettings->gameObjectIndex)));
+   iniSettings->wallIndex       = SpatialIndex::stringToType(ini->GetValue(section, "WallIndex",       SpatialIndex::typeToString(iniSettings->wallIndex)));
+   iniSettings->botZoneIndex    = SpatialIndex::stringToType(ini->GetValue(section, "BotZoneIndex",    SpatialIndex::typeToString(iniSettings->botZoneIndex)));
+
+   iniSettings->workerThreads = max(ini->GetValueI(section, "WorkerThreads", iniSettings->workerThreads), 0);
+   iniSettings->saveBotZones  = ini->GetValueYN(section, "SaveBotZones", iniSettings->saveBotZones);
+
+   iniSettings->wallVisibilityTree = ini->GetValueYN(section, "WallVisibilityTree", iniSettings->wallVisibilityTree);
+   iniSettings->botZoneVisibility  = ini->GetValueYN(section, "BotZoneVisibility",  iniSettings->botZoneVisibility);
+   iniSettings->parallelBotScripts = ini->GetValueYN(section, "ParallelBotScripts", iniSettings->parallelBotScripts);
+
+   iniSettings->scriptProfiling  = ini->GetValueYN(section, "ScriptProfiling", iniSettings->scriptProfiling);
+   iniSettings->scriptTickBudget = (U32) max(ini->GetValueI(section, "ScriptTickBudget", S32(iniSettings->scriptTickBudget)), 0);
+   iniSettings->pooledLuaAllocator = ini->GetValueYN(section, "PooledLuaAllocator", iniSettings->pooledLuaAllocator);
+   iniSettings->networkIOThread    = ini->GetValueYN(section, "NetworkIOThread", iniSettings->networkIOThread);
+   iniSettings->rateControl = RateController::stringToType(ini->GetValue(section, "RateControl", RateController::typeToString(iniSettings->rateControl)).c_str());
+   iniSettings->netStatsLogTime = (U32) max(ini->GetValueI(section, "NetStatsLogTime", S32(iniSettings->netStatsLogTime)), 0);
 }
 
 
@@ -1784,6 +1818,34 @@ static void writeHost(CIniFile *ini, IniSettings *iniSettings)
       addComment(" VoteLength - number of seconds the voting will last, zero will disable voting.");
       addComment(" VoteRetryLength - When vote fail, the vote caller is unable to vote until after this number of seconds.");
       addComment(" Vote Strengths - Vote will pass when sum of all vote strengths is bigger then zero.");
+      addComment(" GameObjectIndex, WallIndex, BotZoneIndex - Spatial index used for game objects, wall edges, and bot zones.  Use Grid for the");
+      addComment("                        classic 16x16 wrapping grid, or Hierarchical for a multi-level grid sized to fit each level (better on big levels)");
+      addComment(" WorkerThreads - Number of extra threads used to figure out what to send each client, and to get a head start on");
+      addComment("                        collision searches for projectiles and turrets.  Can help busy servers with many players; 0 does");
+      addComment("                        everything on the main thread");
+      addComment(" SaveBotZones - Save the bot zones built for each level in the botzones folder, and use them the next time the same level");
+      addComment("                        loads instead of building them again.  Levels with levelgens are always built from scratch");
+      addComment(" WallVisibilityTree - Sort each level's walls into a tree when it loads, so line-of-sight checks don't have to search for them");
+      addComment(" BotZoneVisibility - Also work out which bot zones can see each other when a level loads, so bots can rule out distant");
+      addComment("                        targets quickly.  Needs WallVisibilityTree, and takes a while on big levels");
+      addComment(" ParallelBotScripts - Give each bot its own Lua interpreter, and run the bots' onTick handlers side by side on the");
+      addComment("                        WorkerThreads.  Bots see the game as it was when the tick started; messages they send and changes");
+      addComment("                        they make are applied afterwards, bot by bot, and return nothing.  Uses more memory per bot");
+      addComment(" ScriptProfiling - Count the Lua instructions each bot and levelgen runs, and log the costliest scripts every minute.");
+      addComment("                        Slows scripts down a little; time and memory are tracked either way (see /scriptstats)");
+      addComment(" ScriptTickBudget - Milliseconds of Lua a bot or levelgen may use per tick.  Scripts over it skip onTick until they've");
+      addComment("                        made up the time, and calls running past 10 times it are stopped with an error.  0 for no limit");
+      addComment(" PooledLuaAllocator - Hand out small Lua objects from pools kept by each Lua interpreter, rather than from LuaJIT's");
+      addComment("                        allocator.  Can speed up scripts that make lots of short-lived tables, but makes full garbage");
+      addComment("                        collections slower.  Takes effect on restart");
+      addComment(" NetworkIOThread - Send and receive packets on a thread of their own, so they go out and come in on time (and");
+      addComment("                        pings stay honest) even when a tick runs long, as during level loads or with heavy scripts");
+      addComment(" RateControl - How packets to each client are paced.  Fixed sends at the rate the client asked for.  DelayBased");
+      addComment("                        starts there, then sends less when round trips grow or packets go missing, and more (up to");
+      addComment("                        this server's own limit) when they don't");
+      addComment(" NetStatsLogTime - Every this many seconds, write a CSV line for each client to bitfighter_netstats.log, with");
+      addComment("                        their round trip time, packet loss, bytes sent by kind, and ghosts in scope.  0 for none;");
+      addComment("                        admins can see the same numbers with /netstats either way");
       addComment("----------------");
    }
 
@@ -1829,6 +1891,21 @@ static void writeHost(CIniFile *ini, IniSettings *iniSettings)
    ini->SetValue  (section, "GlobalLevelScript", iniSettings->globalLevelScript);
 
    ini->setValueYN(section, "GameRecording", iniSettings->enableGameRecording);
+
+   ini->SetValue  (section, "GameObjectIndex", SpatialIndex::typeToString(iniSettings->gameObjectIndex));
+   ini->SetValue  (section, "WallIndex",       SpatialIndex::typeToString(iniSettings->wallIndex));
+   ini->SetValue  (section, "BotZoneIndex",    SpatialIndex::typeToString(iniSettings->botZoneIndex));
+   ini->SetValueI (section, "WorkerThreads", iniSettings->workerThreads);
+   ini->setValueYN(section, "SaveBotZones", iniSettings->saveBotZones);
+   ini->setValueYN(section, "WallVisibilityTree", iniSettings->wallVisibilityTree);
+   ini->setValueYN(section, "BotZoneVisibility", iniSettings->botZoneVisibility);
+   ini->setValueYN(section, "ParallelBotScripts", iniSettings->parallelBotScripts);
+   ini->setValueYN(section, "ScriptProfiling", iniSettings->scriptProfiling);
+   ini->SetValueI (section, "ScriptTickBudget", S32(iniSettings->scriptTickBudget));
+   ini->setValueYN(section, "PooledLuaAllocator", iniSettings->pooledLuaAllocator);
+   ini->setValueYN(section, "NetworkIOThread", iniSettings->networkIOThread);
+   ini->SetValue  (section, "RateControl", RateController::typeToString(iniSettings->rateControl));
+   ini->SetValueI (section, "NetStatsLogTime", S32(iniSettings->netStatsLogTime));
 #ifdef BF_WRITE_TO_MYSQL
    if(iniSettings->mySqlStatsDatabaseServer == "" && iniSettings->mySqlStatsDatabaseName == "" && iniSettings->mySqlStatsDatabaseUser == "" && iniSettings->mySqlStatsDatabasePassword == "")
       ini->SetValue  (section, "MySqlStatsDatabaseCredentials", "server, dbname, login, password");
@@ -2086,6 +2163,7 @@ void FolderManager::resolveDirs(GameSettings *settings)
    folderManager->screenshotDir = resolutionHelper(cmdLineDirs.screenshotDir, rootDataDir, "screenshots");
    folderManager->musicDir      = resolutionHelper(cmdLineDirs.musicDir,      rootDataDir, "music");
    folderManager->recordDir     = resolutionHelper(cmdLineDirs.recordDir,     rootDataDir, "record");
+   folderManager->botZoneDir    = resolutionHelper("",                        rootDataDir, "botzones");
 
    // rootDataDir not used for these folders
    folderManager->sfxDir        = resolutionHelper(cmdLineDirs.sfxDir,        "", "sfx");
@@ -2109,6 +2187,7 @@ void FolderManager::resolveDirs(const string &root)
    screenshotDir = joindir(root, "screenshots");
    musicDir      = joindir(root, "music");
    recordDir     = joindir(root, "record");
+   botZoneDir    = joindir(root, "botzones");
 
    // root not used for these folders
    sfxDir        = joindir("", "sfx");
@@ -15,9 +15,11 @@
 #include "Color.h"      // For Color def
 #include "ConfigEnum.h" // For DisplayMode
 #include "Settings.h"
+#include "SpatialIndex.h"  // For SpatialIndexType
 
 #include "tnlTypes.h"
 #include "tnlNetStringTable.h"
+#include "tnlRateController.h"    // For RateControlType
 #include "tnlVector.h"
 
 #include <string>
@@ -63,6 +65,7 @@ struct FolderManager
    string pluginDir;
    string fontsDir;
    string recordDir;
+   string botZoneDir;      // Bot zones saved from earlier loads, by level hash
 
    void resolveDirs(GameSettings *settings);                                  
    void resolveDirs(const string &root);
@@ -229,6 +232,22 @@ public:
    bool enableGameRecording;
    bool kickIdlePlayers;
 
+   SpatialIndexType gameObjectIndex;   // Bucket layout for each of the server's spatial databases
+   SpatialIndexType wallIndex;
+   SpatialIndexType botZoneIndex;
+
+   S32 workerThreads;               // Threads used to prepare packets and object searches; 0 does it all on the main thread
+   bool saveBotZones;               // Keep the bot zones built for each level, so they don't need building next time
+   bool wallVisibilityTree;         // Put walls in a tree at level load to speed up line-of-sight checks
+   bool botZoneVisibility;          // Also work out which bot zones can see each other
+   bool parallelBotScripts;         // Give each bot its own Lua state, and run their onTick handlers on the worker threads
+   bool scriptProfiling;            // Count the instructions scripts run, and log the costliest ones now and then
+   U32 scriptTickBudget;            // Time, in ms, a script may use per tick before it starts sitting ticks out; 0 for no limit
+   bool pooledLuaAllocator;         // Give each Lua state its own pools for small blocks
+   bool networkIOThread;            // Read and write the server's socket on a thread of its own
+   RateControlType rateControl;     // How the server paces the packets it sends each client
+   U32 netStatsLogTime;             // Seconds between lines of per-client network stats in bitfighter_netstats.log; 0 for none
+
    S32 connectionSpeed;
 
    bool randomLevels;
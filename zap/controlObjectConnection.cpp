@@ -73,6 +73,28 @@ BfObject *ControlObjectConnection::getControlObject() const
 }
 
 
+NetObject *ControlObjectConnection::getPriorityReferenceObject()
+{
+   return getControlObject();
+}
+
+
+// Only BfObjects ask for batched priorities, so they can all go through an UpdatePriorityBatch.  This can be
+// called for several connections at once on different threads, but each only touches its own batch.
+void ControlObjectConnection::computeBatchedUpdatePriorities(GhostInfo **ghosts, S32 count)
+{
+   mUpdatePriorityBatch.clear();
+
+   for(S32 i = 0; i < count; i++)
+      mUpdatePriorityBatch.add(static_cast<BfObject *>(ghosts[i]->obj), ghosts[i]->updateMask, ghosts[i]->updateSkipCount);
+
+   mUpdatePriorityBatch.compute(getControlObject());
+
+   for(S32 i = 0; i < count; i++)
+      ghosts[i]->priority = mUpdatePriorityBatch.getPriority(i);
+}
+
+
 U32 ControlObjectConnection::getControlCRC()
 {
    PacketStream stream;
@@ -129,6 +151,8 @@ static U8 CLIENTCONTROLBITS = 16;
 
 void ControlObjectConnection::writePacket(BitStream *bstream, PacketNotify *notify)
 {
+   U32 movesStart = bstream->getBitPosition();
+
    if(isConnectionToServer())
    {
       S8 firstSendIndex = highSendIndex[0];
@@ -187,6 +211,8 @@ void ControlObjectConnection::writePacket(BitStream *bstream, PacketNotify *noti
          }
       }
    }
+   addTrafficBits(TrafficMoves, bstream->getBitPosition() - movesStart);
+
    Parent::writePacket(bstream, notify);
 }
 
@@ -9,6 +9,7 @@
 #include "move.h"
 #include "Point.h"
 #include "BfObject.h" 
+#include "UpdatePriorityBatch.h"
 
 #include "tnl.h"
 #include "tnlGhostConnection.h"
@@ -65,12 +66,17 @@ private:
 
    U32 mBusyTime;          // How long have we been busy (see mIsBusy)
 
+   UpdatePriorityBatch mUpdatePriorityBatch;    // Reused for every packet
+
    void onGotNewMove(const Move &move);
 
 protected:
    bool mIsBusy;
    bool mNeedReplayMoves;
 
+   NetObject *getPriorityReferenceObject();     // Ghost priorities depend on where our ship is
+   void computeBatchedUpdatePriorities(GhostInfo **ghosts, S32 count);
+
 public:
    ControlObjectConnection();
    virtual ~ControlObjectConnection();
@@ -194,6 +194,13 @@ void   Game::deleteAllBots()                         { TNLAssert(false, "Not imp
 void   Game::balanceTeams()                          { TNLAssert(false, "Not implemented for this class!"); }
 
 
+// Only ServerGame prepares these
+bool Game::findPreparedIdleObjects(const BfObject *object, TestFunc testFunc, const Rect &queryRect,
+                                   Vector<DatabaseObject *> &fillVector)
+{
+   return false;
+}
+
 
 void Game::setReadyToConnectToMaster(bool ready)
 {
@@ -344,6 +344,10 @@ public:
    virtual void kickSingleBotFromLargestTeamWithBots();
    virtual void balanceTeams();
 
+   // Searches done ahead of time for objects' idle() methods; see BfObject::getIdleQuery()
+   virtual bool findPreparedIdleObjects(const BfObject *object, TestFunc testFunc, const Rect &queryRect,
+                                        Vector<DatabaseObject *> &fillVector);
+
 
 
    void loadLevelFromString(const string &contents, GridDatabase *database, const string& filename = "");
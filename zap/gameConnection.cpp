@@ -109,6 +109,10 @@ void GameConnection::initialize()
    mLevelSource = NULL;
    mLevelUploadIndex = -1;
 
+   mStatsTicks = 0;
+   mStatsGhostsInScope = 0;
+   mStatsMaxGhostsInScope = 0;
+
    resetConnectionStatus();
 }
 
@@ -2238,6 +2242,11 @@ void GameConnection::updateTimers_server(U32 timeDelta)
 
    if(mIsBusy)
       addBusyTime(timeDelta);
+
+   S32 ghostCount = getGhostCount();
+   mStatsTicks++;
+   mStatsGhostsInScope += ghostCount;
+   mStatsMaxGhostsInScope = getMax(mStatsMaxGhostsInScope, ghostCount);
 }
 
 
@@ -2358,6 +2367,103 @@ void GameConnection::setConnectionSpeed(S32 speed)
    setFixedRateParameters(minPacketSendPeriod, minPacketRecvPeriod, maxSendBandwidth, maxRecvBandwidth);
 }
 
+
+// Constructor
+ConnectionStats::ConnectionStats()
+{
+   period = 0;
+   for(S32 i = 0; i < NetConnection::TrafficCategoryCount; i++)
+      bytesSent[i] = 0;
+   bytesReceived = 0;
+   packetsSent = 0;
+   packetsLost = 0;
+   eventsRetransmitted = 0;
+   ghostUpdatesSent = 0;
+   ghostUpdatesSkipped = 0;
+   ticks = 0;
+   ghostsInScope = 0;
+   maxGhostsInScope = 0;
+   roundTripTime = 0;
+}
+
+
+U32 ConnectionStats::getTotalBytesSent() const
+{
+   U32 total = 0;
+   for(S32 i = 0; i < NetConnection::TrafficCategoryCount; i++)
+      total += bytesSent[i];
+
+   return total;
+}
+
+
+F32 ConnectionStats::getAverageGhostsInScope() const
+{
+   return ticks > 0 ? F32(ghostsInScope) / ticks : 0;
+}
+
+
+ConnectionStats GameConnection::getStatsTotals()
+{
+   ConnectionStats totals;
+
+   totals.period = getInterface()->getCurrentTime();
+   for(S32 i = 0; i < TrafficCategoryCount; i++)
+      totals.bytesSent[i] = U32(mTrafficBitsSent[i] / 8);
+   totals.bytesReceived = mPacketRecvBytesTotal;
+   totals.packetsSent = mPacketSendCount;
+   totals.packetsLost = mPacketSendDropped;
+   totals.eventsRetransmitted = mEventsRetransmitted;
+   totals.ghostUpdatesSent = getGhostUpdatesSent();
+   totals.ghostUpdatesSkipped = getGhostUpdatesSkipped();
+   totals.ticks = mStatsTicks;
+   totals.ghostsInScope = mStatsGhostsInScope;
+   totals.maxGhostsInScope = mStatsMaxGhostsInScope;
+   totals.roundTripTime = getRoundTripTime();
+
+   return totals;
+}
+
+
+// Counters are free to wrap; the differences still come out right
+static ConnectionStats getStatsBetween(const ConnectionStats &start, const ConnectionStats &end)
+{
+   ConnectionStats stats = end;
+
+   stats.period -= start.period;
+   for(S32 i = 0; i < NetConnection::TrafficCategoryCount; i++)
+      stats.bytesSent[i] -= start.bytesSent[i];
+   stats.bytesReceived -= start.bytesReceived;
+   stats.packetsSent -= start.packetsSent;
+   stats.packetsLost -= start.packetsLost;
+   stats.eventsRetransmitted -= start.eventsRetransmitted;
+   stats.ghostUpdatesSent -= start.ghostUpdatesSent;
+   stats.ghostUpdatesSkipped -= start.ghostUpdatesSkipped;
+   stats.ticks -= start.ticks;
+   stats.ghostsInScope -= start.ghostsInScope;
+
+   return stats;
+}
+
+
+void GameConnection::endConnectionStatsPeriod()
+{
+   ConnectionStats totals = getStatsTotals();
+
+   mConnectionStats = getStatsBetween(mStatsStart, totals);
+   mStatsStart = totals;
+   mStatsMaxGhostsInScope = 0;
+}
+
+
+ConnectionStats GameConnection::getConnectionStats()
+{
+   if(mConnectionStats.period > 0)
+      return mConnectionStats;
+
+   return getStatsBetween(mStatsStart, getStatsTotals());
+}
+
 // Runs on client and server
 void GameConnection::onConnectionEstablished()
 {
@@ -2415,6 +2521,8 @@ void GameConnection::onConnectionEstablished_client()
 void GameConnection::onConnectionEstablished_server()
 {
    setConnectionSpeed(2);                 // High speed, most servers have sufficient bandwidth
+   setRateController(RateController::create(mServerGame->getSettings()->getIniSettings()->rateControl));
+   mStatsStart = getStatsTotals();
    mServerGame->addClient(mClientInfo);   // This clientInfo was created by the server... it has no badge data yet
    setGhostFrom(true);
    setGhostTo(false);
@@ -2619,6 +2727,18 @@ bool GameConnection::isInCommanderMap()
 }
 
 
+DatabaseQuery &GameConnection::getScopeQuery()
+{
+   return mScopeQuery;
+}
+
+
+RegionQueryCache &GameConnection::getScopeCache()
+{
+   return mScopeCache;
+}
+
+
 
 };
 
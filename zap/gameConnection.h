@@ -38,6 +38,29 @@ class LuaPlayerInfo;
 class GameSettings;
 class LevelSource;
 
+// What a client's connection carried over a stretch of time; servers log these, and show them to admins with /netstats
+struct ConnectionStats
+{
+   U32 period;                                              // Ms covered
+   U32 bytesSent[NetConnection::TrafficCategoryCount];
+   U32 bytesReceived;
+   U32 packetsSent;
+   U32 packetsLost;
+   U32 eventsRetransmitted;
+   U32 ghostUpdatesSent;
+   U32 ghostUpdatesSkipped;                                 // Updates that didn't fit in a packet, summed over packets
+   U32 ticks;
+   U64 ghostsInScope;                                       // Summed over ticks
+   S32 maxGhostsInScope;
+   F32 roundTripTime;                                       // As it was at the end
+
+   ConnectionStats();
+
+   U32 getTotalBytesSent() const;
+   F32 getAverageGhostsInScope() const;
+};
+
+
 class GameConnection: public ControlObjectConnection, public ChatCheck
 {
 private:
@@ -69,6 +92,9 @@ private:
    bool mWantsScoreboardUpdates;    // Indicates if client has requested scoreboard streaming (e.g. pressing Tab key)
    bool mReadyForRegularGhosts;
 
+   DatabaseQuery mScopeQuery;       // Our own search context, so scope queries for several connections can run at once
+   RegionQueryCache mScopeCache;    // What our last scope query found, so the next only has to look at what has changed
+
    StringTableEntry mClientNameNonUnique; // For authentication, not unique name
 
    Timer mAuthenticationTimer;
@@ -89,6 +115,15 @@ private:
    void updateTimers_client(U32 timeDelta);
    void updateTimers_server(U32 timeDelta);
 
+   // Running totals are sampled when each stretch starts, so a stretch's stats are the difference
+   ConnectionStats mStatsStart;
+   ConnectionStats mConnectionStats;   // The last complete stretch
+   U32 mStatsTicks;
+   U64 mStatsGhostsInScope;
+   S32 mStatsMaxGhostsInScope;         // Just for the current stretch
+
+   ConnectionStats getStatsTotals();    // Since the connection began, with the time they were taken in place of period
+
    S32 mUploadIndex;
 
 public:
@@ -236,6 +271,8 @@ public:
 
 
    bool isInCommanderMap();
+   DatabaseQuery &getScopeQuery();
+   RegionQueryCache &getScopeCache();
 
    TNL_DECLARE_RPC(c2sRequestCommanderMap, ());
    TNL_DECLARE_RPC(c2sReleaseCommanderMap, ());
@@ -341,6 +378,9 @@ public:
 
    void setConnectionSpeed(S32 speed);
 
+   void endConnectionStatsPeriod();                     // Server only; starts a new stretch of stats
+   ConnectionStats getConnectionStats();                // The last complete stretch, or what we have so far if there isn't one
+
    void onConnectionEstablished();
    void onConnectionEstablished_client();
    void onConnectionEstablished_server();
@@ -97,6 +97,9 @@ GameType::GameType(S32 winningScore) : mScoreboardUpdateTimer(THREE_SECONDS), mG
 
    mObjectsExpected = 0;
    mGame = NULL;
+
+   mSpyBugViewsReady = false;
+   mSpyBugViewRevision = 0;
 }
 
 
@@ -105,6 +108,8 @@ GameType::~GameType()
 {
    if(mGame)
       mGame->setPreviousLevelName(getLevelName());
+
+   mSpyBugViews.deleteAndClear();
 }
 
 
@@ -1332,6 +1337,63 @@ static void markAllMountedItemsAsBeingInScope(Ship *ship, GameConnection *conn)
 
 
 // Runs only on server, I think
+// Objects a spy bug at center can see
+class SpyBugViewFilter : public RegionQueryCache::Filter
+{
+private:
+   Point mCenter;
+
+public:
+   explicit SpyBugViewFilter(const Point &center) { mCenter = center; }
+
+   bool passes(DatabaseObject *object) const
+   {
+      // Some objects don't have geometry (ForceFields).  Is this a bug?
+      return object->hasGeometry() && pointInHexagon(object->getPos(), mCenter, SpyBug::SPY_BUG_RADIUS);
+   }
+};
+
+
+static Rect getSpyBugViewRect(const Point &pos)
+{
+   Rect queryRect(pos, pos);
+   queryRect.expand(Point(SpyBug::SPY_BUG_RADIUS, SpyBug::SPY_BUG_RADIUS * FloatSqrt3Half));  // Bounding box of hexagon
+   return queryRect;
+}
+
+
+// Server only.  Figures out what each spy bug can see, so performScopeQuery() doesn't need to do it for every
+// connection.  Must be called, on the main thread, right before connections are asked to send packets.  Spy bugs
+// don't move, so their caches only have to look at objects that have come, gone or moved near them.
+void GameType::prepareScopeQueries()
+{
+   GridDatabase *database = mGame->getGameObjDatabase();
+   const Vector<DatabaseObject *> *spyBugs = database->findObjects_fast(SpyBugTypeNumber);
+
+   while(mSpyBugViews.size() < spyBugs->size())
+      mSpyBugViews.push_back(new SpyBugView());
+
+   while(mSpyBugViews.size() > spyBugs->size())
+   {
+      delete mSpyBugViews.last();
+      mSpyBugViews.pop_back();
+   }
+
+   for(S32 i = 0; i < spyBugs->size(); i++)
+   {
+      Point pos = static_cast<SpyBug *>(spyBugs->get(i))->getActualPos();
+      SpyBugViewFilter filter(pos);
+
+      mSpyBugViews[i]->query.clearResults();
+      database->findObjects((TestFunc)isAnyObjectType, mSpyBugViews[i]->query, mSpyBugViews[i]->cache,
+                            getSpyBugViewRect(pos), &filter);
+   }
+
+   mSpyBugViewsReady = true;
+   mSpyBugViewRevision = database->getRevision();
+}
+
+
 void GameType::performScopeQuery(GhostConnection *connection)
 {
    GameConnection *conn = (GameConnection *) connection;
@@ -1363,10 +1425,15 @@ void GameType::performScopeQuery(GhostConnection *connection)
    }
 
    // What does the spy bug see?
+   GridDatabase *database = mGame->getGameObjDatabase();
+   DatabaseQuery &query = conn->getScopeQuery();
    bool sameQuery = false;  // helps speed up by not repeatedly finding same objects
 
-   const Vector<DatabaseObject *> *spyBugs = mGame->getGameObjDatabase()->findObjects_fast(SpyBugTypeNumber);
-   const Point scopeRange(SpyBug::SPY_BUG_RADIUS, SpyBug::SPY_BUG_RADIUS * FloatSqrt3Half);  // Bounding box of hexagon
+   const Vector<DatabaseObject *> *spyBugs = database->findObjects_fast(SpyBugTypeNumber);
+
+   // Use what prepareScopeQueries() found, unless the database has changed since
+   bool useViews = mSpyBugViewsReady && mSpyBugViewRevision == database->getRevision() &&
+                   mSpyBugViews.size() == spyBugs->size();
 
    for(S32 i = spyBugs->size()-1; i >= 0; i--)
    {
@@ -1376,26 +1443,25 @@ void GameType::performScopeQuery(GhostConnection *connection)
       if(sb->isVisibleToPlayer(clientInfo, isTeamGame()))
       {
          Point pos = sb->getActualPos();
-         Rect queryRect(pos, pos);
+         SpyBugViewFilter filter(pos);
 
-         queryRect.expand(scopeRange);
+         if(!useViews)
+         {
+            query.clearResults();
+            database->findObjects((TestFunc)isAnyObjectType, query, getSpyBugViewRect(pos), sameQuery);
+            sameQuery = true;
+         }
 
-         fillVector.clear();
-         mGame->getGameObjDatabase()->findObjects((TestFunc)isAnyObjectType, fillVector, queryRect, sameQuery);
-         sameQuery = true;
+         const Vector<DatabaseObject *> &found = useViews ? mSpyBugViews[i]->query.getResults() : query.getResults();
 
-         for(S32 j = 0; j < fillVector.size(); j++)
+         for(S32 j = 0; j < found.size(); j++)
          {
-            // Some objects don't have geometry (ForceFields).  Is this a bug?
-            if(!fillVector[j]->hasGeometry())
-               continue;
-
-            if(!pointInHexagon(fillVector[j]->getPos(), pos, SpyBug::SPY_BUG_RADIUS))
+            if(!useViews && !filter.passes(found[j]))
                continue;
 
-            connection->objectInScope(static_cast<BfObject *>(fillVector[j]));
-            if(isShipType(fillVector[j]->getObjectTypeNumber()))
-               markAllMountedItemsAsBeingInScope(static_cast<Ship *>(fillVector[j]), conn);
+            connection->objectInScope(static_cast<BfObject *>(found[j]));
+            if(isShipType(found[j]->getObjectTypeNumber()))
+               markAllMountedItemsAsBeingInScope(static_cast<Ship *>(found[j]), conn);
          }
       }
    }
@@ -1430,10 +1496,14 @@ void GameType::performProxyScopeQuery(BfObject *scopeObject, ClientInfo *clientI
    GameConnection *connection = clientInfo->getConnection();
    TNLAssert(connection, "NULL gameConnection!");
 
+   // Use the connection's own query rather than fillVector; scope queries for different connections may run
+   // at the same time on the server's worker threads
+   DatabaseQuery &query = connection->getScopeQuery();
+   query.clearResults();
+
    if(isTeamGame() && connection->isInCommanderMap())
    {
       S32 teamId = clientInfo->getTeamIndex();
-      fillVector.clear();
       bool sameQuery = false;  // helps speed up by not repeatedly finding same objects
 
       for(S32 i = 0; i < mGame->getClientCount(); i++)
@@ -1459,7 +1529,7 @@ void GameType::performProxyScopeQuery(BfObject *scopeObject, ClientInfo *clientI
             else     // No sensor
                testFunc = &isVisibleOnCmdrsMapType;
 
-         mGame->getGameObjDatabase()->findObjects(testFunc, fillVector, queryRect, sameQuery);
+         mGame->getGameObjDatabase()->findObjects(testFunc, query, queryRect, sameQuery);
          sameQuery = true;
       }
    }
@@ -1473,16 +1543,18 @@ void GameType::performProxyScopeQuery(BfObject *scopeObject, ClientInfo *clientI
       Rect queryRect(pos, pos);
       queryRect.expand( mGame->getScopeRange(co->hasModule(ModuleSensor)) );
 
-      fillVector.clear();
-      mGame->getGameObjDatabase()->findObjects((TestFunc)isAnyObjectType, fillVector, queryRect);
+      // Our ship usually hasn't gone far since the last packet, so most of the buckets should be unchanged
+      mGame->getGameObjDatabase()->findObjects((TestFunc)isAnyObjectType, query, connection->getScopeCache(), queryRect);
    }
 
+   const Vector<DatabaseObject *> &found = query.getResults();
+
    // Set object-in-scope for all objects found above
-   for(S32 i = 0; i < fillVector.size(); i++)
+   for(S32 i = 0; i < found.size(); i++)
    {
-      connection->objectInScope(static_cast<BfObject *>(fillVector[i]));
-      if(isShipType(fillVector[i]->getObjectTypeNumber()))
-         markAllMountedItemsAsBeingInScope(static_cast<Ship *>(fillVector[i]), connection);
+      connection->objectInScope(static_cast<BfObject *>(found[i]));
+      if(isShipType(found[i]->getObjectTypeNumber()))
+         markAllMountedItemsAsBeingInScope(static_cast<Ship *>(found[i]), connection);
    }
 
    // Make bots visible if showAllBots has been activated
@@ -1492,6 +1564,15 @@ void GameType::performProxyScopeQuery(BfObject *scopeObject, ClientInfo *clientI
 }
 
 
+// Adds up how many objects prepareScopeQueries() has had to look at, compared to how many it would have looked at
+// without its caches, and starts counting again
+void GameType::collectScopeStats(U32 &objectsExamined, U32 &objectsCovered)
+{
+   for(S32 i = 0; i < mSpyBugViews.size(); i++)
+      mSpyBugViews[i]->cache.collectTotals(objectsExamined, objectsCovered);
+}
+
+
 // Server only
 void GameType::addItemOfInterest(MoveItem *item)
 {
@@ -3197,6 +3278,92 @@ GAMETYPE_RPC_C2S(GameType, c2sClearScriptCache, (), ())
 
 
 
+// Sends the admin a line for each running script, with what it has cost us since it started.  Newer than every
+// other RPC, so it goes at the end of the list, and older clients still agree with us on everything before it.
+TNL_IMPLEMENT_NETOBJECT_RPC(GameType, c2sShowScriptStats, (), (),
+                            NetClassGroupGameMask, RPCGuaranteedOrdered, RPCToGhostParent, 4)
+{
+   ClientInfo *clientInfo = ((GameConnection *) getRPCSourceConnection())->getClientInfo();
+
+   if(!clientInfo->isAdmin())    // Error message handled client-side
+      return;
+
+   GameConnection *conn = clientInfo->getConnection();
+
+   Vector<LuaScriptRunner *> scripts;
+   static_cast<ServerGame *>(getGame())->getScripts(scripts);
+
+   if(scripts.size() == 0)
+   {
+      conn->s2cDisplayMessage(GameConnection::ColorRed, SFXNone, "No scripts are running");
+      return;
+   }
+
+   for(S32 i = 0; i < scripts.size(); i++)
+   {
+      const LuaScriptProfile &profile = scripts[i]->getProfile();
+
+      string stats = itos(profile.calls) + " calls, " + ftos(profile.time, 1) + " ms, " + 
+                     itos(profile.bytesAllocated / 1024) + " KB allocated";
+
+      if(LuaScriptRunner::isCountingInstructions())
+         stats += ", " + itos(profile.instructions / 1000) + "K instructions";
+
+      if(profile.deferredTicks > 0)
+         stats += ", " + itos(profile.deferredTicks) + " ticks deferred";
+
+      if(scripts[i]->getMemoryInUse() > 0)
+         stats += ", " + itos(scripts[i]->getMemoryInUse() / 1024) + " KB in use";
+
+      messageVals.clear();
+      messageVals.push_back(scripts[i]->getProfileName());
+      messageVals.push_back(stats);
+      conn->s2cDisplayMessageE(GameConnection::ColorInfo, SFXNone, "%e0: %e1", messageVals);
+   }
+}
+
+
+// Sends the admin a line for each player, with what their connection carried over the last stretch of network stats.
+// Declared at version 4 for the same reason as c2sShowScriptStats.
+TNL_IMPLEMENT_NETOBJECT_RPC(GameType, c2sShowNetStats, (), (),
+                            NetClassGroupGameMask, RPCGuaranteedOrdered, RPCToGhostParent, 4)
+{
+   ClientInfo *clientInfo = ((GameConnection *) getRPCSourceConnection())->getClientInfo();
+
+   if(!clientInfo->isAdmin())    // Error message handled client-side
+      return;
+
+   GameConnection *conn = clientInfo->getConnection();
+
+   for(S32 i = 0; i < mGame->getClientCount(); i++)
+   {
+      ClientInfo *info = mGame->getClientInfo(i);
+
+      if(info->isRobot())
+         continue;
+
+      ConnectionStats netStats = info->getConnection()->getConnectionStats();
+      F32 seconds = getMax(netStats.period / 1000.0f, 0.001f);
+
+      string stats = ftos(netStats.roundTripTime, 0) + " ms, " + 
+                     ftos(netStats.packetsSent > 0 ? 100.0f * netStats.packetsLost / netStats.packetsSent : 0, 1) + "% lost, " +
+                     itos(U32(netStats.getTotalBytesSent() / seconds)) + " B/s out (moves " + 
+                     itos(U32(netStats.bytesSent[NetConnection::TrafficMoves] / seconds)) + ", events " + 
+                     itos(U32(netStats.bytesSent[NetConnection::TrafficEvents] / seconds)) + ", ghosts " + 
+                     itos(U32(netStats.bytesSent[NetConnection::TrafficGhosts] / seconds)) + "), " + 
+                     itos(U32(netStats.bytesReceived / seconds)) + " B/s in, " + 
+                     ftos(netStats.getAverageGhostsInScope(), 0) + " ghosts, " + 
+                     itos(netStats.ghostUpdatesSkipped) + " updates deferred, " + 
+                     itos(netStats.eventsRetransmitted) + " events resent";
+
+      messageVals.clear();
+      messageVals.push_back(info->getName());
+      messageVals.push_back(stats);
+      conn->s2cDisplayMessageE(GameConnection::ColorInfo, SFXNone, "%e0: %e1", messageVals);
+   }
+}
+
+
 GAMETYPE_RPC_C2S(GameType, c2sTriggerTeamChange, (StringTableEntry playerName, S32 teamIndex), (playerName, teamIndex))
 {
    GameConnection *source = (GameConnection *) getRPCSourceConnection();
@@ -213,6 +213,17 @@ public:
 
    Vector<ItemOfInterest> mItemsOfInterest;
 
+   // What a spy bug can see.  Worked out once per tick by prepareScopeQueries(), rather than by every connection.
+   struct SpyBugView
+   {
+      RegionQueryCache cache;
+      DatabaseQuery query;
+   };
+
+   Vector<SpyBugView *> mSpyBugViews;     // One for each spy bug in the game object database, in the same order
+   bool mSpyBugViewsReady;
+   U32 mSpyBugViewRevision;               // Database revision when mSpyBugViews was brought up to date
+
    void addItemOfInterest(MoveItem *theItem);
 
    void broadcastMessage(GameConnection::MessageColors color, SFXProfiles sfx, const StringTableEntry &formatString);
@@ -380,8 +391,10 @@ public:
 
    void queryItemsOfInterest();
    bool makeSureTeamCountIsNotZero();
+   void prepareScopeQueries();
    void performScopeQuery(GhostConnection *connection);
    virtual void performProxyScopeQuery(BfObject *scopeObject, ClientInfo *clientInfo);
+   void collectScopeStats(U32 &objectsExamined, U32 &objectsCovered);
 
    virtual void onGhostAvailable(GhostConnection *theConnection);
    TNL_DECLARE_RPC(s2cSetLevelInfo, (StringTableEntry levelName, StringPtr levelDesc, StringPtr musicName, S32 teamScoreLimit,
@@ -489,6 +502,8 @@ public:
    TNL_DECLARE_RPC(c2sRenamePlayer, (StringTableEntry playerName, StringTableEntry newName));
    TNL_DECLARE_RPC(c2sGlobalMutePlayer, (StringTableEntry playerName));
    TNL_DECLARE_RPC(c2sClearScriptCache, ());
+   TNL_DECLARE_RPC(c2sShowScriptStats, ());
+   TNL_DECLARE_RPC(c2sShowNetStats, ());
    TNL_DECLARE_RPC(c2sTriggerTeamChange, (StringTableEntry playerName, S32 teamIndex));
    TNL_DECLARE_RPC(c2sKickPlayer, (StringTableEntry playerName));
 
@@ -512,8 +527,6 @@ public:
    bool addBotFromClient(Vector<StringTableEntry> args);
 
    void displayAnnouncement(const string &message) const;
-
-   map <pair<U16,U16>, Vector<Point> > cachedBotFlightPlans;  // cache of zone-to-zone flight plans, shared for all bots
 };
 
 #define GAMETYPE_RPC_S2C(className, methodName, args, argNames) \
@@ -6,17 +6,21 @@
 #include "gridDB.h"
 #include "moveObject.h"    // For def of ActualState
 #include "WallSegmentManager.h"
+#include "WallVisibility.h"
 #include "GeomUtils.h"
 
 #include "tnlLog.h"
 
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  define BF_RAY_SSE
+#  include <xmmintrin.h>
+#endif
+
 namespace Zap
 {
 
-U32 GridDatabase::mQueryId = 0;
-ClassChunker<DatabaseBucketEntry> *GridDatabase::mChunker = NULL;
-U32 GridDatabase::mCountGridDatabase = 0;
-
 static U32 getNextId() 
 {
    static U32 nextId = 0;
@@ -26,20 +30,21 @@ static U32 getNextId()
 // Constructor
 GridDatabase::GridDatabase(bool createWallSegmentManager)
 {
-   if(mChunker == NULL)
-      mChunker = new ClassChunker<DatabaseBucketEntry>();        // Static shared by all databases, reference counted and deleted in destructor
+   mRevision = 0;
 
-   mCountGridDatabase++;
+   // Start with the classic grid, which needs no knowledge of the level; see setSpatialIndex()
+   mSpatialIndex = NULL;
+   setSpatialIndex(SpatialIndexWrappingGrid, Rect());
 
-   for(U32 i = 0; i < BucketRowCount; i++)
-      for(U32 j = 0; j < BucketRowCount; j++)
-         mBuckets[i][j].nextInBucket = NULL;
+   mQuerySlotCount = 0;
 
    if(createWallSegmentManager)
       mWallSegmentManager = new WallSegmentManager();    // Gets deleted in destructor
    else
       mWallSegmentManager = NULL;
 
+   mWallVisibility = NULL;
+
    mDatabaseId = getNextId();
 }
 
@@ -59,18 +64,186 @@ GridDatabase::~GridDatabase()
 {
    removeEverythingFromDatabase();
 
-   TNLAssert(mChunker != NULL || mCountGridDatabase != 0, "Running GridDatabase destructor without initalizing?");
-
    if(mWallSegmentManager)
       delete mWallSegmentManager;
 
-   mCountGridDatabase--;
+   delete mWallVisibility;
+   delete mSpatialIndex;
+}
+
+
+// Switch to a different bucket layout.  Objects already in the database are re-bucketed, so this can be called
+// at any time -- typically after a level has loaded, once we know how big it is.
+void GridDatabase::setSpatialIndex(SpatialIndexType type, const Rect &levelExtents)
+{
+   for(S32 i = 0; i < mAllObjects.size(); i++)
+      unlinkFromBuckets(mAllObjects[i]);
+
+   delete mSpatialIndex;
+   mSpatialIndex = SpatialIndex::create(type, levelExtents);
+
+   mBuckets.clear();
+   mBuckets.resize(mSpatialIndex->getBucketCount());
+
+   mLevelObjectCounts.resize(mSpatialIndex->getLevelCount());
+   for(S32 i = 0; i < mLevelObjectCounts.size(); i++)
+      mLevelObjectCounts[i] = 0;
+
+   for(S32 i = 0; i < mAllObjects.size(); i++)
+   {
+      BucketRange range;
+      mSpatialIndex->getInsertRange(mAllObjects[i]->getExtent(), range);
+      linkToBuckets(mAllObjects[i], range, mAllObjects[i]->getExtent());
+   }
+}
+
+
+SpatialIndexType GridDatabase::getSpatialIndexType() const
+{
+   return mSpatialIndex->getType();
+}
+
+
+S32 GridDatabase::getBucketCount() const
+{
+   return mBuckets.size();
+}
+
+
+// Add object to every bucket in range
+void GridDatabase::linkToBuckets(DatabaseObject *theObject, const BucketRange &range, const Rect &extents)
+{
+   TNLAssert(theObject->mBucketSlots.size() == 0, "Object is already in buckets!");
+
+   // Don't use x <= maxx, it will endless loop if maxx = S32_MAX and x overflows
+   // Instead, use maxx - x >= 0, it will better handle overflows and avoid endless loop (MIN_S32 - MAX_S32 = +1)
+   for(S32 x = range.bins.minx; range.bins.maxx - x >= 0; x++)
+      for(S32 y = range.bins.miny; range.bins.maxy - y >= 0; y++)
+      {
+         DatabaseBucket &bucket = mBuckets[mSpatialIndex->getBucketIndex(range.level, x, y)];
+
+         theObject->mBucketSlots.push_back(bucket.objects.size());
+         bucket.objects.push_back(theObject);
+         bucket.extents.push_back(extents);
+         bucket.slotRefs.push_back(theObject->mBucketSlots.size() - 1);
+         touchBucket(bucket);
+      }
+
+   theObject->mBucketRange = range;
+   mLevelObjectCounts[range.level]++;
+}
+
+
+// Remove object from all its buckets
+void GridDatabase::unlinkFromBuckets(DatabaseObject *theObject)
+{
+   const BucketRange &range = theObject->mBucketRange;
+   S32 index = 0;
+
+   // Visit the buckets in the same order as linkToBuckets() so we can match them up with mBucketSlots
+   for(S32 x = range.bins.minx; range.bins.maxx - x >= 0; x++)
+      for(S32 y = range.bins.miny; range.bins.maxy - y >= 0; y++)
+      {
+         DatabaseBucket &bucket = mBuckets[mSpatialIndex->getBucketIndex(range.level, x, y)];
+         S32 slot = theObject->mBucketSlots[index];
+         index++;
+
+         TNLAssert(bucket.objects[slot] == theObject, "Object mismatch");
+
+         // Swap the last entry into our slot, then tell the object that got moved where it lives now
+         bucket.objects.erase_fast(slot);
+         bucket.extents.erase_fast(slot);
+         bucket.slotRefs.erase_fast(slot);
+
+         if(slot < bucket.objects.size())
+            bucket.objects[slot]->mBucketSlots[bucket.slotRefs[slot]] = slot;
+
+         touchBucket(bucket);
+      }
+
+   TNLAssert(index == theObject->mBucketSlots.size(), "Bucket slots don't match bucket range!");
+
+   theObject->mBucketSlots.clear();
+   mLevelObjectCounts[range.level]--;
+}
+
+
+// Object has moved, but is still in the same buckets; update our cached copies of its extent
+void GridDatabase::updateBucketExtents(DatabaseObject *theObject, const Rect &extents)
+{
+   const BucketRange &range = theObject->mBucketRange;
+   S32 index = 0;
+
+   for(S32 x = range.bins.minx; range.bins.maxx - x >= 0; x++)
+      for(S32 y = range.bins.miny; range.bins.maxy - y >= 0; y++)
+      {
+         DatabaseBucket &bucket = mBuckets[mSpatialIndex->getBucketIndex(range.level, x, y)];
+         bucket.extents[theObject->mBucketSlots[index]] = extents;
+         touchBucket(bucket);
+         index++;
+      }
+}
+
+
+// Lets anyone who cached what was in this bucket know it's changed
+void GridDatabase::touchBucket(DatabaseBucket &bucket)
+{
+   mRevision++;
+   bucket.revision = mRevision;
+}
+
+
+U32 GridDatabase::getRevision() const
+{
+   return mRevision;
+}
+
 
-   if(mCountGridDatabase == 0)
+// Latest revision of any bucket that an object overlapping extents could be in.  Until this changes, neither will
+// what a search of extents finds.
+U32 GridDatabase::getRevision(const Rect &extents) const
+{
+   U32 revision = 0;
+   IntRect bins;
+
+   // Check every level, even empty ones -- something might get added there later
+   for(S32 level = 0; level < mLevelObjectCounts.size(); level++)
+   {
+      mSpatialIndex->getQueryBins(level, extents, bins);
+
+      for(S32 x = bins.minx; bins.maxx - x >= 0; x++)
+         for(S32 y = bins.miny; bins.maxy - y >= 0; y++)
+         {
+            U32 bucketRevision = mBuckets[mSpatialIndex->getBucketIndex(level, x, y)].revision;
+            if(bucketRevision > revision)
+               revision = bucketRevision;
+         }
+   }
+
+   return revision;
+}
+
+
+// Move object to the buckets for newExtents, or just refresh its cached extent if the buckets haven't changed
+void GridDatabase::updateBuckets(DatabaseObject *theObject, const Rect &newExtents)
+{
+   if(!(newExtents == theObject->mExtent))
+      onObjectChanged(theObject);
+
+   BucketRange range;
+   mSpatialIndex->getInsertRange(newExtents, range);
+
+   if(range == theObject->mBucketRange)
    {
-      delete mChunker;
-      mChunker = NULL;
+      // Objects often get told to move to where they already are; no need to disturb anyone's cached searches
+      if(!(newExtents == theObject->mExtent))
+         updateBucketExtents(theObject, newExtents);
+      return;
    }
+
+   // They are different... remove and readd to database, but don't touch mAllObjects
+   unlinkFromBuckets(theObject);
+   linkToBuckets(theObject, range, newExtents);
 }
 
 
@@ -120,30 +293,28 @@ void GridDatabase::addToDatabase(DatabaseObject *theObject)
    TNLAssert(theObject->mDatabase != this, "Already added to database, trying to add to same database again!");
    TNLAssert(!theObject->mDatabase,        "Already added to database, trying to add to different database!");
    TNLAssert(theObject->getExtentSet(),    "Object extents were never set!");
-   TNLAssert(!theObject->mBucketList,       "BucketList must be NULL");
+   TNLAssert(theObject->mBucketSlots.size() == 0, "Object is already in buckets!");
 
    if(theObject->mDatabase)      // Should never happen
       return;
 
    theObject->mDatabase = this;
 
-   static IntRect bins;
-   fillBins(theObject->getExtent(), bins);
+   // Reuse a slot freed up by a departed object if we can, so DatabaseQuery's arrays don't grow without bound
+   if(mFreeQuerySlots.size() > 0)
+   {
+      theObject->mQuerySlot = mFreeQuerySlots.last();
+      mFreeQuerySlots.pop_back();
+   }
+   else
+   {
+      theObject->mQuerySlot = mQuerySlotCount;
+      mQuerySlotCount++;
+   }
 
-   for(S32 x = bins.minx; bins.maxx - x >= 0; x++)
-      for(S32 y = bins.miny; bins.maxy - y >= 0; y++)
-      {
-         DatabaseBucketEntry *be = mChunker->alloc();
-         DatabaseBucketEntryBase *base = &mBuckets[x & BucketMask][y & BucketMask];
-         be->theObject = theObject;
-         if(base->nextInBucket)
-            base->nextInBucket->prevInBucket = be;
-         be->nextInBucket = base->nextInBucket;
-         be->prevInBucket = base;
-         base->nextInBucket = be;
-         be->nextInBucketForThisObject = theObject->mBucketList;
-         theObject->mBucketList = be;
-      }
+   BucketRange range;
+   mSpatialIndex->getInsertRange(theObject->getExtent(), range);
+   linkToBuckets(theObject, range, theObject->getExtent());
 
    // Add the object to our non-spatial "database" as well
    mAllObjects.push_back(theObject);
@@ -155,6 +326,8 @@ void GridDatabase::addToDatabase(DatabaseObject *theObject)
       mFlags.push_back(theObject);
    else if(type == SpyBugTypeNumber)
       mSpyBugs.push_back(theObject);
+
+   onObjectChanged(theObject);
    
    //sortObjects(mAllObjects);  // problem: Barriers in-game don't have mGeometry (it is NULL)
 }
@@ -170,22 +343,26 @@ void GridDatabase::addToDatabase(const Vector<DatabaseObject *> &objects)
 
 void GridDatabase::removeEverythingFromDatabase()
 {
-   for(S32 x = 0; x < BucketRowCount; x++)
+   for(S32 i = 0; i < mAllObjects.size(); i++)
    {
-      for(S32 y = 0; y < BucketRowCount; y++)
-      {
-         for(DatabaseBucketEntry *walk = mBuckets[x & BucketMask][y & BucketMask].nextInBucket; walk; )
-         {
-            DatabaseBucketEntry *rem = walk;
-            walk->theObject->mDatabase = NULL;  // make sure object don't point to this database anymore
-            walk->theObject->mBucketList = NULL;
-            walk = rem->nextInBucket;
-            mChunker->free(rem);
-         }
-         mBuckets[x & BucketMask][y & BucketMask].nextInBucket = NULL;
-      }
+      mAllObjects[i]->mDatabase = NULL;  // make sure object don't point to this database anymore
+      mAllObjects[i]->mBucketSlots.clear();
+   }
+
+   for(S32 i = 0; i < mBuckets.size(); i++)
+   {
+      mBuckets[i].objects.clear();
+      mBuckets[i].extents.clear();
+      mBuckets[i].slotRefs.clear();
+      touchBucket(mBuckets[i]);
    }
 
+   for(S32 i = 0; i < mLevelObjectCounts.size(); i++)
+      mLevelObjectCounts[i] = 0;
+
+   mFreeQuerySlots.clear();
+   mQuerySlotCount = 0;
+
    // Clear out our specialty lists -- since objects are also in mAllObjects, they'll be deleted below
    mGoalZones.clear();
    mFlags.clear();
@@ -195,6 +372,31 @@ void GridDatabase::removeEverythingFromDatabase()
    
    if(mWallSegmentManager)
       mWallSegmentManager->clear();
+
+   if(mWallVisibility)
+      mWallVisibility->clear();
+}
+
+
+void GridDatabase::onObjectChanged(const DatabaseObject *theObject)
+{
+   if(mWallVisibility && mWallVisibility->isBuilt() && isWallType(theObject->getObjectTypeNumber()))
+      mWallVisibility->clear();
+}
+
+
+bool GridDatabase::buildWallVisibility()
+{
+   if(!mWallVisibility)
+      mWallVisibility = new WallVisibility();    // Deleted in destructor
+
+   return mWallVisibility->build(this);
+}
+
+
+WallVisibility *GridDatabase::getWallVisibility() const
+{
+   return (mWallVisibility && mWallVisibility->isBuilt()) ? mWallVisibility : NULL;
 }
 
 
@@ -216,23 +418,12 @@ void GridDatabase::removeFromDatabase(DatabaseObject *object, bool deleteObject)
    if(object->mDatabase != this)
       return;
 
-   const Rect &extents = object->mExtent;
    object->mDatabase = NULL;
 
-   static IntRect bins;
-   fillBins(extents, bins);
+   unlinkFromBuckets(object);
 
-   while(object->mBucketList)
-   {
-      DatabaseBucketEntry *b = object->mBucketList;
-      TNLAssert(b->theObject == object, "Object mismatch");
-      TNLAssert(b->prevInBucket->nextInBucket == b, "Broken linked list");
-      if(b->nextInBucket)
-         b->nextInBucket->prevInBucket = b->prevInBucket;
-      b->prevInBucket->nextInBucket = b->nextInBucket;
-      object->mBucketList = b->nextInBucketForThisObject;
-      mChunker->free(b);
-   }
+   mFreeQuerySlots.push_back(object->mQuerySlot);
+   object->mQuerySlot = -1;
 
    // Find and delete object from our non-spatial databases
    for(S32 i = 0; i < mAllObjects.size(); i++)
@@ -252,6 +443,8 @@ void GridDatabase::removeFromDatabase(DatabaseObject *object, bool deleteObject)
    else if(type == SpyBugTypeNumber)
       eraseObject_fast(&mSpyBugs, object);
 
+   onObjectChanged(object);
+
    if(deleteObject)
       delete object;      
 }
@@ -290,35 +483,74 @@ const Vector<DatabaseObject *> *GridDatabase::findObjects_fast(U8 typeNumber) co
 }
 
 
-void GridDatabase::findObjects(U8 typeNumber, Vector<DatabaseObject *> &fillVector, const Rect *extents, const IntRect *bins) const
+// Type tests used to specialize findObjectsInBuckets() for each flavor of findObjects()
+struct SingleTypeTest
 {
-   static Vector<U8> types;
-   types.resize(1);
+   U8 typeNumber;
+   explicit SingleTypeTest(U8 type) : typeNumber(type) { }
+   bool operator()(U8 type) const { return type == typeNumber; }
+};
 
-   types[0] = typeNumber;
 
-   findObjects(types, fillVector, extents, bins);
-}
+struct TypeListTest
+{
+   const Vector<U8> &types;
+   explicit TypeListTest(const Vector<U8> &typeList) : types(typeList) { }
+   bool operator()(U8 type) const
+   {
+      for(S32 i = 0; i < types.size(); i++)
+         if(types[i] == type)
+            return true;
+      return false;
+   }
+};
+
+
+struct TestFuncTest
+{
+   TestFunc testFunc;
+   explicit TestFuncTest(TestFunc func) : testFunc(func) { }
+   bool operator()(U8 type) const { return testFunc(type); }
+};
 
 
-void GridDatabase::findObjects(Vector<U8> typeNumbers, Vector<DatabaseObject *> &fillVector, const Rect *extents, const IntRect *bins) const
+// Walk all buckets overlapping extents, on every level of the index that has something in it
+template <class TypeTest>
+void GridDatabase::findObjectsInBuckets(const TypeTest &typeTest, DatabaseQuery &query, Vector<DatabaseObject *> &fillVector, 
+                                        const Rect &extents, bool sameQuery) const
 {
-   mQueryId++;    // Used to prevent the same item from being found in multiple buckets
+   query.prepare(mQuerySlotCount, sameQuery);    // Used to prevent the same item from being found in multiple buckets
+
+   IntRect bins;
+
+   for(S32 level = 0; level < mLevelObjectCounts.size(); level++)
+   {
+      if(mLevelObjectCounts[level] == 0)
+         continue;
+
+      mSpatialIndex->getQueryBins(level, extents, bins);
 
-   for(S32 x = bins->minx; bins->maxx - x >= 0; x++)
-      for(S32 y = bins->miny; bins->maxy - y >= 0; y++)
-         for(DatabaseBucketEntry *walk = mBuckets[x & BucketMask][y & BucketMask].nextInBucket; walk; walk = walk->nextInBucket)
+      for(S32 x = bins.minx; bins.maxx - x >= 0; x++)
+         for(S32 y = bins.miny; bins.maxy - y >= 0; y++)
          {
-            DatabaseObject *theObject = walk->theObject;
+            const DatabaseBucket &bucket = mBuckets[mSpatialIndex->getBucketIndex(level, x, y)];
+            const Rect *bucketExtents = bucket.extents.address();
+            S32 count = bucket.extents.size();
 
-            if(theObject->mLastQueryId != mQueryId &&                         // Object hasn't been queried; and
-               testTypes(typeNumbers, theObject->getObjectTypeNumber()) &&    // is of the right type; and
-               (!extents || theObject->mExtent.intersects(*extents)) )        // overlaps our extents (if passed)
+            for(S32 i = 0; i < count; i++)
             {
-               walk->theObject->mLastQueryId = mQueryId;    // Flag the object so we know we've already visited it
-               fillVector.push_back(walk->theObject);       // And save it as a found item
+               // Check the cached extent first so we only touch objects that are actually nearby
+               if(!bucketExtents[i].intersects(extents))
+                  continue;
+
+               DatabaseObject *theObject = bucket.objects[i];
+
+               // Check type first, so objects we don't want don't use up their visit
+               if(typeTest(theObject->getObjectTypeNumber()) && query.visit(theObject->mQuerySlot))
+                  fillVector.push_back(theObject);
             }
          }
+   }
 }
 
 
@@ -356,52 +588,16 @@ void GridDatabase::findObjects(U8 typeNumber, Vector<DatabaseObject *> &fillVect
 }
 
 
-// Translates extents into bins to search
-void GridDatabase::fillBins(const Rect &extents, IntRect &bins) const
-{
-   bins.minx = S32(extents.min.x) >> BucketWidthBitShift;
-   bins.miny = S32(extents.min.y) >> BucketWidthBitShift;
-   bins.maxx = S32(extents.max.x) >> BucketWidthBitShift;
-   bins.maxy = S32(extents.max.y) >> BucketWidthBitShift;
-
-   if(U32(bins.maxx - bins.minx) >= BucketRowCount)
-      bins.maxx = bins.minx + BucketRowCount - 1;
-
-   if(U32(bins.maxy - bins.miny) >= BucketRowCount)
-      bins.maxy = bins.miny + BucketRowCount - 1;
-}
-
-
 // Find all objects in &extents that are of type typeNumber
 void GridDatabase::findObjects(U8 typeNumber, Vector<DatabaseObject *> &fillVector, const Rect &extents) const
 {
-   static IntRect bins;
-   fillBins(extents, bins);
-
-   findObjects(typeNumber, fillVector, &extents, &bins);
+   findObjectsInBuckets(SingleTypeTest(typeNumber), mDefaultQuery, fillVector, extents, false);
 }
 
 
-void GridDatabase::findObjects(TestFunc testFunc, Vector<DatabaseObject *> &fillVector, const Rect *extents, const IntRect *bins, bool sameQuery) const
+void GridDatabase::findObjects(U8 typeNumber, DatabaseQuery &query, const Rect &extents, bool sameQuery) const
 {
-   TNLAssert(this, "findObjects 'this' is NULL");
-   if(!sameQuery)
-      mQueryId++;    // Used to prevent the same item from being found in multiple buckets
-
-   for(S32 x = bins->minx; bins->maxx - x >= 0; x++)
-      for(S32 y = bins->miny; bins->maxy - y >= 0; y++)
-         for(DatabaseBucketEntry *walk = mBuckets[x & BucketMask][y & BucketMask].nextInBucket; walk; walk = walk->nextInBucket)
-         {
-            DatabaseObject *theObject = walk->theObject;
-
-            if(theObject->mLastQueryId != mQueryId &&                      // Object hasn't been queried; and
-               (testFunc(theObject->getObjectTypeNumber())) &&             // is of the right type; and
-               (!extents || theObject->mExtent.intersects(*extents)) )     // overlaps our extents (if passed)
-            {
-               walk->theObject->mLastQueryId = mQueryId;    // Flag the object so we know we've already visited it
-               fillVector.push_back(walk->theObject);       // And save it as a found item
-            }
-         }
+   findObjectsInBuckets(SingleTypeTest(typeNumber), query, query.mResults, extents, sameQuery);
 }
 
 
@@ -417,10 +613,13 @@ void GridDatabase::findObjects(TestFunc testFunc, Vector<DatabaseObject *> &fill
 // Find all objects in database using derived type test function
 void GridDatabase::findObjects(const Vector<U8> &types, Vector<DatabaseObject *> &fillVector, const Rect &extents) const
 {
-   static IntRect bins;
-   fillBins(extents, bins);
+   findObjectsInBuckets(TypeListTest(types), mDefaultQuery, fillVector, extents, false);
+}
 
-   findObjects(types, fillVector, &extents, &bins);
+
+void GridDatabase::findObjects(const Vector<U8> &types, DatabaseQuery &query, const Rect &extents, bool sameQuery) const
+{
+   findObjectsInBuckets(TypeListTest(types), query, query.mResults, extents, sameQuery);
 }
 
 
@@ -461,23 +660,118 @@ bool GridDatabase::testTypes(const Vector<U8> &types, U8 objectType) const
 // Find all objects in &extents derived type test function
 void GridDatabase::findObjects(TestFunc testFunc, Vector<DatabaseObject *> &fillVector, const Rect &extents, bool sameQuery) const
 {
-   static IntRect bins;
-   fillBins(extents, bins);
+   TNLAssert(this, "findObjects 'this' is NULL");
+   findObjectsInBuckets(TestFuncTest(testFunc), mDefaultQuery, fillVector, extents, sameQuery);
+}
 
-   findObjects(testFunc, fillVector, &extents, &bins, sameQuery);
+
+void GridDatabase::findObjects(TestFunc testFunc, DatabaseQuery &query, const Rect &extents, bool sameQuery) const
+{
+   findObjectsInBuckets(TestFuncTest(testFunc), query, query.mResults, extents, sameQuery);
 }
 
 
-void GridDatabase::dumpObjects()
+void GridDatabase::findObjects(TestFunc testFunc, DatabaseQuery &query, RegionQueryCache &cache, const Rect &extents,
+                               const RegionQueryCache::Filter *filter, bool sameQuery) const
 {
-   for(S32 x = 0; x < BucketRowCount; x++)
-      for(S32 y = 0; y < BucketRowCount; y++)
-         for(DatabaseBucketEntry *walk = mBuckets[x & BucketMask][y & BucketMask].nextInBucket; walk; walk = walk->nextInBucket)
+   // Anything remembered from a different database, or for a different test, is no use to us
+   if(cache.mDatabaseId != mDatabaseId || cache.mTestFunc != testFunc)
+   {
+      cache.clear();
+      cache.mDatabaseId = mDatabaseId;
+      cache.mTestFunc = testFunc;
+   }
+
+   query.prepare(mQuerySlotCount, sameQuery);
+
+   cache.mNextBuckets.clear();
+   cache.mNextMatches.clear();
+   cache.mObjectsExamined = 0;
+   cache.mObjectsCovered = 0;
+
+   IntRect bins;
+
+   for(S32 level = 0; level < mLevelObjectCounts.size(); level++)
+   {
+      if(mLevelObjectCounts[level] == 0)
+         continue;
+
+      mSpatialIndex->getQueryBins(level, extents, bins);
+
+      for(S32 x = bins.minx; bins.maxx - x >= 0; x++)
+         for(S32 y = bins.miny; bins.maxy - y >= 0; y++)
          {
-            DatabaseObject *theObject = walk->theObject;
-            logprintf("Found object in (%d,%d) with extents %s", x, y, theObject->getExtent().toString().c_str());
-            logprintf("Obj coords: %s", static_cast<BfObject *>(theObject)->getPos().toString().c_str());
+            S32 bucketIndex = mSpatialIndex->getBucketIndex(level, x, y);
+            const DatabaseBucket &bucket = mBuckets[bucketIndex];
+            const RegionQueryCache::CachedBucket *cached = cache.findBucket(bucketIndex);
+
+            RegionQueryCache::CachedBucket entry;
+            entry.bucketIndex = bucketIndex;
+            entry.revision = bucket.revision;
+            entry.searchRect = extents;
+            entry.firstMatch = cache.mNextMatches.size();
+
+            cache.mObjectsCovered += bucket.objects.size();
+
+            if(cached && cached->revision == bucket.revision && cached->canReuse(extents, filter != NULL))
+            {
+               entry.bounds = cached->bounds;
+               entry.hasBounds = cached->hasBounds;
+
+               // Matches are either all still good, or, if we've moved away from everything, none are
+               if(cached->hasBounds && cached->bounds.intersects(extents))
+                  for(S32 i = 0; i < cached->matchCount; i++)
+                     cache.mNextMatches.push_back(cache.mMatches[cached->firstMatch + i]);
+            }
+            else
+            {
+               const Rect *bucketExtents = bucket.extents.address();
+               entry.hasBounds = false;
+
+               cache.mObjectsExamined += bucket.objects.size();
+
+               for(S32 i = 0; i < bucket.objects.size(); i++)
+               {
+                  DatabaseObject *theObject = bucket.objects[i];
+
+                  if(!testFunc(theObject->getObjectTypeNumber()))
+                     continue;
+
+                  if(entry.hasBounds)
+                     entry.bounds.unionRect(bucketExtents[i]);
+                  else
+                  {
+                     entry.bounds = bucketExtents[i];
+                     entry.hasBounds = true;
+                  }
+
+                  if(bucketExtents[i].intersects(extents) && (!filter || filter->passes(theObject)))
+                     cache.mNextMatches.push_back(theObject);
+               }
+            }
+
+            entry.matchCount = cache.mNextMatches.size() - entry.firstMatch;
+            cache.mNextBuckets.push_back(entry);
+
+            for(S32 i = entry.firstMatch; i < cache.mNextMatches.size(); i++)
+               if(query.visit(cache.mNextMatches[i]->mQuerySlot))
+                  query.mResults.push_back(cache.mNextMatches[i]);
          }
+   }
+
+   cache.finishSearch();
+}
+
+
+void GridDatabase::dumpObjects()
+{
+   for(S32 i = 0; i < mBuckets.size(); i++)
+      for(S32 j = 0; j < mBuckets[i].objects.size(); j++)
+      {
+         DatabaseObject *theObject = mBuckets[i].objects[j];
+         logprintf("Found object in bucket %d with extents %s", i, theObject->getExtent().toString().c_str());
+         logprintf("Obj coords: %s", static_cast<BfObject *>(theObject)->getPos().toString().c_str());
+      }
 }
 
 
@@ -537,112 +831,544 @@ WallSegmentManager *GridDatabase::getWallSegmentManager() const
 ////////////////////////////////////////
 
 // Constructor
-DatabaseObject::DatabaseObject() 
+DatabaseQuery::DatabaseQuery()
 {
-   initialize();
+   mQueryNumber = 0;
 }
 
 
-// Copy constructor
-DatabaseObject::DatabaseObject(const DatabaseObject &t) : Parent(t)
-{  
-   initialize();
-   mObjectTypeNumber = t.mObjectTypeNumber; 
-   mExtent = t.mExtent;
-   mExtentSet = t.mExtentSet;
+// Get ready for a search of a database with querySlotCount slots; unless sameQuery is set, forget everything we've found
+void DatabaseQuery::prepare(S32 querySlotCount, bool sameQuery)
+{
+   if(mLastVisit.size() < querySlotCount)
+      mLastVisit.resize(querySlotCount);     // New entries are zeroed, which no query will ever match
+
+   if(sameQuery && mQueryNumber != 0)
+      return;
+
+   mQueryNumber++;
+
+   // On the rare occasion we wrap around, wipe the slate clean so old visits don't look like new ones
+   if(mQueryNumber == 0)
+   {
+      for(S32 i = 0; i < mLastVisit.size(); i++)
+         mLastVisit[i] = 0;
+
+      mQueryNumber = 1;
+   }
 }
 
 
-// Destructor
-DatabaseObject::~DatabaseObject()
+bool DatabaseQuery::visit(S32 querySlot)
 {
-   TNLAssert(!mDatabase, "Must remove from database when deleting this object");
-   // Do nothing
+   if(mLastVisit[querySlot] == mQueryNumber)
+      return false;
+
+   mLastVisit[querySlot] = mQueryNumber;
+   return true;
 }
 
 
-// Code that needs to run for both constructor and copy constructor
-void DatabaseObject::initialize() 
+Vector<DatabaseObject *> &DatabaseQuery::getResults()
 {
-   mLastQueryId = 0; 
-   mExtent = Rect(); 
-   mExtentSet = false;
-   mDatabase = NULL;
-   mBucketList = NULL;
+   return mResults;
 }
 
 
-// Find objects along a ray, returning first discovered object, along with time of
-// that collision and a Point representing the normal angle at intersection point
-//             (at least I think that's what's going on here - CE)
-DatabaseObject *GridDatabase::findObjectLOS(U8 typeNumber, U32 stateIndex,
-                                            const Point &rayStart, const Point &rayEnd, 
-                                            float &collisionTime, Point &surfaceNormal) const
+void DatabaseQuery::clearResults()
 {
-   return findObjectLOS(typeNumber, stateIndex, true, rayStart, rayEnd, collisionTime, surfaceNormal);
+   mResults.clear();
 }
 
 
-// Format is a passthrough to polygonLineIntersect().  Will be true for most items, false for walls in editor.
-DatabaseObject *GridDatabase::findObjectLOS(U8 typeNumber, U32 stateIndex, bool format,
-                                            const Point &rayStart, const Point &rayEnd,
-                                            float &collisionTime, Point &surfaceNormal) const
-{
-   Rect queryRect(rayStart, rayEnd);
+////////////////////////////////////////
+////////////////////////////////////////
 
-   static Vector<DatabaseObject *> fillVector;  // Use local here, Most of code expects a global FillVector left unchanged
-   fillVector.clear();
+// Constructor
+DatabaseBucket::DatabaseBucket()
+{
+   revision = 0;
+}
 
-   findObjects(typeNumber, fillVector, queryRect);
 
-   Point collisionPoint;
+////////////////////////////////////////
+////////////////////////////////////////
 
-   collisionTime = 1;
-   DatabaseObject *retObject = NULL;
+// Destructor
+RegionQueryCache::Filter::~Filter()
+{
+   // Do nothing
+}
 
-   Point center;
-   Rect rect;
 
-   for(S32 i = 0; i < fillVector.size(); i++)
-   {
-      if(!fillVector[i]->isCollisionEnabled())     // Skip collision-disabled objects
-         continue;
+// Constructor
+RegionQueryCache::RegionQueryCache()
+{
+   mDatabaseId = 0;
+   mTestFunc = NULL;
+   mObjectsExamined = 0;
+   mObjectsCovered = 0;
+   mTotalObjectsExamined = 0;
+   mTotalObjectsCovered = 0;
+}
 
-      const Vector<Point> *poly = fillVector[i]->getCollisionPoly();
 
-      F32 radius, ct;
+// Forget everything; the next search will examine every bucket
+void RegionQueryCache::clear()
+{
+   mBuckets.clear();
+   mMatches.clear();
+   mTestFunc = NULL;
+}
 
-      if(poly)
-      {
-         if(poly->size() == 0)    // This can happen in the editor when a wall segment is completely hidden by another
-            continue;
 
-         Point normal;
-         if(polygonIntersectsSegmentDetailed(&poly->first(), poly->size(), format, rayStart, rayEnd, ct, normal))
+// Inner is inside outer, and not touching its edges, so anything in inner intersects outer
+static bool strictlyContains(const Rect &outer, const Rect &inner)
+{
+   return inner.min.x > outer.min.x && inner.min.y > outer.min.y && inner.max.x < outer.max.x && inner.max.y < outer.max.y;
+}
+
+
+// Can the results of this bucket's last search be used for a search of extents, assuming its contents haven't changed?
+bool RegionQueryCache::CachedBucket::canReuse(const Rect &extents, bool filtered) const
+{
+   // Searching the same region again, or there's nothing in here to find
+   if(searchRect == extents || !hasBounds)
+      return true;
+
+   // Everything in here is outside the region -- no matches
+   if(!bounds.intersects(extents))
+      return true;
+
+   // Everything in here was inside the last region, and is still inside this one, so the matches are the same --
+   // provided we didn't filter any out; we don't know whether the filter would like them anywhere else
+   return !filtered && strictlyContains(searchRect, bounds) && strictlyContains(extents, bounds);
+}
+
+
+bool RegionQueryCache::isLowerBucket(const CachedBucket &a, const CachedBucket &b)
+{
+   return a.bucketIndex < b.bucketIndex;
+}
+
+
+const RegionQueryCache::CachedBucket *RegionQueryCache::findBucket(S32 bucketIndex) const
+{
+   S32 low = 0;
+   S32 high = mBuckets.size() - 1;
+
+   while(low <= high)
+   {
+      S32 mid = (low + high) / 2;
+
+      if(mBuckets[mid].bucketIndex < bucketIndex)
+         low = mid + 1;
+      else if(mBuckets[mid].bucketIndex > bucketIndex)
+         high = mid - 1;
+      else
+         return &mBuckets[mid];
+   }
+
+   return NULL;
+}
+
+
+// What we found this time becomes what we remember for next time
+void RegionQueryCache::finishSearch()
+{
+   std::sort(mNextBuckets.address(), mNextBuckets.address() + mNextBuckets.size(), isLowerBucket);
+
+   mBuckets.getStlVector().swap(mNextBuckets.getStlVector());
+   mMatches.getStlVector().swap(mNextMatches.getStlVector());
+
+   mTotalObjectsExamined += mObjectsExamined;
+   mTotalObjectsCovered += mObjectsCovered;
+}
+
+
+S32 RegionQueryCache::getObjectsExamined() const
+{
+   return mObjectsExamined;
+}
+
+
+S32 RegionQueryCache::getObjectsCovered() const
+{
+   return mObjectsCovered;
+}
+
+
+void RegionQueryCache::collectTotals(U32 &objectsExamined, U32 &objectsCovered)
+{
+   objectsExamined += mTotalObjectsExamined;
+   objectsCovered += mTotalObjectsCovered;
+
+   mTotalObjectsExamined = 0;
+   mTotalObjectsCovered = 0;
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+// Rays get split into groups until the area a group's search covers is no more than this many times the area of an
+// average ray in the group -- beyond that, testing every ray against everything the group finds costs more than the
+// searches it saves
+static const F32 RayGroupSpread = 16;
+
+
+// Constructor
+RayBatch::RayBatch()
+{
+   mGroupCount = 0;
+}
+
+
+void RayBatch::clear()
+{
+   mRays.clear();
+}
+
+
+S32 RayBatch::addRay(const Point &start, const Point &end)
+{
+   Ray ray;
+   ray.start = start;
+   ray.end = end;
+   ray.hitTime = 1;
+   ray.hitObject = NULL;
+
+   mRays.push_back(ray);
+
+   return mRays.size() - 1;
+}
+
+
+S32 RayBatch::getRayCount() const
+{
+   return mRays.size();
+}
+
+
+bool RayBatch::isBlocked(S32 index) const
+{
+   return mRays[index].hitObject != NULL;
+}
+
+
+F32 RayBatch::getHitTime(S32 index) const
+{
+   return mRays[index].hitTime;
+}
+
+
+DatabaseObject *RayBatch::getHitObject(S32 index) const
+{
+   return mRays[index].hitObject;
+}
+
+
+Point RayBatch::getHitNormal(S32 index) const
+{
+   return mRays[index].hitNormal;
+}
+
+
+U32 RayBatch::getGroupCount() const
+{
+   return mGroupCount;
+}
+
+
+// Same rules as findFirstHit() and polygonIntersectsSegmentDetailed()
+void RayBatch::gatherEdges(U32 stateIndex, bool format)
+{
+   mEdgeX.clear();
+   mEdgeY.clear();
+   mEdgeDX.clear();
+   mEdgeDY.clear();
+   mEdgeObject.clear();
+
+   mCircleCenters.clear();
+   mCircleRadii.clear();
+   mCircleObject.clear();
+
+   const Vector<DatabaseObject *> &candidates = mQuery.getResults();
+
+   for(S32 i = 0; i < candidates.size(); i++)
+   {
+      if(!candidates[i]->isCollisionEnabled())
+         continue;
+
+      const Vector<Point> *poly = candidates[i]->getCollisionPoly();
+      Point center;
+      F32 radius;
+
+      if(poly)
+      {
+         S32 inc = format ? 1 : 2;
+         Point v1 = poly->size() > 0 ? poly->last() : Point();
+
+         for(S32 j = 0; j < poly->size() - (inc - 1); j += inc)
          {
-            if(ct < collisionTime)
-            {
-               collisionTime = ct;
-               retObject = fillVector[i];
-               surfaceNormal = normal;
-            }
+            if(!format)
+               v1 = poly->get(j);
+
+            Point v2 = poly->get(j + inc - 1);
+            Point dv = v2 - v1;
+
+            mEdgeX.push_back(v1.x);
+            mEdgeY.push_back(v1.y);
+            mEdgeDX.push_back(dv.x);
+            mEdgeDY.push_back(dv.y);
+            mEdgeObject.push_back(candidates[i]);
+
+            v1 = v2;
          }
       }
-      else if(fillVector[i]->getCollisionCircle(stateIndex, center, radius))
+      else if(candidates[i]->getCollisionCircle(stateIndex, center, radius))
       {
-         if(circleIntersectsSegment(center, radius, rayStart, rayEnd, ct) && ct < collisionTime)
+         mCircleCenters.push_back(center);
+         mCircleRadii.push_back(radius);
+         mCircleObject.push_back(candidates[i]);
+      }
+   }
+
+   // Pad out to a multiple of four with edges of no length, which never get hit
+   while(mEdgeX.size() % 4 != 0)
+   {
+      mEdgeX.push_back(0);
+      mEdgeY.push_back(0);
+      mEdgeDX.push_back(0);
+      mEdgeDY.push_back(0);
+      mEdgeObject.push_back(NULL);
+   }
+}
+
+
+// Finds the first of edges that start-end crosses at less than bestTime along the way, in edge order when several
+// are crossed at the same spot; stops at the first crossing found if nearestHit is false.  Returns the edge's index,
+// or -1 if none are crossed.  The math is the same as polygonIntersectsSegmentDetailed()'s, done four edges at once.
+static S32 findEdgeHit(const F32 *edgeX, const F32 *edgeY, const F32 *edgeDX, const F32 *edgeDY, S32 edgeCount,
+                       const Point &start, const Point &end, bool nearestHit, F32 &bestTime)
+{
+   Point dp = end - start;
+   S32 bestEdge = -1;
+
+#ifdef BF_RAY_SSE
+   const __m128 startX = _mm_set1_ps(start.x);
+   const __m128 startY = _mm_set1_ps(start.y);
+   const __m128 dpX = _mm_set1_ps(dp.x);
+   const __m128 dpY = _mm_set1_ps(dp.y);
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1);
+
+   for(S32 i = 0; i < edgeCount; i += 4)
+   {
+      __m128 vX  = _mm_loadu_ps(edgeX + i);
+      __m128 vY  = _mm_loadu_ps(edgeY + i);
+      __m128 dvX = _mm_loadu_ps(edgeDX + i);
+      __m128 dvY = _mm_loadu_ps(edgeDY + i);
+
+      __m128 denom = _mm_sub_ps(_mm_mul_ps(dpY, dvX), _mm_mul_ps(dpX, dvY));
+      __m128 ax = _mm_sub_ps(startX, vX);
+      __m128 ay = _mm_sub_ps(vY, startY);
+
+      __m128 s = _mm_div_ps(_mm_add_ps(_mm_mul_ps(ax, dvY), _mm_mul_ps(ay, dvX)), denom);
+      __m128 t = _mm_div_ps(_mm_add_ps(_mm_mul_ps(ax, dpY), _mm_mul_ps(ay, dpX)), denom);
+
+      __m128 hit = _mm_and_ps(_mm_cmpneq_ps(denom, zero),
+                   _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(s, zero), _mm_cmplt_ps(s, _mm_set1_ps(bestTime))),
+                              _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmple_ps(t, one))));
+
+      S32 mask = _mm_movemask_ps(hit);
+      if(!mask)
+         continue;
+
+      F32 times[4];
+      _mm_storeu_ps(times, s);
+
+      for(S32 j = 0; j < 4; j++)
+         if((mask & (1 << j)) && times[j] < bestTime)
          {
-            collisionTime = ct;
-            surfaceNormal = (rayStart + (rayEnd - rayStart) * ct) - center;
-            retObject = fillVector[i];
+            bestTime = times[j];
+            bestEdge = i + j;
          }
+
+      if(!nearestHit)
+         break;
+   }
+#else
+   for(S32 i = 0; i < edgeCount; i++)
+   {
+      F32 denom = dp.y * edgeDX[i] - dp.x * edgeDY[i];
+      if(denom == 0)
+         continue;
+
+      F32 ax = start.x - edgeX[i];
+      F32 ay = edgeY[i] - start.y;
+
+      F32 s = (ax * edgeDY[i] + ay * edgeDX[i]) / denom;
+      F32 t = (ax * dp.y + ay * dp.x) / denom;
+
+      if(s >= 0 && s < bestTime && t >= 0 && t <= 1)
+      {
+         bestTime = s;
+         bestEdge = i;
+
+         if(!nearestHit)
+            break;
       }
    }
+#endif
 
-   if(retObject)
-      surfaceNormal.normalize();
+   return bestEdge;
+}
 
-   return retObject;
+
+void RayBatch::castRange(const GridDatabase *database, TestFunc testFunc, U32 stateIndex, bool format, bool nearestHit,
+                         S32 first, S32 count)
+{
+   Rect extents(mRays[mOrder[first]].start, mRays[mOrder[first]].end);
+   F32 rayArea = 0;
+
+   for(S32 i = first; i < first + count; i++)
+   {
+      Rect rayExtents(mRays[mOrder[i]].start, mRays[mOrder[i]].end);
+
+      extents.unionRect(rayExtents);
+      rayArea += (rayExtents.getWidth() + 1) * (rayExtents.getHeight() + 1);     // + 1 so straight rays have some area
+   }
+
+   if(count == 1 || (extents.getWidth() + 1) * (extents.getHeight() + 1) <= RayGroupSpread * rayArea / count)
+   {
+      castGroup(database, testFunc, stateIndex, format, nearestHit, first, count, extents);
+      return;
+   }
+
+   // Too spread out -- split the rays in half across the long side of the area they cover, by their midpoints
+   bool splitX = extents.getWidth() >= extents.getHeight();
+   S32 half = count / 2;
+
+   Vector<Ray> &rays = mRays;
+   nth_element(mOrder.address() + first, mOrder.address() + first + half, mOrder.address() + first + count,
+               [&rays, splitX](S32 a, S32 b)
+               {
+                  Point midA = rays[a].start + rays[a].end;
+                  Point midB = rays[b].start + rays[b].end;
+                  return splitX ? midA.x < midB.x : midA.y < midB.y;
+               });
+
+   castRange(database, testFunc, stateIndex, format, nearestHit, first, half);
+   castRange(database, testFunc, stateIndex, format, nearestHit, first + half, count - half);
+}
+
+
+void RayBatch::castGroup(const GridDatabase *database, TestFunc testFunc, U32 stateIndex, bool format, bool nearestHit,
+                         S32 first, S32 count, const Rect &extents)
+{
+   mGroupCount++;
+
+   mQuery.clearResults();
+   database->findObjects(testFunc, mQuery, extents);
+
+   gatherEdges(stateIndex, format);
+
+   for(S32 i = first; i < first + count; i++)
+   {
+      Ray &ray = mRays[mOrder[i]];
+
+      F32 bestTime = 1;
+      S32 edge = findEdgeHit(mEdgeX.address(), mEdgeY.address(), mEdgeDX.address(), mEdgeDY.address(), mEdgeX.size(),
+                             ray.start, ray.end, nearestHit, bestTime);
+
+      if(edge >= 0)
+      {
+         ray.hitTime = bestTime;
+         ray.hitObject = mEdgeObject[edge];
+         ray.hitNormal.set(mEdgeDY[edge], -mEdgeDX[edge]);
+
+         if(!nearestHit)
+            continue;
+      }
+
+      for(S32 j = 0; j < mCircleObject.size(); j++)
+      {
+         F32 time;
+         if(circleIntersectsSegment(mCircleCenters[j], mCircleRadii[j], ray.start, ray.end, time) && time < ray.hitTime)
+         {
+            ray.hitTime = time;
+            ray.hitObject = mCircleObject[j];
+            ray.hitNormal = (ray.start + (ray.end - ray.start) * time) - mCircleCenters[j];
+
+            if(!nearestHit)
+               break;
+         }
+      }
+
+      if(ray.hitObject)
+         ray.hitNormal.normalize();
+   }
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+// Constructor
+DatabaseObject::DatabaseObject() 
+{
+   initialize();
+}
+
+
+// Copy constructor
+DatabaseObject::DatabaseObject(const DatabaseObject &t) : Parent(t)
+{  
+   initialize();
+   mObjectTypeNumber = t.mObjectTypeNumber; 
+   mExtent = t.mExtent;
+   mExtentSet = t.mExtentSet;
+}
+
+
+// Destructor
+DatabaseObject::~DatabaseObject()
+{
+   TNLAssert(!mDatabase, "Must remove from database when deleting this object");
+   // Do nothing
+}
+
+
+// Code that needs to run for both constructor and copy constructor
+void DatabaseObject::initialize() 
+{
+   mQuerySlot = -1;
+   mExtent = Rect(); 
+   mExtentSet = false;
+   mDatabase = NULL;
+   mBucketSlots.clear();
+}
+
+
+// Find objects along a ray, returning first discovered object, along with time of
+// that collision and a Point representing the normal angle at intersection point
+//             (at least I think that's what's going on here - CE)
+DatabaseObject *GridDatabase::findObjectLOS(U8 typeNumber, U32 stateIndex,
+                                            const Point &rayStart, const Point &rayEnd, 
+                                            float &collisionTime, Point &surfaceNormal) const
+{
+   return findObjectLOS(typeNumber, stateIndex, true, rayStart, rayEnd, collisionTime, surfaceNormal);
+}
+
+
+// Format is a passthrough to polygonLineIntersect().  Will be true for most items, false for walls in editor.
+DatabaseObject *GridDatabase::findObjectLOS(U8 typeNumber, U32 stateIndex, bool format,
+                                            const Point &rayStart, const Point &rayEnd,
+                                            float &collisionTime, Point &surfaceNormal) const
+{
+   // Use our own query here, most callers expect our global fillVector to be left unchanged
+   return findObjectLOS(typeNumber, mDefaultQuery, stateIndex, format, rayStart, rayEnd, collisionTime, surfaceNormal);
 }
 
 
@@ -650,30 +1376,36 @@ DatabaseObject *GridDatabase::findObjectLOS(TestFunc testFunc, U32 stateIndex, b
                                             const Point &rayStart, const Point &rayEnd, 
                                             float &collisionTime, Point &surfaceNormal) const
 {
-   Rect queryRect(rayStart, rayEnd);
+   return findObjectLOS(testFunc, mDefaultQuery, stateIndex, format, rayStart, rayEnd, collisionTime, surfaceNormal);
+}
 
-   static Vector<DatabaseObject *> fillVector;  // Use local here, most callers expect our global fillVector to be left unchanged
-   fillVector.clear();
 
-   findObjects(testFunc, fillVector, queryRect);
+DatabaseObject *GridDatabase::findObjectLOS(TestFunc testFunc, U32 stateIndex,
+                                            const Point &rayStart, const Point &rayEnd,
+                                            float &collisionTime, Point &surfaceNormal) const
+{
+   return findObjectLOS(testFunc, stateIndex, true, rayStart, rayEnd, collisionTime, surfaceNormal);
+}
 
-   Point collisionPoint;
 
+// Figure out which of candidates the ray hits first
+DatabaseObject *GridDatabase::findFirstHit(const Vector<DatabaseObject *> &candidates, U32 stateIndex, bool format,
+                                           const Point &rayStart, const Point &rayEnd, 
+                                           float &collisionTime, Point &surfaceNormal)
+{
    collisionTime = 1;
    DatabaseObject *retObject = NULL;
 
    Point center;
-   Rect rect;
 
-   for(S32 i = 0; i < fillVector.size(); i++)
+   for(S32 i = 0; i < candidates.size(); i++)
    {
-      if(!fillVector[i]->isCollisionEnabled())     // Skip collision-disabled objects
+      if(!candidates[i]->isCollisionEnabled())     // Skip collision-disabled objects
          continue;
 
-      const Vector<Point> *poly = fillVector[i]->getCollisionPoly();
+      const Vector<Point> *poly = candidates[i]->getCollisionPoly();
 
-      F32 radius;
-      float ct;
+      F32 radius, ct;
 
       if(poly)
       {
@@ -681,31 +1413,27 @@ DatabaseObject *GridDatabase::findObjectLOS(TestFunc testFunc, U32 stateIndex, b
             continue;
 
          Point normal;
-         if(polygonIntersectsSegmentDetailed(&poly->get(0), poly->size(), format, rayStart, rayEnd, ct, normal))
+         if(polygonIntersectsSegmentDetailed(&poly->first(), poly->size(), format, rayStart, rayEnd, ct, normal))
          {
             if(ct < collisionTime)
             {
                collisionTime = ct;
-               retObject = fillVector[i];
+               retObject = candidates[i];
                surfaceNormal = normal;
             }
          }
       }
-      else if(fillVector[i]->getCollisionCircle(stateIndex, center, radius))
+      else if(candidates[i]->getCollisionCircle(stateIndex, center, radius))
       {
-         if(circleIntersectsSegment(center, radius, rayStart, rayEnd, ct))
+         if(circleIntersectsSegment(center, radius, rayStart, rayEnd, ct) && ct < collisionTime)
          {
-            if(ct < collisionTime)
-            {
-               collisionTime = ct;
-               surfaceNormal = (rayStart + (rayEnd - rayStart) * ct) - center;
-               retObject = fillVector[i];
-            }
+            collisionTime = ct;
+            surfaceNormal = (rayStart + (rayEnd - rayStart) * ct) - center;
+            retObject = candidates[i];
          }
       }
    }
 
-
    if(retObject)
       surfaceNormal.normalize();
 
@@ -713,11 +1441,61 @@ DatabaseObject *GridDatabase::findObjectLOS(TestFunc testFunc, U32 stateIndex, b
 }
 
 
-DatabaseObject *GridDatabase::findObjectLOS(TestFunc testFunc, U32 stateIndex,
+DatabaseObject *GridDatabase::findObjectLOS(U8 typeNumber, DatabaseQuery &query, U32 stateIndex, bool format,
                                             const Point &rayStart, const Point &rayEnd,
                                             float &collisionTime, Point &surfaceNormal) const
 {
-   return findObjectLOS(testFunc, stateIndex, true, rayStart, rayEnd, collisionTime, surfaceNormal);
+   query.clearResults();
+   findObjects(typeNumber, query, Rect(rayStart, rayEnd));
+
+   return findFirstHit(query.getResults(), stateIndex, format, rayStart, rayEnd, collisionTime, surfaceNormal);
+}
+
+
+DatabaseObject *GridDatabase::findObjectLOS(TestFunc testFunc, DatabaseQuery &query, U32 stateIndex, bool format,
+                                            const Point &rayStart, const Point &rayEnd,
+                                            float &collisionTime, Point &surfaceNormal) const
+{
+   query.clearResults();
+
+   if(testFunc == (TestFunc)isWallType && format && getWallVisibility())
+      return mWallVisibility->findFirstHit(rayStart, rayEnd, true, collisionTime, surfaceNormal);
+
+   findObjects(testFunc, query, Rect(rayStart, rayEnd));
+
+   return findFirstHit(query.getResults(), stateIndex, format, rayStart, rayEnd, collisionTime, surfaceNormal);
+}
+
+
+void GridDatabase::castRays(TestFunc testFunc, U32 stateIndex, RayBatch &batch, bool nearestHit, bool format) const
+{
+   batch.mGroupCount = 0;
+
+   S32 rayCount = batch.mRays.size();
+   if(rayCount == 0)
+      return;
+
+   batch.mOrder.resize(rayCount);
+   for(S32 i = 0; i < rayCount; i++)
+   {
+      batch.mOrder[i] = i;
+      batch.mRays[i].hitTime = 1;
+      batch.mRays[i].hitObject = NULL;
+   }
+
+   // Walls have a quicker way
+   if(testFunc == (TestFunc)isWallType && format && getWallVisibility())
+   {
+      for(S32 i = 0; i < rayCount; i++)
+      {
+         RayBatch::Ray &ray = batch.mRays[i];
+         ray.hitObject = mWallVisibility->findFirstHit(ray.start, ray.end, nearestHit, ray.hitTime, ray.hitNormal);
+      }
+
+      return;
+   }
+
+   batch.castRange(this, testFunc, stateIndex, format, nearestHit, 0, rayCount);
 }
 
 
@@ -900,73 +1678,20 @@ void DatabaseObject::setExtent(const Rect &extents)
 
    GridDatabase *gridDB = getDatabase();
 
+   // Move to different buckets if needed -- the database won't touch mAllObjects, and will do nothing if the buckets haven't changed
    if(gridDB)
-   {
-      // Remove from the extents database for current extents...
-      //gridDB->removeFromDatabase(this, mExtent);    // old extent
-      // ...and re-add for the new extent
-      //gridDB->addToDatabase(this, extents);
-
-
-      S32 minxold, minyold, maxxold, maxyold;
-      S32 minx, miny, maxx, maxy;
+      gridDB->updateBuckets(this, extents);
 
-      minxold = S32(mExtent.min.x) >> GridDatabase::BucketWidthBitShift;
-      minyold = S32(mExtent.min.y) >> GridDatabase::BucketWidthBitShift;
-      maxxold = S32(mExtent.max.x) >> GridDatabase::BucketWidthBitShift;
-      maxyold = S32(mExtent.max.y) >> GridDatabase::BucketWidthBitShift;
-
-      minx    = S32(extents.min.x) >> GridDatabase::BucketWidthBitShift;
-      miny    = S32(extents.min.y) >> GridDatabase::BucketWidthBitShift;
-      maxx    = S32(extents.max.x) >> GridDatabase::BucketWidthBitShift;
-      maxy    = S32(extents.max.y) >> GridDatabase::BucketWidthBitShift;
-
-      // Don't do anything if the buckets haven't changed...
-      if((minxold - minx) | (minyold - miny) | (maxxold - maxx) | (maxyold - maxy))
-      {
-         // They are different... remove and readd to database, but don't touch gridDB->mAllObjects
-         if(U32(maxx - minx) >= gridDB->BucketRowCount)        maxx    = minx    + gridDB->BucketRowCount - 1;
-         if(U32(maxy - miny) >= gridDB->BucketRowCount)        maxy    = miny    + gridDB->BucketRowCount - 1;
-         if(U32(maxxold >= minxold) + gridDB->BucketRowCount)  maxxold = minxold + gridDB->BucketRowCount - 1;
-         if(U32(maxyold >= minyold) + gridDB->BucketRowCount)  maxyold = minyold + gridDB->BucketRowCount - 1;
-
-
-         // Don't use x <= maxx, it will endless loop if maxx = S32_MAX and x overflows
-         // Instead, use maxx - x >= 0, it will better handle overflows and avoid endless loop (MIN_S32 - MAX_S32 = +1)
+   mExtent.set(extents);
+   mExtentSet = true;
 
-         // Remove from the extents database for current extents...
-         while(mBucketList)
-         {
-            DatabaseBucketEntry *b = mBucketList;
-            TNLAssert(b->theObject == this, "Object mismatch");
-            TNLAssert(b->prevInBucket->nextInBucket == b, "Broken linked list");
-            if(b->nextInBucket)
-               b->nextInBucket->prevInBucket = b->prevInBucket;
-            b->prevInBucket->nextInBucket = b->nextInBucket;
-            mBucketList = b->nextInBucketForThisObject;
-            gridDB->mChunker->free(b);
-         }
+   onExtentChanged();
+}
 
-         // ...and re-add for the new extent
-         for(S32 x = minx; maxx - x >= 0; x++)
-            for(S32 y = miny; maxy - y >= 0; y++)
-            {
-               DatabaseBucketEntry *be = gridDB->mChunker->alloc();
-               DatabaseBucketEntryBase *base = &gridDB->mBuckets[x & gridDB->BucketMask][y & gridDB->BucketMask];
-               be->theObject = this;
-               if(base->nextInBucket)
-                  base->nextInBucket->prevInBucket = be;
-               be->nextInBucket = base->nextInBucket;
-               be->prevInBucket = base;
-               base->nextInBucket = be;
-               be->nextInBucketForThisObject = mBucketList;
-               mBucketList = be;
-            }
-      }
-   }
 
-   mExtent.set(extents);
-   mExtentSet = true;
+void DatabaseObject::onExtentChanged()
+{
+   // Do nothing
 }
 
 
@@ -9,10 +9,10 @@
 #include "GeomObject.h"    // Base class
 
 #include "tnlTypes.h"
-#include "tnlDataChunker.h"
 #include "tnlVector.h"
 
 #include "Rect.h"
+#include "SpatialIndex.h"
 
 
 using namespace TNL;
@@ -25,18 +25,163 @@ typedef bool (*TestFunc)(U8);
 // Interface for dealing with objects that can be in our spatial database.
 class GridDatabase;
 class EditorObjectDatabase;
-struct DatabaseBucketEntry;
 class DatabaseObject;
 
-struct DatabaseBucketEntryBase
+// Contents of a single bucket, stored as parallel arrays so queries can scan the extents without touching the objects.
+// Entries are removed by swapping in the last one, so order is not preserved.
+struct DatabaseBucket
 {
-   DatabaseBucketEntry *nextInBucket;
+   Vector<DatabaseObject *> objects;
+   Vector<Rect> extents;         // Copy of each object's extent
+   Vector<S32> slotRefs;         // Which entry of the object's mBucketSlots points back at this bucket
+   U32 revision;                 // Changes whenever an object enters, leaves, or moves within this bucket
+
+   DatabaseBucket();             // Constructor
 };
-struct DatabaseBucketEntry : public DatabaseBucketEntryBase
+
+
+// Everything needed to run a search of a GridDatabase: which objects have been found so far, and a place to put
+// them.  Searches that use their own DatabaseQuery don't touch any shared state, so several threads can search
+// the same database at once, as long as nobody is modifying it in the meantime.
+class DatabaseQuery
 {
-   DatabaseObject *theObject;
-   DatabaseBucketEntryBase *prevInBucket;
-   DatabaseBucketEntry *nextInBucketForThisObject;
+   friend class GridDatabase;
+
+private:
+   Vector<U32> mLastVisit;       // Query number on which each object was last found, indexed by DatabaseObject::mQuerySlot
+   U32 mQueryNumber;
+
+   Vector<DatabaseObject *> mResults;
+
+   void prepare(S32 querySlotCount, bool sameQuery);
+   bool visit(S32 querySlot);    // Returns true the first time an object is seen during the current query
+
+public:
+   DatabaseQuery();     // Constructor
+
+   Vector<DatabaseObject *> &getResults();
+   void clearResults();
+};
+
+
+// Remembers what a search of a region of a GridDatabase found in each bucket, so searching the same region
+// again -- or one covering mostly the same buckets, like the area around a ship that has moved a bit -- only
+// has to re-examine the buckets that have changed since.  Results are only reused from buckets whose contents
+// are exactly as they were, so they never refer to objects that have left the database.  Use the same test
+// function and filter every time with a given cache.
+class RegionQueryCache
+{
+   friend class GridDatabase;
+
+public:
+   // Extra test applied to objects found in the region.  Its verdicts get cached along with everything else, so
+   // it can only depend on things that don't change unless the object's extent does.
+   class Filter
+   {
+   public:
+      virtual ~Filter();
+      virtual bool passes(DatabaseObject *object) const = 0;
+   };
+
+private:
+   struct CachedBucket
+   {
+      S32 bucketIndex;
+      U32 revision;           // Bucket's revision when we examined it
+      Rect searchRect;        // Region the matches were found for
+      Rect bounds;            // Combined extents of everything in the bucket that passed the test function
+      bool hasBounds;         // False if nothing did
+      S32 firstMatch;         // Matches are stored in mMatches
+      S32 matchCount;
+
+      bool canReuse(const Rect &extents, bool filtered) const;
+   };
+
+   U32 mDatabaseId;
+   TestFunc mTestFunc;
+
+   Vector<CachedBucket> mBuckets;         // Sorted by bucketIndex
+   Vector<DatabaseObject *> mMatches;
+   Vector<CachedBucket> mNextBuckets;     // Built up during a search, then swapped with the above
+   Vector<DatabaseObject *> mNextMatches;
+
+   S32 mObjectsExamined;
+   S32 mObjectsCovered;
+   U32 mTotalObjectsExamined;    // Running totals of the above, for stats
+   U32 mTotalObjectsCovered;
+
+   static bool isLowerBucket(const CachedBucket &a, const CachedBucket &b);
+
+   const CachedBucket *findBucket(S32 bucketIndex) const;
+   void finishSearch();
+
+public:
+   RegionQueryCache();     // Constructor
+
+   void clear();
+
+   S32 getObjectsExamined() const;     // Objects the last search had to look at
+   S32 getObjectsCovered() const;      // Objects in all the buckets the last search covered; what an uncached search looks at
+
+   // Adds the totals of the above since the last call to the arguments, and starts counting again
+   void collectTotals(U32 &objectsExamined, U32 &objectsCovered);
+};
+
+
+// A set of rays to cast against a GridDatabase all at once with GridDatabase::castRays().  Rays near each other are
+// grouped, each group searches the database once, and the edges of everything found are tested against all the
+// group's rays together, four edges at a time.  Everything here is reused from one batch to the next.
+class RayBatch
+{
+   friend class GridDatabase;
+
+private:
+   struct Ray
+   {
+      Point start;
+      Point end;
+      F32 hitTime;                  // Fraction of the way from start to end, 1 if nothing was hit
+      DatabaseObject *hitObject;
+      Point hitNormal;
+   };
+
+   Vector<Ray> mRays;
+   Vector<S32> mOrder;              // Ray indices, rearranged as rays get grouped
+
+   DatabaseQuery mQuery;
+
+   // Edges of the objects found for the current group, split up by coordinate so they can be tested four at a time
+   Vector<F32> mEdgeX, mEdgeY, mEdgeDX, mEdgeDY;
+   Vector<DatabaseObject *> mEdgeObject;
+
+   // Objects found for the current group that are circles rather than polygons
+   Vector<Point> mCircleCenters;
+   Vector<F32> mCircleRadii;
+   Vector<DatabaseObject *> mCircleObject;
+
+   U32 mGroupCount;
+
+   void gatherEdges(U32 stateIndex, bool format);
+
+   // Splits rays first through first + count - 1 (in mOrder) into groups that are close together, and casts each
+   void castRange(const GridDatabase *database, TestFunc testFunc, U32 stateIndex, bool format, bool nearestHit,
+                  S32 first, S32 count);
+   void castGroup(const GridDatabase *database, TestFunc testFunc, U32 stateIndex, bool format, bool nearestHit,
+                  S32 first, S32 count, const Rect &extents);
+
+public:
+   RayBatch();    // Constructor
+
+   void clear();
+   S32 addRay(const Point &start, const Point &end);     // Returns the ray's index
+   S32 getRayCount() const;
+
+   bool isBlocked(S32 index) const;
+   F32 getHitTime(S32 index) const;
+   DatabaseObject *getHitObject(S32 index) const;
+   Point getHitNormal(S32 index) const;                  // Normalized; only set if castRays() looked for nearest hits
+
+   U32 getGroupCount() const;                            // Database searches made by the last castRays()
 };
 
 
@@ -50,15 +195,18 @@ class DatabaseObject : public GeomObject
 
 
 private:
-   U32 mLastQueryId;
+   S32 mQuerySlot;      // Index assigned by our database, used by DatabaseQuery to track which objects it has found
    Rect mExtent;
    bool mExtentSet;     // A flag to mark whether extent has been set on this object
    GridDatabase *mDatabase;
-   DatabaseBucketEntry *mBucketList;
+   BucketRange mBucketRange;     // Which buckets we're currently stored in
+   Vector<S32> mBucketSlots;     // Our position in each of those buckets, in the order they are visited
 
 protected:
    U8 mObjectTypeNumber;
 
+   virtual void onExtentChanged();              // Called by setExtent()
+
 public:
    DatabaseObject();                            // Constructor
    DatabaseObject(const DatabaseObject &t);     // Copy constructor
@@ -98,45 +246,55 @@ public:
 ////////////////////////////////////////
 
 class WallSegmentManager;
+class WallVisibility;
 class GoalZone;
 class BfObject;
 
 class GridDatabase
 {
+   friend class DatabaseObject;     // For updateBuckets()
+
 private:
    U32 mDatabaseId;
-   static U32 mQueryId;
-   static U32 mCountGridDatabase;      // Reference counter for destruction of mChunker
+
+   mutable DatabaseQuery mDefaultQuery;      // Used by the older findObjects() overloads that don't take a DatabaseQuery
+
+   Vector<S32> mFreeQuerySlots;
+   S32 mQuerySlotCount;
 
    WallSegmentManager *mWallSegmentManager;
+   WallVisibility *mWallVisibility;    // NULL unless buildWallVisibility() has been called
 
    Vector<DatabaseObject *> mAllObjects;
    Vector<DatabaseObject *> mGoalZones;
    Vector<DatabaseObject *> mFlags;
    Vector<DatabaseObject *> mSpyBugs;
 
-   void findObjects(U8 typeNumber, Vector<DatabaseObject *> &fillVector, const Rect *extents, const IntRect *bins) const;
-   void findObjects(Vector<U8> typeNumbers, Vector<DatabaseObject *> &fillVector, const Rect *extents, const IntRect *bins) const;
-   void findObjects(TestFunc testFunc, Vector<DatabaseObject *> &fillVector, const Rect *extents, const IntRect *bins, bool sameQuery = false) const;
+   SpatialIndex *mSpatialIndex;
+   Vector<DatabaseBucket> mBuckets;
+   Vector<S32> mLevelObjectCounts;     // Number of objects stored on each level of mSpatialIndex, so we can skip empty ones
+   U32 mRevision;                      // Last revision handed out to a bucket
 
-   void fillBins(const Rect &extents, IntRect &bins) const;    // Helper function -- translates extents into bins to search
+   void touchBucket(DatabaseBucket &bucket);
+   void onObjectChanged(const DatabaseObject *theObject);     // Throws out mWallVisibility if theObject is a wall
 
-public:
-   enum {
-      BucketRowCount = 16,    // Number of buckets per grid row, and number of rows; should be power of 2
-      BucketMask = BucketRowCount - 1,
-   };
+   void linkToBuckets(DatabaseObject *theObject, const BucketRange &range, const Rect &extents);
+   void unlinkFromBuckets(DatabaseObject *theObject);
+   void updateBucketExtents(DatabaseObject *theObject, const Rect &extents);
+   void updateBuckets(DatabaseObject *theObject, const Rect &newExtents);
 
-   static ClassChunker<DatabaseBucketEntry> *mChunker;
-
-   DatabaseBucketEntryBase mBuckets[BucketRowCount][BucketRowCount];
+   template <class TypeTest>
+   void findObjectsInBuckets(const TypeTest &typeTest, DatabaseQuery &query, Vector<DatabaseObject *> &fillVector,
+                             const Rect &extents, bool sameQuery) const;
 
+public:
    explicit GridDatabase(bool createWallSegmentManager = true);   // Constructor
    // GridDatabase::GridDatabase(const GridDatabase &source);
    virtual ~GridDatabase();                                       // Destructor
 
-
-   static const S32 BucketWidthBitShift = 8;    // Width/height of each bucket in pixels, in a form of 2 ^ n, 8 is 256 pixels
+   void setSpatialIndex(SpatialIndexType type, const Rect &levelExtents);   // Rebuilds buckets; safe to call when populated
+   SpatialIndexType getSpatialIndexType() const;
+   S32 getBucketCount() const;
 
    DatabaseObject *findObjectLOS(U8 typeNumber, U32 stateIndex, bool format, const Point &rayStart, const Point &rayEnd,
                                  float &collisionTime, Point &surfaceNormal) const;
@@ -147,6 +305,26 @@ public:
    DatabaseObject *findObjectLOS(TestFunc testFunc, U32 stateIndex, const Point &rayStart, const Point &rayEnd,
                                  float &collisionTime, Point &surfaceNormal) const;
 
+   // Reentrant versions of the above; query's results are replaced with the objects examined along the way
+   DatabaseObject *findObjectLOS(U8 typeNumber, DatabaseQuery &query, U32 stateIndex, bool format, const Point &rayStart,
+                                 const Point &rayEnd, float &collisionTime, Point &surfaceNormal) const;
+   DatabaseObject *findObjectLOS(TestFunc testFunc, DatabaseQuery &query, U32 stateIndex, bool format, const Point &rayStart,
+                                 const Point &rayEnd, float &collisionTime, Point &surfaceNormal) const;
+
+   // The part of findObjectLOS() that picks which of the objects found near the ray it hits first
+   static DatabaseObject *findFirstHit(const Vector<DatabaseObject *> &candidates, U32 stateIndex, bool format,
+                                       const Point &rayStart, const Point &rayEnd, float &collisionTime, Point &surfaceNormal);
+
+   // Casts every ray in batch against the objects passing testFunc.  With nearestHit, finds what each ray hits first,
+   // the same as findObjectLOS() (except maybe which object, when two are hit at exactly the same spot); otherwise
+   // just finds whether anything is in the way, which is quicker.
+   void castRays(TestFunc testFunc, U32 stateIndex, RayBatch &batch, bool nearestHit = true, bool format = true) const;
+
+   // Puts the walls now in the database into a WallVisibility, which findObjectLOS(), castRays() and
+   // pointCanSeePoint() then use for isWallType checks, until a wall is added, removed or moved
+   bool buildWallVisibility();
+   WallVisibility *getWallVisibility() const;     // NULL if there isn't a usable one
+
    bool pointCanSeePoint(const Point &point1, const Point &point2);
    void computeSelectionMinMax(Point &min, Point &max);
 
@@ -163,6 +341,20 @@ public:
    void findObjects(const Vector<U8> &types, Vector<DatabaseObject *> &fillVector) const;
    void findObjects(const Vector<U8> &types, Vector<DatabaseObject *> &fillVector, const Rect &extents) const;
 
+   // Reentrant versions of the spatial searches above -- results are appended to query.getResults().  Passing
+   // sameQuery = true skips anything found by the previous search with the same query.
+   void findObjects(U8 typeNumber, DatabaseQuery &query, const Rect &extents, bool sameQuery = false) const;
+   void findObjects(TestFunc testFunc, DatabaseQuery &query, const Rect &extents, bool sameQuery = false) const;
+   void findObjects(const Vector<U8> &types, DatabaseQuery &query, const Rect &extents, bool sameQuery = false) const;
+
+   // Same as findObjects(testFunc, query, extents, sameQuery), with an optional filter, but only re-examines buckets
+   // that have changed since the last search with the same cache
+   void findObjects(TestFunc testFunc, DatabaseQuery &query, RegionQueryCache &cache, const Rect &extents,
+                    const RegionQueryCache::Filter *filter = NULL, bool sameQuery = false) const;
+
+   U32 getRevision() const;      // Changes whenever anything in the database is added, removed or moved
+   U32 getRevision(const Rect &extents) const;   // Changes whenever anything that overlaps extents does
+
    BfObject *findObjectById(S32 id) const;
 
    void copyObjects(const GridDatabase *source);
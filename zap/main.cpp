@@ -120,6 +120,7 @@ using namespace TNL;
 #include "BotNavMeshZone.h"
 #include "ship.h"
 #include "LevelSource.h"
+#include "TickStats.h"
 
 #include <math.h>
 #include <stdarg.h>
@@ -169,6 +170,8 @@ namespace Zap
 
 ZapJournal gZapJournal;          // Our main journaling object
 
+static TickStats *tickStats = NULL;    // Created with -tick-stats
+
 void exitToOs(S32 errcode)
 {
 #ifdef TNL_OS_XBOX
@@ -214,6 +217,9 @@ void hostGame(ServerGame *serverGame)
       clientGames->get(i)->joinLocalGame(serverGame->getNetInterface());  // ...then we'll play, too!
    }
 #endif
+
+   if(serverGame->isDedicated())
+      initExtraHosting(serverGame);    // Run any other games requested with -instances
 }
 
 
@@ -278,6 +284,16 @@ void checkIfServerGameIsShuttingDown(U32 timeDelta)
    ServerGame *serverGame = GameManager::getServerGame();
 
    string shutdownReason;
+
+   // Extra instances of a multi-instance server just go away on their own; the others keep running
+   const Vector<ServerGame *> *serverGames = GameManager::getServerGames();
+   for(S32 i = serverGames->size() - 1; i > 0; i--)
+      if(serverGames->get(i)->isReadyToShutdown(timeDelta, shutdownReason))
+      {
+         logprintf(LogConsumer::ServerFilter, "Game instance %d shut down: %s", i + 1, shutdownReason.c_str());
+         GameManager::deleteServerGame(serverGames->get(i));
+      }
+
    if(serverGame && serverGame->isReadyToShutdown(timeDelta, shutdownReason))
    {
 #ifndef ZAP_DEDICATED
@@ -351,9 +367,15 @@ void idle()
    bool dedicated = GameManager::getServerGame() && GameManager::getServerGame()->isDedicated();
 
    U32 maxFPS = dedicated ? settings->getIniSettings()->maxDedicatedFPS : settings->getIniSettings()->maxFPS;
+   U32 frameTime = 1000 / maxFPS;
+
+   static bool pacedTick = false;      // Was this tick supposed to come one frame after the last one?
 
-   if(deltaT >= S32(1000 / maxFPS))
+   if(deltaT >= S32(frameTime))
    {
+      if(tickStats)
+         tickStats->beginTick(frameTime, pacedTick);
+
       checkIfServerGameIsShuttingDown(U32(deltaT));
       GameManager::idle(U32(deltaT));
 
@@ -368,6 +390,9 @@ void idle()
 
       if(!dedicated)
          sleepTime = 0;      
+
+      if(tickStats)
+         tickStats->endTick();
    }
 
 
@@ -392,14 +417,24 @@ void idle()
 #endif
 
 
-   // Sleep a bit so we don't saturate the system. For a non-dedicated server,
-   // sleep(0) helps reduce the impact of OpenGL on windows.
+   // A dedicated server sleeps on its sockets until the next tick is due or, when no one is playing, until one of
+   // the games' timers needs looking after.  Packets wake it right away, and get read without waiting for the tick.
+   if(dedicated)
+   {
+      S32 sinceTick = deltaT + S32(Platform::getRealMilliseconds() - prevTimer);
+      U32 untilTick = sinceTick < S32(frameTime) ? frameTime - sinceTick : 0;
+      U32 untilIdleNeeded = GameManager::getTimeUntilServerIdleNeeded();
+
+      pacedTick = (untilIdleNeeded == 0);
 
-   // If there are no players, set sleepTime to 40 to further reduce impact on the server.
-   // We'll only go into this longer sleep on dedicated servers when there are no players.
-   if(dedicated && GameManager::getServerGame()->isSuspended())
-      sleepTime = 40;     // The higher this number, the less accurate the ping is on server lobby when empty, but the less power consumed.
+      if(GameManager::waitForServerPackets(untilIdleNeeded > untilTick ? untilIdleNeeded : untilTick))
+         GameManager::checkIncomingServerPackets();
 
+      return;
+   }
+
+   // Sleep a bit so we don't saturate the system. For a non-dedicated server,
+   // sleep(0) helps reduce the impact of OpenGL on windows.
    Platform::sleep(sleepTime);
 
 }  // end idle()
@@ -623,6 +658,7 @@ void setupLogging(const string &logDir)
 
    gMainLog.init(joindir(logDir, "bitfighter.log"), "w");
    gMainLog.logprintf("------ Bitfighter Log File ------");
+   gMainLog.setMsgType(LogConsumer::NetStatsFilter, false);    // Servers logging them open a file of their own
 
 #ifndef BF_NO_CONSOLE
    gOglConsoleLog.setMsgTypes(consoleEvents);   // writes to in-game console
@@ -1204,6 +1240,7 @@ int main(int argc, char **argv)
       checkIfThisIsAnUpdate(settings.get(), isStandalone);
 
    // Load Lua stuff
+   LuaScriptRunner::setPooledAllocation(settings->getIniSettings()->pooledLuaAllocator);
    LuaScriptRunner::startLua(folderManager->luaDir);  // Create single "L" instance which all scripts will use
    // TODO: What should we do if this fails?  Quit the game?
 
@@ -1305,6 +1342,9 @@ int main(int argc, char **argv)
 #endif
    }
 
+   if(settings->getSpecified(TICK_STATS))
+      tickStats = new TickStats();     // Lives as long as the process does
+
    // We made it!
    gStdoutLog.logprintf("Welcome to Bitfighter!");
 
@@ -241,6 +241,27 @@ void Projectile::onAddedToGame(Game *game)
    Parent::onAddedToGame(game);
 }
 
+
+// Where the projectile will be after time ms, if it doesn't hit anything
+Point Projectile::getEndPos(const Point &startPos, F32 time) const
+{
+   return startPos + (mVelocity * .001f) * time;    // mVelocity in units/sec
+}
+
+
+// The first search idle() does
+bool Projectile::getIdleQuery(U32 timeDelta, TestFunc &testFunc, Rect &queryRect) const
+{
+   if(!mAlive || isGhost())
+      return false;
+
+   testFunc = (TestFunc)isWeaponCollideableType;
+   queryRect = Rect(getPos(), getEndPos(getPos(), (F32)timeDelta));
+
+   return true;
+}
+
+
 void Projectile::idle(BfObject::IdleCallPath path)
 {
    U32 deltaT = mCurrentMove.time;
@@ -260,10 +281,11 @@ void Projectile::idle(BfObject::IdleCallPath path)
          startPos = getPos();
 
          // Calculate where projectile will be at the end of the current interval
-         Point endPos = startPos + (mVelocity * .001f) * timeLeft;    // mVelocity in units/sec, timeLeft in ms
+         Point endPos = getEndPos(startPos, timeLeft);
 
          // Check for collision along projected route of movement
          static Vector<BfObject *> disabledList;
+         static Vector<DatabaseObject *> candidates;
 
          Rect queryRect(startPos, endPos);     // Bounding box of our travels
 
@@ -285,7 +307,11 @@ void Projectile::idle(BfObject::IdleCallPath path)
          // Do the search
          while(true)  
          {
-            hitObject = findObjectLOS((TestFunc)isWeaponCollideableType, RenderState, startPos, endPos, collisionTime, surfNormal);
+            candidates.clear();
+            findIdleObjects((TestFunc)isWeaponCollideableType, candidates, queryRect);    // Everything we could hit
+
+            hitObject = static_cast<BfObject *>(
+                  GridDatabase::findFirstHit(candidates, RenderState, true, startPos, endPos, collisionTime, surfNormal));
 
             if((!hitObject || hitObject->collide(this)))
                break;
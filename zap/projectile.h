@@ -35,6 +35,7 @@ private:
    BfObject *mLastHitObject;    // Last object hit by the projectile
 
    void initialize(WeaponType type, const Point &pos, const Point &vel, BfObject *shooter);
+   Point getEndPos(const Point &startPos, F32 time) const;
 
 protected:
    enum MaskBits {
@@ -74,6 +75,7 @@ public:
    void onAddedToGame(Game *game);
 
    void idle(BfObject::IdleCallPath path);
+   bool getIdleQuery(U32 timeDelta, TestFunc &testFunc, Rect &queryRect) const;
    void damageObject(DamageInfo *info);
    void explode(BfObject *hitObject, Point p);
 
@@ -14,6 +14,7 @@
 #include "GeomUtils.h"
 
 #include "ServerGame.h"
+#include "WallVisibility.h"
 #include "GameManager.h"
 
 
@@ -133,6 +134,7 @@ Robot::Robot(lua_State *L) : Ship(NULL, TEAM_NEUTRAL, Point(0,0), true),
 
    mCurrentZone = U16_MAX;
    flightPlanTo = U16_MAX;
+   mNextPathHandle = 0;
 
    mPlayerInfo = new RobotPlayerInfo(this);
 
@@ -213,7 +215,7 @@ bool Robot::initialize(Point &pos)
    catch(LuaException &e)
    {
       logError("Robot error during spawn: %s.  Shutting robot down.", e.what());
-      clearStack(L);
+      clearStack(getLuaState());
       return false;
    }
 
@@ -224,10 +226,27 @@ bool Robot::initialize(Point &pos)
 const char *Robot::getErrorMessagePrefix() { return "***ROBOT ERROR***"; }
 
 
+// Several bots often run the same script, so tell them apart by name
+string Robot::getProfileName()
+{
+   if(!mClientInfo)
+      return LuaScriptRunner::getProfileName();
+
+   return string(mClientInfo->getName().getString()) + " (" + LuaScriptRunner::getProfileName() + ")";
+}
+
+
 // Server only
 bool Robot::start()
 {
-   if(!getGame() || !runScript(!getGame()->isTestServer()))   // Load the script, execute the chunk to get it in memory, then run its main() function
+   if(!getGame())
+      return false;
+
+   // With a Lua state of our own, our onTick handler can run on a worker thread, alongside other bots'
+   if(getGame()->getSettings()->getIniSettings()->parallelBotScripts && !hasOwnLuaState() && !createOwnLuaState())
+      return false;
+
+   if(!runScript(!getGame()->isTestServer()))   // Load the script, execute the chunk to get it in memory, then run its main() function
       return false;
 
    // Pass true so that if this bot doesn't have a TickEvent handler, we don't print a message
@@ -251,6 +270,8 @@ bool Robot::prepareEnvironment()
    if(!LuaScriptRunner::prepareEnvironment())
       return false;
 
+   lua_State *L = getLuaState();
+
    // Set this first so we have this object available in the helper functions in case we need overrides
    setSelf(L, this, "bot");
 
@@ -274,6 +295,8 @@ static string getNextName()
 // Run bot's getName function, return default name if fn isn't defined
 string Robot::runGetName()
 {
+   lua_State *L = getLuaState();
+
    TNLAssert(lua_gettop(L) == 0 || dumpStack(L), "Stack dirty!");
 
    // error will only be true if: 1) getName doesn't exist, which should never happen -- getName is stubbed out in robot_helper_functions.lua
@@ -501,6 +524,18 @@ F32 Robot::getAnglePt(Point point)
 
 bool Robot::canSeePoint(Point point, bool wallOnly)
 {
+   // If we know which bot zones can't possibly see each other, points in zones hidden from ours can't be seen; anything
+   // else needs checking for real
+   const WallVisibility *wallVisibility = mGame->getGameObjDatabase()->getWallVisibility();
+
+   if(wallVisibility && wallVisibility->hasZoneVisibility())
+   {
+      U16 pointZone = static_cast<ServerGame *>(getGame())->findZoneContaining(point);
+
+      if(pointZone != U16_MAX && !wallVisibility->canZonesSee(U16(getCurrentZone()), pointZone))
+         return false;
+   }
+
    Point difference = point - getActualPos();
 
    Point crossVector(difference.y, -difference.x);  // Create a point whose vector from 0,0 is perpenticular to the original vector
@@ -615,6 +650,22 @@ Robot *Robot::clone() const
 }
 
 
+struct ZoneCandidate
+{
+   BotNavMeshZone *zone;
+   F32 distSquared;
+};
+
+
+static S32 QSORT_CALLBACK zoneCandidateSort(ZoneCandidate *a, ZoneCandidate *b)
+{
+   if(a->distSquared == b->distSquared)
+      return 0;
+
+   return a->distSquared < b->distSquared ? -1 : 1;
+}
+
+
 // Another helper function: returns id of closest zone to a given point
 U16 Robot::findClosestZone(const Point &point)
 {
@@ -630,16 +681,37 @@ U16 Robot::findClosestZone(const Point &point)
 
    getGame()->getBotZoneDatabase()->findObjects(BotNavMeshZoneTypeNumber, objects, rect);
 
+   // Nearest zones first, since they're the likeliest to see the point
+   Vector<ZoneCandidate> candidates(objects.size());
    for(S32 i = 0; i < objects.size(); i++)
    {
-      BotNavMeshZone *zone = static_cast<BotNavMeshZone *>(objects[i]);
-      Point center = zone->getCenter();
+      ZoneCandidate candidate;
+      candidate.zone = static_cast<BotNavMeshZone *>(objects[i]);
+      candidate.distSquared = candidate.zone->getCenter().distSquared(point);
+      candidates.push_back(candidate);
+   }
 
-      if(getGame()->getGameObjDatabase()->pointCanSeePoint(center, point))  // This is an expensive test
-      {
-         closestZone = zone->getZoneId();
-         break;
-      }
+   candidates.sort(zoneCandidateSort);
+
+   // Seeing whether point can be seen from each zone's center is the expensive part.  Usually one of the first few
+   // can, so cast a few rays at a time, and stop at the first batch with a zone that sees it; we only care whether
+   // the rays are blocked, not where.
+   for(S32 first = 0; first < candidates.size() && closestZone == U16_MAX; first += ZoneRayBatchSize)
+   {
+      S32 count = getMin(ZoneRayBatchSize, candidates.size() - first);
+
+      mZoneRays.clear();
+      for(S32 i = 0; i < count; i++)
+         mZoneRays.addRay(candidates[first + i].zone->getCenter(), point);
+
+      getGame()->getGameObjDatabase()->castRays((TestFunc)isWallType, ActualState, mZoneRays, false);
+
+      for(S32 i = 0; i < count; i++)
+         if(!mZoneRays.isBlocked(i))
+         {
+            closestZone = candidates[first + i].zone->getZoneId();
+            break;
+         }
    }
 
    // Target must be outside extents of the map, find nearest zone if a straight line was drawn
@@ -671,6 +743,9 @@ U16 Robot::findClosestZone(const Point &point)
    METHOD(CLASS,  canSeePoint,          ARRAYDEF({{ PT, END }              }), 1 )           \
                                                                                              \
    METHOD(CLASS,  getWaypoint,          ARRAYDEF({{ PT, END }}), 1 )                         \
+   METHOD(CLASS,  requestPath,          ARRAYDEF({{ PT, END }}), 1 )                         \
+   METHOD(CLASS,  isPathReady,          ARRAYDEF({{ INT, END }}), 1 )                        \
+   METHOD(CLASS,  getPath,              ARRAYDEF({{ INT, END }}), 1 )                        \
                                                                                              \
    METHOD(CLASS,  setThrust,            ARRAYDEF({{ NUM, NUM, END }, { NUM, PT, END}}), 2 )  \
    METHOD(CLASS,  setThrustToPt,        ARRAYDEF({{ PT,       END }                 }), 1 )  \
@@ -904,26 +979,163 @@ S32 Robot::lua_getWaypoint(lua_State *L)
    // or the path we had no longer applied to our current location
    flightPlanTo = targetZone;
 
-   // check cache for path first
-   pair<S32,S32> pathIndex = pair<S32,S32>(currentZone, targetZone);
+   // Paths are shared by all bots on the level, so someone has probably been this way before
+   flightPlan = static_cast<ServerGame *>(getGame())->getBotPathCache()->findPath(currentZone, targetZone, target);
+
+   if(flightPlan.size() > 0)
+      return returnPoint(L, flightPlan.last());
+   else
+      return returnNil(L);    // Out of options, end of the road
+}
+
 
-   const Vector<BotNavMeshZone *> *zones = static_cast<ServerGame *>(getGame())->getBotZones();  // Our pre-cached list of nav zones
+/**
+ * @luafunc num Robot::requestPath(point p)
+ *
+ * @brief Ask for a path to `p` without waiting for it to be found.
+ *
+ * @descr Paths are found between ticks, together with those of all other bots,
+ * so a bot never holds up the game while its path is worked out.  Use
+ * isPathReady() or subscribe to the PathReady event to find out when it's done.
+ * Once a path is ready, getWaypoint() will follow it without searching again.
+ *
+ * A bot can have 8 requests outstanding; asking for more forgets the oldest.
+ *
+ * @param p The destination point
+ *
+ * @return A handle identifying the request, or `nil` if the bot or `p` is off
+ * the map
+ */
+S32 Robot::lua_requestPath(lua_State *L)
+{
+   checkArgList(L, functionArgs, "Robot", "requestPath");
+
+   Point target = getPointOrXY(L, 1);
+
+   ServerGame *game = static_cast<ServerGame *>(getGame());
+
+   U16 targetZone = game->findZoneContaining(target);
+   if(targetZone == U16_MAX)
+      targetZone = findClosestZone(target);
 
-   if(getGame()->getGameType()->cachedBotFlightPlans.find(pathIndex) == getGame()->getGameType()->cachedBotFlightPlans.end())
+   U16 currentZone = getCurrentZone();
+   if(currentZone == U16_MAX)
+      currentZone = findClosestZone(getActualPos());
+
+   if(targetZone == U16_MAX || currentZone == U16_MAX)
+      return returnNil(L);
+
+   if(mPathRequests.size() == MaxPathRequests)
+      mPathRequests.erase(0);
+
+   mNextPathHandle++;
+
+   PathRequest request;
+   request.handle = mNextPathHandle;
+   request.targetZone = targetZone;
+   request.target = target;
+   request.ready = false;
+   request.found = false;
+
+   mPathRequests.push_back(request);
+
+   game->queueBotPath(this, mNextPathHandle, currentZone, targetZone, target);
+
+   return returnInt(L, mNextPathHandle);
+}
+
+
+/**
+ * @luafunc bool Robot::isPathReady(num handle)
+ *
+ * @brief Has the path asked for with requestPath() been worked out yet?
+ *
+ * @param handle The handle returned by requestPath()
+ *
+ * @return `true` once the search is done, whether or not a path was found
+ */
+S32 Robot::lua_isPathReady(lua_State *L)
+{
+   checkArgList(L, functionArgs, "Robot", "isPathReady");
+
+   PathRequest *request = findPathRequest(getInt(L, 1));
+
+   return returnBool(L, request && request->ready);
+}
+
+
+/**
+ * @luafunc table Robot::getPath(num handle)
+ *
+ * @brief Get the path asked for with requestPath().
+ *
+ * @param handle The handle returned by requestPath()
+ *
+ * @return A table of points to fly through, starting with the nearest and
+ * ending with the destination, or `nil` if the path isn't ready or there is
+ * no way there
+ */
+S32 Robot::lua_getPath(lua_State *L)
+{
+   checkArgList(L, functionArgs, "Robot", "getPath");
+
+   PathRequest *request = findPathRequest(getInt(L, 1));
+
+   clearStack(L);
+
+   if(!request || !request->found)
+      return returnNil(L);
+
+   Vector<Point> points;
+   for(S32 i = request->path.size() - 1; i >= 0; i--)
+      points.push_back(request->path[i]);
+
+   return returnPoints(L, &points);
+}
+
+
+Robot::PathRequest *Robot::findPathRequest(S32 handle)
+{
+   for(S32 i = 0; i < mPathRequests.size(); i++)
+      if(mPathRequests[i].handle == handle)
+         return &mPathRequests[i];
+
+   return NULL;
+}
+
+
+// Called by ServerGame between ticks, with path laid out like AStar::findPath(); path is empty if there's no way there
+void Robot::onPathSolved(S32 handle, U16 targetZone, const Vector<Point> &path)
+{
+   PathRequest *request = findPathRequest(handle);
+
+   if(!request)      // Forgotten already
+      return;
+
+   request->ready = true;
+   request->found = path.size() > 0;
+   request->path = path;
+
+   if(request->found)
    {
-      // Not found so calculate flight plan
-      flightPlan = AStar::findPath(zones, currentZone, targetZone, target);
+      request->path[0] = request->target;    // Paths are shared, and another bot may have been going somewhere else
 
-      // Add to cache
-      getGame()->getGameType()->cachedBotFlightPlans[pathIndex] = flightPlan;
+      // getWaypoint() can pick it up from here
+      flightPlan = request->path;
+      flightPlanTo = targetZone;
    }
-   else
-      flightPlan = getGame()->getGameType()->cachedBotFlightPlans[pathIndex];
 
-   if(flightPlan.size() > 0)
-      return returnPoint(L, flightPlan.last());
-   else
-      return returnNil(L);    // Out of options, end of the road
+   EventManager::get()->fireEvent(this, EventManager::PathReadyEvent, handle, request->found);
+}
+
+
+// Level is changing, so the search won't be happening
+void Robot::cancelPathRequest(S32 handle)
+{
+   PathRequest *request = findPathRequest(handle);
+
+   if(request)
+      request->ready = true;
 }
 
 
@@ -38,6 +38,28 @@ private:
 
    bool mHasSpawned;
 
+   // Paths asked for with requestPath(), which ServerGame solves between ticks
+   struct PathRequest
+   {
+      S32 handle;
+      U16 targetZone;
+      Point target;
+      bool ready;
+      bool found;
+      Vector<Point> path;        // Laid out like flightPlan
+   };
+
+   static const S32 MaxPathRequests = 8;     // Asking for more forgets the oldest
+
+   Vector<PathRequest> mPathRequests;        // Oldest first
+   S32 mNextPathHandle;
+
+   PathRequest *findPathRequest(S32 handle);
+
+   static const S32 ZoneRayBatchSize = 8;    // Rays findClosestZone() casts at a time
+
+   RayBatch mZoneRays;                       // Reused by findClosestZone()
+
    Point getNextWaypoint();                          // Helper function for getWaypoint()
    U16 findClosestZone(const Point &point);          // Finds zone closest to point, used when robots get off the map
 
@@ -66,12 +88,16 @@ public:
    Vector<Point> flightPlan;           // List of points to get from one point to another
    U16 flightPlanTo;                   // Zone our flightplan was calculated to
 
+   void onPathSolved(S32 handle, U16 targetZone, const Vector<Point> &path);
+   void cancelPathRequest(S32 handle);
+
    // Some informational functions
    F32 getAnglePt(Point point);
 
    bool isRobot();
 
    const char *getErrorMessagePrefix();
+   string getProfileName();
 
    LuaPlayerInfo *getPlayerInfo();
    bool start();
@@ -102,6 +128,9 @@ public:
 
    // Navigation
    S32 lua_getWaypoint(lua_State *L);
+   S32 lua_requestPath(lua_State *L);
+   S32 lua_isPathReady(lua_State *L);
+   S32 lua_getPath(lua_State *L);
 
    // Finding stuff
    S32 lua_findVisibleObjects(lua_State *L);
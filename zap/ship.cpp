@@ -1683,7 +1683,8 @@ F32 Ship::getUpdatePriority(GhostConnection *connection, U32 updateMask, S32 upd
 {
    F32 value = Parent::getUpdatePriority(connection, updateMask, updateSkips);
 
-   if(getControllingClient())
+   // Avoid copying the SafePtr here, as this can be called from several threads at once
+   if(controllingClientIsValid())
       value += 2.3f;
    else
       value -= 2.3f;
@@ -1692,6 +1693,12 @@ F32 Ship::getUpdatePriority(GhostConnection *connection, U32 updateMask, S32 upd
 }
 
 
+bool Ship::hasBatchedUpdatePriority()
+{
+   return false;     // Our getUpdatePriority() needs to be called
+}
+
+
 void Ship::updateInterpolation()
 {
    Parent::updateInterpolation();